@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 
+#include "contrib/endpoints/include/api_manager/auth_statistics.h"
 #include "contrib/endpoints/include/api_manager/env_interface.h"
 #include "contrib/endpoints/include/api_manager/request.h"
 #include "contrib/endpoints/include/api_manager/request_handler_interface.h"
@@ -34,6 +35,7 @@ namespace api_manager {
 // copied into a shared memory.
 struct ApiManagerStatistics {
   service_control::Statistics service_control_statistics;
+  AuthStatistics auth_statistics;
 };
 
 class ApiManager {
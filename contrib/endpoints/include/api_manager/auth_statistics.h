@@ -0,0 +1,87 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_STATISTICS_H_
+#define API_MANAGER_AUTH_STATISTICS_H_
+
+#include <stdint.h>
+
+#include "contrib/endpoints/include/api_manager/latency_histogram.h"
+
+namespace google {
+namespace api_manager {
+
+// The stages of the authentication of a request, in execution order.
+enum AuthStage {
+  AUTH_STAGE_GET_AUTH_TOKEN = 0,
+  AUTH_STAGE_LOOKUP_JWT_CACHE,
+  AUTH_STAGE_PARSE_JWT,
+  AUTH_STAGE_CHECK_AUDIENCE,
+  // Includes waiting for the key fetch and OpenID discovery.
+  AUTH_STAGE_INIT_KEY,
+  // Includes waiting for a signature verification worker.
+  AUTH_STAGE_VERIFY_SIGNATURE,
+  AUTH_STAGE_PASS_USER_INFO,
+  AUTH_STAGE_MAX,
+};
+
+// The statistics recorded by API authentication.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct AuthStatistics {
+  // The latency of each stage, indexed by AuthStage. Time spent waiting for
+  // a key fetch or a worker thread counts toward its stage.
+  LatencyHistogram stage_latency[AUTH_STAGE_MAX];
+  // The latency of the whole authentication of a request.
+  LatencyHistogram total_latency;
+
+  // JWT cache lookups.
+  uint64_t jwt_cache_hits;
+  uint64_t jwt_cache_misses;
+
+  // Key lookups for signature verification. A miss waits for a key fetch.
+  uint64_t key_cache_hits;
+  uint64_t key_cache_misses;
+
+  // Key fetches, including the background refreshes, and those that failed.
+  uint64_t key_fetches;
+  uint64_t key_fetch_failures;
+
+  // JWTs rejected from the negative JWT cache without being verified. A
+  // sudden rise means the same invalid tokens are being replayed.
+  uint64_t negative_jwt_cache_hits;
+  // JWTs missing from both JWT caches, which are parsed and verified.
+  uint64_t negative_jwt_cache_misses;
+
+  // Merge two statistics.
+  void Merge(const AuthStatistics& v) {
+    for (int i = 0; i < AUTH_STAGE_MAX; ++i) {
+      stage_latency[i].Merge(v.stage_latency[i]);
+    }
+    total_latency.Merge(v.total_latency);
+    jwt_cache_hits += v.jwt_cache_hits;
+    jwt_cache_misses += v.jwt_cache_misses;
+    key_cache_hits += v.key_cache_hits;
+    key_cache_misses += v.key_cache_misses;
+    key_fetches += v.key_fetches;
+    key_fetch_failures += v.key_fetch_failures;
+    negative_jwt_cache_hits += v.negative_jwt_cache_hits;
+    negative_jwt_cache_misses += v.negative_jwt_cache_misses;
+  }
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_STATISTICS_H_
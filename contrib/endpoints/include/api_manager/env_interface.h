@@ -60,7 +60,21 @@ class ApiManagerEnvInterface {
   // (possibly before returning).
   virtual void RunHTTPRequest(std::unique_ptr<HTTPRequest> request) = 0;
 
+  // Environment support for issuing unary gRPC requests. The environment
+  // takes ownership of the request, and is responsible for eventually
+  // invoking request->OnComplete() with the result of the request. It is
+  // expected to keep a long-lived channel to each server and to multiplex
+  // the concurrent requests to that server over it, so that requests do not
+  // pay for connection and TLS setup. An environment without gRPC support
+  // completes the request with UNIMPLEMENTED.
   virtual void RunGRPCRequest(std::unique_ptr<GRPCRequest> request) = 0;
+
+  // Schedules a callback to run on the thread that drives the API Manager.
+  // Unlike the other methods, this may be called from any thread. Returns
+  // false, without running the callback, if the environment does not
+  // support it; the API Manager then does all its work on the driving
+  // thread.
+  virtual bool PostCallback(std::function<void()> callback) { return false; }
 };
 
 }  // namespace api_manager
@@ -16,6 +16,7 @@
 #define API_MANAGER_GRPC_REQUEST_H_
 
 #include <functional>
+#include <map>
 #include <string>
 
 #include "contrib/endpoints/include/api_manager/utils/status.h"
@@ -29,7 +30,7 @@ class GRPCRequest {
  public:
   // GRPCRequest constructor without headers in the callback function.
   GRPCRequest(std::function<void(utils::Status, std::string&&)> callback)
-      : callback_(callback) {}
+      : callback_(callback), secure_(false), timeout_ms_(0) {}
 
   // A callback for the environment to invoke when the request is
   // complete. This will be invoked by the environment exactly once,
@@ -61,6 +62,13 @@ class GRPCRequest {
     return *this;
   }
 
+  // Whether the channel to the server uses TLS.
+  bool secure() const { return secure_; }
+  GRPCRequest& set_secure(bool value) {
+    secure_ = value;
+    return *this;
+  }
+
   // The gRPC service name.
   const std::string& service() const { return service_; }
   GRPCRequest& set_service(const std::string& value) {
@@ -82,13 +90,43 @@ class GRPCRequest {
     body_ = std::move(value);
     return *this;
   }
+  // Lets the callback take the body back, e.g. to resend it or to reuse its
+  // buffer, once the request is complete.
+  std::string* mutable_body() { return &body_; }
+
+  // The metadata to send with the request.
+  const std::map<std::string, std::string>& metadata() const {
+    return metadata_;
+  }
+  GRPCRequest& set_metadata(const std::string& name,
+                            const std::string& value) {
+    metadata_[name] = value;
+    return *this;
+  }
+
+  GRPCRequest& set_auth_token(const std::string& value) {
+    if (!value.empty()) {
+      set_metadata("authorization", "Bearer " + value);
+    }
+    return *this;
+  }
+
+  // Timeout, in milliseconds, for the request. 0 for no timeout.
+  int timeout_ms() const { return timeout_ms_; }
+  GRPCRequest& set_timeout_ms(int value) {
+    timeout_ms_ = value;
+    return *this;
+  }
 
  private:
   std::function<void(utils::Status, std::string&&)> callback_;
   std::string method_;
   std::string server_;
+  bool secure_;
   std::string service_;
   std::string body_;
+  std::map<std::string, std::string> metadata_;
+  int timeout_ms_;
 };
 
 }  // namespace api_manager
@@ -84,6 +84,9 @@ class HTTPRequest {
     body_ = std::move(value);
     return *this;
   }
+  // Lets the callback take the body back, e.g. to reuse its buffer, once the
+  // request is complete.
+  std::string* mutable_body() { return &body_; }
 
   HTTPRequest& set_auth_token(const std::string& value) {
     if (!value.empty()) {
@@ -0,0 +1,66 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_LATENCY_HISTOGRAM_H_
+#define API_MANAGER_LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+namespace google {
+namespace api_manager {
+
+// The number of buckets of a LatencyHistogram.
+const int kLatencyHistogramBuckets = 10;
+
+// The upper bounds of the LatencyHistogram buckets in microseconds, for
+// local work such as the auth stages. The last bucket has no upper bound.
+const uint64_t kLatencyHistogramBoundsUs[kLatencyHistogramBuckets - 1] = {
+    10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000};
+
+// The upper bounds for the latencies of RPCs to remote servers, from 1 ms to
+// 10 s.
+const uint64_t kRpcLatencyHistogramBoundsUs[kLatencyHistogramBuckets - 1] = {
+    1000, 3000, 10000, 30000, 100000, 300000, 1000000, 3000000, 10000000};
+
+// A histogram of latencies.
+// Important note: please don't use std::string. These fields are directly
+// copied into a shared memory.
+struct LatencyHistogram {
+  // The number of latencies recorded.
+  uint64_t count;
+  // The sum and the maximum of the latencies in microseconds.
+  uint64_t total_us;
+  uint64_t max_us;
+  // buckets[i] counts the latencies below the i-th upper bound of the
+  // histogram, kLatencyHistogramBoundsUs or kRpcLatencyHistogramBoundsUs,
+  // and at or above the bound of the previous bucket.
+  uint64_t buckets[kLatencyHistogramBuckets];
+
+  // Merge two histograms.
+  void Merge(const LatencyHistogram& v) {
+    count += v.count;
+    total_us += v.total_us;
+    if (v.max_us > max_us) {
+      max_us = v.max_us;
+    }
+    for (int i = 0; i < kLatencyHistogramBuckets; ++i) {
+      buckets[i] += v.buckets[i];
+    }
+  }
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_LATENCY_HISTOGRAM_H_
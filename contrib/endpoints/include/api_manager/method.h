@@ -68,6 +68,12 @@ class MethodInfo {
   virtual const std::vector<std::string> *api_key_url_query_parameters()
       const = 0;
 
+  // Get the url query parameters, then the lowercased http headers, to look
+  // the api_key up in, in that order. These are the default ones if no
+  // api_key system parameter is configured.
+  virtual const std::vector<std::string> &api_key_lookup_queries() const = 0;
+  virtual const std::vector<std::string> &api_key_lookup_headers() const = 0;
+
   // Get the backend address for this method.
   virtual const std::string &backend_address() const = 0;
 
@@ -87,8 +93,9 @@ class MethodInfo {
   // Get whether response is streaming
   virtual bool response_streaming() const = 0;
 
-  // Get the names of url system parameters
-  virtual const std::set<std::string> &system_query_parameter_names() const = 0;
+  // Get the names of url system parameters, sorted.
+  virtual const std::vector<std::string> &system_query_parameter_names()
+      const = 0;
 
   // Get quota metric cost vector
   virtual const std::vector<std::pair<std::string, int>> &metric_cost_vector()
@@ -15,10 +15,20 @@
 #ifndef API_MANAGER_SERVICE_CONTROL_H_
 #define API_MANAGER_SERVICE_CONTROL_H_
 
+#include "contrib/endpoints/include/api_manager/latency_histogram.h"
+
 namespace google {
 namespace api_manager {
 namespace service_control {
 
+// The RPCs sent to the service control server.
+enum Rpc {
+  RPC_CHECK = 0,
+  RPC_ALLOCATE_QUOTA,
+  RPC_REPORT,
+  RPC_MAX,
+};
+
 // The statistics recorded by service control library.
 // Important note: please don't use std::string. These fields are directly
 // copied into a shared memory.
@@ -46,6 +56,57 @@ struct Statistics {
   // Maximum report request size send to server.
   uint64_t max_report_size;
 
+  // Check, AllocateQuota and Report request protobufs allocated, and those
+  // served by reusing a pooled protobuf.
+  uint64_t check_request_allocs;
+  uint64_t check_request_reuses;
+  uint64_t quota_request_allocs;
+  uint64_t quota_request_reuses;
+  uint64_t report_request_allocs;
+  uint64_t report_request_reuses;
+
+  // Reports whose metrics were rolled up locally, and the operations the
+  // rollups were sent as.
+  uint64_t rolled_up_reports;
+  uint64_t rolled_up_operations;
+
+  // Cached check responses refreshed in the background before a request
+  // had to wait for them.
+  uint64_t refreshed_ahead_checks;
+
+  // Quota allocations served from pre-allocated quota, and the
+  // pre-allocations sent to the server.
+  uint64_t local_quota_allocations;
+  uint64_t quota_preallocations;
+
+  // Undelivered reports kept in the spill file, replayed from it, and
+  // dropped because the file was full or the server rejected them.
+  uint64_t spilled_reports;
+  uint64_t replayed_spilled_reports;
+  uint64_t dropped_spilled_reports;
+
+  // The report aggregation cache size and flush interval in use. The
+  // interval follows the load if adaptive flushing is enabled.
+  uint64_t report_cache_entries;
+  uint64_t report_flush_interval_ms;
+
+  // The latency of each RPC, indexed by Rpc, from the request being sent to
+  // its response being parsed, and the RPCs that failed.
+  LatencyHistogram rpc_latency[RPC_MAX];
+  uint64_t rpc_failures[RPC_MAX];
+  // The time to serialize, and compress, the request of each RPC.
+  LatencyHistogram serialize_latency[RPC_MAX];
+  // The bytes of the requests sent and of the responses received.
+  uint64_t request_bytes[RPC_MAX];
+  uint64_t response_bytes[RPC_MAX];
+
+  // Check() and Quota() calls answered from the cache of the service control
+  // client, and those which had to wait for the server.
+  uint64_t check_cache_hits;
+  uint64_t check_cache_misses;
+  uint64_t quota_cache_hits;
+  uint64_t quota_cache_misses;
+
   // Merge two statistics.
   void Merge(const Statistics& v) {
     total_called_checks += v.total_called_checks;
@@ -57,6 +118,37 @@ struct Statistics {
     if (v.max_report_size > max_report_size) {
       max_report_size = v.max_report_size;
     }
+    check_request_allocs += v.check_request_allocs;
+    check_request_reuses += v.check_request_reuses;
+    quota_request_allocs += v.quota_request_allocs;
+    quota_request_reuses += v.quota_request_reuses;
+    report_request_allocs += v.report_request_allocs;
+    report_request_reuses += v.report_request_reuses;
+    rolled_up_reports += v.rolled_up_reports;
+    rolled_up_operations += v.rolled_up_operations;
+    refreshed_ahead_checks += v.refreshed_ahead_checks;
+    local_quota_allocations += v.local_quota_allocations;
+    quota_preallocations += v.quota_preallocations;
+    spilled_reports += v.spilled_reports;
+    replayed_spilled_reports += v.replayed_spilled_reports;
+    dropped_spilled_reports += v.dropped_spilled_reports;
+    if (v.report_cache_entries > report_cache_entries) {
+      report_cache_entries = v.report_cache_entries;
+    }
+    if (v.report_flush_interval_ms > report_flush_interval_ms) {
+      report_flush_interval_ms = v.report_flush_interval_ms;
+    }
+    for (int i = 0; i < RPC_MAX; ++i) {
+      rpc_latency[i].Merge(v.rpc_latency[i]);
+      rpc_failures[i] += v.rpc_failures[i];
+      serialize_latency[i].Merge(v.serialize_latency[i]);
+      request_bytes[i] += v.request_bytes[i];
+      response_bytes[i] += v.response_bytes[i];
+    }
+    check_cache_hits += v.check_cache_hits;
+    check_cache_misses += v.check_cache_misses;
+    quota_cache_hits += v.quota_cache_hits;
+    quota_cache_misses += v.quota_cache_misses;
   }
 };
 
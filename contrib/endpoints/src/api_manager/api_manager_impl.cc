@@ -16,6 +16,7 @@
 //
 #include "contrib/endpoints/src/api_manager/api_manager_impl.h"
 #include "contrib/endpoints/src/api_manager/check_workflow.h"
+#include "contrib/endpoints/src/api_manager/fetch_pub_key.h"
 #include "contrib/endpoints/src/api_manager/request_handler.h"
 
 namespace google {
@@ -37,7 +38,8 @@ ApiManagerImpl::ApiManagerImpl(std::unique_ptr<ApiManagerEnvInterface> env,
 void ApiManagerImpl::AddConfig(const std::string &service_config,
                                bool deploy_it) {
   std::unique_ptr<Config> config =
-      Config::Create(global_context_->env(), service_config);
+      Config::Create(global_context_->env(), service_config,
+                     global_context_->http_template_cache());
   if (config != nullptr) {
     std::string service_name = config->service().name();
     if (global_context_->service_name().empty()) {
@@ -75,15 +77,42 @@ utils::Status ApiManagerImpl::Init() {
     global_context_->cloud_trace_aggregator()->Init();
   }
 
+  // Worker threads are started here rather than in the constructor, which
+  // may run in a process that forks the workers.
+  auth::SignatureVerifier *verifier = global_context_->signature_verifier();
+  if (verifier->num_threads() > 0 && !verifier->Start()) {
+    global_context_->env()->LogWarning(
+        "JWT signatures are verified inline: the environment cannot post "
+        "callbacks from worker threads.");
+  }
+
   for (auto it : service_context_map_) {
     if (it.second->service_control()) {
       it.second->service_control()->Init();
     }
   }
+
+  pubkey_refresh_timer_ = global_context_->env()->StartPeriodicTimer(
+      kPubKeyRefreshInterval, [this]() {
+        for (auto it : service_context_map_) {
+          if (it.second->RequireAuth()) {
+            RefreshPubKeys(it.second);
+          }
+        }
+      });
+
+  // Auth tokens generated from the client secret are signed ahead of their
+  // expiration instead of by the first request that finds them expired.
+  global_context_->service_account_token()->StartRefreshTimer();
   return utils::Status::OK;
 }
 
 utils::Status ApiManagerImpl::Close() {
+  if (pubkey_refresh_timer_) {
+    pubkey_refresh_timer_->Stop();
+  }
+  global_context_->service_account_token()->StopRefreshTimer();
+
   if (global_context_->cloud_trace_aggregator()) {
     global_context_->cloud_trace_aggregator()->SendAndClearTraces();
   }
@@ -123,7 +152,11 @@ utils::Status ApiManagerImpl::GetStatistics(
     ApiManagerStatistics *statistics) const {
   memset(&statistics->service_control_statistics, 0,
          sizeof(service_control::Statistics));
+  memset(&statistics->auth_statistics, 0, sizeof(AuthStatistics));
   for (const auto &it : service_context_map_) {
+    AuthStatistics auth_stat;
+    it.second->GetAuthStatistics(&auth_stat);
+    statistics->auth_statistics.Merge(auth_stat);
     if (it.second->service_control()) {
       service_control::Statistics stat;
       auto status = it.second->service_control()->GetStatistics(&stat);
@@ -73,6 +73,9 @@ class ApiManagerImpl : public ApiManager {
 
   // A weighted service selector.
   std::unique_ptr<WeightedSelector> service_selector_;
+
+  // The timer to refresh the verification keys before they expire.
+  std::unique_ptr<PeriodicTimer> pubkey_refresh_timer_;
 };
 
 }  // namespace api_manager
@@ -81,6 +81,15 @@ TEST_F(ApiManagerTest, CorrectStatistics) {
   EXPECT_EQ(0, service_control_stat.send_reports_by_flush);
   EXPECT_EQ(0, service_control_stat.send_reports_in_flight);
   EXPECT_EQ(0, service_control_stat.send_report_operations);
+  EXPECT_EQ(0, service_control_stat.rpc_latency[service_control::RPC_CHECK]
+                   .count);
+  EXPECT_EQ(0, service_control_stat.request_bytes[service_control::RPC_REPORT]);
+  EXPECT_EQ(0, service_control_stat.check_cache_hits);
+  EXPECT_EQ(0, statistics.auth_statistics.negative_jwt_cache_hits);
+  EXPECT_EQ(0, statistics.auth_statistics.negative_jwt_cache_misses);
+  EXPECT_EQ(0, statistics.auth_statistics.total_latency.count);
+  EXPECT_EQ(0, statistics.auth_statistics.jwt_cache_misses);
+  EXPECT_EQ(0, statistics.auth_statistics.key_fetches);
 }
 
 }  // namespace
@@ -0,0 +1,70 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/auth_stats.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+AuthStats::AuthStats()
+    : jwt_cache_hits_(0),
+      jwt_cache_misses_(0),
+      key_cache_hits_(0),
+      key_cache_misses_(0),
+      key_fetches_(0),
+      key_fetch_failures_(0) {}
+
+void AuthStats::RecordStage(AuthStage stage,
+                            std::chrono::steady_clock::duration latency) {
+  stages_[stage].Record(latency);
+}
+
+void AuthStats::RecordTotal(std::chrono::steady_clock::duration latency) {
+  total_.Record(latency);
+}
+
+void AuthStats::CountJwtCacheLookup(bool hit) {
+  ++(hit ? jwt_cache_hits_ : jwt_cache_misses_);
+}
+
+void AuthStats::CountKeyCacheLookup(bool hit) {
+  ++(hit ? key_cache_hits_ : key_cache_misses_);
+}
+
+void AuthStats::CountKeyFetch(bool ok) {
+  ++key_fetches_;
+  if (!ok) {
+    ++key_fetch_failures_;
+  }
+}
+
+void AuthStats::GetStatistics(AuthStatistics* stat) const {
+  for (int i = 0; i < AUTH_STAGE_MAX; ++i) {
+    stages_[i].Get(&stat->stage_latency[i]);
+  }
+  total_.Get(&stat->total_latency);
+  stat->jwt_cache_hits = jwt_cache_hits_;
+  stat->jwt_cache_misses = jwt_cache_misses_;
+  stat->key_cache_hits = key_cache_hits_;
+  stat->key_cache_misses = key_cache_misses_;
+  stat->key_fetches = key_fetches_;
+  stat->key_fetch_failures = key_fetch_failures_;
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
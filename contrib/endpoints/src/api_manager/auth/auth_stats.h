@@ -0,0 +1,68 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_AUTH_STATS_H_
+#define API_MANAGER_AUTH_AUTH_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "contrib/endpoints/include/api_manager/auth_statistics.h"
+#include "contrib/endpoints/src/api_manager/utils/atomic_latency_histogram.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// Records the latencies and the cache and key fetch counts of API
+// authentication. All methods are thread safe; they only update atomic
+// counters.
+class AuthStats {
+ public:
+  AuthStats();
+
+  // Records the latency of one stage of the authentication of a request.
+  void RecordStage(AuthStage stage,
+                   std::chrono::steady_clock::duration latency);
+
+  // Records the latency of the whole authentication of a request.
+  void RecordTotal(std::chrono::steady_clock::duration latency);
+
+  void CountJwtCacheLookup(bool hit);
+  void CountKeyCacheLookup(bool hit);
+  // Counts a completed key fetch.
+  void CountKeyFetch(bool ok);
+
+  // Copies out the statistics. The negative JWT cache counts are not kept
+  // here and are left unchanged.
+  void GetStatistics(AuthStatistics* stat) const;
+
+ private:
+  utils::AtomicLatencyHistogram stages_[AUTH_STAGE_MAX];
+  utils::AtomicLatencyHistogram total_;
+
+  std::atomic<uint64_t> jwt_cache_hits_;
+  std::atomic<uint64_t> jwt_cache_misses_;
+  std::atomic<uint64_t> key_cache_hits_;
+  std::atomic<uint64_t> key_cache_misses_;
+  std::atomic<uint64_t> key_fetches_;
+  std::atomic<uint64_t> key_fetch_failures_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_AUTH_STATS_H_
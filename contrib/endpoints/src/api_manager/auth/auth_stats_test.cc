@@ -0,0 +1,141 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/auth_stats.h"
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using std::chrono::microseconds;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+
+AuthStatistics GetStatistics(const AuthStats& stats) {
+  AuthStatistics stat;
+  memset(&stat, 0, sizeof(stat));
+  stats.GetStatistics(&stat);
+  return stat;
+}
+
+TEST(AuthStats, Empty) {
+  AuthStats stats;
+  AuthStatistics stat = GetStatistics(stats);
+  for (int i = 0; i < AUTH_STAGE_MAX; ++i) {
+    ASSERT_EQ(0u, stat.stage_latency[i].count);
+  }
+  ASSERT_EQ(0u, stat.total_latency.count);
+  ASSERT_EQ(0u, stat.jwt_cache_hits);
+  ASSERT_EQ(0u, stat.key_fetches);
+}
+
+TEST(AuthStats, RecordStage) {
+  AuthStats stats;
+  stats.RecordStage(AUTH_STAGE_PARSE_JWT, microseconds(5));
+  stats.RecordStage(AUTH_STAGE_PARSE_JWT, microseconds(10));
+  stats.RecordStage(AUTH_STAGE_PARSE_JWT, microseconds(250));
+  stats.RecordStage(AUTH_STAGE_PARSE_JWT, std::chrono::seconds(1));
+  // A negative latency from a clock adjustment counts as zero.
+  stats.RecordStage(AUTH_STAGE_INIT_KEY, microseconds(-3));
+
+  AuthStatistics stat = GetStatistics(stats);
+  const LatencyHistogram& parse = stat.stage_latency[AUTH_STAGE_PARSE_JWT];
+  ASSERT_EQ(4u, parse.count);
+  ASSERT_EQ(1000265u, parse.total_us);
+  ASSERT_EQ(1000000u, parse.max_us);
+  ASSERT_EQ(1u, parse.buckets[0]);
+  ASSERT_EQ(1u, parse.buckets[1]);
+  ASSERT_EQ(1u, parse.buckets[3]);
+  ASSERT_EQ(1u, parse.buckets[kLatencyHistogramBuckets - 1]);
+
+  const LatencyHistogram& init_key = stat.stage_latency[AUTH_STAGE_INIT_KEY];
+  ASSERT_EQ(1u, init_key.count);
+  ASSERT_EQ(0u, init_key.total_us);
+  ASSERT_EQ(1u, init_key.buckets[0]);
+
+  ASSERT_EQ(0u, stat.stage_latency[AUTH_STAGE_VERIFY_SIGNATURE].count);
+  ASSERT_EQ(0u, stat.total_latency.count);
+}
+
+TEST(AuthStats, Counters) {
+  AuthStats stats;
+  stats.RecordTotal(microseconds(40));
+  stats.CountJwtCacheLookup(true);
+  stats.CountJwtCacheLookup(true);
+  stats.CountJwtCacheLookup(false);
+  stats.CountKeyCacheLookup(false);
+  stats.CountKeyFetch(true);
+  stats.CountKeyFetch(false);
+
+  AuthStatistics stat = GetStatistics(stats);
+  ASSERT_EQ(1u, stat.total_latency.count);
+  ASSERT_EQ(1u, stat.total_latency.buckets[2]);
+  ASSERT_EQ(2u, stat.jwt_cache_hits);
+  ASSERT_EQ(1u, stat.jwt_cache_misses);
+  ASSERT_EQ(0u, stat.key_cache_hits);
+  ASSERT_EQ(1u, stat.key_cache_misses);
+  ASSERT_EQ(2u, stat.key_fetches);
+  ASSERT_EQ(1u, stat.key_fetch_failures);
+}
+
+TEST(AuthStats, Merge) {
+  AuthStats stats1;
+  stats1.RecordStage(AUTH_STAGE_CHECK_AUDIENCE, microseconds(20));
+  stats1.CountJwtCacheLookup(true);
+  AuthStats stats2;
+  stats2.RecordStage(AUTH_STAGE_CHECK_AUDIENCE, microseconds(2000));
+  stats2.CountJwtCacheLookup(false);
+
+  AuthStatistics stat = GetStatistics(stats1);
+  stat.Merge(GetStatistics(stats2));
+  const LatencyHistogram& audience =
+      stat.stage_latency[AUTH_STAGE_CHECK_AUDIENCE];
+  ASSERT_EQ(2u, audience.count);
+  ASSERT_EQ(2020u, audience.total_us);
+  ASSERT_EQ(2000u, audience.max_us);
+  ASSERT_EQ(1u, stat.jwt_cache_hits);
+  ASSERT_EQ(1u, stat.jwt_cache_misses);
+}
+
+TEST(AuthStats, ConcurrentRecord) {
+  AuthStats stats;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&stats, t]() {
+      for (int i = 0; i < 1000; ++i) {
+        stats.RecordStage(AUTH_STAGE_VERIFY_SIGNATURE, microseconds(t * 100));
+        stats.CountKeyCacheLookup(true);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  AuthStatistics stat = GetStatistics(stats);
+  ASSERT_EQ(4000u, stat.stage_latency[AUTH_STAGE_VERIFY_SIGNATURE].count);
+  ASSERT_EQ(300u, stat.stage_latency[AUTH_STAGE_VERIFY_SIGNATURE].max_us);
+  ASSERT_EQ(4000u, stat.key_cache_hits);
+}
+
+}  // namespace
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,106 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/certs.h"
+
+using std::chrono::system_clock;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+Certs::Certs() : issuer_cert_map_(std::make_shared<const CertMap>()) {}
+
+void Certs::Update(const std::string& issuer, const std::string& cert,
+                   system_clock::time_point expiration) {
+  // Keys are parsed before taking the lock.
+  std::shared_ptr<const Cert> entry = std::make_shared<const Cert>(
+      std::shared_ptr<const PublicKeys>(
+          PublicKeys::Create(cert.data(), cert.size())),
+      expiration);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::shared_ptr<CertMap> map =
+      std::make_shared<CertMap>(*std::atomic_load(&issuer_cert_map_));
+  (*map)[issuer] = entry;
+  std::atomic_store(&issuer_cert_map_, std::shared_ptr<const CertMap>(map));
+}
+
+std::shared_ptr<const Certs::Cert> Certs::GetCert(
+    const std::string& iss) const {
+  std::shared_ptr<const CertMap> map = std::atomic_load(&issuer_cert_map_);
+  auto it = map->find(iss);
+  return it == map->end() ? nullptr : it->second;
+}
+
+bool Certs::StartFetch(const std::string& issuer, FetchCallback on_done) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = pending_fetches_.find(issuer);
+  if (it != pending_fetches_.end()) {
+    it->second.push_back(on_done);
+    return false;
+  }
+  pending_fetches_[issuer].push_back(on_done);
+  return true;
+}
+
+void Certs::FinishFetch(const std::string& issuer,
+                        const utils::Status& status) {
+  // A callback may start a new fetch for the same issuer, so the entry is
+  // removed before any of them runs, and they run without the lock.
+  std::vector<FetchCallback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_fetches_.find(issuer);
+    if (it == pending_fetches_.end()) {
+      return;
+    }
+    callbacks.swap(it->second);
+    pending_fetches_.erase(it);
+  }
+  for (const auto& callback : callbacks) {
+    callback(status);
+  }
+}
+
+bool Certs::IsFetching(const std::string& issuer) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return IsFetchingLocked(issuer);
+}
+
+bool Certs::IsFetchingLocked(const std::string& issuer) const {
+  return pending_fetches_.find(issuer) != pending_fetches_.end();
+}
+
+std::vector<std::string> Certs::GetIssuersToRefresh(
+    system_clock::time_point now, system_clock::duration window,
+    system_clock::duration max_stale) const {
+  std::shared_ptr<const CertMap> map = std::atomic_load(&issuer_cert_map_);
+  std::vector<std::string> issuers;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& it : *map) {
+    const system_clock::time_point& expiration = it.second->second;
+    if (expiration < now + window && expiration + max_stale > now &&
+        !IsFetchingLocked(it.first)) {
+      issuers.push_back(it.first);
+    }
+  }
+  return issuers;
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
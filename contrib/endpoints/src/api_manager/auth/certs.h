@@ -16,33 +16,84 @@
 #define API_MANAGER_AUTH_CERTS_H_
 
 #include <chrono>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include "contrib/endpoints/include/api_manager/utils/status.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
 
 namespace google {
 namespace api_manager {
 namespace auth {
 
-// A class to manage certs for token validation.
+// A class to manage certs for token validation. The keys are parsed when
+// they are updated, so verifying a token only looks up a parsed key.
+//
+// Certs also tracks the key fetches in flight, so that concurrent requests
+// for the same issuer wait on a single fetch, and selects the issuers whose
+// keys should be refreshed in the background before they expire.
+//
+// All methods are thread safe. The keys are published as immutable
+// snapshots: an update copies the issuer map and swaps it in, so lookups
+// never wait for an update, and a key returned by GetCert() stays valid
+// after it has been replaced.
 class Certs {
  public:
+  typedef std::function<void(const utils::Status&)> FetchCallback;
+
+  // The parsed verification keys of an issuer and their absolute expiration
+  // time.
+  typedef std::pair<std::shared_ptr<const PublicKeys>,
+                    std::chrono::system_clock::time_point>
+      Cert;
+
+  Certs();
+
   void Update(const std::string& issuer, const std::string& cert,
-              std::chrono::system_clock::time_point expiration) {
-    issuer_cert_map_[issuer] = std::make_pair(cert, expiration);
-  }
+              std::chrono::system_clock::time_point expiration);
+
+  // Returns the keys of the issuer, or nullptr if they were never fetched.
+  std::shared_ptr<const Cert> GetCert(const std::string& iss) const;
+
+  // Queues "on_done" to be called when the key fetch for "issuer" completes.
+  // Returns true if no fetch was in flight, in which case the caller must
+  // start one and call FinishFetch() when it completes.
+  bool StartFetch(const std::string& issuer, FetchCallback on_done);
 
-  const std::pair<std::string, std::chrono::system_clock::time_point>* GetCert(
-      const std::string& iss) {
-    return issuer_cert_map_.find(iss) == issuer_cert_map_.end()
-               ? nullptr
-               : &(issuer_cert_map_[iss]);
-  }
+  // Completes the key fetch in flight for "issuer", calling every queued
+  // callback with "status".
+  void FinishFetch(const std::string& issuer, const utils::Status& status);
+
+  // Returns true if a key fetch for "issuer" is in flight.
+  bool IsFetching(const std::string& issuer) const;
+
+  // Returns the issuers whose keys expire before "now + window" and are
+  // not being fetched. Keys that expired more than "max_stale" ago are
+  // no longer refreshed; the next request for them fetches them again.
+  std::vector<std::string> GetIssuersToRefresh(
+      std::chrono::system_clock::time_point now,
+      std::chrono::system_clock::duration window,
+      std::chrono::system_clock::duration max_stale) const;
 
  private:
-  // Map from issuer to a verification key and its absolute expiration time.
-  std::map<std::string,
-           std::pair<std::string, std::chrono::system_clock::time_point> >
-      issuer_cert_map_;
+  typedef std::map<std::string, std::shared_ptr<const Cert> > CertMap;
+
+  // Returns true if a key fetch for "issuer" is in flight. Requires mutex_.
+  bool IsFetchingLocked(const std::string& issuer) const;
+
+  // The current snapshot of the map from issuer to its keys. It is read
+  // and replaced with the atomic shared_ptr operations.
+  std::shared_ptr<const CertMap> issuer_cert_map_;
+
+  // Serializes the updates of issuer_cert_map_ and guards pending_fetches_.
+  mutable std::mutex mutex_;
+
+  // Map from issuer to the callbacks waiting on its key fetch in flight.
+  std::map<std::string, std::vector<FetchCallback> > pending_fetches_;
 };
 
 }  // namespace auth
@@ -0,0 +1,171 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/certs.h"
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+using std::chrono::seconds;
+using std::chrono::system_clock;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+
+const char kIssuer1[] = "https://issuer1.com";
+const char kIssuer2[] = "https://issuer2.com";
+const char kIssuer3[] = "https://issuer3.com";
+
+TEST(CertsTest, UpdateAndGet) {
+  Certs certs;
+  system_clock::time_point expiration = system_clock::now();
+  EXPECT_EQ(nullptr, certs.GetCert(kIssuer1));
+
+  certs.Update(kIssuer1, "secret", expiration);
+  auto cert = certs.GetCert(kIssuer1);
+  ASSERT_NE(nullptr, cert);
+  EXPECT_EQ("secret", cert->first->raw());
+  EXPECT_EQ(expiration, cert->second);
+  EXPECT_EQ(nullptr, certs.GetCert(kIssuer2));
+}
+
+TEST(CertsTest, UpdateKeepsSnapshot) {
+  Certs certs;
+  system_clock::time_point now = system_clock::now();
+  certs.Update(kIssuer1, "key1", now);
+  auto cert = certs.GetCert(kIssuer1);
+
+  // A key read before an update is not changed by it.
+  certs.Update(kIssuer1, "key2", now + seconds(60));
+  EXPECT_EQ("key1", cert->first->raw());
+  EXPECT_EQ(now, cert->second);
+  EXPECT_EQ("key2", certs.GetCert(kIssuer1)->first->raw());
+}
+
+TEST(CertsTest, ConcurrentAccess) {
+  Certs certs;
+  system_clock::time_point now = system_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&certs, now, t]() {
+      std::string issuer = "https://issuer" + std::to_string(t % 2) + ".com";
+      for (int i = 0; i < 200; ++i) {
+        if (t < 2) {
+          certs.Update(issuer, "key" + std::to_string(i), now);
+        } else {
+          auto cert = certs.GetCert(issuer);
+          if (cert != nullptr) {
+            EXPECT_EQ(0u, cert->first->raw().find("key"));
+          }
+          certs.GetIssuersToRefresh(now, seconds(60), seconds(3600));
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ("key199", certs.GetCert("https://issuer0.com")->first->raw());
+  EXPECT_EQ("key199", certs.GetCert("https://issuer1.com")->first->raw());
+}
+
+TEST(CertsTest, CoalesceFetches) {
+  Certs certs;
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  EXPECT_FALSE(certs.IsFetching(kIssuer1));
+  EXPECT_TRUE(certs.StartFetch(kIssuer1, on_done));
+  EXPECT_TRUE(certs.IsFetching(kIssuer1));
+  EXPECT_FALSE(certs.StartFetch(kIssuer1, on_done));
+  EXPECT_FALSE(certs.StartFetch(kIssuer1, on_done));
+  // Fetches for other issuers are independent.
+  EXPECT_TRUE(certs.StartFetch(kIssuer2, on_done));
+  EXPECT_TRUE(results.empty());
+
+  Status error(Code::UNAUTHENTICATED, "Unable to fetch verification key");
+  certs.FinishFetch(kIssuer1, error);
+  ASSERT_EQ(3u, results.size());
+  for (const auto &status : results) {
+    EXPECT_EQ(error, status);
+  }
+  EXPECT_FALSE(certs.IsFetching(kIssuer1));
+  EXPECT_TRUE(certs.IsFetching(kIssuer2));
+
+  certs.FinishFetch(kIssuer2, Status::OK);
+  ASSERT_EQ(4u, results.size());
+  EXPECT_TRUE(results.back().ok());
+
+  // Finishing a fetch which is not in flight does nothing.
+  certs.FinishFetch(kIssuer2, Status::OK);
+  EXPECT_EQ(4u, results.size());
+}
+
+TEST(CertsTest, StartFetchFromCallback) {
+  Certs certs;
+  int calls = 0;
+  certs.StartFetch(kIssuer1, [&certs, &calls](const Status &) {
+    ++calls;
+    // The previous fetch is over, so this starts a new one.
+    EXPECT_TRUE(
+        certs.StartFetch(kIssuer1, [&calls](const Status &) { ++calls; }));
+  });
+
+  certs.FinishFetch(kIssuer1, Status::OK);
+  EXPECT_EQ(1, calls);
+  EXPECT_TRUE(certs.IsFetching(kIssuer1));
+  certs.FinishFetch(kIssuer1, Status::OK);
+  EXPECT_EQ(2, calls);
+}
+
+TEST(CertsTest, GetIssuersToRefresh) {
+  Certs certs;
+  system_clock::time_point now = system_clock::now();
+  certs.Update(kIssuer1, "key1", now + seconds(30));
+  certs.Update(kIssuer2, "key2", now + seconds(300));
+  certs.Update(kIssuer3, "key3", now - seconds(7200));
+
+  // Issuer1 is about to expire; issuer2 is fresh and issuer3 is too old.
+  std::vector<std::string> issuers =
+      certs.GetIssuersToRefresh(now, seconds(60), seconds(3600));
+  ASSERT_EQ(1u, issuers.size());
+  EXPECT_EQ(kIssuer1, issuers[0]);
+
+  // Expired keys are refreshed until they are too old.
+  issuers = certs.GetIssuersToRefresh(now + seconds(600), seconds(60),
+                                      seconds(3600));
+  ASSERT_EQ(2u, issuers.size());
+  EXPECT_EQ(kIssuer1, issuers[0]);
+  EXPECT_EQ(kIssuer2, issuers[1]);
+
+  // Issuers with a fetch in flight are skipped.
+  certs.StartFetch(kIssuer1, [](const Status &) {});
+  issuers = certs.GetIssuersToRefresh(now, seconds(60), seconds(3600));
+  EXPECT_TRUE(issuers.empty());
+}
+
+}  // namespace
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,127 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_EXPIRING_CACHE_SHARD_H_
+#define API_MANAGER_AUTH_EXPIRING_CACHE_SHARD_H_
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// One independently locked shard of a cache whose entries expire, such as
+// JwtCache and NegativeJwtCache. Entries are indexed by key for lookup and
+// by expiration time for eviction: a full shard drops everything that has
+// already expired, or the entry that expires first if nothing has. All
+// methods are thread safe.
+template <class Key, class Value>
+class ExpiringCacheShard {
+ public:
+  typedef std::chrono::system_clock::time_point TimePoint;
+
+  explicit ExpiringCacheShard(size_t max_size) : max_size_(max_size) {}
+
+  // Looks up "key". If its entry has not expired at "now", returns what
+  // "use" returns when called with the value, under the lock. An expired
+  // entry is removed.
+  template <class Use>
+  bool Lookup(const Key& key, const TimePoint& now, Use use) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return false;
+    }
+    if (now > it->second.exp) {
+      Erase(it);
+      return false;
+    }
+    return use(it->second.value);
+  }
+
+  // Inserts or replaces the entry of "key", which expires at "exp".
+  void Insert(const Key& key, Value&& value, const TimePoint& exp,
+              const TimePoint& now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      Erase(it);
+    } else if (entries_.size() >= max_size_) {
+      EvictOne(now);
+    }
+    auto inserted = entries_.emplace(key, Entry()).first;
+    Entry& entry = inserted->second;
+    entry.value = std::move(value);
+    entry.exp = exp;
+    entry.expiry = expiry_index_.insert(std::make_pair(exp, &inserted->first));
+  }
+
+  // Removes the entry of "key" if "match" returns true for its value.
+  template <class Match>
+  void Remove(const Key& key, Match match) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() && match(it->second.value)) {
+      Erase(it);
+    }
+  }
+
+  size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  // Points to the keys owned by the entries, which do not move.
+  typedef std::multimap<TimePoint, const Key*> ExpiryIndex;
+
+  struct Entry {
+    Value value;
+    TimePoint exp;
+    typename ExpiryIndex::iterator expiry;
+  };
+  typedef std::unordered_map<Key, Entry> EntryMap;
+
+  void Erase(typename EntryMap::iterator it) {
+    expiry_index_.erase(it->second.expiry);
+    entries_.erase(it);
+  }
+
+  // Makes room for one entry.
+  void EvictOne(const TimePoint& now) {
+    if (expiry_index_.empty()) {
+      return;
+    }
+    do {
+      entries_.erase(*expiry_index_.begin()->second);
+      expiry_index_.erase(expiry_index_.begin());
+    } while (!expiry_index_.empty() && expiry_index_.begin()->first < now);
+  }
+
+  size_t max_size_;
+  mutable std::mutex mutex_;
+  EntryMap entries_;
+  ExpiryIndex expiry_index_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_EXPIRING_CACHE_SHARD_H_
@@ -16,7 +16,11 @@
 //
 #include "contrib/endpoints/src/api_manager/auth/jwt_cache.h"
 
-using ::google::service_control_client::SimpleLRUCache;
+#include <algorithm>
+#include <functional>
+
+#include "contrib/endpoints/src/api_manager/auth/expiring_cache_shard.h"
+
 using std::chrono::system_clock;
 
 namespace google {
@@ -24,26 +28,89 @@ namespace api_manager {
 namespace auth {
 
 namespace {
-// The maximum lifetime of a cache entry. Unit: seconds.
-// TODO: This value should be configurable via server config.
+// The default maximum lifetime of a cache entry. Unit: seconds.
 const int kJwtCacheTimeout = 300;
-// The number of entries in JWT cache.
-// TODO: This value should be configurable via server config.
-const int kJwtCacheSize = 100;
+// The default number of entries in JWT cache.
+const size_t kJwtCacheSize = 10000;
+// The default number of shards in JWT cache.
+const size_t kJwtCacheShards = 16;
+
+// A JwtCache entry. The JWT itself is kept to rule out hash collisions.
+struct JwtEntry {
+  std::string jwt;
+  JwtValue value;
+};
 }  // namespace
 
-JwtCache::JwtCache() : SimpleLRUCache<std::string, JwtValue>(kJwtCacheSize) {}
+// A shard holds the entries whose hash maps to it.
+class JwtCache::Shard : public ExpiringCacheShard<size_t, JwtEntry> {
+ public:
+  using ExpiringCacheShard<size_t, JwtEntry>::ExpiringCacheShard;
+};
+
+JwtCache::Options::Options()
+    : max_size(kJwtCacheSize),
+      timeout(kJwtCacheTimeout),
+      num_shards(kJwtCacheShards) {}
 
-JwtCache::~JwtCache() { Clear(); }
+JwtCache::JwtCache() : JwtCache(Options()) {}
+
+JwtCache::JwtCache(const Options& options) : options_(options) {
+  options_.num_shards = std::max<size_t>(1, options_.num_shards);
+  options_.max_size = std::max(options_.max_size, options_.num_shards);
+  size_t shard_size =
+      (options_.max_size + options_.num_shards - 1) / options_.num_shards;
+  for (size_t i = 0; i < options_.num_shards; ++i) {
+    shards_.emplace_back(new Shard(shard_size));
+  }
+}
+
+JwtCache::~JwtCache() {}
+
+JwtCache::Shard* JwtCache::GetShard(size_t hash) const {
+  // The low bits select the bucket inside a shard, so pick the shard with
+  // the high bits to keep the two independent.
+  return shards_[(hash >> (sizeof(size_t) * 4)) % shards_.size()].get();
+}
+
+bool JwtCache::Lookup(const std::string& jwt,
+                      const system_clock::time_point& now,
+                      UserInfo* user_info) {
+  size_t hash = std::hash<std::string>()(jwt);
+  return GetShard(hash)->Lookup(
+      hash, now, [&jwt, user_info](const JwtEntry& entry) {
+        if (entry.jwt != jwt) {
+          return false;
+        }
+        *user_info = entry.value.user_info;
+        return true;
+      });
+}
 
 void JwtCache::Insert(const std::string& jwt, const UserInfo& user_info,
                       const system_clock::time_point& token_exp,
                       const system_clock::time_point& now) {
-  JwtValue* newval = new JwtValue();
-  newval->user_info = user_info;
-  newval->exp =
-      std::min(token_exp, now + std::chrono::seconds(kJwtCacheTimeout));
-  SimpleLRUCache::Insert(jwt, newval, 1);
+  JwtEntry entry;
+  entry.jwt = jwt;
+  entry.value.user_info = user_info;
+  entry.value.exp = std::min(token_exp, now + options_.timeout);
+  system_clock::time_point exp = entry.value.exp;
+  size_t hash = std::hash<std::string>()(jwt);
+  GetShard(hash)->Insert(hash, std::move(entry), exp, now);
+}
+
+void JwtCache::Remove(const std::string& jwt) {
+  size_t hash = std::hash<std::string>()(jwt);
+  GetShard(hash)->Remove(
+      hash, [&jwt](const JwtEntry& entry) { return entry.jwt == jwt; });
+}
+
+size_t JwtCache::Size() const {
+  size_t size = 0;
+  for (const auto& shard : shards_) {
+    size += shard->Size();
+  }
+  return size;
 }
 
 }  // namespace auth
@@ -16,10 +16,12 @@
 #define API_MANAGER_AUTH_JWT_CACHE_H_
 
 #include <chrono>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "contrib/endpoints/src/api_manager/auth.h"
-#include "utils/simple_lru_cache_inl.h"
 
 namespace google {
 namespace api_manager {
@@ -31,22 +33,56 @@ struct JwtValue {
   UserInfo user_info;
 
   // Expiration time of the cache entry. This is the minimum of "exp" field in
-  // the JWT and [the time this cache entry is added + kJwtCacheTimeout].
+  // the JWT and [the time this cache entry is added + timeout].
   std::chrono::system_clock::time_point exp;
 };
 
-// A local cache that resides in ESP. The key of the cache is a JWT,
-// and the value is of type JwtValue.
-class JwtCache
-    : public google::service_control_client::SimpleLRUCache<std::string,
-                                                            JwtValue> {
+// A local cache that resides in ESP. The cache is keyed by a hash of the
+// JWT, and the value is of type JwtValue. The entries are spread over
+// several independently locked shards so that concurrent requests rarely
+// contend, and when a shard is full the entry closest to expiry is evicted.
+// All methods are thread safe.
+class JwtCache {
  public:
+  struct Options {
+    Options();
+
+    // The maximum number of entries in the cache.
+    size_t max_size;
+    // The maximum lifetime of a cache entry.
+    std::chrono::seconds timeout;
+    // The number of shards.
+    size_t num_shards;
+  };
+
   JwtCache();
+  explicit JwtCache(const Options& options);
   ~JwtCache();
 
+  // Looks up a JWT. Returns true and copies out the user info if an entry is
+  // found and has not expired at "now". An expired entry is removed.
+  bool Lookup(const std::string& jwt,
+              const std::chrono::system_clock::time_point& now,
+              UserInfo* user_info);
+
   void Insert(const std::string& jwt, const UserInfo& user_info,
               const std::chrono::system_clock::time_point& token_exp,
               const std::chrono::system_clock::time_point& now);
+
+  void Remove(const std::string& jwt);
+
+  // Returns the number of entries in the cache.
+  size_t Size() const;
+
+  const Options& options() const { return options_; }
+
+ private:
+  class Shard;
+
+  Shard* GetShard(size_t hash) const;
+
+  Options options_;
+  std::vector<std::unique_ptr<Shard>> shards_;
 };
 
 }  // namespace auth
@@ -16,6 +16,8 @@
 //
 #include "contrib/endpoints/src/api_manager/auth/jwt_cache.h"
 #include <memory>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 
 using std::chrono::system_clock;
@@ -49,18 +51,22 @@ class TestJwtCache : public ::testing::Test {
   std::unique_ptr<JwtCache> cache_;
 };
 
-// Test the Insert function in JwtCache class.
-void InsertAndLookupImpl(JwtCache *cache, bool token_exp_earlier) {
-  ASSERT_EQ(nullptr, cache->Lookup(kJwt));
-
+UserInfo CreateUserInfo(const std::string &id) {
   UserInfo user_info;
-  user_info.id = kId;
+  user_info.id = id;
   user_info.email = kEmail;
   user_info.consumer_id = kConsumer;
   user_info.issuer = kIssuer;
   user_info.audiences.insert("aud1");
   user_info.audiences.insert("aud2");
+  return user_info;
+}
+
+// Test the Insert function in JwtCache class.
+void InsertAndLookupImpl(JwtCache *cache, bool token_exp_earlier) {
   system_clock::time_point now = system_clock::now();
+  UserInfo val;
+  ASSERT_FALSE(cache->Lookup(kJwt, now, &val));
 
   system_clock::time_point token_exp;
   if (token_exp_earlier) {
@@ -68,23 +74,26 @@ void InsertAndLookupImpl(JwtCache *cache, bool token_exp_earlier) {
   } else {
     token_exp = now + std::chrono::seconds(kJwtCacheTimeout + 1);
   }
-  cache->Insert(kJwt, user_info, token_exp, now);
-  JwtValue *val = cache->Lookup(kJwt);
-  ASSERT_NE(nullptr, val);
-  ASSERT_EQ(val->user_info.id, kId);
-  ASSERT_EQ(val->user_info.email, kEmail);
-  ASSERT_EQ(val->user_info.consumer_id, kConsumer);
-  ASSERT_EQ(val->user_info.issuer, kIssuer);
-  ASSERT_EQ(val->user_info.AudiencesAsString(), "aud1,aud2");
-  if (token_exp_earlier) {
-    ASSERT_EQ(val->exp, token_exp);
-  } else {
-    ASSERT_EQ(val->exp, now + std::chrono::seconds(kJwtCacheTimeout));
-  }
+  cache->Insert(kJwt, CreateUserInfo(kId), token_exp, now);
+  ASSERT_TRUE(cache->Lookup(kJwt, now, &val));
+  ASSERT_EQ(val.id, kId);
+  ASSERT_EQ(val.email, kEmail);
+  ASSERT_EQ(val.consumer_id, kConsumer);
+  ASSERT_EQ(val.issuer, kIssuer);
+  ASSERT_EQ(val.AudiencesAsString(), "aud1,aud2");
+
+  // The entry expires at the earlier of token "exp" and the cache timeout.
+  system_clock::time_point exp =
+      token_exp_earlier ? token_exp
+                        : now + std::chrono::seconds(kJwtCacheTimeout);
+  ASSERT_TRUE(cache->Lookup(kJwt, exp, &val));
+  ASSERT_FALSE(cache->Lookup(kJwt, exp + std::chrono::seconds(1), &val));
+  // The expired entry is removed by the lookup.
+  ASSERT_EQ(0u, cache->Size());
 
-  cache->Release(kJwt, val);
+  cache->Insert(kJwt, CreateUserInfo(kId), token_exp, now);
   cache->Remove(kJwt);
-  ASSERT_EQ(nullptr, cache->Lookup(kJwt));
+  ASSERT_FALSE(cache->Lookup(kJwt, now, &val));
 }
 
 TEST_F(TestJwtCache, InsertAndLookUp) {
@@ -95,6 +104,99 @@ TEST_F(TestJwtCache, InsertAndLookUp) {
   InsertAndLookupImpl(cache_.get(), false);
 }
 
+TEST_F(TestJwtCache, DefaultOptions) {
+  ASSERT_EQ(10000u, cache_->options().max_size);
+  ASSERT_EQ(std::chrono::seconds(kJwtCacheTimeout), cache_->options().timeout);
+  ASSERT_EQ(16u, cache_->options().num_shards);
+}
+
+TEST(JwtCache, ConfiguredTimeout) {
+  JwtCache::Options options;
+  options.timeout = std::chrono::seconds(10);
+  JwtCache cache(options);
+
+  system_clock::time_point now = system_clock::now();
+  cache.Insert(kJwt, CreateUserInfo(kId), now + std::chrono::hours(1), now);
+  UserInfo val;
+  ASSERT_TRUE(cache.Lookup(kJwt, now + std::chrono::seconds(10), &val));
+  ASSERT_FALSE(cache.Lookup(kJwt, now + std::chrono::seconds(11), &val));
+}
+
+TEST(JwtCache, EvictsEarliestExpiry) {
+  JwtCache::Options options;
+  options.max_size = 3;
+  options.num_shards = 1;
+  JwtCache cache(options);
+
+  system_clock::time_point now = system_clock::now();
+  cache.Insert("jwt1", CreateUserInfo("user1"),
+               now + std::chrono::seconds(30), now);
+  cache.Insert("jwt2", CreateUserInfo("user2"),
+               now + std::chrono::seconds(10), now);
+  cache.Insert("jwt3", CreateUserInfo("user3"),
+               now + std::chrono::seconds(20), now);
+  ASSERT_EQ(3u, cache.Size());
+
+  // The cache is full, "jwt2" expires first and is evicted.
+  cache.Insert("jwt4", CreateUserInfo("user4"),
+               now + std::chrono::seconds(5), now);
+  ASSERT_EQ(3u, cache.Size());
+
+  UserInfo val;
+  ASSERT_FALSE(cache.Lookup("jwt2", now, &val));
+  ASSERT_TRUE(cache.Lookup("jwt1", now, &val));
+  ASSERT_EQ("user1", val.id);
+  ASSERT_TRUE(cache.Lookup("jwt3", now, &val));
+  ASSERT_TRUE(cache.Lookup("jwt4", now, &val));
+
+  // Every entry that has expired is dropped to make room.
+  system_clock::time_point later = now + std::chrono::seconds(25);
+  cache.Insert("jwt5", CreateUserInfo("user5"),
+               later + std::chrono::seconds(30), later);
+  ASSERT_EQ(2u, cache.Size());
+  ASSERT_TRUE(cache.Lookup("jwt1", later, &val));
+  ASSERT_TRUE(cache.Lookup("jwt5", later, &val));
+}
+
+TEST(JwtCache, ReplacesExistingEntry) {
+  JwtCache cache;
+  system_clock::time_point now = system_clock::now();
+  cache.Insert(kJwt, CreateUserInfo("user1"), now + std::chrono::seconds(10),
+               now);
+  cache.Insert(kJwt, CreateUserInfo("user2"), now + std::chrono::seconds(20),
+               now);
+  ASSERT_EQ(1u, cache.Size());
+
+  UserInfo val;
+  ASSERT_TRUE(cache.Lookup(kJwt, now + std::chrono::seconds(15), &val));
+  ASSERT_EQ("user2", val.id);
+}
+
+TEST(JwtCache, ConcurrentAccess) {
+  JwtCache::Options options;
+  options.max_size = 1000;
+  options.num_shards = 4;
+  JwtCache cache(options);
+
+  system_clock::time_point now = system_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, now, t]() {
+      UserInfo val;
+      for (int i = 0; i < 1000; ++i) {
+        std::string jwt = "jwt" + std::to_string(t * 1000 + i);
+        cache.Insert(jwt, CreateUserInfo(jwt), now + std::chrono::seconds(60),
+                     now);
+        cache.Lookup(jwt, now, &val);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_LE(cache.Size(), 1000u);
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -19,6 +19,8 @@
 // Implementation of JWT token verification.
 
 // Support public keys in x509 format or JWK (Json Web Keys).
+// Supported algorithms are RS256/384/512, HS256/384/512, ES256 (ECDSA on the
+// P-256 curve) and EdDSA (Ed25519, JWK keys only).
 // -- Sample x509 keys
 // {
 // "8f3e950b309186540c314ecf348bb14f1784d79d": "-----BEGIN
@@ -62,11 +64,15 @@ extern "C" {
 
 #include <openssl/hmac.h>
 #include <openssl/pem.h>
+#if defined(OPENSSL_IS_BORINGSSL)
+#include <openssl/curve25519.h>
+#endif
 #include <cstring>
 #include <set>
 #include <string>
 
-#include "contrib/endpoints/src/api_manager/auth/lib/json_util.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/base64.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/jwt_claims.h"
 
 using std::string;
 using std::chrono::system_clock;
@@ -77,11 +83,9 @@ namespace api_manager {
 namespace auth {
 namespace {
 
-// JOSE header. see http://tools.ietf.org/html/rfc7515#section-4
-struct JoseHeader {
-  const char *alg;
-  const char *kid;
-};
+// The clock skew allowed when checking the time constraints of a JWT.
+// Unit: seconds.
+const int64_t kClockSkewSeconds = 60;
 
 // An implementation of JwtValidator, hold ALL allocated memory data.
 class JwtValidatorImpl : public JwtValidator {
@@ -89,6 +93,7 @@ class JwtValidatorImpl : public JwtValidator {
   JwtValidatorImpl(const char *jwt, size_t jwt_len);
   Status Parse(UserInfo *user_info);
   Status VerifySignature(const char *pkey, size_t pkey_len);
+  Status VerifySignature(const PublicKeys &keys);
   system_clock::time_point &GetExpirationTime() { return exp_; }
   ~JwtValidatorImpl();
 
@@ -98,34 +103,23 @@ class JwtValidatorImpl : public JwtValidator {
                                     const char *pkey, size_t pkey_len,
                                     const char *aud);
   grpc_jwt_verifier_status ParseImpl();
-  grpc_jwt_verifier_status VerifySignatureImpl(const char *pkey,
-                                               size_t pkey_len);
-  // Parses the audiences and removes the audiences from the json object.
-  void UpdateAudience(grpc_json *json);
+  grpc_jwt_verifier_status VerifySignatureImpl(const PublicKeys &keys);
 
-  // Creates header_ from header_json_.
-  void CreateJoseHeader();
+  // Decodes and parses the JOSE header into header_.
+  bool ParseJoseHeader(const char *data, size_t len);
   // Checks required fields and fills User Info from claims_.
   // And sets expiration time to exp_.
   grpc_jwt_verifier_status FillUserInfoAndSetExp(UserInfo *user_info);
-  // Finds the public key and verifies JWT signature with it.
-  grpc_jwt_verifier_status FindAndVerifySignature();
-  // Extracts the public key from x509 string (key) and sets it to pkey_.
-  // Returns true if successful.
-  bool ExtractPubkeyFromX509(const char *key);
-  // Extracts the public key from a jwk key (jkey) and sets it to pkey_.
-  // Returns true if successful.
-  bool ExtractPubkeyFromJwk(const grpc_json *jkey);
-  // Extracts the public key from jwk key set and verifies JWT signature with
-  // it.
-  grpc_jwt_verifier_status ExtractAndVerifyJwkKeys(const grpc_json *jwt_keys);
-  // Extracts the public key from pkey_json_ and verifies JWT signature with
-  // it.
-  grpc_jwt_verifier_status ExtractAndVerifyX509Keys();
-  // Verifies signature with pkey_.
-  grpc_jwt_verifier_status VerifyPubkey();
-  // Verifies RS (asymmetric) signature.
-  grpc_jwt_verifier_status VerifyRsSignature(const char *pkey, size_t pkey_len);
+  // Finds the matching jwk key and verifies JWT signature with it.
+  grpc_jwt_verifier_status VerifyJwkKeys(const PublicKeys &keys);
+  // Finds the matching x509 key and verifies JWT signature with it.
+  grpc_jwt_verifier_status VerifyX509Keys(const PublicKeys &keys);
+  // Verifies signature with key.
+  grpc_jwt_verifier_status VerifyKey(const PublicKeys::Key &key);
+  // Verifies EdDSA signature with an Ed25519 public key.
+  grpc_jwt_verifier_status VerifyEd25519(const std::string &public_key);
+  // Verifies RS, ES or EdDSA (asymmetric) signature.
+  grpc_jwt_verifier_status VerifyAsymmetricSignature(const PublicKeys &keys);
   // Verifies HS (symmetric) signature.
   grpc_jwt_verifier_status VerifyHsSignature(const char *pkey, size_t pkey_len);
 
@@ -133,22 +127,20 @@ class JwtValidatorImpl : public JwtValidator {
   const char *jwt;
   int jwt_len;
 
-  JoseHeader *header_;
-  grpc_json *header_json_;
-  gpr_slice header_buffer_;
-  grpc_jwt_claims *claims_;
-  gpr_slice sig_buffer_;
-  gpr_slice signed_buffer_;
+  // The header and the claims are extracted while scanning their decoded
+  // JSON once, without building a JSON tree. buffer_ holds the decoded
+  // header, then the decoded claims, which are kept for User Info.
+  std::string buffer_;
+  JoseHeader header_;
+  bool header_parsed_;
+  JwtClaims claims_;
+  // The signed data is the "header.payload" prefix of jwt, not a copy.
+  size_t signed_len_;
+  std::string sig_;
 
-  std::set<std::string> audiences_;
   system_clock::time_point exp_;
 
-  grpc_json *pkey_json_;
   gpr_slice pkey_buffer_;
-  BIO *bio_;
-  X509 *x509_;
-  RSA *rsa_;
-  EVP_PKEY *pkey_;
   EVP_MD_CTX *md_ctx_;
 
   grpc_exec_ctx exec_ctx_;
@@ -157,16 +149,16 @@ class JwtValidatorImpl : public JwtValidator {
 // Gets EVP_MD mapped from an alg (algorithm string).
 const EVP_MD *EvpMdFromAlg(const char *alg);
 
-// Gets hash size from HS algorithm string.
-size_t HashSizeFromAlg(const char *alg);
+// Returns true if alg (algorithm string) is supported.
+bool IsSupportedAlg(const char *alg);
 
-// Parses str into grpc_json object. Does not own buffer.
-grpc_json *DecodeBase64AndParseJson(grpc_exec_ctx *exec_ctx, const char *str,
-                                    size_t len, gpr_slice *buffer);
+// Converts a JWS ECDSA signature, the fixed size big-endian R and S, into
+// the DER encoding expected by OpenSSL. Returns false if it is malformed.
+bool EcdsaSignatureToDer(const std::string &sig, size_t component_size,
+                         std::string *der);
 
-// Gets BIGNUM from b64 string, used for extracting pkey from jwk.
-// Result owned by rsa_.
-BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64);
+// Gets hash size from HS algorithm string.
+size_t HashSizeFromAlg(const char *alg);
 
 }  // namespace
 
@@ -179,60 +171,18 @@ namespace {
 JwtValidatorImpl::JwtValidatorImpl(const char *jwt, size_t jwt_len)
     : jwt(jwt),
       jwt_len(jwt_len),
-      header_(nullptr),
-      header_json_(nullptr),
-      claims_(nullptr),
-      pkey_json_(nullptr),
-      bio_(nullptr),
-      x509_(nullptr),
-      rsa_(nullptr),
-      pkey_(nullptr),
+      header_parsed_(false),
+      signed_len_(0),
       md_ctx_(nullptr),
       exec_ctx_(GRPC_EXEC_CTX_INIT) {
-  header_buffer_ = gpr_empty_slice();
-  signed_buffer_ = gpr_empty_slice();
-  sig_buffer_ = gpr_empty_slice();
   pkey_buffer_ = gpr_empty_slice();
 }
 
 // Makes sure all data are cleaned up, both success and failure case.
 JwtValidatorImpl::~JwtValidatorImpl() {
-  if (header_ != nullptr) {
-    gpr_free(header_);
-  }
-  if (header_json_ != nullptr) {
-    grpc_json_destroy(header_json_);
-  }
-  if (pkey_json_ != nullptr) {
-    grpc_json_destroy(pkey_json_);
-  }
-  if (claims_ != nullptr) {
-    grpc_jwt_claims_destroy(&exec_ctx_, claims_);
-  }
-  if (!GPR_SLICE_IS_EMPTY(header_buffer_)) {
-    gpr_slice_unref(header_buffer_);
-  }
-  if (!GPR_SLICE_IS_EMPTY(signed_buffer_)) {
-    gpr_slice_unref(signed_buffer_);
-  }
-  if (!GPR_SLICE_IS_EMPTY(sig_buffer_)) {
-    gpr_slice_unref(sig_buffer_);
-  }
   if (!GPR_SLICE_IS_EMPTY(pkey_buffer_)) {
     gpr_slice_unref(pkey_buffer_);
   }
-  if (bio_ != nullptr) {
-    BIO_free(bio_);
-  }
-  if (x509_ != nullptr) {
-    X509_free(x509_);
-  }
-  if (rsa_ != nullptr) {
-    RSA_free(rsa_);
-  }
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
   if (md_ctx_ != nullptr) {
     EVP_MD_CTX_destroy(md_ctx_);
   }
@@ -251,46 +201,6 @@ Status JwtValidatorImpl::Parse(UserInfo *user_info) {
                 grpc_jwt_verifier_status_to_string(status));
 }
 
-// Extracts and removes the audiences from the token.
-// This is a workaround to deal with GRPC library not accepting
-// multiple audiences.
-void JwtValidatorImpl::UpdateAudience(grpc_json *json) {
-  grpc_json *cur;
-  for (cur = json->child; cur != nullptr; cur = cur->next) {
-    if (strcmp(cur->key, "aud") == 0) {
-      if (cur->type == GRPC_JSON_ARRAY) {
-        grpc_json *aud;
-        for (aud = cur->child; aud != nullptr; aud = aud->next) {
-          if (aud->type == GRPC_JSON_STRING && aud->value != nullptr) {
-            audiences_.insert(aud->value);
-          }
-        }
-        // Replaces the array of audiences with an empty string.
-        grpc_json *prev = cur->prev;
-        grpc_json *next = cur->next;
-        grpc_json_destroy(cur);
-        grpc_json *fake_audience = grpc_json_create(GRPC_JSON_STRING);
-        fake_audience->key = "aud";
-        fake_audience->value = "";
-        fake_audience->parent = json;
-        fake_audience->prev = prev;
-        fake_audience->next = next;
-        if (prev) {
-          prev->next = fake_audience;
-        } else {
-          json->child = fake_audience;
-        }
-        if (next) {
-          next->prev = fake_audience;
-        }
-      } else if (cur->type == GRPC_JSON_STRING && cur->value != nullptr) {
-        audiences_.insert(cur->value);
-      }
-      return;
-    }
-  }
-}
-
 grpc_jwt_verifier_status JwtValidatorImpl::ParseImpl() {
   // ====================
   // Basic check.
@@ -298,79 +208,58 @@ grpc_jwt_verifier_status JwtValidatorImpl::ParseImpl() {
   if (jwt == nullptr || jwt_len <= 0) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
+  const char *end = jwt + jwt_len;
 
   // ====================
-  // Creates Jose Header.
+  // Parses Jose Header.
   // ====================
   const char *cur = jwt;
-  const char *dot = strchr(cur, '.');
-  if (dot == nullptr) {
-    return GRPC_JWT_VERIFIER_BAD_FORMAT;
-  }
-  header_json_ =
-      DecodeBase64AndParseJson(&exec_ctx_, cur, dot - cur, &header_buffer_);
-  CreateJoseHeader();
-  if (header_ == nullptr) {
+  const char *dot = static_cast<const char *>(memchr(cur, '.', end - cur));
+  if (dot == nullptr || !ParseJoseHeader(cur, dot - cur)) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
 
   // =============================
-  // Creates Claims/Payload.
+  // Parses Claims/Payload.
   // =============================
   cur = dot + 1;
-  dot = strchr(cur, '.');
+  dot = static_cast<const char *>(memchr(cur, '.', end - cur));
   if (dot == nullptr) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-
-  // claim_buffer is the only exception that requires deallocation for failure
-  // case, and it is owned by claims_ for successful case.
-  gpr_slice claims_buffer = gpr_empty_slice();
-  grpc_json *claims_json =
-      DecodeBase64AndParseJson(&exec_ctx_, cur, dot - cur, &claims_buffer);
-  if (claims_json == nullptr) {
-    if (!GPR_SLICE_IS_EMPTY(claims_buffer)) {
-      gpr_slice_unref(claims_buffer);
-    }
+  if (!Base64UrlDecode(cur, dot - cur, &buffer_)) {
+    gpr_log(GPR_ERROR, "Invalid base64.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  UpdateAudience(claims_json);
-  // Takes ownershp of claims_json and claims_buffer.
-  claims_ = grpc_jwt_claims_from_json(&exec_ctx_, claims_json, claims_buffer);
-
-  if (claims_ == nullptr) {
+  if (!ParseJwtClaims(buffer_.data(), buffer_.size(), &claims_)) {
     gpr_log(GPR_ERROR,
             "JWT claims could not be created."
             " Incompatible value types for some claim(s)");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
 
-  // issuer is mandatory. grpc_jwt_claims_issuer checks if claims_ is nullptr.
-  if (grpc_jwt_claims_issuer(claims_) == nullptr) {
+  // issuer is mandatory.
+  if (!claims_.has_iss) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
 
-  // Check timestamp.
-  // Passing in its own audience to skip audience check.
-  // Audience check should be done by the caller.
-  grpc_jwt_verifier_status status =
-      grpc_jwt_claims_check(claims_, grpc_jwt_claims_audience(claims_));
-  if (status != GRPC_JWT_VERIFIER_OK) {
-    return status;
+  // Check timestamp. Audience check should be done by the caller.
+  int64_t now = system_clock::to_time_t(system_clock::now());
+  if (claims_.exp != 0 && now - kClockSkewSeconds > claims_.exp) {
+    gpr_log(GPR_ERROR, "JWT is expired.");
+    return GRPC_JWT_VERIFIER_TIME_CONSTRAINT_FAILURE;
+  }
+  if (claims_.nbf != 0 && now + kClockSkewSeconds < claims_.nbf) {
+    gpr_log(GPR_ERROR, "JWT is not valid yet.");
+    return GRPC_JWT_VERIFIER_TIME_CONSTRAINT_FAILURE;
   }
 
   // =============================
-  // Creates Buffer for signature check
+  // Decodes signature.
   // =============================
-  size_t signed_jwt_len = (size_t)(dot - jwt);
-  signed_buffer_ = gpr_slice_from_copied_buffer(jwt, signed_jwt_len);
-  if (GPR_SLICE_IS_EMPTY(signed_buffer_)) {
-    return GRPC_JWT_VERIFIER_BAD_FORMAT;
-  }
+  signed_len_ = dot - jwt;
   cur = dot + 1;
-  sig_buffer_ = grpc_base64_decode_with_len(&exec_ctx_, cur,
-                                            jwt_len - signed_jwt_len - 1, 1);
-  if (GPR_SLICE_IS_EMPTY(sig_buffer_)) {
+  if (!Base64UrlDecode(cur, end - cur, &sig_) || sig_.empty()) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
 
@@ -378,7 +267,11 @@ grpc_jwt_verifier_status JwtValidatorImpl::ParseImpl() {
 }
 
 Status JwtValidatorImpl::VerifySignature(const char *pkey, size_t pkey_len) {
-  grpc_jwt_verifier_status status = VerifySignatureImpl(pkey, pkey_len);
+  return VerifySignature(*PublicKeys::Create(pkey, pkey_len));
+}
+
+Status JwtValidatorImpl::VerifySignature(const PublicKeys &keys) {
+  grpc_jwt_verifier_status status = VerifySignatureImpl(keys);
   if (status == GRPC_JWT_VERIFIER_OK) {
     return Status::OK;
   } else {
@@ -388,250 +281,151 @@ Status JwtValidatorImpl::VerifySignature(const char *pkey, size_t pkey_len) {
 }
 
 grpc_jwt_verifier_status JwtValidatorImpl::VerifySignatureImpl(
-    const char *pkey, size_t pkey_len) {
-  if (pkey == nullptr || pkey_len <= 0) {
+    const PublicKeys &keys) {
+  if (keys.raw().empty()) {
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
   if (jwt == nullptr || jwt_len <= 0) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  if (GPR_SLICE_IS_EMPTY(signed_buffer_) || GPR_SLICE_IS_EMPTY(sig_buffer_)) {
+  if (signed_len_ == 0 || sig_.empty()) {
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  if (strncmp(header_->alg, "RS", 2) == 0) {  // Asymmetric keys.
-    return VerifyRsSignature(pkey, pkey_len);
+  if (header_.alg.compare(0, 2, "HS") != 0) {  // Asymmetric keys.
+    return VerifyAsymmetricSignature(keys);
   } else {  // Symmetric key.
-    return VerifyHsSignature(pkey, pkey_len);
+    return VerifyHsSignature(keys.raw().data(), keys.raw().size());
   }
 }
 
-void JwtValidatorImpl::CreateJoseHeader() {
-  if (header_json_ == nullptr) {
-    return;
+bool JwtValidatorImpl::ParseJoseHeader(const char *data, size_t len) {
+  if (!Base64UrlDecode(data, len, &buffer_)) {
+    gpr_log(GPR_ERROR, "Invalid base64.");
+    return false;
   }
-  const char *alg = GetStringValue(header_json_, "alg");
-  if (alg == nullptr) {
-    gpr_log(GPR_ERROR, "Missing alg field.");
-    return;
+  if (!auth::ParseJoseHeader(buffer_.data(), buffer_.size(), &header_)) {
+    gpr_log(GPR_ERROR, "JSON parsing error.");
+    return false;
   }
-  if (EvpMdFromAlg(alg) == nullptr) {
-    gpr_log(GPR_ERROR, "Invalid alg field [%s].", alg);
-    return;
+  if (!header_.has_alg) {
+    gpr_log(GPR_ERROR, "Missing alg field.");
+    return false;
   }
-
-  header_ = reinterpret_cast<JoseHeader *>(gpr_malloc(sizeof(JoseHeader)));
-  if (header_ == nullptr) {
-    gpr_log(GPR_ERROR, "Jose header creation failed");
+  if (!IsSupportedAlg(header_.alg.c_str())) {
+    gpr_log(GPR_ERROR, "Invalid alg field [%s].", header_.alg.c_str());
+    return false;
   }
-  header_->alg = alg;
-  header_->kid = GetStringValue(header_json_, "kid");
+  header_parsed_ = true;
+  return true;
 }
 
-grpc_jwt_verifier_status JwtValidatorImpl::FindAndVerifySignature() {
-  if (pkey_json_ == nullptr) {
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyAsymmetricSignature(
+    const PublicKeys &keys) {
+  if (!keys.valid()) {
     gpr_log(GPR_ERROR, "The public keys are empty.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
-  if (header_ == nullptr) {
+  if (!header_parsed_) {
     gpr_log(GPR_ERROR, "JWT header is empty.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  // JWK set https://tools.ietf.org/html/rfc7517#section-5.
-  const grpc_json *jwk_keys = GetProperty(pkey_json_, "keys");
-  if (jwk_keys == nullptr) {
-    // Try x509 format.
-    return ExtractAndVerifyX509Keys();
+  if (keys.is_jwk()) {
+    return VerifyJwkKeys(keys);
   } else {
-    // JWK format.
-    return ExtractAndVerifyJwkKeys(jwk_keys);
+    return VerifyX509Keys(keys);
   }
 }
 
-grpc_jwt_verifier_status JwtValidatorImpl::ExtractAndVerifyX509Keys() {
-  // Precondition (checked by caller): pkey_json_ and header_ are not nullptr.
-  if (header_->kid != nullptr) {
-    const char *value = GetStringValue(pkey_json_, header_->kid);
-    if (value == nullptr) {
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyX509Keys(
+    const PublicKeys &keys) {
+  // Precondition (checked by caller): header_ is parsed.
+  if (header_.has_kid) {
+    const PublicKeys::Key *key = keys.Find(header_.kid.c_str(), nullptr);
+    if (key == nullptr) {
       gpr_log(GPR_ERROR,
               "Cannot find matching key in key set for kid=%s and alg=%s",
-              header_->kid, header_->alg);
+              header_.kid.c_str(), header_.alg.c_str());
       return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
     }
-    if (!ExtractPubkeyFromX509(value)) {
+    if (key->pkey == nullptr) {
       gpr_log(GPR_ERROR, "Failed to extract public key from X509 key (%s)",
-              header_->kid);
+              header_.kid.c_str());
       return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
     }
-    return VerifyPubkey();
+    return VerifyKey(*key);
   }
   // If kid is not specified in the header, try all keys. If the JWT can be
   // validated with any of the keys, the request is successful.
-  const grpc_json *cur;
-  if (pkey_json_->child == nullptr) {
-    gpr_log(GPR_ERROR, "Failed to extract public key from X509 key (%s)",
-            header_->kid);
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-  for (cur = pkey_json_->child; cur != nullptr; cur = cur->next) {
-    if (cur->value == nullptr || !ExtractPubkeyFromX509(cur->value)) {
+  for (const auto &key : keys.keys()) {
+    if (key.pkey == nullptr) {
       // Failed to extract public key from current X509 key, try next one.
       continue;
     }
-    if (VerifyPubkey() == GRPC_JWT_VERIFIER_OK) {
+    if (VerifyKey(key) == GRPC_JWT_VERIFIER_OK) {
       return GRPC_JWT_VERIFIER_OK;
     }
   }
-  // header_->kid is nullptr. The JWT cannot be validated with any of the keys.
+  // header_ has no kid. The JWT cannot be validated with any of the keys.
   // Return error.
   gpr_log(GPR_ERROR,
           "The JWT cannot be validated with any of the public keys.");
   return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
 }
 
-bool JwtValidatorImpl::ExtractPubkeyFromX509(const char *key) {
-  if (bio_ != nullptr) {
-    BIO_free(bio_);
-  }
-  bio_ = BIO_new(BIO_s_mem());
-  if (bio_ == nullptr) {
-    gpr_log(GPR_ERROR, "Unable to allocate a BIO object.");
-    return false;
-  }
-  if (BIO_write(bio_, key, strlen(key)) <= 0) {
-    gpr_log(GPR_ERROR, "BIO write error for key (%s).", key);
-    return false;
-  }
-  if (x509_ != nullptr) {
-    X509_free(x509_);
-  }
-  x509_ = PEM_read_bio_X509(bio_, nullptr, nullptr, nullptr);
-  if (x509_ == nullptr) {
-    gpr_log(GPR_ERROR, "Unable to parse x509 cert for key (%s).", key);
-    return false;
-  }
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
-  pkey_ = X509_get_pubkey(x509_);
-  if (pkey_ == nullptr) {
-    gpr_log(GPR_ERROR, "X509_get_pubkey failed");
-    return false;
-  }
-  return true;
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::ExtractAndVerifyJwkKeys(
-    const grpc_json *jwk_keys) {
-  // Precondition (checked by caller): jwk_keys and header_ are not nullptr.
-  if (jwk_keys->type != GRPC_JSON_ARRAY) {
-    gpr_log(GPR_ERROR,
-            "Unexpected value type of keys property in jwks key set.");
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-
-  const grpc_json *jkey = nullptr;
-
-  if (jwk_keys->child == nullptr) {
-    gpr_log(GPR_ERROR, "The jwks key set is empty");
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-  // JWK format from https://tools.ietf.org/html/rfc7518#section-6.
-  for (jkey = jwk_keys->child; jkey != nullptr; jkey = jkey->next) {
-    if (jkey->type != GRPC_JSON_OBJECT) continue;
-    const char *alg = GetStringValue(jkey, "alg");
-    if (alg == nullptr || strcmp(alg, header_->alg) != 0) {
-      continue;
-    }
-    const char *kid = GetStringValue(jkey, "kid");
-    if (kid == nullptr ||
-        (header_->kid != nullptr && strcmp(kid, header_->kid) != 0)) {
-      continue;
-    }
-    const char *kty = GetStringValue(jkey, "kty");
-    if (kty == nullptr || strcmp(kty, "RSA") != 0) {
-      gpr_log(GPR_ERROR, "Missing or unsupported key type %s.", kty);
-      continue;
-    }
-    if (!ExtractPubkeyFromJwk(jkey)) {
-      // Failed to extract public key from this Jwk key.
-      continue;
-    }
-    if (header_->kid != nullptr) {
-      return VerifyPubkey();
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyJwkKeys(
+    const PublicKeys &keys) {
+  // Precondition (checked by caller): header_ is parsed.
+  if (header_.has_kid) {
+    const PublicKeys::Key *key =
+        keys.Find(header_.kid.c_str(), header_.alg.c_str());
+    if (key == nullptr) {
+      gpr_log(GPR_ERROR,
+              "Cannot find matching key in key set for kid=%s and alg=%s",
+              header_.kid.c_str(), header_.alg.c_str());
+      return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
     }
-    // If kid is not specified in the header, try all keys. If the JWT can be
-    // validated with any of the keys, the request is successful.
-    if (VerifyPubkey() == GRPC_JWT_VERIFIER_OK) {
+    return VerifyKey(*key);
+  }
+  // If kid is not specified in the header, try all keys. If the JWT can be
+  // validated with any of the keys, the request is successful.
+  for (const auto &key : keys.keys()) {
+    if (key.alg == header_.alg &&
+        VerifyKey(key) == GRPC_JWT_VERIFIER_OK) {
       return GRPC_JWT_VERIFIER_OK;
     }
   }
-
-  if (header_->kid != nullptr) {
-    gpr_log(GPR_ERROR,
-            "Cannot find matching key in key set for kid=%s and alg=%s",
-            header_->kid, header_->alg);
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
-  }
-  // header_->kid is nullptr. The JWT cannot be validated with any of the keys.
+  // header_ has no kid. The JWT cannot be validated with any of the keys.
   // Return error.
   gpr_log(GPR_ERROR,
           "The JWT cannot be validated with any of the public keys.");
   return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
 }
 
-bool JwtValidatorImpl::ExtractPubkeyFromJwk(const grpc_json *jkey) {
-  if (rsa_ != nullptr) {
-    RSA_free(rsa_);
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyKey(
+    const PublicKeys::Key &key) {
+  if (header_.alg == "EdDSA") {
+    return VerifyEd25519(key.ed25519_key);
   }
-  rsa_ = RSA_new();
-  if (rsa_ == nullptr) {
-    gpr_log(GPR_ERROR, "Could not create rsa key.");
-    return false;
-  }
-
-  const char *rsa_n = GetStringValue(jkey, "n");
-  rsa_->n =
-      rsa_n == nullptr ? nullptr : BigNumFromBase64String(&exec_ctx_, rsa_n);
-  const char *rsa_e = GetStringValue(jkey, "e");
-  rsa_->e =
-      rsa_e == nullptr ? nullptr : BigNumFromBase64String(&exec_ctx_, rsa_e);
-
-  if (rsa_->e == nullptr || rsa_->n == nullptr) {
-    gpr_log(GPR_ERROR, "Missing RSA public key field.");
-    return false;
-  }
-
-  if (pkey_ != nullptr) {
-    EVP_PKEY_free(pkey_);
-  }
-  pkey_ = EVP_PKEY_new();
-  if (EVP_PKEY_set1_RSA(pkey_, rsa_) == 0) {
-    gpr_log(GPR_ERROR, "EVP_PKEY_ste1_RSA failed");
-    return false;
-  }
-  return true;
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyRsSignature(const char *pkey,
-                                                             size_t pkey_len) {
-  pkey_buffer_ = gpr_slice_from_copied_buffer(pkey, pkey_len);
-  if (GPR_SLICE_IS_EMPTY(pkey_buffer_)) {
+  EVP_PKEY *pkey = key.pkey;
+  if (pkey == nullptr) {
+    gpr_log(GPR_ERROR, "Cannot find public key.");
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
-  pkey_json_ = grpc_json_parse_string_with_len(
-      reinterpret_cast<char *>(GPR_SLICE_START_PTR(pkey_buffer_)),
-      GPR_SLICE_LENGTH(pkey_buffer_));
-  if (pkey_json_ == nullptr) {
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
+  // An RS token must not be verified with an EC key, nor the reverse.
+  bool is_ecdsa = header_.alg.compare(0, 2, "ES") == 0;
+  if (EVP_PKEY_id(pkey) != (is_ecdsa ? EVP_PKEY_EC : EVP_PKEY_RSA)) {
+    gpr_log(GPR_ERROR, "The key type does not match alg [%s].",
+            header_.alg.c_str());
+    return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
-
-  return FindAndVerifySignature();
-}
-
-grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkey() {
-  if (pkey_ == nullptr) {
-    gpr_log(GPR_ERROR, "Cannot find public key.");
-    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
+  const std::string *sig = &sig_;
+  std::string der_sig;
+  if (is_ecdsa) {
+    if (!EcdsaSignatureToDer(sig_, 32, &der_sig)) {
+      gpr_log(GPR_ERROR, "Invalid ECDSA signature.");
+      return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
+    }
+    sig = &der_sig;
   }
   if (md_ctx_ != nullptr) {
     EVP_MD_CTX_destroy(md_ctx_);
@@ -641,21 +435,55 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkey() {
     gpr_log(GPR_ERROR, "Could not create EVP_MD_CTX.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
-  const EVP_MD *md = EvpMdFromAlg(header_->alg);
+  const EVP_MD *md = EvpMdFromAlg(header_.alg.c_str());
 
   GPR_ASSERT(md != nullptr);  // Checked before.
 
-  if (EVP_DigestVerifyInit(md_ctx_, nullptr, md, nullptr, pkey_) != 1) {
+  if (EVP_DigestVerifyInit(md_ctx_, nullptr, md, nullptr, pkey) != 1) {
     gpr_log(GPR_ERROR, "EVP_DigestVerifyInit failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
-  if (EVP_DigestVerifyUpdate(md_ctx_, GPR_SLICE_START_PTR(signed_buffer_),
-                             GPR_SLICE_LENGTH(signed_buffer_)) != 1) {
+  if (EVP_DigestVerifyUpdate(md_ctx_, jwt, signed_len_) != 1) {
     gpr_log(GPR_ERROR, "EVP_DigestVerifyUpdate failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
-  if (EVP_DigestVerifyFinal(md_ctx_, GPR_SLICE_START_PTR(sig_buffer_),
-                            GPR_SLICE_LENGTH(sig_buffer_)) != 1) {
+  if (EVP_DigestVerifyFinal(
+          md_ctx_, reinterpret_cast<const unsigned char *>(sig->data()),
+          sig->size()) != 1) {
+    gpr_log(GPR_ERROR, "JWT signature verification failed.");
+    return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
+  }
+  return GRPC_JWT_VERIFIER_OK;
+}
+
+grpc_jwt_verifier_status JwtValidatorImpl::VerifyEd25519(
+    const std::string &public_key) {
+  if (public_key.size() != 32) {
+    gpr_log(GPR_ERROR, "Cannot find public key.");
+    return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
+  }
+  if (sig_.size() != 64) {
+    gpr_log(GPR_ERROR, "Invalid EdDSA signature.");
+    return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
+  }
+  const uint8_t *key = reinterpret_cast<const uint8_t *>(public_key.data());
+  const uint8_t *sig = reinterpret_cast<const uint8_t *>(sig_.data());
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(jwt);
+#if defined(OPENSSL_IS_BORINGSSL)
+  bool verified = ED25519_verify(data, signed_len_, sig, key) == 1;
+#else
+  bool verified = false;
+  EVP_PKEY *pkey =
+      EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr, key, 32);
+  EVP_MD_CTX *md_ctx = EVP_MD_CTX_create();
+  if (pkey != nullptr && md_ctx != nullptr &&
+      EVP_DigestVerifyInit(md_ctx, nullptr, nullptr, nullptr, pkey) == 1) {
+    verified = EVP_DigestVerify(md_ctx, sig, 64, data, signed_len_) == 1;
+  }
+  EVP_MD_CTX_destroy(md_ctx);
+  EVP_PKEY_free(pkey);
+#endif
+  if (!verified) {
     gpr_log(GPR_ERROR, "JWT signature verification failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
@@ -664,7 +492,7 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyPubkey() {
 
 grpc_jwt_verifier_status JwtValidatorImpl::VerifyHsSignature(const char *pkey,
                                                              size_t pkey_len) {
-  const EVP_MD *md = EvpMdFromAlg(header_->alg);
+  const EVP_MD *md = EvpMdFromAlg(header_.alg.c_str());
   GPR_ASSERT(md != nullptr);  // Checked before.
 
   pkey_buffer_ = grpc_base64_decode_with_len(&exec_ctx_, pkey, pkey_len, 1);
@@ -673,19 +501,18 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyHsSignature(const char *pkey,
     return GRPC_JWT_VERIFIER_KEY_RETRIEVAL_ERROR;
   }
 
-  unsigned char res[HashSizeFromAlg(header_->alg)];
+  unsigned char res[HashSizeFromAlg(header_.alg.c_str())];
   unsigned int res_len = 0;
   HMAC(md, GPR_SLICE_START_PTR(pkey_buffer_), GPR_SLICE_LENGTH(pkey_buffer_),
-       GPR_SLICE_START_PTR(signed_buffer_), GPR_SLICE_LENGTH(signed_buffer_),
-       res, &res_len);
+       reinterpret_cast<const unsigned char *>(jwt), signed_len_, res,
+       &res_len);
   if (res_len == 0) {
     gpr_log(GPR_ERROR, "Cannot compute HMAC from secret.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
 
-  if (res_len != GPR_SLICE_LENGTH(sig_buffer_) ||
-      CRYPTO_memcmp(reinterpret_cast<void *>(GPR_SLICE_START_PTR(sig_buffer_)),
-                    reinterpret_cast<void *>(res), res_len) != 0) {
+  if (res_len != sig_.size() ||
+      CRYPTO_memcmp(sig_.data(), res, res_len) != 0) {
     gpr_log(GPR_ERROR, "JWT signature verification failed.");
     return GRPC_JWT_VERIFIER_BAD_SIGNATURE;
   }
@@ -695,40 +522,28 @@ grpc_jwt_verifier_status JwtValidatorImpl::VerifyHsSignature(const char *pkey,
 grpc_jwt_verifier_status JwtValidatorImpl::FillUserInfoAndSetExp(
     UserInfo *user_info) {
   // Required fields.
-  const char *issuer = grpc_jwt_claims_issuer(claims_);
-  if (issuer == nullptr) {
+  if (!claims_.has_iss) {
     gpr_log(GPR_ERROR, "Missing issuer field.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  if (audiences_.empty()) {
+  if (claims_.audiences.empty()) {
     gpr_log(GPR_ERROR, "Missing audience field.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  const char *subject = grpc_jwt_claims_subject(claims_);
-  if (subject == nullptr) {
+  if (!claims_.has_sub) {
     gpr_log(GPR_ERROR, "Missing subject field.");
     return GRPC_JWT_VERIFIER_BAD_FORMAT;
   }
-  user_info->issuer = issuer;
-  user_info->audiences = audiences_;
-  user_info->id = subject;
+  user_info->issuer = claims_.iss;
+  user_info->audiences = claims_.audiences;
+  user_info->id = claims_.sub;
 
   // Optional field.
-  const grpc_json *grpc_json = grpc_jwt_claims_json(claims_);
-
-  char *json_str =
-      grpc_json_dump_to_string(const_cast<::grpc_json *>(grpc_json), 0);
-  if (json_str != nullptr) {
-    user_info->claims = json_str;
-    gpr_free(json_str);
-  }
-
-  const char *email = GetStringValue(grpc_json, "email");
-  user_info->email = email == nullptr ? "" : email;
-  const char *authorized_party = GetStringValue(grpc_json, "azp");
-  user_info->authorized_party =
-      authorized_party == nullptr ? "" : authorized_party;
-  exp_ = system_clock::from_time_t(grpc_jwt_claims_expires_at(claims_).tv_sec);
+  user_info->claims = buffer_;
+  user_info->email = claims_.email;
+  user_info->authorized_party = claims_.azp;
+  exp_ = claims_.exp != 0 ? system_clock::from_time_t(claims_.exp)
+                          : system_clock::time_point::max();
 
   return GRPC_JWT_VERIFIER_OK;
 }
@@ -736,6 +551,8 @@ grpc_jwt_verifier_status JwtValidatorImpl::FillUserInfoAndSetExp(
 const EVP_MD *EvpMdFromAlg(const char *alg) {
   if (strcmp(alg, "RS256") == 0 || strcmp(alg, "HS256") == 0) {
     return EVP_sha256();
+  } else if (strcmp(alg, "ES256") == 0) {
+    return EVP_sha256();
   } else if (strcmp(alg, "RS384") == 0 || strcmp(alg, "HS384") == 0) {
     return EVP_sha384();
   } else if (strcmp(alg, "RS512") == 0 || strcmp(alg, "HS512") == 0) {
@@ -745,6 +562,42 @@ const EVP_MD *EvpMdFromAlg(const char *alg) {
   }
 }
 
+bool IsSupportedAlg(const char *alg) {
+  // EdDSA hashes internally, so it has no EVP_MD.
+  return EvpMdFromAlg(alg) != nullptr || strcmp(alg, "EdDSA") == 0;
+}
+
+// Appends a DER INTEGER holding the unsigned big-endian value.
+void AppendDerInteger(const char *value, size_t size, std::string *der) {
+  while (size > 1 && value[0] == 0) {
+    ++value;
+    --size;
+  }
+  bool pad = (value[0] & 0x80) != 0;
+  der->push_back(0x02);
+  der->push_back(static_cast<char>(size + pad));
+  if (pad) {
+    der->push_back(0);
+  }
+  der->append(value, size);
+}
+
+bool EcdsaSignatureToDer(const std::string &sig, size_t component_size,
+                         std::string *der) {
+  // Short form lengths are enough for the curves up to P-384.
+  if (sig.size() != 2 * component_size || component_size > 48) {
+    return false;
+  }
+  std::string integers;
+  AppendDerInteger(sig.data(), component_size, &integers);
+  AppendDerInteger(sig.data() + component_size, component_size, &integers);
+  der->clear();
+  der->push_back(0x30);
+  der->push_back(static_cast<char>(integers.size()));
+  der->append(integers);
+  return true;
+}
+
 // Gets hash byte size from HS algorithm string.
 size_t HashSizeFromAlg(const char *alg) {
   if (strcmp(alg, "HS256") == 0) {
@@ -758,39 +611,6 @@ size_t HashSizeFromAlg(const char *alg) {
   }
 }
 
-grpc_json *DecodeBase64AndParseJson(grpc_exec_ctx *exec_ctx, const char *str,
-                                    size_t len, gpr_slice *buffer) {
-  grpc_json *json;
-
-  *buffer = grpc_base64_decode_with_len(exec_ctx, str, len, 1);
-  if (GPR_SLICE_IS_EMPTY(*buffer)) {
-    gpr_log(GPR_ERROR, "Invalid base64.");
-    return nullptr;
-  }
-  json = grpc_json_parse_string_with_len(
-      reinterpret_cast<char *>(GPR_SLICE_START_PTR(*buffer)),
-      GPR_SLICE_LENGTH(*buffer));
-  if (json == nullptr) {
-    gpr_log(GPR_ERROR, "JSON parsing error.");
-  }
-  return json;
-}
-
-BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64) {
-  BIGNUM *result = nullptr;
-  gpr_slice bin;
-
-  if (b64 == nullptr) return nullptr;
-  bin = grpc_base64_decode(exec_ctx, b64, 1);
-  if (GPR_SLICE_IS_EMPTY(bin)) {
-    gpr_log(GPR_ERROR, "Invalid base64 for big num.");
-    return nullptr;
-  }
-  result = BN_bin2bn(GPR_SLICE_START_PTR(bin), GPR_SLICE_LENGTH(bin), nullptr);
-  gpr_slice_unref(bin);
-  return result;
-}
-
 }  // namespace
 }  // namespace auth
 }  // namespace api_manager
@@ -21,6 +21,7 @@
 
 #include "contrib/endpoints/include/api_manager/utils/status.h"
 #include "contrib/endpoints/src/api_manager/auth.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
 
 using ::google::api_manager::utils::Status;
 
@@ -43,6 +44,11 @@ class JwtValidator {
   // Otherwise, produces a status error message.
   virtual Status VerifySignature(const char *pkey, size_t pkey_len) = 0;
 
+  // Verify signature with a key set that has already been parsed.
+  // Returns Status::OK when signature verification is successful.
+  // Otherwise, produces a status error message.
+  virtual Status VerifySignature(const PublicKeys &keys) = 0;
+
   // Returns the expiration time of the JWT.
   virtual std::chrono::system_clock::time_point &GetExpirationTime() = 0;
 
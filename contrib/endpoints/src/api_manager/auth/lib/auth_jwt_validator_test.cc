@@ -307,6 +307,36 @@ const char kTokenWithAzp[] =
     "Z_Wbu2Pc9Pq0kPHQo-e9gKCt403cI8MaVxDQkSolpjiVg29rul5m7k359q_XVexvsboHRVP2-"
     "no5Y_Ge3KbA7XosymMYlal0J0iYHQuV_sw";
 
+// An EC key on the P-256 curve with kid "es-key" and an Ed25519 key with kid
+// "ed-key".
+const char kPublicKeyJwkEc[] =
+    "{\"keys\":[{\"kty\":\"EC\",\"crv\":\"P-256\",\"alg\":\"ES256\",\"kid\":"
+    "\"es-key\",\"x\":\"y-zwUrLT8WfJFQhuJxJQtf9dwDdjZrxg9mRS6F6pZ2c\",\"y\":"
+    "\"dBwTglvheWzKCkR-27Vw_v2GECMgnz7JOtOKlPl3Tyk\"},{\"kty\":\"OKP\",\"crv"
+    "\":\"Ed25519\",\"alg\":\"EdDSA\",\"kid\":\"ed-key\",\"x\":\"D1ICP5gjJh9I"
+    "9u_XqT3I5siVaL6cJxdSb1awb2VI9n8\"}]}";
+
+// ES256 token signed with "es-key".
+const char kTokenEs256[] =
+    "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVzLWtleSJ9.eyJpc3MiOiJlcy1"
+    "pc3N1ZXJAZXhhbXBsZS5jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQ"
+    "iOiJodHRwOi8vbXlzZXJ2aWNlLmNvbS9teWFwaSJ9.wr08a9gl3dO-T5GmQfUi9d9YtWbQxy"
+    "0sWVjzPSGR3HI_k2uIfKOxTa6TucL0sNvIlzj6ZQ3xk6LveuoES-IylA";
+
+// ES256 token without kid, signed with "es-key".
+const char kTokenEs256NoKid[] =
+    "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCJ9.eyJpc3MiOiJlcy1pc3N1ZXJAZXhhbXBsZS5"
+    "jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQiOiJodHRwOi8vbXlzZXJ"
+    "2aWNlLmNvbS9teWFwaSJ9.zNKFC8tNPjk_JdSXqhHAMDBqVO4xR49fsqxW04nn1rlBTP8To7"
+    "qTAcGUsN1qjrJgrPgUhD2k2Rq3S6Lpc2HPjA";
+
+// EdDSA token signed with "ed-key".
+const char kTokenEdDsa[] =
+    "eyJhbGciOiJFZERTQSIsInR5cCI6IkpXVCIsImtpZCI6ImVkLWtleSJ9.eyJpc3MiOiJlcy1"
+    "pc3N1ZXJAZXhhbXBsZS5jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQ"
+    "iOiJodHRwOi8vbXlzZXJ2aWNlLmNvbS9teWFwaSJ9.yXcLHhwbj3yTH7J4HnkPcfORdLReVZ"
+    "d8TYVQuPIYhvZXq47b6yiZzH62u0imTdBcEzR2laR9BsKX1JJYevZgBQ";
+
 class JwtValidatorTest : public ::testing::Test {
  public:
   void SetUp() {}
@@ -338,13 +368,22 @@ void TestTokenWithPubkey(char *token, const char *pkey) {
   ASSERT_EQ(status.message(), "BAD_FORMAT") << status.message();
 
   // Wrong sig.
-  validator = JwtValidator::Create(token, strlen(token) - 1);
+  std::string wrong_sig(token);
+  size_t sig_pos = wrong_sig.rfind('.') + 1;
+  wrong_sig[sig_pos] = wrong_sig[sig_pos] == 'A' ? 'B' : 'A';
+  validator = JwtValidator::Create(wrong_sig.c_str(), wrong_sig.size());
   status = validator->Parse(&user_info);
   ASSERT_TRUE(status.ok());
   status = validator->VerifySignature(pkey, strlen(pkey));
   ASSERT_FALSE(status.ok());
   ASSERT_EQ(status.message(), "BAD_SIGNATURE") << status.message();
 
+  // Truncated sig, which is not valid base64url.
+  validator = JwtValidator::Create(token, strlen(token) - 1);
+  status = validator->Parse(&user_info);
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "BAD_FORMAT") << status.message();
+
   // Wrong key length.
   validator = JwtValidator::Create(token, strlen(token));
   status = validator->Parse(&user_info);
@@ -491,6 +530,80 @@ TEST_F(JwtValidatorTest, TokenWithAuthorizedParty) {
   ASSERT_EQ(user_info.authorized_party, kAuthorizedParty);
 }
 
+// Verifies a token signed with kPublicKeyJwkEc, and checks that flipping a
+// bit of its signature fails the verification.
+void TestEcKeysToken(const char *token) {
+  UserInfo user_info;
+  std::unique_ptr<JwtValidator> validator =
+      JwtValidator::Create(token, strlen(token));
+  Status status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok()) << status.message();
+  ASSERT_EQ("es-issuer@example.com", user_info.issuer);
+  ASSERT_EQ("es-issuer@example.com", user_info.id);
+  ASSERT_EQ(1U, user_info.audiences.count(kAudience));
+
+  status = validator->VerifySignature(kPublicKeyJwkEc, strlen(kPublicKeyJwkEc));
+  ASSERT_TRUE(status.ok()) << status.message();
+
+  std::string wrong_sig(token);
+  size_t sig_pos = wrong_sig.rfind('.') + 1;
+  wrong_sig[sig_pos] = wrong_sig[sig_pos] == 'A' ? 'B' : 'A';
+  validator = JwtValidator::Create(wrong_sig.c_str(), wrong_sig.size());
+  status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+  status = validator->VerifySignature(kPublicKeyJwkEc, strlen(kPublicKeyJwkEc));
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "BAD_SIGNATURE") << status.message();
+
+  // Truncated signature.
+  std::string short_sig(token, strlen(token) - 4);
+  validator = JwtValidator::Create(short_sig.c_str(), short_sig.size());
+  status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+  status = validator->VerifySignature(kPublicKeyJwkEc, strlen(kPublicKeyJwkEc));
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "BAD_SIGNATURE") << status.message();
+}
+
+TEST_F(JwtValidatorTest, OkTokenEs256) { TestEcKeysToken(kTokenEs256); }
+
+TEST_F(JwtValidatorTest, OkTokenEs256NoKid) {
+  TestEcKeysToken(kTokenEs256NoKid);
+}
+
+TEST_F(JwtValidatorTest, OkTokenEdDsa) { TestEcKeysToken(kTokenEdDsa); }
+
+TEST_F(JwtValidatorTest, EcTokenWithRsaKeys) {
+  UserInfo user_info;
+  std::unique_ptr<JwtValidator> validator =
+      JwtValidator::Create(kTokenEs256NoKid, strlen(kTokenEs256NoKid));
+  Status status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+
+  // No RSA key may verify an ES256 token.
+  status = validator->VerifySignature(kPublicKeyX509, strlen(kPublicKeyX509));
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "BAD_SIGNATURE") << status.message();
+
+  validator = JwtValidator::Create(kTokenEs256, strlen(kTokenEs256));
+  status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+  status = validator->VerifySignature(kPublicKeyJwk, strlen(kPublicKeyJwk));
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "KEY_RETRIEVAL_ERROR") << status.message();
+}
+
+TEST_F(JwtValidatorTest, RsTokenWithEcKeys) {
+  UserInfo user_info;
+  std::unique_ptr<JwtValidator> validator =
+      JwtValidator::Create(kTokenNoKid, strlen(kTokenNoKid));
+  Status status = validator->Parse(&user_info);
+  ASSERT_TRUE(status.ok());
+  status = validator->VerifySignature(kPublicKeyJwkEc, strlen(kPublicKeyJwkEc));
+  ASSERT_FALSE(status.ok());
+  ASSERT_EQ(status.message(), "BAD_SIGNATURE") << status.message();
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -16,15 +16,101 @@
 //
 #include "contrib/endpoints/src/api_manager/auth/lib/base64.h"
 
+#include <cstdint>
 #include <cstring>
 #include <string>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "contrib/endpoints/src/api_manager/auth/lib/grpc_internals.h"
 
 namespace google {
 namespace api_manager {
 namespace auth {
 
+namespace {
+
+// Maps a base64url character to its 6-bit value, or to -1.
+struct DecodeTable {
+  DecodeTable() {
+    memset(values, -1, sizeof(values));
+    for (int i = 0; i < 26; ++i) {
+      values['A' + i] = i;
+      values['a' + i] = 26 + i;
+    }
+    for (int i = 0; i < 10; ++i) {
+      values['0' + i] = 52 + i;
+    }
+    values['-'] = 62;
+    values['_'] = 63;
+  }
+
+  signed char values[256];
+};
+
+const DecodeTable kDecodeTable;
+
+#if defined(__SSE2__)
+// Decodes 16 base64url characters into 12 bytes. Returns false, with out
+// left partially written, if any character is not base64url.
+inline bool DecodeBlock(const char *in, unsigned char *out) {
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+
+  // Classifies each character by range, and adds the offset which maps the
+  // range to its 6-bit values. A character in no range is invalid.
+  const __m128i upper =
+      _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+                    _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+  const __m128i lower =
+      _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)),
+                    _mm_cmplt_epi8(chars, _mm_set1_epi8('z' + 1)));
+  const __m128i digit =
+      _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                    _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+  const __m128i dash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('-'));
+  const __m128i underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+  const __m128i valid = _mm_or_si128(
+      _mm_or_si128(upper, lower),
+      _mm_or_si128(digit, _mm_or_si128(dash, underscore)));
+  if (_mm_movemask_epi8(valid) != 0xFFFF) {
+    return false;
+  }
+
+  __m128i offset = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+  offset = _mm_or_si128(offset,
+                        _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+  offset = _mm_or_si128(offset,
+                        _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+  offset = _mm_or_si128(offset, _mm_and_si128(dash, _mm_set1_epi8(62 - '-')));
+  offset = _mm_or_si128(offset,
+                        _mm_and_si128(underscore, _mm_set1_epi8(63 - '_')));
+  const __m128i values = _mm_add_epi8(chars, offset);
+
+  // Packs the 6-bit values of each group of 4 characters into the low
+  // 24 bits of a 32-bit lane: first pairs into 12 bits, then into 24 bits.
+  const __m128i pairs = _mm_or_si128(
+      _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 6),
+      _mm_srli_epi16(values, 8));
+  const __m128i groups = _mm_or_si128(
+      _mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0x0000FFFF)), 12),
+      _mm_srli_epi32(pairs, 16));
+
+  uint32_t lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), groups);
+  for (int i = 0; i < 4; ++i) {
+    out[0] = static_cast<unsigned char>(lanes[i] >> 16);
+    out[1] = static_cast<unsigned char>(lanes[i] >> 8);
+    out[2] = static_cast<unsigned char>(lanes[i]);
+    out += 3;
+  }
+  return true;
+}
+#endif
+
+}  // namespace
+
 char *esp_base64_encode(const void *data, size_t data_size, bool url_safe,
                         bool multiline, bool padding) {
   char *result =
@@ -43,6 +129,55 @@ char *esp_base64_encode(const void *data, size_t data_size, bool url_safe,
   return result;
 }
 
+bool Base64UrlDecode(const char *data, size_t data_size, std::string *out) {
+  // Padding is optional, but must be complete if present.
+  if (data_size > 0 && data[data_size - 1] == '=') {
+    if (data_size % 4 != 0) {
+      return false;
+    }
+    --data_size;
+    if (data[data_size - 1] == '=') {
+      --data_size;
+    }
+  }
+  if (data_size % 4 == 1) {
+    return false;
+  }
+
+  size_t decoded_size =
+      data_size / 4 * 3 + (data_size % 4 ? data_size % 4 - 1 : 0);
+  out->resize(decoded_size);
+  unsigned char *dst = reinterpret_cast<unsigned char *>(&(*out)[0]);
+  const char *src = data;
+  const char *end = data + data_size;
+
+#if defined(__SSE2__)
+  while (end - src >= 16) {
+    if (!DecodeBlock(src, dst)) {
+      return false;
+    }
+    src += 16;
+    dst += 12;
+  }
+#endif
+
+  uint32_t bits = 0;
+  int num_bits = 0;
+  for (; src < end; ++src) {
+    int value = kDecodeTable.values[static_cast<unsigned char>(*src)];
+    if (value < 0) {
+      return false;
+    }
+    bits = (bits << 6) | value;
+    num_bits += 6;
+    if (num_bits >= 8) {
+      num_bits -= 8;
+      *dst++ = static_cast<unsigned char>(bits >> num_bits);
+    }
+  }
+  return true;
+}
+
 }  // namespace auth
 }  // namespace api_manager
 }  // namespace google
@@ -16,6 +16,7 @@
 #define API_MANAGER_AUTH_LIB_BASE64_H_
 
 #include <string.h>
+#include <string>
 
 namespace google {
 namespace api_manager {
@@ -26,6 +27,11 @@ namespace auth {
 char *esp_base64_encode(const void *data, size_t data_size, bool url_safe,
                         bool multiline, bool padding);
 
+// Decodes base64url data, with or without padding, into out, replacing its
+// content but reusing its capacity. Returns false if the data is not valid
+// base64url. Runs of 16 characters are translated with SSE2 when available.
+bool Base64UrlDecode(const char *data, size_t data_size, std::string *out);
+
 }  // namespace auth
 }  // namespace api_manager
 }  // namespace google
@@ -55,6 +55,53 @@ TEST(EspBase64Test, EncodeTest) {
   }
 }
 
+TEST(EspBase64Test, UrlDecodeTest) {
+  std::string decoded;
+  for (const auto &t : test_vectors) {
+    ASSERT_TRUE(Base64UrlDecode(t.encoded_padding, strlen(t.encoded_padding),
+                                &decoded));
+    ASSERT_EQ(t.data, decoded);
+
+    ASSERT_TRUE(Base64UrlDecode(t.encoded_no_padding,
+                                strlen(t.encoded_no_padding), &decoded));
+    ASSERT_EQ(t.data, decoded);
+  }
+}
+
+TEST(EspBase64Test, UrlDecodeLongTest) {
+  // Covers both the vectorized blocks and the scalar tail, for every
+  // length and every byte value.
+  std::string data;
+  for (int i = 0; i < 300; ++i) {
+    data.push_back(static_cast<char>((i * 7) & 0xFF));
+  }
+  std::string decoded;
+  for (size_t len = 0; len <= data.size(); ++len) {
+    char *encoded = esp_base64_encode(data.data(), len, true, false, false);
+    ASSERT_NE(nullptr, encoded);
+    ASSERT_TRUE(Base64UrlDecode(encoded, strlen(encoded), &decoded));
+    ASSERT_EQ(data.substr(0, len), decoded);
+    esp_grpc_free(encoded);
+  }
+}
+
+TEST(EspBase64Test, UrlDecodeInvalidTest) {
+  std::string decoded;
+  // Not base64url characters, in the scalar tail and in a full block.
+  ASSERT_FALSE(Base64UrlDecode("Zm9v+g", 6, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9v/g", 6, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9v.g", 6, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9vYmFyZm9vYmF\\Zm9v", 20, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9vYmFyZm9vYmF\xff" "Zm9v", 20, &decoded));
+  // Wrong lengths and padding.
+  ASSERT_FALSE(Base64UrlDecode("Zm9vY", 5, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9v=", 5, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9vYg===", 9, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm9vYg=", 7, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("===", 3, &decoded));
+  ASSERT_FALSE(Base64UrlDecode("Zm=9", 4, &decoded));
+}
+
 }  // namespace auth
 }  // namespace api_manager
 }  // namespace google
@@ -0,0 +1,432 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/jwt_claims.h"
+
+#include <cstdlib>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+
+// Limits the nesting of skipped values, so that the scanner cannot run out
+// of stack on a hostile token.
+const int kMaxDepth = 64;
+
+// A single-pass JSON scanner. It validates the whole document but only
+// materializes the values its caller asks for.
+class Scanner {
+ public:
+  enum ValueType { STRING, NUMBER, OBJECT, ARRAY, LITERAL, INVALID };
+
+  Scanner(const char *json, size_t json_len)
+      : cur_(json), end_(json + json_len) {}
+
+  // Returns the type of the next value, after skipping whitespace.
+  ValueType Peek() {
+    SkipWhitespace();
+    if (cur_ == end_) {
+      return INVALID;
+    }
+    switch (*cur_) {
+      case '"':
+        return STRING;
+      case '{':
+        return OBJECT;
+      case '[':
+        return ARRAY;
+      case 't':
+      case 'f':
+      case 'n':
+        return LITERAL;
+      default:
+        return *cur_ == '-' || (*cur_ >= '0' && *cur_ <= '9') ? NUMBER
+                                                               : INVALID;
+    }
+  }
+
+  // Parses a string into out, or skips it if out is nullptr.
+  bool ParseString(std::string *out) {
+    if (Peek() != STRING) {
+      return false;
+    }
+    ++cur_;
+    if (out != nullptr) {
+      out->clear();
+    }
+    while (true) {
+      // Copies the run of plain characters at once.
+      const char *start = cur_;
+      while (cur_ < end_ && *cur_ != '"' && *cur_ != '\\' &&
+             static_cast<unsigned char>(*cur_) >= 0x20) {
+        ++cur_;
+      }
+      if (out != nullptr) {
+        out->append(start, cur_ - start);
+      }
+      if (cur_ == end_ || static_cast<unsigned char>(*cur_) < 0x20) {
+        return false;
+      }
+      if (*cur_++ == '"') {
+        return true;
+      }
+      if (!ParseEscape(out)) {
+        return false;
+      }
+    }
+  }
+
+  // Parses a number, returning its integer part as strtol() would.
+  bool ParseInteger(int64_t *out) {
+    if (Peek() != NUMBER) {
+      return false;
+    }
+    const char *start = cur_;
+    if (!SkipNumber()) {
+      return false;
+    }
+    *out = strtoll(std::string(start, cur_ - start).c_str(), nullptr, 10);
+    return true;
+  }
+
+  // Iterates over the members of an object. on_member(key) is called with
+  // the scanner positioned at the value, and must consume it.
+  template <class OnMember>
+  bool ParseObject(OnMember on_member) {
+    if (Peek() != OBJECT || ++depth_ > kMaxDepth) {
+      return false;
+    }
+    ++cur_;
+    if (Consume('}')) {
+      --depth_;
+      return true;
+    }
+    do {
+      if (!ParseString(&key_) || !Consume(':') || !on_member(key_)) {
+        return false;
+      }
+    } while (Consume(','));
+    --depth_;
+    return Consume('}');
+  }
+
+  // Iterates over the elements of an array. on_element() is called with the
+  // scanner positioned at the element, and must consume it.
+  template <class OnElement>
+  bool ParseArray(OnElement on_element) {
+    if (Peek() != ARRAY || ++depth_ > kMaxDepth) {
+      return false;
+    }
+    ++cur_;
+    if (Consume(']')) {
+      --depth_;
+      return true;
+    }
+    do {
+      if (!on_element()) {
+        return false;
+      }
+    } while (Consume(','));
+    --depth_;
+    return Consume(']');
+  }
+
+  // Validates and skips any value.
+  bool SkipValue() {
+    switch (Peek()) {
+      case STRING:
+        return ParseString(nullptr);
+      case NUMBER:
+        return SkipNumber();
+      case OBJECT:
+        return ParseObject([this](const std::string &) { return SkipValue(); });
+      case ARRAY:
+        return ParseArray([this]() { return SkipValue(); });
+      case LITERAL:
+        return SkipLiteral("true") || SkipLiteral("false") ||
+               SkipLiteral("null");
+      default:
+        return false;
+    }
+  }
+
+  // Returns true if only whitespace is left.
+  bool AtEnd() {
+    SkipWhitespace();
+    return cur_ == end_;
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (cur_ < end_ &&
+           (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r')) {
+      ++cur_;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (cur_ < end_ && *cur_ == c) {
+      ++cur_;
+      return true;
+    }
+    return false;
+  }
+
+  bool SkipLiteral(const char *literal) {
+    const char *p = cur_;
+    for (; *literal != '\0'; ++literal, ++p) {
+      if (p == end_ || *p != *literal) {
+        return false;
+      }
+    }
+    cur_ = p;
+    return true;
+  }
+
+  bool SkipDigits() {
+    const char *start = cur_;
+    while (cur_ < end_ && *cur_ >= '0' && *cur_ <= '9') {
+      ++cur_;
+    }
+    return cur_ != start;
+  }
+
+  bool SkipNumber() {
+    if (cur_ < end_ && *cur_ == '-') {
+      ++cur_;
+    }
+    if (cur_ < end_ && *cur_ == '0') {
+      ++cur_;
+    } else if (!SkipDigits()) {
+      return false;
+    }
+    if (cur_ < end_ && *cur_ == '.') {
+      ++cur_;
+      if (!SkipDigits()) {
+        return false;
+      }
+    }
+    if (cur_ < end_ && (*cur_ == 'e' || *cur_ == 'E')) {
+      ++cur_;
+      if (cur_ < end_ && (*cur_ == '+' || *cur_ == '-')) {
+        ++cur_;
+      }
+      if (!SkipDigits()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ParseHex4(uint32_t *out) {
+    if (end_ - cur_ < 4) {
+      return false;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      char c = *cur_++;
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    *out = value;
+    return true;
+  }
+
+  // Parses the escape sequence following a backslash.
+  bool ParseEscape(std::string *out) {
+    if (cur_ == end_) {
+      return false;
+    }
+    char c = *cur_++;
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u':
+        return ParseUnicodeEscape(out);
+      default:
+        return false;
+    }
+    if (out != nullptr) {
+      out->push_back(c);
+    }
+    return true;
+  }
+
+  // Parses a \uXXXX escape, or a surrogate pair of them, into UTF-8.
+  bool ParseUnicodeEscape(std::string *out) {
+    uint32_t code;
+    if (!ParseHex4(&code)) {
+      return false;
+    }
+    if (code >= 0xD800 && code <= 0xDBFF) {
+      uint32_t low;
+      if (end_ - cur_ < 2 || cur_[0] != '\\' || cur_[1] != 'u') {
+        return false;
+      }
+      cur_ += 2;
+      if (!ParseHex4(&low) || low < 0xDC00 || low > 0xDFFF) {
+        return false;
+      }
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+      return false;
+    }
+    if (out == nullptr) {
+      return true;
+    }
+    if (code < 0x80) {
+      out->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    return true;
+  }
+
+  const char *cur_;
+  const char *end_;
+  int depth_ = 0;
+  // Reused for the keys of all objects.
+  std::string key_;
+};
+
+// Parses a string value if it is one, and skips it otherwise.
+bool ParseOptionalString(Scanner *scanner, std::string *out, bool *found) {
+  if (scanner->Peek() != Scanner::STRING) {
+    return scanner->SkipValue();
+  }
+  *found = scanner->ParseString(out);
+  return *found;
+}
+
+// Parses a time claim, which must be a non-zero number.
+bool ParseTime(Scanner *scanner, int64_t *out) {
+  return scanner->ParseInteger(out) && *out != 0;
+}
+
+}  // namespace
+
+bool ParseJoseHeader(const char *json, size_t json_len, JoseHeader *header) {
+  header->has_alg = false;
+  header->has_kid = false;
+  Scanner scanner(json, json_len);
+  return scanner.ParseObject([&scanner, header](const std::string &key) {
+    if (key == "alg") {
+      return ParseOptionalString(&scanner, &header->alg, &header->has_alg);
+    } else if (key == "kid") {
+      return ParseOptionalString(&scanner, &header->kid, &header->has_kid);
+    }
+    return scanner.SkipValue();
+  }) && scanner.AtEnd();
+}
+
+bool ParseJwtClaims(const char *json, size_t json_len, JwtClaims *claims) {
+  claims->has_iss = false;
+  claims->has_sub = false;
+  claims->audiences.clear();
+  claims->azp.clear();
+  claims->email.clear();
+  claims->exp = 0;
+  claims->nbf = 0;
+
+  Scanner scanner(json, json_len);
+  std::string value;
+  bool found;
+  int64_t iat;
+  return scanner.ParseObject([&](const std::string &key) {
+    if (key == "iss") {
+      claims->has_iss = scanner.ParseString(&claims->iss);
+      return claims->has_iss;
+    } else if (key == "sub") {
+      claims->has_sub = scanner.ParseString(&claims->sub);
+      return claims->has_sub;
+    } else if (key == "aud") {
+      claims->audiences.clear();
+      if (scanner.Peek() == Scanner::STRING) {
+        if (!scanner.ParseString(&value)) {
+          return false;
+        }
+        claims->audiences.insert(value);
+        return true;
+      }
+      // Elements other than strings are ignored.
+      return scanner.ParseArray([&]() {
+        found = false;
+        if (!ParseOptionalString(&scanner, &value, &found)) {
+          return false;
+        }
+        if (found) {
+          claims->audiences.insert(value);
+        }
+        return true;
+      });
+    } else if (key == "azp") {
+      return ParseOptionalString(&scanner, &claims->azp, &found);
+    } else if (key == "email") {
+      return ParseOptionalString(&scanner, &claims->email, &found);
+    } else if (key == "exp") {
+      return ParseTime(&scanner, &claims->exp);
+    } else if (key == "nbf") {
+      return ParseTime(&scanner, &claims->nbf);
+    } else if (key == "iat") {
+      return ParseTime(&scanner, &iat);
+    } else if (key == "jti") {
+      return scanner.ParseString(nullptr);
+    }
+    return scanner.SkipValue();
+  }) && scanner.AtEnd();
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
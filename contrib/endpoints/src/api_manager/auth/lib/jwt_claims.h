@@ -0,0 +1,66 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_LIB_JWT_CLAIMS_H_
+#define API_MANAGER_AUTH_LIB_JWT_CLAIMS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// JOSE header. see http://tools.ietf.org/html/rfc7515#section-4
+struct JoseHeader {
+  std::string alg;
+  bool has_alg;
+  std::string kid;
+  bool has_kid;
+};
+
+// The JWT claims used by ESP. see https://tools.ietf.org/html/rfc7519
+struct JwtClaims {
+  std::string iss;
+  bool has_iss;
+  std::string sub;
+  bool has_sub;
+  // Collected from "aud", either a string or an array of strings.
+  std::set<std::string> audiences;
+  std::string azp;
+  std::string email;
+  // Unit: seconds since epoch. Zero if the claim is absent.
+  int64_t exp;
+  int64_t nbf;
+};
+
+// Parses a decoded JOSE header, extracting "alg" and "kid" in a single pass
+// without building a JSON tree. Values of other types than string are
+// ignored. Returns false if the header is not a valid JSON object.
+bool ParseJoseHeader(const char *json, size_t json_len, JoseHeader *header);
+
+// Parses a decoded JWT payload, extracting the claims used by ESP in a single
+// pass without building a JSON tree. Returns false if the payload is not a
+// valid JSON object, or if a registered claim has the wrong type: "iss",
+// "sub" and "jti" must be strings, "aud" a string or an array, and "exp",
+// "nbf" and "iat" non-zero integers. Other claims are skipped.
+bool ParseJwtClaims(const char *json, size_t json_len, JwtClaims *claims);
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_LIB_JWT_CLAIMS_H_
@@ -0,0 +1,159 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/jwt_claims.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+bool ParseHeader(const char *json, JoseHeader *header) {
+  return ParseJoseHeader(json, strlen(json), header);
+}
+
+bool ParseClaims(const char *json, JwtClaims *claims) {
+  return ParseJwtClaims(json, strlen(json), claims);
+}
+
+TEST(JwtClaimsTest, JoseHeader) {
+  JoseHeader header;
+  ASSERT_TRUE(ParseHeader(
+      R"({"alg":"RS256","typ":"JWT","kid":"abc","x5c":[{"a":1}]})", &header));
+  EXPECT_TRUE(header.has_alg);
+  EXPECT_EQ("RS256", header.alg);
+  EXPECT_TRUE(header.has_kid);
+  EXPECT_EQ("abc", header.kid);
+
+  // kid is optional, and ignored if not a string.
+  ASSERT_TRUE(ParseHeader(R"( {"alg" : "HS256", "kid": 12} )", &header));
+  EXPECT_EQ("HS256", header.alg);
+  EXPECT_FALSE(header.has_kid);
+
+  ASSERT_TRUE(ParseHeader("{}", &header));
+  EXPECT_FALSE(header.has_alg);
+}
+
+TEST(JwtClaimsTest, Claims) {
+  JwtClaims claims;
+  ASSERT_TRUE(ParseClaims(
+      R"({"iss":"issuer","sub":"subject","aud":"audience","azp":"party",)"
+      R"("email":"a@b.com","exp":1500000000,"nbf":1400000000,)"
+      R"("iat":1400000000,"jti":"id","extra":{"nested":[1,2.5e3,null]}})",
+      &claims));
+  EXPECT_TRUE(claims.has_iss);
+  EXPECT_EQ("issuer", claims.iss);
+  EXPECT_TRUE(claims.has_sub);
+  EXPECT_EQ("subject", claims.sub);
+  EXPECT_EQ(std::set<std::string>({"audience"}), claims.audiences);
+  EXPECT_EQ("party", claims.azp);
+  EXPECT_EQ("a@b.com", claims.email);
+  EXPECT_EQ(1500000000, claims.exp);
+  EXPECT_EQ(1400000000, claims.nbf);
+}
+
+TEST(JwtClaimsTest, OptionalClaims) {
+  JwtClaims claims;
+  ASSERT_TRUE(ParseClaims(R"({"azp":1,"email":false})", &claims));
+  EXPECT_FALSE(claims.has_iss);
+  EXPECT_FALSE(claims.has_sub);
+  EXPECT_TRUE(claims.audiences.empty());
+  EXPECT_EQ("", claims.azp);
+  EXPECT_EQ("", claims.email);
+  EXPECT_EQ(0, claims.exp);
+  EXPECT_EQ(0, claims.nbf);
+}
+
+TEST(JwtClaimsTest, AudienceArray) {
+  JwtClaims claims;
+  // Elements other than strings are ignored.
+  ASSERT_TRUE(ParseClaims(R"({"aud":["a","b",3,{"c":"d"},"a"]})", &claims));
+  EXPECT_EQ(std::set<std::string>({"a", "b"}), claims.audiences);
+
+  ASSERT_TRUE(ParseClaims(R"({"aud":[]})", &claims));
+  EXPECT_TRUE(claims.audiences.empty());
+}
+
+TEST(JwtClaimsTest, Escapes) {
+  JwtClaims claims;
+  ASSERT_TRUE(ParseClaims(
+      R"({"sub":"a\"b\\c\/d\n\u00e9\u20ac\ud83d\ude00","iss":"\u0041"})",
+      &claims));
+  EXPECT_EQ("a\"b\\c/d\n\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", claims.sub);
+  EXPECT_EQ("A", claims.iss);
+
+  // Escaped keys are matched after unescaping.
+  ASSERT_TRUE(ParseClaims(R"({"\u0069ss":"x"})", &claims));
+  EXPECT_EQ("x", claims.iss);
+}
+
+TEST(JwtClaimsTest, WrongClaimTypes) {
+  JwtClaims claims;
+  EXPECT_FALSE(ParseClaims(R"({"iss":1})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"sub":null})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"jti":[]})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"aud":1})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"exp":"1500000000"})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"nbf":0})", &claims));
+  EXPECT_FALSE(ParseClaims(R"({"iat":true})", &claims));
+}
+
+TEST(JwtClaimsTest, InvalidJson) {
+  JwtClaims claims;
+  const char *invalid[] = {
+      "",
+      "[]",
+      "\"iss\"",
+      "{",
+      "{\"iss\":\"a\"",
+      "{\"iss\":\"a\",}",
+      "{\"iss\" \"a\"}",
+      "{\"iss\":\"a\"} {}",
+      "{\"iss\":\"a\nb\"}",
+      "{\"iss\":\"\\x\"}",
+      "{\"iss\":\"\\u12\"}",
+      "{\"iss\":\"\\ud83d\"}",
+      "{\"iss\":\"\\ude00\"}",
+      "{\"a\":tru}",
+      "{\"a\":nul}",
+      "{\"a\":01}",
+      "{\"a\":1.}",
+      "{\"a\":-}",
+      "{\"a\":1e}",
+      "{\"a\":[1,]}",
+      "{\"a\":{\"b\":1,}}",
+      "{\"a\":+1}",
+  };
+  for (const char *json : invalid) {
+    EXPECT_FALSE(ParseClaims(json, &claims)) << json;
+  }
+
+  // Deeply nested values are rejected.
+  std::string nested = "{\"a\":" + std::string(100, '[') +
+                       std::string(100, ']') + "}";
+  EXPECT_FALSE(ParseJwtClaims(nested.data(), nested.size(), &claims));
+  nested = "{\"a\":" + std::string(10, '[') + std::string(10, ']') + "}";
+  EXPECT_TRUE(ParseJwtClaims(nested.data(), nested.size(), &claims));
+}
+
+}  // namespace
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,203 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Compares the streaming JWT parsing of JwtValidator against the grpc base64
+// decoding, grpc_json tree and grpc_jwt_claims path it replaced.
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/auth_jwt_validator.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/auth_token.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/base64.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/jwt_claims.h"
+#include "contrib/endpoints/src/api_manager/utils/benchmark.h"
+
+extern "C" {
+#include <grpc/support/alloc.h>
+}
+
+#include "contrib/endpoints/src/api_manager/auth/lib/grpc_internals.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/json_util.h"
+
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <string>
+
+using ::google::api_manager::utils::DoNotOptimize;
+using ::google::api_manager::utils::RunBenchmark;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+// The previous implementation, kept here as the baseline.
+namespace baseline {
+
+size_t Parse(const std::string &jwt) {
+  grpc_exec_ctx exec_ctx = GRPC_EXEC_CTX_INIT;
+  const char *dot = strchr(jwt.c_str(), '.');
+  const char *dot2 = strchr(dot + 1, '.');
+  size_t result = 0;
+
+  gpr_slice header_buffer = grpc_base64_decode_with_len(
+      &exec_ctx, jwt.c_str(), dot - jwt.c_str(), 1);
+  grpc_json *header_json = grpc_json_parse_string_with_len(
+      reinterpret_cast<char *>(GPR_SLICE_START_PTR(header_buffer)),
+      GPR_SLICE_LENGTH(header_buffer));
+  const char *alg = GetStringValue(header_json, "alg");
+  const char *kid = GetStringValue(header_json, "kid");
+  result += strlen(alg) + strlen(kid);
+
+  gpr_slice claims_buffer =
+      grpc_base64_decode_with_len(&exec_ctx, dot + 1, dot2 - dot - 1, 1);
+  grpc_json *claims_json = grpc_json_parse_string_with_len(
+      reinterpret_cast<char *>(GPR_SLICE_START_PTR(claims_buffer)),
+      GPR_SLICE_LENGTH(claims_buffer));
+
+  // Collects the audiences and replaces an array with an empty string.
+  std::set<std::string> audiences;
+  for (grpc_json *cur = claims_json->child; cur != nullptr; cur = cur->next) {
+    if (strcmp(cur->key, "aud") == 0) {
+      if (cur->type == GRPC_JSON_ARRAY) {
+        for (grpc_json *aud = cur->child; aud != nullptr; aud = aud->next) {
+          audiences.insert(aud->value);
+        }
+        grpc_json *prev = cur->prev;
+        grpc_json *next = cur->next;
+        grpc_json_destroy(cur);
+        grpc_json *fake_audience = grpc_json_create(GRPC_JSON_STRING);
+        fake_audience->key = "aud";
+        fake_audience->value = "";
+        fake_audience->parent = claims_json;
+        fake_audience->prev = prev;
+        fake_audience->next = next;
+        if (prev) {
+          prev->next = fake_audience;
+        } else {
+          claims_json->child = fake_audience;
+        }
+        if (next) {
+          next->prev = fake_audience;
+        }
+      } else {
+        audiences.insert(cur->value);
+      }
+      break;
+    }
+  }
+  grpc_jwt_claims *claims =
+      grpc_jwt_claims_from_json(&exec_ctx, claims_json, claims_buffer);
+  result += strlen(grpc_jwt_claims_issuer(claims)) +
+            strlen(grpc_jwt_claims_subject(claims)) + audiences.size();
+
+  const grpc_json *json = grpc_jwt_claims_json(claims);
+  char *json_str = grpc_json_dump_to_string(const_cast<grpc_json *>(json), 0);
+  std::string user_info_claims = json_str;
+  gpr_free(json_str);
+  result += user_info_claims.size();
+  result += strlen(GetStringValue(json, "email")) +
+            strlen(GetStringValue(json, "azp"));
+
+  gpr_slice sig_buffer = grpc_base64_decode_with_len(
+      &exec_ctx, dot2 + 1, jwt.size() - (dot2 + 1 - jwt.c_str()), 1);
+  result += GPR_SLICE_LENGTH(sig_buffer);
+
+  gpr_slice_unref(sig_buffer);
+  grpc_jwt_claims_destroy(&exec_ctx, claims);
+  grpc_json_destroy(header_json);
+  gpr_slice_unref(header_buffer);
+  return result;
+}
+
+}  // namespace baseline
+
+std::string Base64UrlEncode(const std::string &data) {
+  char *encoded =
+      esp_base64_encode(data.data(), data.size(), true, false, false);
+  std::string result = encoded;
+  esp_grpc_free(encoded);
+  return result;
+}
+
+// A Google ID token sized JWT with an RS256 signature.
+std::string IdToken(int num_audiences) {
+  std::string exp = std::to_string(std::chrono::system_clock::to_time_t(
+                                       std::chrono::system_clock::now()) +
+                                   3600);
+  std::string audiences;
+  for (int i = 0; i < num_audiences; ++i) {
+    audiences += (i == 0 ? "\"" : ",\"") + std::to_string(i) +
+                 "-bookstore.endpoints.example-project.cloud.goog\"";
+  }
+  std::string header =
+      R"({"alg":"RS256","kid":"8f3e950b309186540c314ecf348bb14f1784d79d",)"
+      R"("typ":"JWT"})";
+  std::string payload =
+      R"({"azp":"32555940559.apps.googleusercontent.com",)"
+      R"("aud":[)" +
+      audiences +
+      R"(],"sub":"110169484474386276334",)"
+      R"("email":"someone@example.com","email_verified":true,)"
+      R"("at_hash":"X_B3Z3Fi4udZ2mf75RWo3w",)"
+      R"("iss":"https://accounts.google.com",)"
+      R"("iat":1497000000,"exp":)" +
+      exp + "}";
+  std::string signature(256, '\0');
+  for (size_t i = 0; i < signature.size(); ++i) {
+    signature[i] = static_cast<char>(i * 31 + 7);
+  }
+  return Base64UrlEncode(header) + "." + Base64UrlEncode(payload) + "." +
+         Base64UrlEncode(signature);
+}
+
+void Run(const char *name, const std::string &jwt) {
+  printf("%s: %zu bytes\n", name, jwt.size());
+  RunBenchmark("  baseline grpc base64 + grpc_json + claims",
+               [&]() { DoNotOptimize(baseline::Parse(jwt)); });
+  RunBenchmark("  JwtValidator::Parse", [&]() {
+    UserInfo user_info;
+    std::unique_ptr<JwtValidator> validator =
+        JwtValidator::Create(jwt.data(), jwt.size());
+    DoNotOptimize(validator->Parse(&user_info));
+  });
+
+  // The claims extraction alone, with the decoding buffer reused.
+  const char *dot = strchr(jwt.c_str(), '.') + 1;
+  size_t payload_len = strchr(dot, '.') - dot;
+  std::string buffer;
+  JwtClaims claims;
+  RunBenchmark("  Base64UrlDecode + ParseJwtClaims (payload)", [&]() {
+    Base64UrlDecode(dot, payload_len, &buffer);
+    DoNotOptimize(ParseJwtClaims(buffer.data(), buffer.size(), &claims));
+  });
+}
+
+}  // namespace
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+int main() {
+  using namespace ::google::api_manager::auth;
+#if defined(__SSE2__)
+  printf("Base64UrlDecode: SSE2\n");
+#else
+  printf("Base64UrlDecode: scalar\n");
+#endif
+  Run("ID token, 1 audience", IdToken(1));
+  Run("ID token, 8 audiences", IdToken(8));
+  return 0;
+}
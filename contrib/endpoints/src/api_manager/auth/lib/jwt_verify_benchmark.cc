@@ -0,0 +1,97 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Compares the single core JWT signature verification throughput of RS256,
+// ES256 and EdDSA, with the keys parsed once into PublicKeys.
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/auth_jwt_validator.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
+#include "contrib/endpoints/src/api_manager/utils/benchmark.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+using ::google::api_manager::utils::DoNotOptimize;
+using ::google::api_manager::utils::RunBenchmark;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+// An RSA 2048 key, an EC P-256 key and an Ed25519 key.
+const char kKeys[] =
+    "{\"keys\":[{\"kty\":\"RSA\",\"alg\":\"RS256\",\"kid\":\"rs-key\",\"n\":"
+    "\"nxxe5FAIWv684rt7t_p9jZp_NBPNo-waPEb9MBmt3QBCaMDSBR0vR-0dAKuCfReAx8CbjW"
+    "U8-9zTVP4t8PEjjh5ZVBcHcLwuhvCV_UQ2O4UIxr2ewlmMGEgmET0V2hAfcN0Dn2K0o8Yp16"
+    "sktD8nTCpE3bRkEZAgT5ID1EqGI35nkrHfie_0O4PyiqqOCsV4aE3C1kdMOlcC0D9kxkPeUW"
+    "z70lhalP_yXTiThQlXHwMsVG4L9xF7x5CtpwOplpN67tciTqlICBh52rPRSdJb1vRtx9OVmF"
+    "WOGcijPQFSZRSayrAJonNMxJF6GggYATfjyBhrLvtusmrYyhQdcBoulQ\",\"e\":\"AQAB"
+    "\"},{\"kty\":\"EC\",\"crv\":\"P-256\",\"alg\":\"ES256\",\"kid\":\"es-key"
+    "\",\"x\":\"y-zwUrLT8WfJFQhuJxJQtf9dwDdjZrxg9mRS6F6pZ2c\",\"y\":\"dBwTglv"
+    "heWzKCkR-27Vw_v2GECMgnz7JOtOKlPl3Tyk\"},{\"kty\":\"OKP\",\"crv\":\"Ed255"
+    "19\",\"alg\":\"EdDSA\",\"kid\":\"ed-key\",\"x\":\"D1ICP5gjJh9I9u_XqT3I5s"
+    "iVaL6cJxdSb1awb2VI9n8\"}]}";
+
+const char kTokenRs256[] =
+    "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6InJzLWtleSJ9.eyJpc3MiOiJlcy1"
+    "pc3N1ZXJAZXhhbXBsZS5jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQ"
+    "iOiJodHRwOi8vbXlzZXJ2aWNlLmNvbS9teWFwaSJ9.apmcazyigKS9WCoayMonUUDvMrhGUz"
+    "06OI7Ycq7A3nQmL4HnaGr0yhjbPLHZwJIMfMtpYjUOzZksR_ahR8YS0kkbb7p_h8Y8eHYf_p"
+    "1Tnrng9bERMAsuxlj7rBAu8EBoz5sxf3EuTpdsQb_MObAwhcacdEbSJd9lU-J2mZT3wv1HAi"
+    "3YKwdlqhkANySFprewU2dTDkyMJTV_COObxWPTsGvRHNf5WEJ0gT-FpwCw3rtYE6F-iaP_KY"
+    "f5-pcLCPeugEa8lcKfzB0xJ1-m94taEtd9KS3b7WT4j2qMPQJ5j4_SW53K6f6A6hvYD5yEl6"
+    "6jc5w-ErAnH86Md5KcDw-yZQ";
+
+const char kTokenEs256[] =
+    "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVzLWtleSJ9.eyJpc3MiOiJlcy1"
+    "pc3N1ZXJAZXhhbXBsZS5jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQ"
+    "iOiJodHRwOi8vbXlzZXJ2aWNlLmNvbS9teWFwaSJ9.wr08a9gl3dO-T5GmQfUi9d9YtWbQxy"
+    "0sWVjzPSGR3HI_k2uIfKOxTa6TucL0sNvIlzj6ZQ3xk6LveuoES-IylA";
+
+const char kTokenEdDsa[] =
+    "eyJhbGciOiJFZERTQSIsInR5cCI6IkpXVCIsImtpZCI6ImVkLWtleSJ9.eyJpc3MiOiJlcy1"
+    "pc3N1ZXJAZXhhbXBsZS5jb20iLCJzdWIiOiJlcy1pc3N1ZXJAZXhhbXBsZS5jb20iLCJhdWQ"
+    "iOiJodHRwOi8vbXlzZXJ2aWNlLmNvbS9teWFwaSJ9.yXcLHhwbj3yTH7J4HnkPcfORdLReVZ"
+    "d8TYVQuPIYhvZXq47b6yiZzH62u0imTdBcEzR2laR9BsKX1JJYevZgBQ";
+
+void Run(const char *name, const char *token, const PublicKeys &keys) {
+  UserInfo user_info;
+  std::unique_ptr<JwtValidator> validator =
+      JwtValidator::Create(token, strlen(token));
+  if (!validator->Parse(&user_info).ok() ||
+      !validator->VerifySignature(keys).ok()) {
+    fprintf(stderr, "%s: the token does not verify\n", name);
+    exit(1);
+  }
+  RunBenchmark(name,
+               [&]() { DoNotOptimize(validator->VerifySignature(keys)); });
+}
+
+}  // namespace
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+int main() {
+  using namespace ::google::api_manager::auth;
+  std::unique_ptr<PublicKeys> keys = PublicKeys::Create(kKeys, strlen(kKeys));
+  Run("VerifySignature/RS256", kTokenRs256, *keys);
+  Run("VerifySignature/ES256", kTokenEs256, *keys);
+  Run("VerifySignature/EdDSA", kTokenEdDsa, *keys);
+  return 0;
+}
@@ -0,0 +1,276 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
+
+extern "C" {
+#include <grpc/support/log.h>
+}
+
+#include "grpc_internals.h"
+
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <cstring>
+
+#include "contrib/endpoints/src/api_manager/auth/lib/base64.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/json_util.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+// Gets BIGNUM from b64 string, used for extracting pkey from jwk.
+BIGNUM *BigNumFromBase64String(grpc_exec_ctx *exec_ctx, const char *b64) {
+  BIGNUM *result = nullptr;
+  gpr_slice bin;
+
+  if (b64 == nullptr) return nullptr;
+  bin = grpc_base64_decode(exec_ctx, b64, 1);
+  if (GPR_SLICE_IS_EMPTY(bin)) {
+    gpr_log(GPR_ERROR, "Invalid base64 for big num.");
+    return nullptr;
+  }
+  result = BN_bin2bn(GPR_SLICE_START_PTR(bin), GPR_SLICE_LENGTH(bin), nullptr);
+  gpr_slice_unref(bin);
+  return result;
+}
+
+// Extracts the public key from x509 string (key).
+// Returns nullptr if not successful.
+EVP_PKEY *ExtractPubkeyFromX509(const char *key) {
+  BIO *bio = BIO_new(BIO_s_mem());
+  if (bio == nullptr) {
+    gpr_log(GPR_ERROR, "Unable to allocate a BIO object.");
+    return nullptr;
+  }
+  EVP_PKEY *pkey = nullptr;
+  if (BIO_write(bio, key, strlen(key)) <= 0) {
+    gpr_log(GPR_ERROR, "BIO write error for key (%s).", key);
+  } else {
+    X509 *x509 = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    if (x509 == nullptr) {
+      gpr_log(GPR_ERROR, "Unable to parse x509 cert for key (%s).", key);
+    } else {
+      pkey = X509_get_pubkey(x509);
+      if (pkey == nullptr) {
+        gpr_log(GPR_ERROR, "X509_get_pubkey failed");
+      }
+      X509_free(x509);
+    }
+  }
+  BIO_free(bio);
+  return pkey;
+}
+
+// Decodes a base64url encoded field of a jwk key that must be size bytes.
+bool DecodeJwkField(const grpc_json *jkey, const char *name, size_t size,
+                    std::string *out) {
+  const char *value = GetStringValue(jkey, name);
+  if (value == nullptr || !Base64UrlDecode(value, strlen(value), out) ||
+      out->size() != size) {
+    gpr_log(GPR_ERROR, "Missing or invalid public key field %s.", name);
+    return false;
+  }
+  return true;
+}
+
+// Extracts the public key from an EC jwk key (jkey) on the P-256 curve.
+// Returns nullptr if not successful.
+EVP_PKEY *ExtractEcPubkeyFromJwk(const grpc_json *jkey) {
+  const char *crv = GetStringValue(jkey, "crv");
+  if (crv == nullptr || strcmp(crv, "P-256") != 0) {
+    gpr_log(GPR_ERROR, "Missing or unsupported EC curve %s.",
+            crv ? crv : "(missing)");
+    return nullptr;
+  }
+  std::string x, y;
+  if (!DecodeJwkField(jkey, "x", 32, &x) ||
+      !DecodeJwkField(jkey, "y", 32, &y)) {
+    return nullptr;
+  }
+
+  EC_KEY *ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  if (ec_key == nullptr) {
+    gpr_log(GPR_ERROR, "Could not create ec key.");
+    return nullptr;
+  }
+  BIGNUM *bn_x = BN_bin2bn(reinterpret_cast<const unsigned char *>(x.data()),
+                           x.size(), nullptr);
+  BIGNUM *bn_y = BN_bin2bn(reinterpret_cast<const unsigned char *>(y.data()),
+                           y.size(), nullptr);
+
+  EVP_PKEY *pkey = nullptr;
+  // Also checks that the point is on the curve.
+  if (bn_x == nullptr || bn_y == nullptr ||
+      EC_KEY_set_public_key_affine_coordinates(ec_key, bn_x, bn_y) != 1) {
+    gpr_log(GPR_ERROR, "Invalid EC public key.");
+  } else {
+    pkey = EVP_PKEY_new();
+    if (pkey != nullptr && EVP_PKEY_set1_EC_KEY(pkey, ec_key) == 0) {
+      gpr_log(GPR_ERROR, "EVP_PKEY_set1_EC_KEY failed");
+      EVP_PKEY_free(pkey);
+      pkey = nullptr;
+    }
+  }
+  BN_free(bn_x);
+  BN_free(bn_y);
+  EC_KEY_free(ec_key);
+  return pkey;
+}
+
+// Extracts the public key from a jwk key (jkey).
+// Returns nullptr if not successful.
+EVP_PKEY *ExtractPubkeyFromJwk(grpc_exec_ctx *exec_ctx, const grpc_json *jkey) {
+  RSA *rsa = RSA_new();
+  if (rsa == nullptr) {
+    gpr_log(GPR_ERROR, "Could not create rsa key.");
+    return nullptr;
+  }
+
+  const char *rsa_n = GetStringValue(jkey, "n");
+  rsa->n = rsa_n == nullptr ? nullptr : BigNumFromBase64String(exec_ctx, rsa_n);
+  const char *rsa_e = GetStringValue(jkey, "e");
+  rsa->e = rsa_e == nullptr ? nullptr : BigNumFromBase64String(exec_ctx, rsa_e);
+
+  EVP_PKEY *pkey = nullptr;
+  if (rsa->e == nullptr || rsa->n == nullptr) {
+    gpr_log(GPR_ERROR, "Missing RSA public key field.");
+  } else {
+    pkey = EVP_PKEY_new();
+    if (pkey != nullptr && EVP_PKEY_set1_RSA(pkey, rsa) == 0) {
+      gpr_log(GPR_ERROR, "EVP_PKEY_set1_RSA failed");
+      EVP_PKEY_free(pkey);
+      pkey = nullptr;
+    }
+  }
+  RSA_free(rsa);
+  return pkey;
+}
+
+}  // namespace
+
+std::unique_ptr<PublicKeys> PublicKeys::Create(const char *keys,
+                                               size_t keys_len) {
+  return std::unique_ptr<PublicKeys>(new PublicKeys(keys, keys_len));
+}
+
+PublicKeys::PublicKeys(const char *keys, size_t keys_len)
+    : raw_(keys == nullptr ? std::string() : std::string(keys, keys_len)),
+      valid_(false),
+      is_jwk_(false) {
+  if (raw_.empty()) {
+    return;
+  }
+  // The JSON parser works in place, so parse a copy of the raw text.
+  std::vector<char> buffer(raw_.begin(), raw_.end());
+  grpc_json *json = grpc_json_parse_string_with_len(buffer.data(),
+                                                    buffer.size());
+  if (json == nullptr) {
+    return;
+  }
+
+  // JWK set https://tools.ietf.org/html/rfc7517#section-5.
+  const grpc_json *jwk_keys = GetProperty(json, "keys");
+  if (jwk_keys == nullptr) {
+    // X509 format: a map of kid to certificate.
+    valid_ = json->child != nullptr;
+    for (const grpc_json *cur = json->child; cur != nullptr; cur = cur->next) {
+      if (cur->key == nullptr || cur->type != GRPC_JSON_STRING ||
+          cur->value == nullptr) {
+        continue;
+      }
+      AddKey(Key{cur->key, std::string(), ExtractPubkeyFromX509(cur->value),
+                 std::string()});
+    }
+  } else if (jwk_keys->type != GRPC_JSON_ARRAY) {
+    gpr_log(GPR_ERROR,
+            "Unexpected value type of keys property in jwks key set.");
+  } else if (jwk_keys->child == nullptr) {
+    gpr_log(GPR_ERROR, "The jwks key set is empty");
+  } else {
+    valid_ = true;
+    is_jwk_ = true;
+    grpc_exec_ctx exec_ctx = GRPC_EXEC_CTX_INIT;
+    // JWK format from https://tools.ietf.org/html/rfc7518#section-6.
+    for (const grpc_json *jkey = jwk_keys->child; jkey != nullptr;
+         jkey = jkey->next) {
+      if (jkey->type != GRPC_JSON_OBJECT) continue;
+      const char *alg = GetStringValue(jkey, "alg");
+      const char *kid = GetStringValue(jkey, "kid");
+      if (alg == nullptr || kid == nullptr) {
+        continue;
+      }
+      const char *kty = GetStringValue(jkey, "kty");
+      Key key{kid, alg, nullptr, std::string()};
+      if (kty != nullptr && strcmp(kty, "RSA") == 0) {
+        key.pkey = ExtractPubkeyFromJwk(&exec_ctx, jkey);
+      } else if (kty != nullptr && strcmp(kty, "EC") == 0) {
+        key.pkey = ExtractEcPubkeyFromJwk(jkey);
+      } else if (kty != nullptr && strcmp(kty, "OKP") == 0) {
+        const char *crv = GetStringValue(jkey, "crv");
+        if (crv == nullptr || strcmp(crv, "Ed25519") != 0) {
+          gpr_log(GPR_ERROR, "Missing or unsupported OKP curve %s.",
+                  crv ? crv : "(missing)");
+          continue;
+        }
+        if (!DecodeJwkField(jkey, "x", 32, &key.ed25519_key)) {
+          continue;
+        }
+      } else {
+        gpr_log(GPR_ERROR, "Missing or unsupported key type %s.",
+                kty ? kty : "(missing)");
+        continue;
+      }
+      if (key.pkey != nullptr || !key.ed25519_key.empty()) {
+        AddKey(key);
+      }
+    }
+  }
+  grpc_json_destroy(json);
+}
+
+PublicKeys::~PublicKeys() {
+  for (const auto &key : keys_) {
+    if (key.pkey != nullptr) {
+      EVP_PKEY_free(key.pkey);
+    }
+  }
+}
+
+void PublicKeys::AddKey(const Key &key) {
+  kid_index_.insert(std::make_pair(key.kid, keys_.size()));
+  keys_.push_back(key);
+}
+
+const PublicKeys::Key *PublicKeys::Find(const char *kid,
+                                        const char *alg) const {
+  auto range = kid_index_.equal_range(kid);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Key &key = keys_[it->second];
+    if (alg == nullptr || key.alg == alg) {
+      return &key;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,96 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
+#define API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
+
+#include <openssl/evp.h>
+
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// The verification keys of an issuer, parsed once from the X509 or JWK key
+// set fetched from the issuer, so that verifying a JWT does a key lookup
+// instead of re-parsing JSON and rebuilding RSA or EC keys.
+//
+// The raw key text is kept as well: for symmetric (HS) algorithms the key is
+// the base64 encoded secret itself.
+class PublicKeys {
+ public:
+  // A parsed key.
+  struct Key {
+    // Key id. For X509 keys this is the key name in the key set.
+    std::string kid;
+    // Algorithm. Empty for X509 keys.
+    std::string alg;
+    // The RSA or EC public key, owned by PublicKeys. nullptr for Ed25519
+    // keys, or if an X509 certificate could not be parsed.
+    EVP_PKEY *pkey;
+    // The 32-byte public key of an Ed25519 ("OKP") JWK key. Empty otherwise.
+    std::string ed25519_key;
+  };
+
+  // Parses a key set. Never returns nullptr: a key set that cannot be parsed
+  // is not valid() and has no keys.
+  static std::unique_ptr<PublicKeys> Create(const char *keys, size_t keys_len);
+
+  ~PublicKeys();
+
+  // Returns the raw key set text.
+  const std::string &raw() const { return raw_; }
+
+  // Returns true if the key set was a non-empty X509 or JWK key set.
+  bool valid() const { return valid_; }
+
+  // Returns true for a JWK key set, false for X509 keys.
+  bool is_jwk() const { return is_jwk_; }
+
+  // Returns all the keys, in key set order. JWK keys without "kid" or "alg",
+  // with an unsupported "kty" or "crv", or whose key material cannot be
+  // decoded are left out. Supported JWK keys are RSA, EC on the P-256 curve
+  // and OKP on the Ed25519 curve.
+  const std::vector<Key> &keys() const { return keys_; }
+
+  // Finds the first key with the given kid and, if alg is not nullptr, the
+  // given alg. Returns nullptr if there is none.
+  const Key *Find(const char *kid, const char *alg) const;
+
+ private:
+  PublicKeys(const char *keys, size_t keys_len);
+  PublicKeys(const PublicKeys &) = delete;
+  PublicKeys &operator=(const PublicKeys &) = delete;
+
+  // Adds a key and indexes it by kid.
+  void AddKey(const Key &key);
+
+  std::string raw_;
+  bool valid_;
+  bool is_jwk_;
+  std::vector<Key> keys_;
+  // Index from kid to position in keys_. Equal kids keep key set order.
+  std::multimap<std::string, size_t> kid_index_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_LIB_PUBLIC_KEYS_H_
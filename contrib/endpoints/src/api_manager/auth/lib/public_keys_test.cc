@@ -0,0 +1,142 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+namespace {
+
+std::unique_ptr<PublicKeys> CreateKeys(const char *keys) {
+  return PublicKeys::Create(keys, strlen(keys));
+}
+
+TEST(PublicKeys, InvalidKeySets) {
+  EXPECT_FALSE(PublicKeys::Create(nullptr, 0)->valid());
+  EXPECT_FALSE(CreateKeys("")->valid());
+  EXPECT_FALSE(CreateKeys("{\"kid1\": ")->valid());
+  EXPECT_FALSE(CreateKeys("{}")->valid());
+  EXPECT_FALSE(CreateKeys("{\"keys\": {}}")->valid());
+  EXPECT_FALSE(CreateKeys("{\"keys\": []}")->valid());
+
+  // The raw text is kept, as HS keys are not JSON.
+  std::unique_ptr<PublicKeys> keys = CreateKeys("c2VjcmV0");
+  EXPECT_FALSE(keys->valid());
+  EXPECT_EQ("c2VjcmV0", keys->raw());
+  EXPECT_TRUE(keys->keys().empty());
+}
+
+TEST(PublicKeys, X509Keys) {
+  std::unique_ptr<PublicKeys> keys =
+      CreateKeys("{\"kid1\": \"not a certificate\", \"kid2\": 1}");
+  ASSERT_TRUE(keys->valid());
+  EXPECT_FALSE(keys->is_jwk());
+
+  // A certificate that cannot be parsed is kept without a key, so that a
+  // token naming its kid fails key retrieval.
+  ASSERT_EQ(1u, keys->keys().size());
+  const PublicKeys::Key *key = keys->Find("kid1", nullptr);
+  ASSERT_NE(nullptr, key);
+  EXPECT_EQ("kid1", key->kid);
+  EXPECT_EQ(nullptr, key->pkey);
+  EXPECT_EQ(nullptr, keys->Find("kid2", nullptr));
+}
+
+TEST(PublicKeys, JwkKeys) {
+  std::unique_ptr<PublicKeys> keys = CreateKeys(
+      "{\"keys\": ["
+      // Missing kid.
+      "{\"kty\": \"RSA\", \"alg\": \"RS256\", \"n\": \"AQAB\", \"e\": "
+      "\"AQAB\"},"
+      // Unsupported key type.
+      "{\"kty\": \"oct\", \"alg\": \"RS256\", \"kid\": \"kid1\"},"
+      // Missing modulus.
+      "{\"kty\": \"RSA\", \"alg\": \"RS256\", \"kid\": \"kid1\", \"e\": "
+      "\"AQAB\"},"
+      "{\"kty\": \"RSA\", \"alg\": \"RS256\", \"kid\": \"kid1\", \"n\": "
+      "\"wQIDAQAB\", \"e\": \"AQAB\"},"
+      "{\"kty\": \"RSA\", \"alg\": \"RS384\", \"kid\": \"kid1\", \"n\": "
+      "\"wQIDAQAC\", \"e\": \"AQAB\"},"
+      "{\"kty\": \"RSA\", \"alg\": \"RS256\", \"kid\": \"kid2\", \"n\": "
+      "\"wQIDAQAD\", \"e\": \"AQAB\"}"
+      "]}");
+  ASSERT_TRUE(keys->valid());
+  EXPECT_TRUE(keys->is_jwk());
+  ASSERT_EQ(3u, keys->keys().size());
+  for (const auto &key : keys->keys()) {
+    EXPECT_NE(nullptr, key.pkey);
+  }
+
+  const PublicKeys::Key *key = keys->Find("kid1", "RS256");
+  ASSERT_NE(nullptr, key);
+  EXPECT_EQ(&keys->keys()[0], key);
+  key = keys->Find("kid1", "RS384");
+  ASSERT_NE(nullptr, key);
+  EXPECT_EQ(&keys->keys()[1], key);
+  key = keys->Find("kid2", "RS256");
+  ASSERT_NE(nullptr, key);
+  EXPECT_EQ(&keys->keys()[2], key);
+
+  EXPECT_EQ(nullptr, keys->Find("kid2", "RS384"));
+  EXPECT_EQ(nullptr, keys->Find("kid3", "RS256"));
+}
+
+TEST(PublicKeys, EcAndOkpJwkKeys) {
+  std::unique_ptr<PublicKeys> keys = CreateKeys(
+      "{\"keys\": ["
+      // Unsupported curve.
+      "{\"kty\": \"EC\", \"crv\": \"P-521\", \"alg\": \"ES512\", "
+      "\"kid\": \"kid1\", \"x\": \"AQAB\", \"y\": \"AQAB\"},"
+      // Point not on the curve.
+      "{\"kty\": \"EC\", \"crv\": \"P-256\", \"alg\": \"ES256\", "
+      "\"kid\": \"kid1\", "
+      "\"x\": \"AQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA\", "
+      "\"y\": \"AQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA\"},"
+      "{\"kty\": \"EC\", \"crv\": \"P-256\", \"alg\": \"ES256\", "
+      "\"kid\": \"kid1\", "
+      "\"x\": \"y-zwUrLT8WfJFQhuJxJQtf9dwDdjZrxg9mRS6F6pZ2c\", "
+      "\"y\": \"dBwTglvheWzKCkR-27Vw_v2GECMgnz7JOtOKlPl3Tyk\"},"
+      // Wrong key size.
+      "{\"kty\": \"OKP\", \"crv\": \"Ed25519\", \"alg\": \"EdDSA\", "
+      "\"kid\": \"kid2\", \"x\": \"AQAB\"},"
+      "{\"kty\": \"OKP\", \"crv\": \"Ed25519\", \"alg\": \"EdDSA\", "
+      "\"kid\": \"kid2\", "
+      "\"x\": \"D1ICP5gjJh9I9u_XqT3I5siVaL6cJxdSb1awb2VI9n8\"}"
+      "]}");
+  ASSERT_TRUE(keys->valid());
+  ASSERT_EQ(2u, keys->keys().size());
+
+  const PublicKeys::Key *key = keys->Find("kid1", "ES256");
+  ASSERT_NE(nullptr, key);
+  EXPECT_NE(nullptr, key->pkey);
+  EXPECT_EQ(EVP_PKEY_EC, EVP_PKEY_id(key->pkey));
+  EXPECT_TRUE(key->ed25519_key.empty());
+
+  key = keys->Find("kid2", "EdDSA");
+  ASSERT_NE(nullptr, key);
+  EXPECT_EQ(nullptr, key->pkey);
+  EXPECT_EQ(32u, key->ed25519_key.size());
+}
+
+}  // namespace
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,115 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/negative_jwt_cache.h"
+
+#include <openssl/sha.h>
+#include <algorithm>
+
+#include "contrib/endpoints/src/api_manager/auth/expiring_cache_shard.h"
+
+using std::chrono::system_clock;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+// The default lifetime of a cache entry. Unit: seconds.
+const int kNegativeJwtCacheTtl = 10;
+// The default number of entries in the negative JWT cache.
+const size_t kNegativeJwtCacheSize = 10000;
+// The default number of shards in the negative JWT cache.
+const size_t kNegativeJwtCacheShards = 16;
+
+// Returns the SHA-256 digest of a JWT.
+std::string Digest(const std::string& jwt) {
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char*>(jwt.data()), jwt.size(),
+         digest);
+  return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+}  // namespace
+
+// A shard holds the failure messages of the digests that map to it.
+class NegativeJwtCache::Shard : public ExpiringCacheShard<std::string,
+                                                          std::string> {
+ public:
+  using ExpiringCacheShard<std::string, std::string>::ExpiringCacheShard;
+};
+
+NegativeJwtCache::Options::Options()
+    : max_size(kNegativeJwtCacheSize),
+      ttl(kNegativeJwtCacheTtl),
+      num_shards(kNegativeJwtCacheShards) {}
+
+NegativeJwtCache::NegativeJwtCache() : NegativeJwtCache(Options()) {}
+
+NegativeJwtCache::NegativeJwtCache(const Options& options)
+    : options_(options), hits_(0), misses_(0) {
+  options_.num_shards = std::max<size_t>(1, options_.num_shards);
+  options_.max_size = std::max(options_.max_size, options_.num_shards);
+  size_t shard_size =
+      (options_.max_size + options_.num_shards - 1) / options_.num_shards;
+  for (size_t i = 0; i < options_.num_shards; ++i) {
+    shards_.emplace_back(new Shard(shard_size));
+  }
+}
+
+NegativeJwtCache::~NegativeJwtCache() {}
+
+NegativeJwtCache::Shard* NegativeJwtCache::GetShard(
+    const std::string& digest) const {
+  // The digest is uniform, so its first bytes spread the shards evenly.
+  size_t index = static_cast<unsigned char>(digest[0]) |
+                 (static_cast<unsigned char>(digest[1]) << 8);
+  return shards_[index % shards_.size()].get();
+}
+
+bool NegativeJwtCache::Lookup(const std::string& jwt,
+                              const system_clock::time_point& now,
+                              std::string* error) {
+  std::string digest = Digest(jwt);
+  if (GetShard(digest)->Lookup(digest, now,
+                               [error](const std::string& failure) {
+                                 *error = failure;
+                                 return true;
+                               })) {
+    ++hits_;
+    return true;
+  }
+  ++misses_;
+  return false;
+}
+
+void NegativeJwtCache::Insert(const std::string& jwt, const std::string& error,
+                              const system_clock::time_point& now) {
+  std::string digest = Digest(jwt);
+  GetShard(digest)->Insert(digest, std::string(error), now + options_.ttl,
+                           now);
+}
+
+size_t NegativeJwtCache::Size() const {
+  size_t size = 0;
+  for (const auto& shard : shards_) {
+    size += shard->Size();
+  }
+  return size;
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,93 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_NEGATIVE_JWT_CACHE_H_
+#define API_MANAGER_AUTH_NEGATIVE_JWT_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// A cache of the JWTs that failed verification, so that a flood of invalid
+// tokens is rejected without parsing and verifying each of them again.
+//
+// Entries are keyed by the SHA-256 digest of the JWT, so an entry stays
+// small however large the token is, and a different token is never taken
+// for a cached one. Each entry keeps the failure message and lives for a
+// short, fixed time. Like JwtCache, the entries are spread over
+// ExpiringCacheShards. All methods are thread safe.
+class NegativeJwtCache {
+ public:
+  struct Options {
+    Options();
+
+    // The maximum number of entries in the cache.
+    size_t max_size;
+    // The lifetime of a cache entry.
+    std::chrono::seconds ttl;
+    // The number of shards.
+    size_t num_shards;
+  };
+
+  NegativeJwtCache();
+  explicit NegativeJwtCache(const Options& options);
+  ~NegativeJwtCache();
+
+  // Looks up a JWT. Returns true and copies out the failure message if the
+  // JWT failed verification and the entry has not expired at "now". An
+  // expired entry is removed. Counts a hit or a miss.
+  bool Lookup(const std::string& jwt,
+              const std::chrono::system_clock::time_point& now,
+              std::string* error);
+
+  // Records that a JWT failed verification with "error".
+  void Insert(const std::string& jwt, const std::string& error,
+              const std::chrono::system_clock::time_point& now);
+
+  // Returns the number of entries in the cache.
+  size_t Size() const;
+
+  // Returns the number of lookups that found an entry.
+  uint64_t hits() const { return hits_; }
+
+  // Returns the number of lookups that found no entry.
+  uint64_t misses() const { return misses_; }
+
+  const Options& options() const { return options_; }
+
+ private:
+  class Shard;
+
+  Shard* GetShard(const std::string& digest) const;
+
+  Options options_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_NEGATIVE_JWT_CACHE_H_
@@ -34,14 +34,23 @@ namespace {
 // Token expired in 1 hour, reduce 100 seconds for grace buffer.
 const int kClientSecretAuthTokenExpiration(3600 - 100);
 
+// The default time in seconds before expiration to renew a JWT token.
+const time_t kJwtTokenRenewBefore = 300;
+
 }  // namespace
 
+ServiceAccountToken::ServiceAccountToken(ApiManagerEnvInterface* env)
+    : env_(env), renew_before_(kJwtTokenRenewBefore), state_(NONE) {}
+
+ServiceAccountToken::~ServiceAccountToken() { StopRefreshTimer(); }
+
 Status ServiceAccountToken::SetClientAuthSecret(const std::string& secret) {
+  std::lock_guard<std::mutex> lock(mutex_);
   client_auth_secret_ = secret;
 
   for (unsigned int i = 0; i < JWT_TOKEN_TYPE_MAX; i++) {
-    if (!jwt_tokens_[i].audience().empty()) {
-      Status status = jwt_tokens_[i].GenerateJwtToken(client_auth_secret_);
+    if (!audiences_[i].empty()) {
+      Status status = GenerateJwtToken(static_cast<JWT_TOKEN_TYPE>(i));
       if (!status.ok()) {
         if (env_) {
           env_->LogError("Failed to generate auth token.");
@@ -56,50 +65,119 @@ Status ServiceAccountToken::SetClientAuthSecret(const std::string& secret) {
 void ServiceAccountToken::SetAudience(JWT_TOKEN_TYPE type,
                                       const std::string& audience) {
   GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
-  if (jwt_tokens_[type].audience() != audience) {
-    jwt_tokens_[type].set_token("", 0);
-    jwt_tokens_[type].set_audience(audience);
+  std::lock_guard<std::mutex> lock(mutex_);
+  const JwtToken* token = jwt_tokens_[type].Get();
+  if (audiences_[type] == audience &&
+      (token != nullptr || client_auth_secret_.empty())) {
+    return;
+  }
+  audiences_[type] = audience;
+  if (!client_auth_secret_.empty() && !audience.empty()) {
+    Status status = GenerateJwtToken(type);
+    if (!status.ok() && env_) {
+      env_->LogError("Failed to generate auth token.");
+    }
   }
 }
 
-const std::string& ServiceAccountToken::GetAuthToken(JWT_TOKEN_TYPE type) {
-  return GetAuthToken(type, jwt_tokens_[type].audience());
+void ServiceAccountToken::RefreshJwtTokens() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (client_auth_secret_.empty()) {
+    return;
+  }
+  for (unsigned int i = 0; i < JWT_TOKEN_TYPE_MAX; i++) {
+    const JwtToken* token = jwt_tokens_[i].Get();
+    if (audiences_[i].empty() ||
+        (token != nullptr && token->audience == audiences_[i] &&
+         token->info.is_valid(renew_before_))) {
+      continue;
+    }
+    // A failure keeps the current token, and is retried on the next call.
+    Status status = GenerateJwtToken(static_cast<JWT_TOKEN_TYPE>(i));
+    if (!status.ok() && env_) {
+      env_->LogError("Failed to renew auth token.");
+    }
+  }
 }
 
-const std::string& ServiceAccountToken::GetAuthToken(
-    JWT_TOKEN_TYPE type, const std::string& audience) {
-  SetAudience(type, audience);
+void ServiceAccountToken::StartRefreshTimer() {
+  if (client_auth_secret_.empty() || refresh_timer_ || env_ == nullptr) {
+    return;
+  }
+  RefreshJwtTokens();
+  refresh_timer_ = env_->StartPeriodicTimer(
+      kServiceAccountTokenRefreshInterval, [this]() { RefreshJwtTokens(); });
+}
+
+void ServiceAccountToken::StopRefreshTimer() {
+  if (refresh_timer_) {
+    refresh_timer_->Stop();
+    refresh_timer_.reset();
+  }
+}
 
+const std::string& ServiceAccountToken::GetAuthToken(JWT_TOKEN_TYPE type) {
   // Uses authentication secret if available.
   if (!client_auth_secret_.empty()) {
     GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
-    if (!jwt_tokens_[type].is_valid(0)) {
-      Status status = jwt_tokens_[type].GenerateJwtToken(client_auth_secret_);
-      if (!status.ok()) {
-        if (env_) {
-          env_->LogError("Failed to generate auth token.");
+    const JwtToken* token = jwt_tokens_[type].Get();
+    if (token != nullptr && !token->info.is_valid(0)) {
+      // The refresh timer renews the tokens well before they expire, so an
+      // expired token means that it was not started, or that it does not
+      // fire. Signs a new token inline then.
+      std::lock_guard<std::mutex> lock(mutex_);
+      token = jwt_tokens_[type].Get();
+      if (!token->info.is_valid(0) && !audiences_[type].empty()) {
+        Status status = GenerateJwtToken(type);
+        if (!status.ok() && env_) {
+          env_->LogError("Failed to renew auth token.");
         }
-        static std::string empty;
-        return empty;
+        token = jwt_tokens_[type].Get();
       }
     }
-    return jwt_tokens_[type].token();
+    if (token == nullptr) {
+      static std::string empty;
+      return empty;
+    }
+    return token->info.token();
   }
   return access_token_.token();
 }
 
-Status ServiceAccountToken::JwtTokenInfo::GenerateJwtToken(
-    const std::string& client_auth_secret) {
+const std::string& ServiceAccountToken::GetAuthToken(
+    JWT_TOKEN_TYPE type, const std::string& audience) {
+  if (!client_auth_secret_.empty()) {
+    GOOGLE_CHECK(type >= 0 && type < JWT_TOKEN_TYPE_MAX);
+    const JwtToken* token = jwt_tokens_[type].Get();
+    if (token == nullptr || token->audience != audience) {
+      // The token is signed once for a new audience.
+      SetAudience(type, audience);
+    }
+  }
+  return GetAuthToken(type);
+}
+
+Status ServiceAccountToken::GenerateJwtToken(JWT_TOKEN_TYPE type) {
+  const std::string& audience = audiences_[type];
   // Make sure audience is set.
-  GOOGLE_CHECK(!audience_.empty());
-  char* token =
-      auth::esp_get_auth_token(client_auth_secret.c_str(), audience_.c_str());
-  if (token == nullptr) {
+  GOOGLE_CHECK(!audience.empty());
+  std::unique_ptr<JwtToken> token(new JwtToken);
+  token->audience = audience;
+  char* jwt =
+      auth::esp_get_auth_token(client_auth_secret_.c_str(), audience.c_str());
+  if (jwt == nullptr) {
+    // The current token is kept until it is renewed, unless it is for
+    // another audience.
+    const JwtToken* current = jwt_tokens_[type].Get();
+    if (current == nullptr || current->audience != audience) {
+      jwt_tokens_[type].Publish(std::move(token));
+    }
     return Status(Code::INVALID_ARGUMENT,
                   "Invalid client auth secret, the file may be corrupted.");
   }
-  set_token(token, kClientSecretAuthTokenExpiration);
-  auth::esp_grpc_free(token);
+  token->info.set_token(jwt, kClientSecretAuthTokenExpiration);
+  auth::esp_grpc_free(jwt);
+  jwt_tokens_[type].Publish(std::move(token));
   return Status::OK;
 }
 
@@ -16,6 +16,11 @@
 #define API_MANAGER_AUTH_SERVICE_ACCOUNT_TOKEN_H_
 
 #include <time.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
 
 #include "contrib/endpoints/include/api_manager/env_interface.h"
 
@@ -23,16 +28,26 @@ namespace google {
 namespace api_manager {
 namespace auth {
 
+// The interval at which ServiceAccountToken::RefreshJwtTokens() is called.
+const std::chrono::milliseconds kServiceAccountTokenRefreshInterval(10000);
+
 // Stores service account tokens to access Google services, such as service
 // control and cloud tracing. There are two kinds of auth token:
 // 1) client auth secret is a client secret can be used to generate auth
 // JWT token. But JWT token is audience specific. Need to generate auth
 // JWT token for each service with its audience.
-// 2) GCE service account token is fetched from GCP metadata server.
+// 2) GCE service account token is fetched from GCE metadata server.
 // This auth token can be used for any Google services.
+//
+// JWT tokens are generated when their audience is set, and renewed by
+// RefreshJwtTokens() before they expire. GetAuthToken() only reads the
+// published token, without a lock, unless it is given an audience it has
+// not seen, or the token has expired because the refresh timer is not
+// running.
 class ServiceAccountToken {
  public:
-  ServiceAccountToken(ApiManagerEnvInterface* env) : env_(env), state_(NONE) {}
+  ServiceAccountToken(ApiManagerEnvInterface* env);
+  ~ServiceAccountToken();
 
   // Sets the client auth secret and it can be used to generate JWT token.
   utils::Status SetClientAuthSecret(const std::string& secret);
@@ -71,12 +86,30 @@ class ServiceAccountToken {
     JWT_TOKEN_FOR_QUOTA_CONTROL,
     JWT_TOKEN_TYPE_MAX,
   };
-  // Set audience.  Only calcualtes JWT token with specified audience.
+  // Set audience.  Only calcualtes JWT token with specified audience. The
+  // token is generated at once if the client auth secret is set.
   void SetAudience(JWT_TOKEN_TYPE type, const std::string& audience);
 
+  // Sets how many seconds before its expiration RefreshJwtTokens() renews a
+  // JWT token. Default is 300 seconds.
+  void set_renew_before(time_t renew_before) { renew_before_ = renew_before; }
+
+  // Generates the JWT tokens of all the audiences set that are missing or
+  // expire within the renewal window.
+  void RefreshJwtTokens();
+
+  // Refreshes the JWT tokens, then starts a timer refreshing them every
+  // kServiceAccountTokenRefreshInterval. Does nothing if there is no client
+  // auth secret.
+  void StartRefreshTimer();
+
+  // Stops the timer started by StartRefreshTimer().
+  void StopRefreshTimer();
+
   // Gets the auth token to access Google services.
   // If client auth secret is specified, use it to calcualte JWT token.
   // Otherwise, use the access token fetched from metadata server.
+  // The returned token stays valid until the token is renewed twice.
   const std::string& GetAuthToken(JWT_TOKEN_TYPE type);
 
   // Gets the auth token to access Google services. This method accepts an
@@ -90,6 +123,8 @@ class ServiceAccountToken {
   // Stores base token info. Used for both OAuth and JWT tokens.
   class TokenInfo {
    public:
+    TokenInfo() : expiration_time_(0) {}
+
     // Token available and not expired in `duration` seconds
     bool is_valid(time_t duration) const {
       return !token_.empty() && expiration_time_ >= time(nullptr) + duration;
@@ -114,34 +149,67 @@ class ServiceAccountToken {
     time_t expiration_time_;
   };
 
-  // Stores JWT token info
-  class JwtTokenInfo : public TokenInfo {
+  // A JWT token and the audience it was generated for. It is not modified
+  // once published.
+  struct JwtToken {
+    std::string audience;
+    TokenInfo info;
+  };
+
+  // Publishes the JWT token of one type through an atomic pointer, so that
+  // reading it never takes a lock. The previous token is kept until the
+  // next one is published, for the callers still reading it.
+  class JwtTokenSlot {
    public:
-    void set_audience(const std::string audience) { audience_ = audience; }
-    const std::string& audience() const { return audience_; }
+    JwtTokenSlot() : current_(nullptr) {}
+
+    // Returns the published token, or nullptr if there is none.
+    const JwtToken* Get() const {
+      return current_.load(std::memory_order_acquire);
+    }
 
-    // Generates auth JWT token from client auth secret.
-    utils::Status GenerateJwtToken(const std::string& client_auth_secret);
+    // Publishes a token. Must be called with mutex_ held.
+    void Publish(std::unique_ptr<const JwtToken> token) {
+      previous_ = std::move(owned_);
+      owned_ = std::move(token);
+      current_.store(owned_.get(), std::memory_order_release);
+    }
 
    private:
-    // The audiences.
-    std::string audience_;
+    std::atomic<const JwtToken*> current_;
+    std::unique_ptr<const JwtToken> owned_;
+    std::unique_ptr<const JwtToken> previous_;
   };
 
+  // Generates and publishes the JWT token of "type" from the client auth
+  // secret. Must be called with mutex_ held.
+  utils::Status GenerateJwtToken(JWT_TOKEN_TYPE type);
+
   // environment interface.
   ApiManagerEnvInterface* env_;
 
   // The client auth secret which can be used to generate JWT auth token.
   std::string client_auth_secret_;
 
+  // Serializes the writers of the JWT tokens: SetClientAuthSecret(),
+  // SetAudience() and RefreshJwtTokens().
+  std::mutex mutex_;
+  // The audiences of the JWT tokens. Guarded by mutex_.
+  std::string audiences_[JWT_TOKEN_TYPE_MAX];
   // JWT tokens calcualted from client auth secrect.
-  JwtTokenInfo jwt_tokens_[JWT_TOKEN_TYPE_MAX];
+  JwtTokenSlot jwt_tokens_[JWT_TOKEN_TYPE_MAX];
 
   // GCE service account access token fetched from GCE metadata server.
   TokenInfo access_token_;
 
+  // How many seconds before expiration a JWT token is renewed.
+  time_t renew_before_;
+
   // Fetching state
   FetchState state_;
+
+  // The timer calling RefreshJwtTokens().
+  std::unique_ptr<PeriodicTimer> refresh_timer_;
 };
 
 }  // namespace auth
@@ -21,6 +21,8 @@
 
 using ::google::api_manager::utils::Status;
 using ::google::protobuf::util::error::Code;
+using ::testing::_;
+using ::testing::Invoke;
 
 namespace google {
 namespace api_manager {
@@ -76,6 +78,69 @@ TEST_F(ServiceAccountTokenTest, TestClientAuthSecret) {
                     ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL));
 }
 
+TEST(ServiceAccountTokenRefreshTest, TestRefreshJwtTokens) {
+  ::testing::NiceMock<MockApiManagerEnvironment> env;
+  std::function<void()> refresh;
+  EXPECT_CALL(env, StartPeriodicTimer(kServiceAccountTokenRefreshInterval, _))
+      .WillOnce(Invoke([&refresh](std::chrono::milliseconds,
+                                  std::function<void()> callback) {
+        refresh = callback;
+        return std::unique_ptr<PeriodicTimer>();
+      }));
+
+  ServiceAccountToken sa_token(&env);
+  ASSERT_TRUE(sa_token
+                  .SetClientAuthSecret(
+                      "{\"client_secret\": \"secret\", "
+                      "\"issuer\": \"issuer\", \"subject\": \"subject\"}")
+                  .ok());
+  // The token is generated as soon as its audience is set.
+  sa_token.SetAudience(ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL,
+                       "audience");
+  const std::string &token =
+      sa_token.GetAuthToken(ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL);
+  ASSERT_FALSE(token.empty());
+  std::string first_token = token;
+
+  sa_token.StartRefreshTimer();
+  ASSERT_TRUE(static_cast<bool>(refresh));
+
+  // The token does not expire within the default renewal window.
+  refresh();
+  ASSERT_EQ(&token, &sa_token.GetAuthToken(
+                        ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL));
+
+  // A token expiring within the renewal window is replaced by a new one.
+  sa_token.set_renew_before(3600);
+  refresh();
+  const std::string &renewed_token =
+      sa_token.GetAuthToken(ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL);
+  ASSERT_FALSE(renewed_token.empty());
+  ASSERT_NE(&token, &renewed_token);
+  // The previous token is left intact for the callers still reading it.
+  ASSERT_EQ(first_token, token);
+}
+
+TEST_F(ServiceAccountTokenTest, TestNewAudience) {
+  ASSERT_TRUE(sa_token_
+                  ->SetClientAuthSecret(
+                      "{\"client_secret\": \"secret\", "
+                      "\"issuer\": \"issuer\", \"subject\": \"subject\"}")
+                  .ok());
+  const std::string &token = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_FIREBASE, "audience1");
+  ASSERT_FALSE(token.empty());
+  // The same audience gets the published token.
+  ASSERT_EQ(&token, &sa_token_->GetAuthToken(
+                        ServiceAccountToken::JWT_TOKEN_FOR_FIREBASE,
+                        "audience1"));
+  // Another audience gets a token of its own.
+  const std::string &other = sa_token_->GetAuthToken(
+      ServiceAccountToken::JWT_TOKEN_FOR_FIREBASE, "audience2");
+  ASSERT_FALSE(other.empty());
+  ASSERT_NE(&token, &other);
+}
+
 }  // namespace
 
 }  // namespace auth
@@ -0,0 +1,157 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/signature_verifier.h"
+
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+SignatureVerifier::SignatureVerifier(size_t num_threads, PostCallback post)
+    : num_threads_(num_threads),
+      post_(post),
+      stopped_(false),
+      in_flight_(new InFlightMap) {}
+
+SignatureVerifier::~SignatureVerifier() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  // Results already posted find the map gone and are dropped.
+  InFlightMap in_flight;
+  in_flight.swap(*in_flight_);
+  in_flight_.reset();
+  Status status(Code::UNAVAILABLE, "Signature verifier stopped");
+  for (const auto &entry : in_flight) {
+    for (const auto &callback : entry.second) {
+      callback(status);
+    }
+  }
+}
+
+bool SignatureVerifier::Start() {
+  if (started()) {
+    return true;
+  }
+  // Post a no-op to find out whether the results can be handed back.
+  if (num_threads_ == 0 || !post_ || !post_([]() {})) {
+    return false;
+  }
+  for (size_t i = 0; i < num_threads_; ++i) {
+    threads_.emplace_back(&SignatureVerifier::Work, this);
+  }
+  return true;
+}
+
+void SignatureVerifier::Verify(const std::string &jwt,
+                               std::shared_ptr<JwtValidator> validator,
+                               std::shared_ptr<const PublicKeys> keys,
+                               DoneCallback on_done) {
+  if (!started()) {
+    on_done(validator->VerifySignature(*keys));
+    return;
+  }
+  FailUnposted();
+
+  // The keys differ between services and across refreshes, so only the
+  // verifications with the same keys are shared.
+  auto &callbacks = (*in_flight_)[InFlightKey(jwt, keys.get())];
+  callbacks.push_back(on_done);
+  if (callbacks.size() > 1) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(Task{jwt, validator, keys});
+  }
+  cv_.notify_one();
+}
+
+void SignatureVerifier::Work() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopped_ || !tasks_.empty(); });
+      if (stopped_) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    Status status = task.validator->VerifySignature(*task.keys);
+    std::shared_ptr<const PublicKeys> keys = std::move(task.keys);
+    InFlightKey key(std::move(task.jwt), keys.get());
+    std::weak_ptr<InFlightMap> in_flight = in_flight_;
+    // The result holds the keys until the entry is completed.
+    if (!post_([in_flight, key, keys, status]() {
+          auto map = in_flight.lock();
+          if (map) {
+            Complete(map.get(), key, status);
+          }
+        })) {
+      // Failed on the serving thread by the next Verify(), or by the
+      // destructor.
+      std::lock_guard<std::mutex> lock(mutex_);
+      unposted_.push_back(Unposted{key, keys});
+    }
+  }
+}
+
+void SignatureVerifier::FailUnposted() {
+  std::vector<Unposted> unposted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (unposted_.empty()) {
+      return;
+    }
+    unposted.swap(unposted_);
+  }
+  Status status(Code::UNAVAILABLE,
+                "Failed to post the signature verification result");
+  for (const auto &entry : unposted) {
+    Complete(in_flight_.get(), entry.key, status);
+  }
+}
+
+void SignatureVerifier::Complete(InFlightMap *in_flight,
+                                 const InFlightKey &key,
+                                 const Status &status) {
+  auto it = in_flight->find(key);
+  if (it == in_flight->end()) {
+    return;
+  }
+  std::vector<DoneCallback> callbacks;
+  callbacks.swap(it->second);
+  in_flight->erase(it);
+  for (const auto &callback : callbacks) {
+    callback(status);
+  }
+}
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,127 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_AUTH_SIGNATURE_VERIFIER_H_
+#define API_MANAGER_AUTH_SIGNATURE_VERIFIER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "contrib/endpoints/include/api_manager/utils/status.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/auth_jwt_validator.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/public_keys.h"
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+// Verifies JWT signatures on a pool of worker threads, so that the thread
+// serving requests is not stalled by RSA verification. Results are handed
+// back to the serving thread through a post callback, and verifications of
+// the same JWT with the same keys in flight at the same time are done once.
+// Verifications still pending when the verifier is destroyed fail with
+// UNAVAILABLE, and so do those whose result could not be posted, on the
+// next call to Verify().
+//
+// Until Start() succeeds, signatures are verified inline. Except for the
+// post callback, all methods must be called on the serving thread.
+class SignatureVerifier {
+ public:
+  // Runs a callback on the serving thread. Returns false if that is not
+  // supported. It is called from the worker threads.
+  typedef std::function<bool(std::function<void()>)> PostCallback;
+  typedef std::function<void(const utils::Status &)> DoneCallback;
+
+  SignatureVerifier(size_t num_threads, PostCallback post);
+  ~SignatureVerifier();
+
+  // Starts the worker threads. Returns false, and keeps verifying inline,
+  // if no thread is configured or if callbacks cannot be posted.
+  bool Start();
+
+  // Verifies the signature of "jwt", already parsed by "validator", with
+  // "keys". "on_done" is called on the serving thread, possibly before
+  // Verify() returns.
+  void Verify(const std::string &jwt, std::shared_ptr<JwtValidator> validator,
+              std::shared_ptr<const PublicKeys> keys, DoneCallback on_done);
+
+  // Returns the number of worker threads configured.
+  size_t num_threads() const { return num_threads_; }
+
+  // Returns true if the worker threads are running.
+  bool started() const { return !threads_.empty(); }
+
+ private:
+  struct Task {
+    std::string jwt;
+    std::shared_ptr<JwtValidator> validator;
+    std::shared_ptr<const PublicKeys> keys;
+  };
+
+  // The loop run by each worker thread.
+  void Work();
+
+  // The JWT and the keys it is verified with.
+  typedef std::pair<std::string, const PublicKeys *> InFlightKey;
+  // Map from a verification to the callbacks waiting on it.
+  typedef std::map<InFlightKey, std::vector<DoneCallback>> InFlightMap;
+
+  // A verification whose result could not be posted. Its keys are kept
+  // alive until it is failed on the serving thread.
+  struct Unposted {
+    InFlightKey key;
+    std::shared_ptr<const PublicKeys> keys;
+  };
+
+  // Calls the callbacks waiting on the verification "key".
+  static void Complete(InFlightMap *in_flight, const InFlightKey &key,
+                       const utils::Status &status);
+
+  // Fails the verifications whose result could not be posted.
+  void FailUnposted();
+
+  size_t num_threads_;
+  PostCallback post_;
+
+  std::vector<std::thread> threads_;
+
+  // Protects the task queue, the stop flag and the unposted results, which
+  // are shared with the worker threads.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Task> tasks_;
+  bool stopped_;
+  std::vector<Unposted> unposted_;
+
+  // The verifications in flight. Only used on the serving thread. The
+  // posted results hold a weak reference, so that those posted after the
+  // verifier is destroyed are dropped. The keys of an entry are kept alive
+  // by its task, then by its posted result, so their address is not reused
+  // while it is in flight.
+  std::shared_ptr<InFlightMap> in_flight_;
+};
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_AUTH_SIGNATURE_VERIFIER_H_
@@ -0,0 +1,289 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/auth/signature_verifier.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "gtest/gtest.h"
+
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+
+namespace google {
+namespace api_manager {
+namespace auth {
+
+namespace {
+
+const char kJwt1[] = "jwt1";
+const char kJwt2[] = "jwt2";
+
+// A validator accepting the signature if the keys are "good".
+class FakeValidator : public JwtValidator {
+ public:
+  FakeValidator(std::atomic<int> *calls) : calls_(calls) {}
+
+  Status Parse(UserInfo *) override { return Status::OK; }
+  Status VerifySignature(const char *pkey, size_t pkey_len) override {
+    ++*calls_;
+    return std::string(pkey, pkey_len) == "good"
+               ? Status::OK
+               : Status(Code::UNAUTHENTICATED, "BAD_SIGNATURE");
+  }
+  Status VerifySignature(const PublicKeys &keys) override {
+    return VerifySignature(keys.raw().data(), keys.raw().size());
+  }
+  std::chrono::system_clock::time_point &GetExpirationTime() override {
+    return exp_;
+  }
+
+ private:
+  std::atomic<int> *calls_;
+  std::chrono::system_clock::time_point exp_;
+};
+
+// Collects the posted callbacks, so that the test thread plays the serving
+// thread.
+class FakeServingThread {
+ public:
+  SignatureVerifier::PostCallback poster() {
+    return [this](std::function<void()> callback) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks_.push_back(callback);
+      }
+      cv_.notify_one();
+      return true;
+    };
+  }
+
+  // Runs the callbacks posted so far, without waiting for more.
+  void RunPosted() {
+    std::deque<std::function<void()>> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      callbacks.swap(callbacks_);
+    }
+    for (const auto &callback : callbacks) {
+      callback();
+    }
+  }
+
+  // Runs the posted callbacks until "count" of them have run.
+  void Run(int count) {
+    while (count-- > 0) {
+      std::function<void()> callback;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !callbacks_.empty(); });
+        callback = callbacks_.front();
+        callbacks_.pop_front();
+      }
+      callback();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> callbacks_;
+};
+
+std::shared_ptr<const PublicKeys> CreateKeys(const std::string &keys) {
+  return std::shared_ptr<const PublicKeys>(
+      PublicKeys::Create(keys.data(), keys.size()));
+}
+
+TEST(SignatureVerifierTest, VerifyInline) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  // No worker thread is configured.
+  SignatureVerifier verifier(0, [](std::function<void()>) { return true; });
+  EXPECT_FALSE(verifier.Start());
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("good"), on_done);
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("bad"), on_done);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[0].ok());
+  EXPECT_EQ(Code::UNAUTHENTICATED, results[1].code());
+  EXPECT_EQ(2, calls);
+
+  // Callbacks cannot be posted to the serving thread.
+  SignatureVerifier unsupported(4,
+                                [](std::function<void()>) { return false; });
+  EXPECT_FALSE(unsupported.Start());
+  EXPECT_FALSE(unsupported.started());
+  unsupported.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                     CreateKeys("good"), on_done);
+  ASSERT_EQ(3u, results.size());
+  EXPECT_TRUE(results[2].ok());
+}
+
+TEST(SignatureVerifierTest, VerifyOnWorkers) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  FakeServingThread serving_thread;
+  SignatureVerifier verifier(2, serving_thread.poster());
+  ASSERT_TRUE(verifier.Start());
+  // Consume the no-op posted by Start().
+  serving_thread.Run(1);
+
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("good"), on_done);
+  verifier.Verify(kJwt2, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("bad"), on_done);
+  // Results are only delivered on the serving thread.
+  EXPECT_TRUE(results.empty());
+
+  serving_thread.Run(2);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(2, calls);
+  int ok = 0;
+  for (const auto &status : results) {
+    if (status.ok()) {
+      ++ok;
+    }
+  }
+  EXPECT_EQ(1, ok);
+}
+
+TEST(SignatureVerifierTest, CoalesceIdenticalJwts) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  FakeServingThread serving_thread;
+  SignatureVerifier verifier(2, serving_thread.poster());
+  ASSERT_TRUE(verifier.Start());
+  serving_thread.Run(1);
+
+  auto keys = CreateKeys("good");
+  for (int i = 0; i < 5; ++i) {
+    verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls), keys,
+                    on_done);
+  }
+  serving_thread.Run(1);
+  ASSERT_EQ(5u, results.size());
+  for (const auto &status : results) {
+    EXPECT_TRUE(status.ok());
+  }
+  EXPECT_EQ(1, calls);
+
+  // Once the verification is over, the same JWT is verified again.
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls), keys,
+                  on_done);
+  serving_thread.Run(1);
+  EXPECT_EQ(6u, results.size());
+  EXPECT_EQ(2, calls);
+}
+
+TEST(SignatureVerifierTest, DoNotCoalesceDifferentKeys) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  FakeServingThread serving_thread;
+  SignatureVerifier verifier(2, serving_thread.poster());
+  ASSERT_TRUE(verifier.Start());
+  serving_thread.Run(1);
+
+  // The same JWT, e.g. for another service, or after the keys were
+  // refreshed, gets the result of its own keys.
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("good"), on_done);
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("bad"), on_done);
+  serving_thread.Run(2);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(2, calls);
+  EXPECT_NE(results[0].ok(), results[1].ok());
+}
+
+TEST(SignatureVerifierTest, FailPendingOnDestruction) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  FakeServingThread serving_thread;
+  {
+    SignatureVerifier verifier(1, serving_thread.poster());
+    ASSERT_TRUE(verifier.Start());
+    serving_thread.Run(1);
+    verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                    CreateKeys("good"), on_done);
+    verifier.Verify(kJwt2, std::make_shared<FakeValidator>(&calls),
+                    CreateKeys("good"), on_done);
+  }
+  ASSERT_EQ(2u, results.size());
+  for (const auto &status : results) {
+    EXPECT_EQ(Code::UNAVAILABLE, status.code());
+  }
+
+  // The results posted before the verifier was destroyed are dropped.
+  serving_thread.RunPosted();
+  EXPECT_EQ(2u, results.size());
+}
+
+TEST(SignatureVerifierTest, FailUnpostedResults) {
+  std::atomic<int> calls(0);
+  std::vector<Status> results;
+  auto on_done = [&results](const Status &status) {
+    results.push_back(status);
+  };
+
+  // Only the no-op posted by Start() gets through.
+  std::atomic<int> posts(0);
+  SignatureVerifier verifier(
+      1, [&posts](std::function<void()>) { return posts++ == 0; });
+  ASSERT_TRUE(verifier.Start());
+  verifier.Verify(kJwt1, std::make_shared<FakeValidator>(&calls),
+                  CreateKeys("good"), on_done);
+
+  // A later verification fails the one whose result was lost, once the
+  // worker has given up posting it.
+  auto keys = CreateKeys("good");
+  while (results.empty()) {
+    verifier.Verify(kJwt2, std::make_shared<FakeValidator>(&calls), keys,
+                    [](const Status &) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(Code::UNAVAILABLE, results[0].code());
+}
+
+}  // namespace
+
+}  // namespace auth
+}  // namespace api_manager
+}  // namespace google
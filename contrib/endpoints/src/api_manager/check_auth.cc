@@ -25,17 +25,17 @@
 #include "contrib/endpoints/src/api_manager/auth/lib/auth_token.h"
 #include "contrib/endpoints/src/api_manager/auth/lib/base64.h"
 #include "contrib/endpoints/src/api_manager/auth/lib/json.h"
-#include "contrib/endpoints/src/api_manager/auth/lib/json_util.h"
 #include "contrib/endpoints/src/api_manager/cloud_trace/cloud_trace.h"
+#include "contrib/endpoints/src/api_manager/fetch_pub_key.h"
 #include "contrib/endpoints/src/api_manager/utils/url_util.h"
 
 using ::google::api_manager::auth::Certs;
 using ::google::api_manager::auth::JwtCache;
-using ::google::api_manager::auth::JwtValue;
-using ::google::api_manager::auth::GetStringValue;
 using ::google::api_manager::auth::JwtValidator;
+using ::google::api_manager::auth::NegativeJwtCache;
 using ::google::api_manager::utils::Status;
 using ::google::protobuf::util::error::Code;
+using std::chrono::steady_clock;
 using std::chrono::system_clock;
 
 namespace google {
@@ -45,12 +45,20 @@ namespace {
 const char kAccessTokenName[] = "access_token";
 const char kAuthHeader[] = "authorization";
 const char kBearer[] = "Bearer ";
-// The lifetime of a public key cache entry. Unit: seconds.
-const int kPubKeyCacheDuration = 300;
+// The only signature verification error caused by the JWT itself rather
+// than by the issuer keys, which may be stale. It is the only one remembered
+// in the negative JWT cache.
+const char kBadFormatError[] = "BAD_FORMAT";
 
 // The header key to send endpoint api user info.
 const char kEndpointApiUserInfo[] = "X-Endpoint-API-UserInfo";
 
+// The trace span names of the auth stages, indexed by AuthStage.
+const char *const kAuthStageSpanNames[AUTH_STAGE_MAX] = {
+    "GetAuthToken", "LookupJwtCache",  "ParseJwt",     "CheckAudience",
+    "InitKey",      "VerifySignature", "PassUserInfo",
+};
+
 // An AuthChecker object is created for every incoming request. It authenticates
 // the request, extracts user info from the auth token and sets it to the
 // request context.
@@ -69,9 +77,12 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // Not all the steps are executed for every request.
   // For example, in case of a JWT cache hit, only four steps are executed:
   // GetAuthToken() --> LookupJwtCache() --> CheckAudience() --> PassUserInfo()
+  // A JWT rejected recently is found in the negative JWT cache and stops at
+  // LookupJwtCache().
   // In the case of a JWT cache miss, but a key cache hit, the steps are:
   // GetAuthToken() --> LookupJwtCache() --> ParseJwt() --> CheckAudience() -->
-  // InitKey() --> VerifySignature() --> PassUserInfo()
+  // InitKey() --> VerifySignature() --> PostVerifySignature() -->
+  // PassUserInfo()
   void GetAuthToken();
 
   void LookupJwtCache();
@@ -82,18 +93,16 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
 
   void InitKey();
 
-  void DiscoverJwksUri(const std::string &url);
-
-  // Callback function for open ID discovery http fetch.
-  void PostFetchJwksUri(Status status, std::string &&body);
-
-  void FetchPubKey(const std::string &url);
-
-  // Callback function for public key http fetch.
-  void PostFetchPubKey(Status status, std::string &&body);
+  // Callback function for the public key fetch.
+  void PostFetchPubKey(Status status);
 
+  // Hands the signature verification to the signature verifier, which may
+  // run it on a worker thread.
   void VerifySignature();
 
+  // Callback function for the signature verification.
+  void PostVerifySignature(Status status);
+
   void PassUserInfoOnSuccess();
 
   /*** Helper functions ***/
@@ -101,9 +110,12 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // Returns a shared pointer of this AuthChecker object.
   std::shared_ptr<AuthChecker> GetPtr() { return shared_from_this(); }
 
-  // Helper function to send a http GET request.
-  void HttpFetch(const std::string &url,
-                 std::function<void(Status, std::string &&)> continuation);
+  // Records the latency of the current stage and starts the given one,
+  // with its own child trace span.
+  void StartStage(AuthStage stage);
+
+  // Records the latency of the last stage and of the whole check.
+  void EndStages();
 
   // Authentication error
   void Unauthenticated(const std::string &error);
@@ -111,16 +123,14 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
   // Authorization error
   void Unauthorized(const std::string &error);
 
-  // Fetch error, takes upstream error
-  void FetchFailure(const std::string &error, Status status);
-
   /*** Member Variables. ***/
 
   // Request context.
   std::shared_ptr<context::RequestContext> context_;
 
-  // JWT validator.
-  std::unique_ptr<auth::JwtValidator> validator_;
+  // JWT validator. It is shared with the signature verifier while the
+  // signature is verified.
+  std::shared_ptr<auth::JwtValidator> validator_;
 
   // User info extracted from auth token.
   UserInfo user_info_;
@@ -136,13 +146,21 @@ class AuthChecker : public std::enable_shared_from_this<AuthChecker> {
 
   // Trace span for check auth.
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span_;
+
+  // The current stage, when it and the whole check started, and its trace
+  // span, a child of trace_span_.
+  AuthStage stage_;
+  steady_clock::time_point stage_start_;
+  steady_clock::time_point check_start_;
+  std::shared_ptr<cloud_trace::CloudTraceSpan> stage_span_;
 };
 
 AuthChecker::AuthChecker(std::shared_ptr<context::RequestContext> context,
                          std::function<void(Status status)> continuation)
     : context_(context),
       env_(context_->service_context()->env()),
-      on_done_(continuation) {}
+      on_done_(continuation),
+      stage_(AUTH_STAGE_MAX) {}
 
 void AuthChecker::Check() {
   if (!context_->service_context()->RequireAuth() ||
@@ -154,6 +172,7 @@ void AuthChecker::Check() {
 
   // CreateSpan returns nullptr if trace is disabled.
   trace_span_.reset(CreateSpan(context_->cloud_trace(), "CheckAuth"));
+  check_start_ = steady_clock::now();
 
   GetAuthToken();
   if (auth_token_.empty()) {
@@ -168,6 +187,7 @@ void AuthChecker::Check() {
 }
 
 void AuthChecker::GetAuthToken() {
+  StartStage(AUTH_STAGE_GET_AUTH_TOKEN);
   Request *r = context_->request();
   std::string auth_header;
   if (!r->FindHeader(kAuthHeader, &auth_header)) {
@@ -189,35 +209,31 @@ void AuthChecker::GetAuthToken() {
 }
 
 void AuthChecker::LookupJwtCache() {
-  bool remove = false;  // whether or not need to remove an expired entry.
-  bool cache_hit = false;
+  StartStage(AUTH_STAGE_LOOKUP_JWT_CACHE);
   JwtCache &jwt_cache = context_->service_context()->jwt_cache();
-  {
-    JwtCache::ScopedLookup lookup(&jwt_cache, auth_token_);
-    if (lookup.Found()) {
-      JwtValue *val = lookup.value();
-      if (system_clock::now() <= val->exp) {
-        // Cache hit and cache entry is not expired.
-        user_info_ = val->user_info;
-        cache_hit = true;
-      } else {
-        // Need to removes the expired cache entry.
-        remove = true;
-      }
-    }
-  }
-  if (remove) {
-    jwt_cache.Remove(auth_token_);
-  }
-
+  system_clock::time_point now = system_clock::now();
+  bool cache_hit = jwt_cache.Lookup(auth_token_, now, &user_info_);
+  context_->service_context()->auth_stats().CountJwtCacheLookup(cache_hit);
   if (cache_hit) {
     CheckAudience(true);
-  } else {
-    ParseJwt();
+    return;
+  }
+
+  // A malformed or expired JWT rejected recently is rejected with the same
+  // error without doing the work again.
+  std::string error;
+  NegativeJwtCache &negative_cache =
+      context_->service_context()->negative_jwt_cache();
+  if (negative_cache.Lookup(auth_token_, now, &error)) {
+    Unauthenticated(error);
+    return;
   }
+
+  ParseJwt();
 }
 
 void AuthChecker::ParseJwt() {
+  StartStage(AUTH_STAGE_PARSE_JWT);
   if (validator_ == nullptr) {
     validator_ = JwtValidator::Create(auth_token_.c_str(), auth_token_.size());
     if (validator_ == nullptr) {
@@ -228,6 +244,8 @@ void AuthChecker::ParseJwt() {
 
   Status status = validator_->Parse(&user_info_);
   if (!status.ok()) {
+    context_->service_context()->negative_jwt_cache().Insert(
+        auth_token_, status.message(), system_clock::now());
     Unauthenticated(status.message());
     return;
   }
@@ -236,6 +254,7 @@ void AuthChecker::ParseJwt() {
 }
 
 void AuthChecker::CheckAudience(bool cache_hit) {
+  StartStage(AUTH_STAGE_CHECK_AUDIENCE);
   std::string audience = user_info_.audiences.empty()
                              ? std::string()
                              : user_info_.AudiencesAsString();
@@ -246,6 +265,8 @@ void AuthChecker::CheckAudience(bool cache_hit) {
   context_->set_auth_claims(user_info_.claims);
 
   // Remove http/s header and trailing '/' for issuer.
+  // Issuer and audience failures are not remembered in the negative JWT
+  // cache, since they depend on the method called.
   std::string issuer = utils::GetUrlContent(user_info_.issuer);
   if (!context_->method()->isIssuerAllowed(issuer)) {
     Unauthenticated("Issuer not allowed");
@@ -275,92 +296,49 @@ void AuthChecker::CheckAudience(bool cache_hit) {
 }
 
 void AuthChecker::InitKey() {
+  StartStage(AUTH_STAGE_INIT_KEY);
   Certs &key_cache = context_->service_context()->certs();
   auto cert = key_cache.GetCert(user_info_.issuer);
+  system_clock::time_point now = system_clock::now();
+  bool usable = cert != nullptr &&
+                (now <= cert->second || CanUseStalePubKey(cert->second, now));
+  context_->service_context()->auth_stats().CountKeyCacheLookup(usable);
 
-  if (cert == nullptr || system_clock::now() > cert->second) {
-    // Key has not been fetched or has expired.
-    std::string url;
-    bool tryOpenId =
-        context_->service_context()->GetJwksUri(user_info_.issuer, &url);
-    if (url.empty()) {
-      Unauthenticated("Cannot determine the URI of the key");
-      return;
-    }
-
-    if (tryOpenId) {
-      DiscoverJwksUri(url);
-    } else {
-      // JwksUri is available. No need to try openID discovery.
-      FetchPubKey(url);
-    }
-  } else {
+  if (cert != nullptr && now <= cert->second) {
     // Key is in the cache, next step is to verify signature.
     VerifySignature();
-  }
-}
-
-void AuthChecker::DiscoverJwksUri(const std::string &url) {
-  auto pChecker = GetPtr();
-  HttpFetch(url, [pChecker](Status status, std::string &&body) {
-    pChecker->PostFetchJwksUri(status, std::move(body));
-  });
-}
-
-void AuthChecker::PostFetchJwksUri(Status status, std::string &&body) {
-  if (!status.ok()) {
-    context_->service_context()->SetJwksUri(user_info_.issuer, std::string(),
-                                            false);
-    FetchFailure("Unable to fetch URI of the key via OpenID discovery", status);
     return;
   }
 
-  // Parse discovery doc and extract jwks_uri
-  grpc_json *discovery_json = grpc_json_parse_string_with_len(
-      const_cast<char *>(body.c_str()), body.size());
-  const char *jwks_uri;
-  if (discovery_json != nullptr) {
-    jwks_uri = GetStringValue(discovery_json, "jwks_uri");
-    grpc_json_destroy(discovery_json);
-  } else {
-    jwks_uri = nullptr;
-  }
-
-  if (jwks_uri == nullptr) {
-    env_->LogError("OpenID discovery failed due to invalid doc format");
-    context_->service_context()->SetJwksUri(user_info_.issuer, std::string(),
-                                            false);
-    Unauthenticated("Unable to parse URI of the key via OpenID discovery");
+  if (cert != nullptr && CanUseStalePubKey(cert->second, now)) {
+    // Key has expired, but it is still used while it is refreshed in the
+    // background. The refresh is usually started by RefreshPubKeys() before
+    // the key expires; this only covers a refresh that failed or never ran.
+    FetchPubKey(context_->shared_service_context(), user_info_.issuer,
+                nullptr, [](Status) {});
+    VerifySignature();
     return;
   }
 
-  // OpenID discovery completed. Set jwks_uri for the issuer in cache.
-  context_->service_context()->SetJwksUri(user_info_.issuer, jwks_uri, false);
-
-  FetchPubKey(jwks_uri);
-}
-
-void AuthChecker::FetchPubKey(const std::string &url) {
+  // Key has not been fetched or has expired long ago. Wait for the fetch,
+  // which is shared with the other requests for the same issuer.
   auto pChecker = GetPtr();
-  HttpFetch(url, [pChecker](Status status, std::string &&body) {
-    pChecker->PostFetchPubKey(status, std::move(body));
-  });
+  FetchPubKey(context_->shared_service_context(), user_info_.issuer,
+              stage_span_,
+              [pChecker](Status status) { pChecker->PostFetchPubKey(status); });
 }
 
-void AuthChecker::PostFetchPubKey(Status status, std::string &&body) {
-  if (!status.ok() || body.empty()) {
-    FetchFailure("Unable to fetch verification key", status);
+void AuthChecker::PostFetchPubKey(Status status) {
+  if (!status.ok()) {
+    Unauthenticated(status.message());
     return;
   }
 
-  Certs &key_cache = context_->service_context()->certs();
-  key_cache.Update(
-      user_info_.issuer, std::move(body),
-      system_clock::now() + std::chrono::seconds(kPubKeyCacheDuration));
   VerifySignature();
 }
 
 void AuthChecker::VerifySignature() {
+  StartStage(AUTH_STAGE_VERIFY_SIGNATURE);
   Certs &key_cache = context_->service_context()->certs();
   auto cert = key_cache.GetCert(user_info_.issuer);
   if (cert == nullptr) {
@@ -368,9 +346,22 @@ void AuthChecker::VerifySignature() {
     return;
   }
 
-  Status status =
-      validator_->VerifySignature(cert->first.c_str(), cert->first.size());
+  auto pChecker = GetPtr();
+  context_->service_context()->signature_verifier()->Verify(
+      auth_token_, validator_, cert->first,
+      [pChecker](const Status &status) {
+        pChecker->PostVerifySignature(status);
+      });
+}
+
+void AuthChecker::PostVerifySignature(Status status) {
   if (!status.ok()) {
+    // A bad signature may come from keys rotated since they were fetched,
+    // so it is not remembered.
+    if (status.message() == kBadFormatError) {
+      context_->service_context()->negative_jwt_cache().Insert(
+          auth_token_, status.message(), system_clock::now());
+    }
     Unauthenticated(status.message());
     return;
   }
@@ -384,6 +375,7 @@ void AuthChecker::VerifySignature() {
 }
 
 void AuthChecker::PassUserInfoOnSuccess() {
+  StartStage(AUTH_STAGE_PASS_USER_INFO);
   char *json_buf = auth::WriteUserInfoToJson(user_info_);
   if (json_buf == nullptr) {
     return;
@@ -395,12 +387,14 @@ void AuthChecker::PassUserInfoOnSuccess() {
   auth::esp_grpc_free(json_buf);
   auth::esp_grpc_free(base64_json_buf);
 
+  EndStages();
   TRACE(trace_span_) << "Authenticated.";
   trace_span_.reset();
   on_done_(Status::OK);
 }
 
 void AuthChecker::Unauthenticated(const std::string &error) {
+  EndStages();
   TRACE(trace_span_) << "Authentication failed: " << error;
   trace_span_.reset();
   on_done_(Status(Code::UNAUTHENTICATED,
@@ -409,6 +403,7 @@ void AuthChecker::Unauthenticated(const std::string &error) {
 }
 
 void AuthChecker::Unauthorized(const std::string &error) {
+  EndStages();
   TRACE(trace_span_) << "Authorization failed: " << error;
   trace_span_.reset();
   on_done_(Status(Code::PERMISSION_DENIED,
@@ -416,40 +411,30 @@ void AuthChecker::Unauthorized(const std::string &error) {
                   Status::AUTH));
 }
 
-void AuthChecker::FetchFailure(const std::string &error, Status status) {
-  // Append HTTP response code for the upstream statuses
-  trace_span_.reset();
-  on_done_(
-      Status(Code::UNAUTHENTICATED,
-             std::string("JWT validation failed: ") + error +
-                 (status.code() >= 300
-                      ? ". HTTP response code: " + std::to_string(status.code())
-                      : ""),
-             Status::AUTH));
+void AuthChecker::StartStage(AuthStage stage) {
+  steady_clock::time_point now = steady_clock::now();
+  if (stage_ != AUTH_STAGE_MAX) {
+    context_->service_context()->auth_stats().RecordStage(stage_,
+                                                          now - stage_start_);
+  }
+  stage_ = stage;
+  stage_start_ = now;
+  // Ends the span of the previous stage before starting the next one.
+  stage_span_.reset();
+  stage_span_.reset(
+      CreateChildSpan(trace_span_.get(), kAuthStageSpanNames[stage]));
 }
 
-void AuthChecker::HttpFetch(
-    const std::string &url,
-    std::function<void(Status, std::string &&)> continuation) {
-  std::shared_ptr<cloud_trace::CloudTraceSpan> fetch_span(
-      CreateChildSpan(trace_span_.get(), "HttpFetch"));
-  env_->LogDebug(std::string("http fetch: ") + url);
-  TRACE(fetch_span) << "Http request URL: " << url;
-
-  std::unique_ptr<HTTPRequest> request(
-      new HTTPRequest([continuation, fetch_span](
-          Status status, std::map<std::string, std::string> &&,
-          std::string &&body) {
-        TRACE(fetch_span) << "Http response status: " << status.ToString();
-        continuation(status, std::move(body));
-      }));
-  if (!request) {
-    continuation(Status(Code::INTERNAL, "Out of memory"), "");
+void AuthChecker::EndStages() {
+  if (stage_ == AUTH_STAGE_MAX) {
     return;
   }
-
-  request->set_method("GET").set_url(url);
-  env_->RunHTTPRequest(std::move(request));
+  steady_clock::time_point now = steady_clock::now();
+  auth::AuthStats &stats = context_->service_context()->auth_stats();
+  stats.RecordStage(stage_, now - stage_start_);
+  stats.RecordTotal(now - check_start_);
+  stage_ = AUTH_STAGE_MAX;
+  stage_span_.reset();
 }
 
 }  // namespace
@@ -521,6 +521,77 @@ TEST_F(CheckAuthTest, TestNoOpenId) {
       .WillOnce(Return(utils::Status::OK));
 
   CheckAuth(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
+
+  // Every stage ran once, and the key was fetched.
+  AuthStatistics stat;
+  service_context_->GetAuthStatistics(&stat);
+  for (int i = 0; i < AUTH_STAGE_MAX; ++i) {
+    EXPECT_EQ(1u, stat.stage_latency[i].count) << i;
+  }
+  EXPECT_EQ(1u, stat.total_latency.count);
+  EXPECT_EQ(0u, stat.jwt_cache_hits);
+  EXPECT_EQ(1u, stat.jwt_cache_misses);
+  EXPECT_EQ(0u, stat.key_cache_hits);
+  EXPECT_EQ(1u, stat.key_cache_misses);
+  EXPECT_EQ(1u, stat.key_fetches);
+  EXPECT_EQ(0u, stat.key_fetch_failures);
+}
+
+// Expired keys are still used while they are being refreshed, and are kept
+// if the refresh fails. Keys that expired long ago are not used.
+TEST_F(CheckAuthTest, TestStaleKey) {
+  service_context_->certs().Update(
+      "https://issuer2.com", kPubkey,
+      std::chrono::system_clock::now() - std::chrono::seconds(10));
+
+  EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
+      .WillOnce(Invoke([](const std::string &, std::string *token) {
+        *token = std::string(kBearer) + std::string(kTokenIssuer2);
+        return true;
+      }));
+  EXPECT_CALL(*raw_request_, SetAuthToken(kTokenIssuer2)).Times(1);
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        EXPECT_EQ(req->url(), kIssuer2PubkeyUrl);
+        std::map<std::string, std::string> empty;
+        req->OnComplete(Status(Code::UNAVAILABLE, "Unavailable"),
+                        std::move(empty), "");
+      }));
+  EXPECT_CALL(*raw_request_,
+              AddHeaderToBackend(kEndpointApiUserInfo, kUserInfo_kSub_kIss2))
+      .WillOnce(Return(utils::Status::OK));
+
+  CheckAuth(context_, [](Status status) { ASSERT_TRUE(status.ok()); });
+  EXPECT_NE(nullptr, service_context_->certs().GetCert("https://issuer2.com"));
+
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_request_));
+  EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_env_));
+
+  // The key expired long ago, so the request waits for the fetch.
+  service_context_->certs().Update(
+      "https://issuer2.com", kPubkey,
+      std::chrono::system_clock::now() - std::chrono::hours(2));
+  service_context_->jwt_cache().Remove(kTokenIssuer2);
+
+  EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
+      .WillOnce(Invoke([](const std::string &, std::string *token) {
+        *token = std::string(kBearer) + std::string(kTokenIssuer2);
+        return true;
+      }));
+  EXPECT_CALL(*raw_request_, SetAuthToken(kTokenIssuer2)).Times(1);
+  EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([](HTTPRequest *req) {
+        EXPECT_EQ(req->url(), kIssuer2PubkeyUrl);
+        std::map<std::string, std::string> empty;
+        req->OnComplete(Status(Code::UNAVAILABLE, "Unavailable"),
+                        std::move(empty), "");
+      }));
+
+  CheckAuth(context_, [](Status status) {
+    ASSERT_EQ(status.code(), Code::UNAUTHENTICATED);
+    ASSERT_EQ(status.message(),
+              "JWT validation failed: Unable to fetch verification key");
+  });
 }
 
 // Negative test: invalid token and expired token.
@@ -576,6 +647,43 @@ TEST_F(CheckAuthTest, TestInvalidToken) {
   });
 }
 
+// A rejected token is answered from the negative JWT cache the second time.
+TEST_F(CheckAuthTest, TestNegativeJwtCache) {
+  auth::NegativeJwtCache &negative_cache =
+      service_context_->negative_jwt_cache();
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
+        .WillOnce(Invoke([](const std::string &, std::string *token) {
+          *token = std::string(kBearer) + std::string(kTokenExpired);
+          return true;
+        }));
+    EXPECT_CALL(*raw_request_, SetAuthToken(kTokenExpired)).Times(1);
+    EXPECT_CALL(*raw_env_, DoRunHTTPRequest(_)).Times(0);
+
+    CheckAuth(context_, [](Status status) {
+      ASSERT_EQ(status.code(), Code::UNAUTHENTICATED);
+      ASSERT_EQ(status.message(),
+                "JWT validation failed: TIME_CONSTRAINT_FAILURE");
+    });
+
+    EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_request_));
+    EXPECT_TRUE(Mock::VerifyAndClearExpectations(raw_env_));
+  }
+  EXPECT_EQ(1u, negative_cache.hits());
+  EXPECT_EQ(1u, negative_cache.misses());
+  EXPECT_EQ(1u, negative_cache.Size());
+
+  // The second request stopped at the JWT cache lookup.
+  AuthStatistics stat;
+  service_context_->GetAuthStatistics(&stat);
+  EXPECT_EQ(2u, stat.total_latency.count);
+  EXPECT_EQ(2u, stat.stage_latency[AUTH_STAGE_LOOKUP_JWT_CACHE].count);
+  EXPECT_EQ(1u, stat.stage_latency[AUTH_STAGE_PARSE_JWT].count);
+  EXPECT_EQ(2u, stat.jwt_cache_misses);
+  EXPECT_EQ(1u, stat.negative_jwt_cache_hits);
+  EXPECT_EQ(0u, stat.key_fetches);
+}
+
 // Negative test: bad audience
 TEST_F(CheckAuthTest, TestBadAudience) {
   EXPECT_CALL(*raw_request_, FindHeader(kAuthHeader, _))
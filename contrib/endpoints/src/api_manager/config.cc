@@ -15,14 +15,18 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 #include "contrib/endpoints/src/api_manager/config.h"
+#include "contrib/endpoints/src/api_manager/service_control/logs_metrics_loader.h"
 #include "contrib/endpoints/src/api_manager/utils/marshalling.h"
 #include "contrib/endpoints/src/api_manager/utils/stl_util.h"
 #include "contrib/endpoints/src/api_manager/utils/url_util.h"
 
+#include <climits>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include "google/protobuf/io/tokenizer.h"
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
@@ -53,14 +57,12 @@ class NoOpErrorCollector : public ::google::protobuf::io::ErrorCollector {
   void AddError(int line, int column, const string &message) {}
 };
 
-bool ReadConfigFromString(const std::string &service_config,
-                          ::google::protobuf::Message *service) {
-  // Try binary serialized proto first. Due to a bug in JSON parser,
-  // JSON parser may crash if presented with non-JSON data.
-  if (service->ParseFromString(service_config)) {
-    return true;
-  }
+// Services with at least this many http rules are loaded with multiple
+// threads. Smaller ones load faster than the threads start.
+const int kMinHttpRulesForParallelLoad = 512;
 
+bool ReadConfigFromTextOrJson(const std::string &service_config,
+                              ::google::protobuf::Message *service) {
   // Try JSON.
   Status status = utils::JsonToProto(service_config, service);
   if (status.ok()) {
@@ -77,9 +79,166 @@ bool ReadConfigFromString(const std::string &service_config,
   return false;
 }
 
+bool ReadConfigFromString(const std::string &service_config,
+                          ::google::protobuf::Message *service) {
+  // Try binary serialized proto first. Due to a bug in JSON parser,
+  // JSON parser may crash if presented with non-JSON data.
+  if (service->ParseFromString(service_config)) {
+    return true;
+  }
+  return ReadConfigFromTextOrJson(service_config, service);
+}
+
+// Same as above, but reads from a buffer. The buffer is only copied if it
+// is not a binary serialized proto.
+bool ReadConfigFromArray(const char *data, size_t size,
+                         ::google::protobuf::Message *service) {
+  if (size > INT_MAX) {
+    return false;
+  }
+  if (service->ParseFromArray(data, static_cast<int>(size))) {
+    return true;
+  }
+  return ReadConfigFromTextOrJson(std::string(data, size), service);
+}
+
+// An env which records log messages instead of writing them, so that the
+// messages of loaders running in parallel can be replayed in a fixed order
+// on the real env. Other calls are forwarded to the real env.
+class LogRecorder : public ApiManagerEnvInterface {
+ public:
+  explicit LogRecorder(ApiManagerEnvInterface *env) : env_(env) {}
+
+  void Log(LogLevel level, const char *message) override {
+    logs_.emplace_back(level, message);
+  }
+  std::unique_ptr<PeriodicTimer> StartPeriodicTimer(
+      std::chrono::milliseconds interval,
+      std::function<void()> continuation) override {
+    return env_->StartPeriodicTimer(interval, continuation);
+  }
+  void RunHTTPRequest(std::unique_ptr<HTTPRequest> request) override {
+    env_->RunHTTPRequest(std::move(request));
+  }
+  void RunGRPCRequest(std::unique_ptr<GRPCRequest> request) override {
+    env_->RunGRPCRequest(std::move(request));
+  }
+
+  // Writes the recorded messages to the real env.
+  void Replay() {
+    for (const auto &log : logs_) {
+      env_->Log(log.first, log.second.c_str());
+    }
+    logs_.clear();
+  }
+
+ private:
+  ApiManagerEnvInterface *env_;
+  std::vector<std::pair<LogLevel, std::string>> logs_;
+};
+
+// Runs the loaders in order, stopping at the first failure.
+bool RunLoaders(
+    ApiManagerEnvInterface *env,
+    const std::vector<std::function<bool(ApiManagerEnvInterface *)>> &loaders) {
+  for (const auto &loader : loaders) {
+    if (!loader(env)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs each loader in its own thread. Log messages are written in loader
+// order once all of them finished.
+bool RunLoadersInParallel(
+    ApiManagerEnvInterface *env,
+    const std::vector<std::function<bool(ApiManagerEnvInterface *)>> &loaders) {
+  std::vector<std::unique_ptr<LogRecorder>> recorders;
+  // Not a std::vector<bool>, whose elements cannot be written concurrently.
+  std::unique_ptr<bool[]> results(new bool[loaders.size()]);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < loaders.size(); ++i) {
+    recorders.emplace_back(new LogRecorder(env));
+    LogRecorder *recorder = recorders.back().get();
+    bool *result = &results[i];
+    const auto &loader = loaders[i];
+    threads.emplace_back(
+        [&loader, recorder, result]() { *result = loader(recorder); });
+  }
+  bool ok = true;
+  for (size_t i = 0; i < loaders.size(); ++i) {
+    threads[i].join();
+    recorders[i]->Replay();
+    ok = ok && results[i];
+  }
+  return ok;
+}
+
+// Gets the http method and the url template of an http rule. Both are left
+// unchanged if the rule has no pattern.
+void GetHttpRulePattern(const ::google::api::HttpRule &rule,
+                        const char **http_method, const string **url) {
+  switch (rule.pattern_case()) {
+    case ::google::api::HttpRule::kGet:
+      *url = &rule.get();
+      *http_method = http_get;
+      break;
+    case ::google::api::HttpRule::kPut:
+      *url = &rule.put();
+      *http_method = http_put;
+      break;
+    case ::google::api::HttpRule::kPost:
+      *url = &rule.post();
+      *http_method = http_post;
+      break;
+    case ::google::api::HttpRule::kDelete:
+      *url = &rule.delete_();
+      *http_method = http_delete;
+      break;
+    case ::google::api::HttpRule::kPatch:
+      *url = &rule.patch();
+      *http_method = http_patch;
+      break;
+    case ::google::api::HttpRule::kCustom:
+      *url = &rule.custom().path();
+      *http_method = rule.custom().kind().c_str();
+      break;
+    default:
+      break;
+  }
+}
+
 }  // namespace
 
-Config::Config() {}
+Config::Config()
+    : issuer_jwks_uri_map_(std::make_shared<const JwksUriMap>()) {}
+
+void Config::ParseHttpTemplates(HttpTemplateCache *template_cache) {
+  std::vector<string> templates;
+  templates.reserve(service_.http().rules_size());
+  for (const auto &api : service_.apis()) {
+    if (api.name().empty()) {
+      continue;
+    }
+    for (const auto &method : api.methods()) {
+      // Same as the RPC path built in GetOrCreateMethodInfoImpl.
+      templates.push_back('/' + api.name() + '/' + method.name());
+    }
+  }
+  for (const auto &rule : service_.http().rules()) {
+    const string *url = nullptr;
+    const char *http_method = nullptr;
+    GetHttpRulePattern(rule, &http_method, &url);
+    if (url != nullptr && !url->empty()) {
+      templates.push_back(*url);
+    }
+  }
+  // Drops the templates of released config versions, so that the shared
+  // cache is bounded by the configs still loaded.
+  template_cache->EvictUnused();
+  template_cache->ParseAll(templates);
+}
 
 MethodInfoImpl *Config::GetOrCreateMethodInfoImpl(const string &name,
                                                   const string &api_name,
@@ -149,35 +308,7 @@ bool Config::LoadHttpMethods(ApiManagerEnvInterface *env,
     const string &selector = rule.selector();
     const string *url = nullptr;
     const char *http_method = nullptr;
-
-    switch (rule.pattern_case()) {
-      case ::google::api::HttpRule::kGet:
-        url = &rule.get();
-        http_method = http_get;
-        break;
-      case ::google::api::HttpRule::kPut:
-        url = &rule.put();
-        http_method = http_put;
-        break;
-      case ::google::api::HttpRule::kPost:
-        url = &rule.post();
-        http_method = http_post;
-        break;
-      case ::google::api::HttpRule::kDelete:
-        url = &rule.delete_();
-        http_method = http_delete;
-        break;
-      case ::google::api::HttpRule::kPatch:
-        url = &rule.patch();
-        http_method = http_patch;
-        break;
-      case ::google::api::HttpRule::kCustom:
-        url = &rule.custom().path();
-        http_method = rule.custom().kind().c_str();
-        break;
-      default:
-        break;
-    }
+    GetHttpRulePattern(rule, &http_method, &url);
 
     if (http_method == nullptr || url == nullptr || url->empty()) {
       env->LogError("Invalid HTTP binding encountered.");
@@ -399,10 +530,10 @@ bool Config::LoadBackends(ApiManagerEnvInterface *env) {
   return true;
 }
 
-bool Config::LoadService(ApiManagerEnvInterface *env,
-                         const std::string &service_config) {
-  if (!service_config.empty()) {
-    if (!ReadConfigFromString(service_config, &service_)) {
+bool Config::LoadService(ApiManagerEnvInterface *env, const char *data,
+                         size_t size) {
+  if (size > 0) {
+    if (!ReadConfigFromArray(data, size, &service_)) {
       env->LogError("Cannot load ESP configuration protocol buffer.");
       return false;
     }
@@ -446,35 +577,72 @@ std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
 
 std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
                                        const std::string &service_config) {
+  HttpTemplateCache template_cache;
+  return Create(env, service_config, &template_cache);
+}
+
+std::unique_ptr<Config> Config::Create(ApiManagerEnvInterface *env,
+                                       const std::string &service_config,
+                                       HttpTemplateCache *template_cache) {
   std::unique_ptr<Config> config(new Config);
-  if (!config->LoadService(env, service_config)) {
-    return nullptr;
-  }
-  PathMatcherBuilder<MethodInfo *> pmb;
-  // Load apis before http rules to store API versions
-  if (!config->LoadRpcMethods(env, &pmb)) {
+  if (!config->LoadService(env, service_config.data(),
+                           service_config.size())) {
     return nullptr;
   }
-  if (!config->LoadHttpMethods(env, &pmb)) {
+  if (!config->LoadAll(env, template_cache)) {
     return nullptr;
   }
-  config->path_matcher_ = pmb.Build();
-  if (!config->LoadAuthentication(env)) {
-    return nullptr;
+  return config;
+}
+
+bool Config::LoadAll(ApiManagerEnvInterface *env,
+                     HttpTemplateCache *template_cache) {
+  bool parallel = service_.http().rules_size() >= kMinHttpRulesForParallelLoad;
+  // Service control logs and metrics only depend on the service config, so
+  // they are loaded while the methods are being loaded.
+  std::thread logs_metrics_thread;
+  if (parallel) {
+    logs_metrics_thread = std::thread([this]() { LoadLogsMetrics(); });
+  } else {
+    LoadLogsMetrics();
   }
-  if (!config->LoadUsage(env)) {
-    return nullptr;
+  bool ok = LoadMethods(env, template_cache, parallel);
+  if (logs_metrics_thread.joinable()) {
+    logs_metrics_thread.join();
   }
-  if (!config->LoadSystemParameters(env)) {
-    return nullptr;
-  }
-  if (!config->LoadBackends(env)) {
-    return nullptr;
+  return ok;
+}
+
+bool Config::LoadMethods(ApiManagerEnvInterface *env,
+                         HttpTemplateCache *template_cache, bool parallel) {
+  ParseHttpTemplates(template_cache);
+  PathMatcherBuilder<MethodInfo *> pmb(template_cache);
+  // Load apis before http rules to store API versions
+  if (!LoadRpcMethods(env, &pmb)) {
+    return false;
   }
-  if (!config->LoadQuotaRule(env)) {
-    return nullptr;
+  if (!LoadHttpMethods(env, &pmb)) {
+    return false;
   }
-  return config;
+  path_matcher_ = pmb.Build();
+
+  // Once all methods are created, each of these loaders only reads
+  // method_map_ and writes its own fields of MethodInfoImpl, so they can run
+  // in parallel.
+  std::vector<std::function<bool(ApiManagerEnvInterface *)>> loaders = {
+      [this](ApiManagerEnvInterface *env) { return LoadAuthentication(env); },
+      [this](ApiManagerEnvInterface *env) { return LoadUsage(env); },
+      [this](ApiManagerEnvInterface *env) { return LoadSystemParameters(env); },
+      [this](ApiManagerEnvInterface *env) { return LoadBackends(env); },
+      [this](ApiManagerEnvInterface *env) { return LoadQuotaRule(env); },
+  };
+  return parallel ? RunLoadersInParallel(env, loaders)
+                  : RunLoaders(env, loaders);
+}
+
+void Config::LoadLogsMetrics() {
+  service_control::LogsMetricsLoader::Load(service_, &logs_, &metrics_,
+                                           &labels_);
 }
 
 const MethodInfo *Config::GetMethodInfo(const string &http_method,
@@ -499,8 +667,10 @@ MethodCallInfo Config::GetMethodCallInfo(
 
 bool Config::GetJwksUri(const string &issuer, string *url) const {
   std::string iss = utils::GetUrlContent(issuer);
-  auto it = issuer_jwks_uri_map_.find(iss);
-  if (it == issuer_jwks_uri_map_.end()) {
+  std::shared_ptr<const JwksUriMap> map =
+      std::atomic_load(&issuer_jwks_uri_map_);
+  auto it = map->find(iss);
+  if (it == map->end()) {
     // Unknown issuer.
     *url = string();
     return false;
@@ -539,7 +709,12 @@ void Config::SetJwksUri(const string &issuer, const string &jwks_uri,
                         bool openid_valid) {
   std::string iss = utils::GetUrlContent(issuer);
   if (!iss.empty()) {
-    issuer_jwks_uri_map_[iss] = std::make_pair(jwks_uri, openid_valid);
+    std::lock_guard<std::mutex> lock(jwks_uri_mutex_);
+    std::shared_ptr<JwksUriMap> map =
+        std::make_shared<JwksUriMap>(*std::atomic_load(&issuer_jwks_uri_map_));
+    (*map)[iss] = std::make_pair(jwks_uri, openid_valid);
+    std::atomic_store(&issuer_jwks_uri_map_,
+                      std::shared_ptr<const JwksUriMap>(map));
   }
 }
 
@@ -17,6 +17,7 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 
@@ -41,6 +42,11 @@ class Config {
   // not server_config.
   static std::unique_ptr<Config> Create(ApiManagerEnvInterface *env,
                                         const std::string &service_config);
+  // Same as above, but http templates are parsed through template_cache,
+  // which can be shared by multiple config versions of the service.
+  static std::unique_ptr<Config> Create(ApiManagerEnvInterface *env,
+                                        const std::string &service_config,
+                                        HttpTemplateCache *template_cache);
   // For unit test only
   static std::unique_ptr<Config> Create(ApiManagerEnvInterface *env,
                                         const std::string &service_config,
@@ -85,20 +91,42 @@ class Config {
   bool GetJwksUri(const std::string &issuer, std::string *tryOpenId) const;
 
   // Set jwskUri and openIdValid for a given issuer.
+  // GetJwksUri() and SetJwksUri() are thread safe.
   void SetJwksUri(const std::string &issuer, const std::string &jwks_uri,
                   bool openid_valid);
 
   // Get the Firebase server from Server config
   std::string GetFirebaseServer();
 
+  // The logs, metrics and labels of the service which service control
+  // reports, loaded together with the methods.
+  const std::set<std::string> &logs() const { return logs_; }
+  const std::set<std::string> &metrics() const { return metrics_; }
+  const std::set<std::string> &labels() const { return labels_; }
+
  private:
   GOOGLE_DISALLOW_EVIL_CONSTRUCTORS(Config);
 
   Config();
 
   // Loads the service config into protobuf.
-  bool LoadService(ApiManagerEnvInterface *env,
-                   const std::string &service_config);
+  bool LoadService(ApiManagerEnvInterface *env, const char *data, size_t size);
+
+  // Loads everything derived from the loaded service config. Large services
+  // are loaded with multiple threads.
+  bool LoadAll(ApiManagerEnvInterface *env, HttpTemplateCache *template_cache);
+
+  // Creates all methods, registers them to PathMatcher, then loads their
+  // per-method rules, in parallel if parallel is true.
+  bool LoadMethods(ApiManagerEnvInterface *env,
+                   HttpTemplateCache *template_cache, bool parallel);
+
+  // Loads the logs, metrics and labels for service control.
+  void LoadLogsMetrics();
+
+  // Parses all http templates of the service into template_cache, spread
+  // across worker threads for large services.
+  void ParseHttpTemplates(HttpTemplateCache *template_cache);
 
   // Create MethodInfo for HTTP methods, register them to PathMatcher.
   bool LoadHttpMethods(ApiManagerEnvInterface *env,
@@ -141,7 +169,16 @@ class Config {
   // openIdValid means whether or not we need to try openId discovery to fetch
   // jwksUri for the issuer. It is set to true if jwksUri is not provided in
   // service config and we have not tried openId discovery to fetch jwksUri.
-  std::map<std::string, std::pair<std::string, bool>> issuer_jwks_uri_map_;
+  typedef std::map<std::string, std::pair<std::string, bool>> JwksUriMap;
+  // The current snapshot of the map. SetJwksUri() swaps in an updated copy
+  // with the atomic shared_ptr operations, so readers never take a lock.
+  std::shared_ptr<const JwksUriMap> issuer_jwks_uri_map_;
+  // Serializes the updates of issuer_jwks_uri_map_.
+  std::mutex jwks_uri_mutex_;
+  // Logs, metrics and labels for service control.
+  std::set<std::string> logs_;
+  std::set<std::string> metrics_;
+  std::set<std::string> labels_;
 };
 
 }  // namespace api_manager
@@ -57,6 +57,73 @@ TEST(Config, CreateFromBinaryProto) {
   ASSERT_FALSE(method->allow_unregistered_calls());
 }
 
+TEST(Config, LoadLargeServiceInParallel) {
+  // Large enough to load the per-method rules with multiple threads.
+  const int kMethods = 1000;
+  ::google::api::Service service;
+  service.set_name("service-name");
+  ::google::api::AuthProvider *provider =
+      service.mutable_authentication()->add_providers();
+  provider->set_id("provider");
+  provider->set_issuer("issuer@gserviceaccount.com");
+  provider->set_jwks_uri("https://www.googleapis.com/jwks");
+  for (int i = 0; i < kMethods; ++i) {
+    std::string selector = "Method" + std::to_string(i);
+    ::google::api::HttpRule *rule = service.mutable_http()->add_rules();
+    rule->set_selector(selector);
+    rule->set_get("/shelves/" + std::to_string(i) + "/{shelf}");
+
+    ::google::api::AuthenticationRule *auth_rule =
+        service.mutable_authentication()->add_rules();
+    auth_rule->set_selector(selector);
+    auth_rule->add_requirements()->set_provider_id("provider");
+
+    ::google::api::UsageRule *usage_rule = service.mutable_usage()->add_rules();
+    usage_rule->set_selector(selector);
+    usage_rule->set_allow_unregistered_calls(i % 2 == 0);
+
+    ::google::api::SystemParameterRule *param_rule =
+        service.mutable_system_parameters()->add_rules();
+    param_rule->set_selector(selector);
+    ::google::api::SystemParameter *param = param_rule->add_parameters();
+    param->set_name("api_key");
+    param->set_url_query_parameter("key" + std::to_string(i));
+
+    ::google::api::BackendRule *backend_rule =
+        service.mutable_backend()->add_rules();
+    backend_rule->set_selector(selector);
+    backend_rule->set_address("backend" + std::to_string(i));
+  }
+  // A mismatched usage rule, to check that errors are still logged.
+  service.mutable_usage()->add_rules()->set_selector("Unknown");
+
+  ::testing::NiceMock<MockApiManagerEnvironment> env;
+  EXPECT_CALL(env, Log(::testing::_, ::testing::_))
+      .Times(::testing::AnyNumber());
+  EXPECT_CALL(env, Log(ApiManagerEnvInterface::ERROR,
+                       ::testing::StrEq("Not HTTP rule defined for: Unknown")))
+      .Times(1);
+  std::unique_ptr<Config> config =
+      Config::Create(&env, service.SerializeAsString(), "");
+  ASSERT_NE(nullptr, config.get());
+
+  for (int i = 0; i < kMethods; ++i) {
+    const MethodInfo *method =
+        config->GetMethodInfo("GET", "/shelves/" + std::to_string(i) + "/a");
+    ASSERT_NE(nullptr, method);
+    ASSERT_EQ("Method" + std::to_string(i), method->selector());
+    ASSERT_TRUE(method->auth());
+    ASSERT_TRUE(method->isIssuerAllowed("issuer@gserviceaccount.com"));
+    ASSERT_EQ(i % 2 == 0, method->allow_unregistered_calls());
+    ASSERT_EQ(std::vector<std::string>({"key" + std::to_string(i)}),
+              *method->api_key_url_query_parameters());
+    ASSERT_EQ("backend" + std::to_string(i), method->backend_address());
+  }
+  std::string url;
+  ASSERT_FALSE(config->GetJwksUri("issuer@gserviceaccount.com", &url));
+  ASSERT_EQ("https://www.googleapis.com/jwks", url);
+}
+
 static const char kServerConfig[] = R"(
 service_control_config {
   check_aggregator_config {
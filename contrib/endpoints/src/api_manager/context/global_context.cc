@@ -15,6 +15,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 //
 #include "contrib/endpoints/src/api_manager/context/global_context.h"
+
+#include <algorithm>
+
 #include "contrib/endpoints/src/api_manager/config.h"
 #include "contrib/endpoints/src/api_manager/service_control/aggregated.h"
 
@@ -54,6 +57,18 @@ GlobalContext::GlobalContext(std::unique_ptr<ApiManagerEnvInterface> env,
 
   cloud_trace_aggregator_ = CreateCloudTraceAggregator();
 
+  int verification_threads = 0;
+  if (server_config_ && server_config_->has_api_authentication_config()) {
+    verification_threads =
+        server_config_->api_authentication_config().verification_threads();
+  }
+  ApiManagerEnvInterface* env_ptr = env_.get();
+  signature_verifier_.reset(new auth::SignatureVerifier(
+      std::max(verification_threads, 0),
+      [env_ptr](std::function<void()> callback) {
+        return env_ptr->PostCallback(callback);
+      }));
+
   if (server_config_) {
     if (server_config_->has_metadata_server_config() &&
         server_config_->metadata_server_config().enabled()) {
@@ -62,6 +77,10 @@ GlobalContext::GlobalContext(std::unique_ptr<ApiManagerEnvInterface> env,
 
     service_name_ = server_config_->service_name();
 
+    if (server_config_->auth_token_renew_before_sec() > 0) {
+      service_account_token_.set_renew_before(
+          server_config_->auth_token_renew_before_sec());
+    }
     service_account_token_.SetClientAuthSecret(
         server_config_->google_authentication_secret());
 
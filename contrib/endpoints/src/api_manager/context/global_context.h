@@ -15,11 +15,15 @@
 #ifndef API_MANAGER_CONTEXT_GLOBAL_CONTEXT_H_
 #define API_MANAGER_CONTEXT_GLOBAL_CONTEXT_H_
 
+#include "contrib/endpoints/src/api_manager/auth/auth_stats.h"
 #include "contrib/endpoints/src/api_manager/auth/certs.h"
 #include "contrib/endpoints/src/api_manager/auth/jwt_cache.h"
+#include "contrib/endpoints/src/api_manager/auth/negative_jwt_cache.h"
 #include "contrib/endpoints/src/api_manager/auth/service_account_token.h"
+#include "contrib/endpoints/src/api_manager/auth/signature_verifier.h"
 #include "contrib/endpoints/src/api_manager/cloud_trace/cloud_trace.h"
 #include "contrib/endpoints/src/api_manager/gce_metadata.h"
+#include "contrib/endpoints/src/api_manager/http_template_cache.h"
 #include "contrib/endpoints/src/api_manager/proto/server_config.pb.h"
 
 namespace google {
@@ -32,8 +36,10 @@ namespace context {
 // * server_config
 // * service_account_token
 // * certs and jwt_cache
+// * JWT signature verifier
 // * metadata server and fetched data.
 // * cloud trace object.
+// * parsed http templates shared by all config versions.
 class GlobalContext {
  public:
   GlobalContext(std::unique_ptr<ApiManagerEnvInterface> env,
@@ -49,6 +55,11 @@ class GlobalContext {
 
   const std::string &metadata_server() const { return metadata_server_; }
 
+  // The JWT signature verifier shared by all services.
+  auth::SignatureVerifier *signature_verifier() {
+    return signature_verifier_.get();
+  }
+
   // fetched metadata.
   GceMetadata *gce_metadata() { return &gce_metadata_; }
 
@@ -83,6 +94,9 @@ class GlobalContext {
   const std::string &service_name() const { return service_name_; }
   void set_service_name(const std::string &name) { service_name_ = name; }
 
+  // The http template parse cache shared by all loaded service configs.
+  HttpTemplateCache *http_template_cache() { return &http_template_cache_; }
+
  private:
   // create cloud trace.
   std::unique_ptr<cloud_trace::Aggregator> CreateCloudTraceAggregator();
@@ -94,6 +108,9 @@ class GlobalContext {
   // service account tokens
   auth::ServiceAccountToken service_account_token_;
 
+  // The JWT signature verifier.
+  std::unique_ptr<auth::SignatureVerifier> signature_verifier_;
+
   // The service control object. When trace is force disabled, this will be a
   // nullptr.
   std::unique_ptr<cloud_trace::Aggregator> cloud_trace_aggregator_;
@@ -110,6 +127,9 @@ class GlobalContext {
 
   // The time interval for grpc intermediate report.
   int64_t intermediate_report_interval_;
+
+  // Parsed http templates, shared across the loaded config versions.
+  HttpTemplateCache http_template_cache_;
 };
 
 }  // namespace context
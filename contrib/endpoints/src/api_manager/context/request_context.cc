@@ -49,11 +49,6 @@ const char kUnrecognizedOperation[] = "<Unknown Operation Name>";
 // Maximum 36 byte string for UUID
 const int kMaxUUIDBufSize = 40;
 
-// Default api key names
-const char kDefaultApiKeyQueryName1[] = "key";
-const char kDefaultApiKeyQueryName2[] = "api_key";
-const char kDefaultApiKeyHeaderName[] = "x-api-key";
-
 // Header for android package name, used for api key restriction check.
 const char kXAndroidPackage[] = "x-android-package";
 
@@ -144,34 +139,16 @@ std::string RequestContext::GetRequestHTTPMethodWithOverride() {
 }
 
 void RequestContext::ExtractApiKey() {
-  bool api_key_defined = false;
-  auto url_queries = method()->api_key_url_query_parameters();
-  if (url_queries) {
-    api_key_defined = true;
-    for (const auto &url_query : *url_queries) {
-      if (request_->FindQuery(url_query, &api_key_)) {
-        return;
-      }
+  // The method falls back to the default places if api_key is not
+  // configured, so no std::string is built per request.
+  for (const auto &url_query : method()->api_key_lookup_queries()) {
+    if (request_->FindQuery(url_query, &api_key_)) {
+      return;
     }
   }
-
-  auto headers = method()->api_key_http_headers();
-  if (headers) {
-    api_key_defined = true;
-    for (const auto &header : *headers) {
-      if (request_->FindHeader(header, &api_key_)) {
-        return;
-      }
-    }
-  }
-
-  if (!api_key_defined) {
-    // If api_key is not specified for a method,
-    // check "key" first, if not, check "api_key" in query parameter.
-    if (!request_->FindQuery(kDefaultApiKeyQueryName1, &api_key_)) {
-      if (!request_->FindQuery(kDefaultApiKeyQueryName2, &api_key_)) {
-        request_->FindHeader(kDefaultApiKeyHeaderName, &api_key_);
-      }
+  for (const auto &header : method()->api_key_lookup_headers()) {
+    if (request_->FindHeader(header, &api_key_)) {
+      return;
     }
   }
 }
@@ -40,6 +40,11 @@ class RequestContext {
   context::ServiceContext *service_context() const {
     return service_context_.get();
   }
+  // Get the shared ServiceContext, for callbacks which must keep it alive.
+  const std::shared_ptr<context::ServiceContext> &shared_service_context()
+      const {
+    return service_context_;
+  }
 
   // Get the request object.
   Request *request() const { return request_.get(); }
@@ -31,6 +31,8 @@ ServiceContext::ServiceContext(std::shared_ptr<GlobalContext> global_context,
                                std::unique_ptr<Config> config)
     : global_context_(global_context),
       config_(std::move(config)),
+      jwt_cache_(GetJwtCacheOptions()),
+      negative_jwt_cache_(GetNegativeJwtCacheOptions()),
       service_control_(CreateInterface()) {
   config_->set_server_config(global_context_->server_config());
 }
@@ -71,7 +73,53 @@ std::unique_ptr<service_control::Interface> ServiceContext::CreateInterface() {
   return std::unique_ptr<service_control::Interface>(
       service_control::Aggregated::Create(
           config_->service(), global_context_->server_config().get(), env(),
-          global_context_->service_account_token()));
+          global_context_->service_account_token(), config_->logs(),
+          config_->metrics(), config_->labels()));
+}
+
+auth::JwtCache::Options ServiceContext::GetJwtCacheOptions() const {
+  auth::JwtCache::Options options;
+  auto server_config = global_context_->server_config();
+  if (server_config && server_config->has_api_authentication_config()) {
+    const auto& auth_config = server_config->api_authentication_config();
+    if (auth_config.jwt_cache_size() > 0) {
+      options.max_size = auth_config.jwt_cache_size();
+    }
+    if (auth_config.jwt_cache_timeout_sec() > 0) {
+      options.timeout =
+          std::chrono::seconds(auth_config.jwt_cache_timeout_sec());
+    }
+    if (auth_config.jwt_cache_shards() > 0) {
+      options.num_shards = auth_config.jwt_cache_shards();
+    }
+  }
+  return options;
+}
+
+auth::NegativeJwtCache::Options ServiceContext::GetNegativeJwtCacheOptions()
+    const {
+  auth::NegativeJwtCache::Options options;
+  auto server_config = global_context_->server_config();
+  if (server_config && server_config->has_api_authentication_config()) {
+    const auto& auth_config = server_config->api_authentication_config();
+    if (auth_config.negative_jwt_cache_size() > 0) {
+      options.max_size = auth_config.negative_jwt_cache_size();
+    }
+    if (auth_config.negative_jwt_cache_ttl_sec() > 0) {
+      options.ttl =
+          std::chrono::seconds(auth_config.negative_jwt_cache_ttl_sec());
+    }
+    if (auth_config.jwt_cache_shards() > 0) {
+      options.num_shards = auth_config.jwt_cache_shards();
+    }
+  }
+  return options;
+}
+
+void ServiceContext::GetAuthStatistics(AuthStatistics* stat) const {
+  auth_stats_.GetStatistics(stat);
+  stat->negative_jwt_cache_hits = negative_jwt_cache_.hits();
+  stat->negative_jwt_cache_misses = negative_jwt_cache_.misses();
 }
 
 }  // namespace context
@@ -67,8 +67,15 @@ class ServiceContext {
            !config_->GetFirebaseServer().empty();
   }
 
+  // The auth state below is thread safe, so requests on different threads
+  // can share one ServiceContext.
   auth::Certs &certs() { return certs_; }
   auth::JwtCache &jwt_cache() { return jwt_cache_; }
+  auth::NegativeJwtCache &negative_jwt_cache() { return negative_jwt_cache_; }
+  auth::AuthStats &auth_stats() { return auth_stats_; }
+  auth::SignatureVerifier *signature_verifier() {
+    return global_context_->signature_verifier();
+  }
 
   bool GetJwksUri(const std::string &issuer, std::string *url) {
     return config_->GetJwksUri(issuer, url);
@@ -94,10 +101,19 @@ class ServiceContext {
 
   std::shared_ptr<GlobalContext> global_context() { return global_context_; }
 
+  // Get the statistics of API authentication.
+  void GetAuthStatistics(AuthStatistics *stat) const;
+
  private:
   // Create service control.
   std::unique_ptr<service_control::Interface> CreateInterface();
 
+  // Get the JWT cache options from the server config.
+  auth::JwtCache::Options GetJwtCacheOptions() const;
+
+  // Get the negative JWT cache options from the server config.
+  auth::NegativeJwtCache::Options GetNegativeJwtCacheOptions() const;
+
   // The shared global context object.
   std::shared_ptr<GlobalContext> global_context_;
   // The service config object.
@@ -105,6 +121,8 @@ class ServiceContext {
 
   auth::Certs certs_;
   auth::JwtCache jwt_cache_;
+  auth::NegativeJwtCache negative_jwt_cache_;
+  auth::AuthStats auth_stats_;
 
   // The service control object.
   std::unique_ptr<service_control::Interface> service_control_;
@@ -0,0 +1,204 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/fetch_pub_key.h"
+
+#include <map>
+#include <vector>
+
+#include "contrib/endpoints/include/api_manager/http_request.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/json.h"
+#include "contrib/endpoints/src/api_manager/auth/lib/json_util.h"
+
+using ::google::api_manager::auth::GetStringValue;
+using ::google::api_manager::utils::Status;
+using ::google::protobuf::util::error::Code;
+using std::chrono::system_clock;
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+// The lifetime of a public key cache entry. Unit: seconds.
+const int kPubKeyCacheDuration = 300;
+// Keys expiring within this window are refreshed in the background.
+// Unit: seconds.
+const int kPubKeyRefreshWindow = 60;
+// How long expired keys may still be used while a refresh is in flight or
+// failing. Unit: seconds.
+const int kPubKeyMaxStaleness = 3600;
+
+// Sends a http GET request.
+void HttpFetch(ApiManagerEnvInterface *env, const std::string &url,
+               std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+               std::function<void(Status, std::string &&)> continuation) {
+  std::shared_ptr<cloud_trace::CloudTraceSpan> fetch_span(
+      CreateChildSpan(trace_span.get(), "HttpFetch"));
+  env->LogDebug(std::string("http fetch: ") + url);
+  TRACE(fetch_span) << "Http request URL: " << url;
+
+  std::unique_ptr<HTTPRequest> request(
+      new HTTPRequest([continuation, fetch_span](
+          Status status, std::map<std::string, std::string> &&,
+          std::string &&body) {
+        TRACE(fetch_span) << "Http response status: " << status.ToString();
+        continuation(status, std::move(body));
+      }));
+  if (!request) {
+    continuation(Status(Code::INTERNAL, "Out of memory"), "");
+    return;
+  }
+
+  request->set_method("GET").set_url(url);
+  env->RunHTTPRequest(std::move(request));
+}
+
+// Builds the status of a failed fetch, appending the upstream HTTP response
+// code if there is one.
+Status FetchFailure(const std::string &error, Status status) {
+  return Status(Code::UNAUTHENTICATED,
+                error + (status.code() >= 300
+                             ? ". HTTP response code: " +
+                                   std::to_string(status.code())
+                             : ""),
+                Status::AUTH);
+}
+
+// Completes the fetch of the keys of an issuer and counts it.
+void FinishFetch(const std::shared_ptr<context::ServiceContext> &context,
+                 const std::string &issuer, const Status &status) {
+  context->auth_stats().CountKeyFetch(status.ok());
+  context->certs().FinishFetch(issuer, status);
+}
+
+void FetchKeys(const std::shared_ptr<context::ServiceContext> &context,
+               const std::string &issuer, const std::string &url,
+               std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span) {
+  HttpFetch(context->env(), url, trace_span,
+            [context, issuer](Status status, std::string &&body) {
+              auth::Certs &key_cache = context->certs();
+              if (!status.ok() || body.empty()) {
+                FinishFetch(
+                    context, issuer,
+                    FetchFailure("Unable to fetch verification key", status));
+                return;
+              }
+
+              key_cache.Update(issuer, body,
+                               system_clock::now() +
+                                   std::chrono::seconds(kPubKeyCacheDuration));
+              FinishFetch(context, issuer, Status::OK);
+            });
+}
+
+void DiscoverJwksUri(const std::shared_ptr<context::ServiceContext> &context,
+                     const std::string &issuer, const std::string &url,
+                     std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span) {
+  HttpFetch(context->env(), url, trace_span, [context, issuer, trace_span](
+                                                 Status status,
+                                                 std::string &&body) {
+    if (!status.ok()) {
+      context->SetJwksUri(issuer, std::string(), false);
+      FinishFetch(
+          context, issuer,
+          FetchFailure("Unable to fetch URI of the key via OpenID discovery",
+                       status));
+      return;
+    }
+
+    // Parse discovery doc and extract jwks_uri
+    grpc_json *discovery_json = grpc_json_parse_string_with_len(
+        const_cast<char *>(body.c_str()), body.size());
+    const char *jwks_uri;
+    if (discovery_json != nullptr) {
+      jwks_uri = GetStringValue(discovery_json, "jwks_uri");
+      grpc_json_destroy(discovery_json);
+    } else {
+      jwks_uri = nullptr;
+    }
+
+    if (jwks_uri == nullptr) {
+      context->env()->LogError(
+          "OpenID discovery failed due to invalid doc format");
+      context->SetJwksUri(issuer, std::string(), false);
+      FinishFetch(
+          context, issuer,
+          Status(Code::UNAUTHENTICATED,
+                 "Unable to parse URI of the key via OpenID discovery",
+                 Status::AUTH));
+      return;
+    }
+
+    // OpenID discovery completed. Set jwks_uri for the issuer in cache.
+    context->SetJwksUri(issuer, jwks_uri, false);
+
+    FetchKeys(context, issuer, jwks_uri, trace_span);
+  });
+}
+
+}  // namespace
+
+void FetchPubKey(std::shared_ptr<context::ServiceContext> context,
+                 const std::string &issuer,
+                 std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+                 std::function<void(Status)> continuation) {
+  if (!context->certs().StartFetch(issuer, continuation)) {
+    TRACE(trace_span) << "Waiting for the key fetch in flight.";
+    return;
+  }
+
+  std::string url;
+  bool tryOpenId = context->GetJwksUri(issuer, &url);
+  if (url.empty()) {
+    FinishFetch(context, issuer,
+                Status(Code::UNAUTHENTICATED,
+                       "Cannot determine the URI of the key", Status::AUTH));
+    return;
+  }
+
+  if (tryOpenId) {
+    DiscoverJwksUri(context, issuer, url, trace_span);
+  } else {
+    // JwksUri is available. No need to try openID discovery.
+    FetchKeys(context, issuer, url, trace_span);
+  }
+}
+
+void RefreshPubKeys(std::shared_ptr<context::ServiceContext> context) {
+  std::vector<std::string> issuers = context->certs().GetIssuersToRefresh(
+      system_clock::now(), std::chrono::seconds(kPubKeyRefreshWindow),
+      std::chrono::seconds(kPubKeyMaxStaleness));
+  for (const auto &issuer : issuers) {
+    context->env()->LogDebug("Refreshing verification keys of " + issuer);
+    FetchPubKey(context, issuer, nullptr,
+                [context, issuer](Status status) {
+                  if (!status.ok()) {
+                    context->env()->LogWarning(
+                        "Failed to refresh verification keys of " + issuer +
+                        ": " + status.message());
+                  }
+                });
+  }
+}
+
+bool CanUseStalePubKey(system_clock::time_point expiration,
+                       system_clock::time_point now) {
+  return now <= expiration + std::chrono::seconds(kPubKeyMaxStaleness);
+}
+
+}  // namespace api_manager
+}  // namespace google
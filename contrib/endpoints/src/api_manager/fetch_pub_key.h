@@ -0,0 +1,55 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_FETCH_PUB_KEY_H_
+#define API_MANAGER_FETCH_PUB_KEY_H_
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "contrib/endpoints/include/api_manager/utils/status.h"
+#include "contrib/endpoints/src/api_manager/cloud_trace/cloud_trace.h"
+#include "contrib/endpoints/src/api_manager/context/service_context.h"
+
+namespace google {
+namespace api_manager {
+
+// The interval at which RefreshPubKeys() should be called.
+const std::chrono::milliseconds kPubKeyRefreshInterval(30000);
+
+// Fetches the verification keys of the issuer into the key cache of the
+// service context, running OpenID discovery first if the URI of the keys is
+// not known. Fetches for the same issuer are coalesced: while one is in
+// flight, later callers only wait for its result. The fetch keeps the service
+// context alive until it completes. The trace span may be null.
+void FetchPubKey(std::shared_ptr<context::ServiceContext> context,
+                 const std::string &issuer,
+                 std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+                 std::function<void(utils::Status)> continuation);
+
+// Starts background fetches for the keys that expire soon, so that requests
+// rarely wait for a key fetch. Keys are kept if a refresh fails.
+void RefreshPubKeys(std::shared_ptr<context::ServiceContext> context);
+
+// Returns true if keys which expired at "expiration" may still be used at
+// "now" while they are being refreshed.
+bool CanUseStalePubKey(std::chrono::system_clock::time_point expiration,
+                       std::chrono::system_clock::time_point now);
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_FETCH_PUB_KEY_H_
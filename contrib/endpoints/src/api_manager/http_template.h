@@ -45,6 +45,7 @@ class HttpTemplate {
   };
 
   std::vector<Variable> &Variables() { return variables_; }
+  const std::vector<Variable> &variables() const { return variables_; }
 
   // '/.': match any single path segment.
   static const char kSingleParameterKey[];
@@ -0,0 +1,121 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/http_template_cache.h"
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+// Below this many templates per thread, spawning threads costs more than the
+// parsing itself.
+const size_t kMinTemplatesPerThread = 256;
+
+}  // namespace
+
+std::shared_ptr<const HttpTemplate> HttpTemplateCache::Parse(
+    const std::string &ht) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = templates_.find(ht);
+    if (it != templates_.end()) {
+      return it->second;
+    }
+  }
+
+  // Parse outside of the lock. If another thread parsed the same template in
+  // the meantime, the first inserted result wins.
+  std::shared_ptr<const HttpTemplate> parsed(HttpTemplate::Parse(ht));
+  std::lock_guard<std::mutex> lock(mutex_);
+  return templates_.emplace(ht, std::move(parsed)).first->second;
+}
+
+void HttpTemplateCache::ParseAll(const std::vector<std::string> &templates,
+                                 unsigned int max_threads) {
+  // Collect the distinct templates which are not cached yet.
+  std::vector<const std::string *> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_set<std::string> seen;
+    for (const auto &ht : templates) {
+      if (templates_.find(ht) == templates_.end() &&
+          seen.insert(ht).second) {
+        pending.push_back(&ht);
+      }
+    }
+  }
+  if (pending.empty()) {
+    return;
+  }
+
+  if (max_threads == 0) {
+    max_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  size_t num_threads =
+      std::min<size_t>(max_threads, pending.size() / kMinTemplatesPerThread);
+  if (num_threads <= 1) {
+    for (const auto *ht : pending) {
+      Parse(*ht);
+    }
+    return;
+  }
+
+  // Each worker parses a contiguous slice of pending into its own slot, so
+  // the workers do not contend on the mutex.
+  std::vector<std::shared_ptr<const HttpTemplate>> parsed(pending.size());
+  std::vector<std::thread> workers;
+  size_t chunk = (pending.size() + num_threads - 1) / num_threads;
+  for (size_t begin = 0; begin < pending.size(); begin += chunk) {
+    size_t end = std::min(begin + chunk, pending.size());
+    workers.emplace_back([&pending, &parsed, begin, end]() {
+      for (size_t i = begin; i < end; ++i) {
+        parsed[i].reset(HttpTemplate::Parse(*pending[i]));
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    templates_.emplace(*pending[i], std::move(parsed[i]));
+  }
+}
+
+void HttpTemplateCache::EvictUnused() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = templates_.begin(); it != templates_.end();) {
+    if (it->second == nullptr || it->second.use_count() == 1) {
+      it = templates_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t HttpTemplateCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return templates_.size();
+}
+
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,78 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_HTTP_TEMPLATE_CACHE_H_
+#define API_MANAGER_HTTP_TEMPLATE_CACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "contrib/endpoints/src/api_manager/http_template.h"
+
+namespace google {
+namespace api_manager {
+
+// A thread safe intern cache for parsed HTTP templates.
+//
+// Identical template strings are parsed only once and the resulting
+// HttpTemplate object is shared by every caller. Invalid templates are
+// cached too, so a bad template is not re-parsed for every config version.
+// Templates no longer used by any caller are dropped by EvictUnused(), so
+// the cache only holds the templates of the live config versions.
+//
+// Usage example:
+//     HttpTemplateCache cache;
+//     cache.ParseAll(all_templates);  // optional, parses in parallel
+//     PathMatcherBuilder<MethodInfo *> builder(&cache);
+//     builder.Register(...);          // served from the cache
+class HttpTemplateCache {
+ public:
+  HttpTemplateCache() {}
+
+  // Returns the parsed template for ht, parsing and caching it on first use.
+  // Returns nullptr if ht is not a valid HTTP template.
+  std::shared_ptr<const HttpTemplate> Parse(const std::string &ht);
+
+  // Parses all templates not yet cached. When there are enough of them, the
+  // work is split across up to max_threads worker threads. A max_threads of
+  // 0 uses the number of hardware threads.
+  void ParseAll(const std::vector<std::string> &templates,
+                unsigned int max_threads = 0);
+
+  // Drops the templates which are referenced only by the cache, and the
+  // invalid ones. Called before a new config version is loaded, so that the
+  // cache does not grow with every config rollout.
+  void EvictUnused();
+
+  // Returns the number of distinct template strings in the cache.
+  size_t size() const;
+
+ private:
+  HttpTemplateCache(const HttpTemplateCache &) = delete;
+  HttpTemplateCache &operator=(const HttpTemplateCache &) = delete;
+
+  // Guards templates_.
+  mutable std::mutex mutex_;
+  // Maps a template string to its parsed template, nullptr if invalid.
+  std::unordered_map<std::string, std::shared_ptr<const HttpTemplate>>
+      templates_;
+};
+
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_HTTP_TEMPLATE_CACHE_H_
@@ -0,0 +1,106 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/http_template_cache.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+
+namespace {
+
+typedef std::vector<std::string> Segments;
+
+TEST(HttpTemplateCache, SharesParsedTemplate) {
+  HttpTemplateCache cache;
+  auto ht1 = cache.Parse("/shelves/{shelf}/books/{book}");
+  ASSERT_NE(nullptr, ht1);
+  ASSERT_EQ(Segments({"shelves", "*", "books", "*"}), ht1->segments());
+  ASSERT_EQ(2, ht1->variables().size());
+
+  auto ht2 = cache.Parse("/shelves/{shelf}/books/{book}");
+  ASSERT_EQ(ht1.get(), ht2.get());
+  ASSERT_EQ(1, cache.size());
+
+  auto ht3 = cache.Parse("/shelves/{shelf}");
+  ASSERT_NE(nullptr, ht3);
+  ASSERT_NE(ht1.get(), ht3.get());
+  ASSERT_EQ(2, cache.size());
+}
+
+TEST(HttpTemplateCache, CachesInvalidTemplate) {
+  HttpTemplateCache cache;
+  ASSERT_EQ(nullptr, cache.Parse("/shelves/**/*"));
+  ASSERT_EQ(nullptr, cache.Parse("/shelves/**/*"));
+  ASSERT_EQ(1, cache.size());
+}
+
+TEST(HttpTemplateCache, EvictsUnusedTemplates) {
+  HttpTemplateCache cache;
+  auto used = cache.Parse("/shelves/{shelf}");
+  ASSERT_NE(nullptr, used);
+  ASSERT_NE(nullptr, cache.Parse("/shelves/{shelf}/books/{book}"));
+  ASSERT_EQ(nullptr, cache.Parse("/shelves/**/*"));
+  ASSERT_EQ(3, cache.size());
+
+  cache.EvictUnused();
+  ASSERT_EQ(1, cache.size());
+  ASSERT_EQ(used.get(), cache.Parse("/shelves/{shelf}").get());
+
+  used.reset();
+  cache.EvictUnused();
+  ASSERT_EQ(0, cache.size());
+}
+
+TEST(HttpTemplateCache, ParseAllSingleThread) {
+  HttpTemplateCache cache;
+  cache.ParseAll({"/a/{b}", "/a/{b}", "/c:verb", "invalid"});
+  ASSERT_EQ(3, cache.size());
+
+  auto ht = cache.Parse("/c:verb");
+  ASSERT_NE(nullptr, ht);
+  ASSERT_EQ("verb", ht->verb());
+  ASSERT_EQ(nullptr, cache.Parse("invalid"));
+  ASSERT_EQ(3, cache.size());
+}
+
+TEST(HttpTemplateCache, ParseAllMultipleThreads) {
+  std::vector<std::string> templates;
+  for (int i = 0; i < 4096; ++i) {
+    templates.push_back("/v1/shelves/{shelf}/books/" + std::to_string(i) +
+                        "/{name=**}:get");
+  }
+  HttpTemplateCache cache;
+  cache.ParseAll(templates, 4);
+  ASSERT_EQ(templates.size(), cache.size());
+
+  for (const auto &t : templates) {
+    auto ht = cache.Parse(t);
+    ASSERT_NE(nullptr, ht);
+    ASSERT_EQ(6, ht->segments().size());
+    ASSERT_EQ("get", ht->verb());
+    ASSERT_EQ(2, ht->variables().size());
+  }
+  ASSERT_EQ(templates.size(), cache.size());
+}
+
+}  // namespace
+
+}  // namespace api_manager
+}  // namespace google
@@ -17,10 +17,10 @@
 #include "contrib/endpoints/src/api_manager/method_impl.h"
 #include "contrib/endpoints/src/api_manager/utils/url_util.h"
 
+#include <algorithm>
+#include <cctype>
 #include <sstream>
 
-using std::map;
-using std::set;
 using std::string;
 using std::stringstream;
 
@@ -30,6 +30,29 @@ namespace api_manager {
 // The name for api key in system parameter from service config.
 const char api_key_parameter_name[] = "api_key";
 
+// Where the api_key is looked up if it is not configured: the "key" query
+// parameter first, then "api_key", then the "x-api-key" header.
+const char *const kDefaultApiKeyQueryNames[] = {"key", "api_key"};
+const char kDefaultApiKeyHeaderName[] = "x-api-key";
+
+namespace {
+
+// Orders a sorted vector of pairs by key only.
+template <class Pair>
+bool KeyLess(const Pair &pair, const string &key) {
+  return pair.first < key;
+}
+
+// Inserts value into a sorted vector if it is not there yet.
+void InsertSorted(std::vector<string> *values, const string &value) {
+  auto it = std::lower_bound(values->begin(), values->end(), value);
+  if (it == values->end() || *it != value) {
+    values->insert(it, value);
+  }
+}
+
+}  // namespace
+
 MethodInfoImpl::MethodInfoImpl(const string &name, const string &api_name,
                                const string &api_version)
     : name_(name),
@@ -37,8 +60,9 @@ MethodInfoImpl::MethodInfoImpl(const string &name, const string &api_name,
       api_version_(api_version),
       auth_(false),
       allow_unregistered_calls_(false),
-      api_key_http_headers_(nullptr),
-      api_key_url_query_parameters_(nullptr),
+      api_key_lookup_queries_(std::begin(kDefaultApiKeyQueryNames),
+                              std::end(kDefaultApiKeyQueryNames)),
+      api_key_lookup_headers_(1, kDefaultApiKeyHeaderName),
       request_streaming_(false),
       response_streaming_(false) {}
 
@@ -51,7 +75,12 @@ void MethodInfoImpl::addAudiencesForIssuer(const string &issuer,
   if (iss.empty()) {
     return;
   }
-  set<string> &audiences = issuer_audiences_map_[iss];
+  auto it = std::lower_bound(issuer_audiences_.begin(), issuer_audiences_.end(),
+                             iss, KeyLess<IssuerAudiences>);
+  if (it == issuer_audiences_.end() || it->first != iss) {
+    it = issuer_audiences_.insert(it, IssuerAudiences(iss, {}));
+  }
+  std::vector<string> &audiences = it->second;
   stringstream ss(audiences_list);
   string audience;
   // Audience list is comma-delimited.
@@ -59,47 +88,110 @@ void MethodInfoImpl::addAudiencesForIssuer(const string &issuer,
     if (!audience.empty()) {  // Only adds non-empty audience.
       std::string aud = utils::GetUrlContent(audience);
       if (!aud.empty()) {
-        audiences.insert(aud);
+        InsertSorted(&audiences, aud);
       }
     }
   }
 }
 
 bool MethodInfoImpl::isIssuerAllowed(const std::string &issuer) const {
-  return !issuer.empty() &&
-         issuer_audiences_map_.find(issuer) != issuer_audiences_map_.end();
+  if (issuer.empty()) {
+    return false;
+  }
+  auto it = std::lower_bound(issuer_audiences_.begin(), issuer_audiences_.end(),
+                             issuer, KeyLess<IssuerAudiences>);
+  return it != issuer_audiences_.end() && it->first == issuer;
 }
 
 bool MethodInfoImpl::isAudienceAllowed(
     const string &issuer, const std::set<string> &jwt_audiences) const {
-  if (issuer.empty() || jwt_audiences.empty() || !isIssuerAllowed(issuer)) {
+  if (issuer.empty() || jwt_audiences.empty()) {
+    return false;
+  }
+  auto it = std::lower_bound(issuer_audiences_.begin(), issuer_audiences_.end(),
+                             issuer, KeyLess<IssuerAudiences>);
+  if (it == issuer_audiences_.end() || it->first != issuer) {
     return false;
   }
-  const set<string> &audiences = issuer_audiences_map_.at(issuer);
-  for (const auto &it : jwt_audiences) {
-    if (audiences.find(it) != audiences.end()) {
+  const std::vector<string> &audiences = it->second;
+  for (const auto &aud : jwt_audiences) {
+    if (std::binary_search(audiences.begin(), audiences.end(), aud)) {
       return true;
     }
   }
   return false;
 }
 
+const std::vector<string> *MethodInfoImpl::FindParameter(
+    const ParameterMap &parameters, const string &name) {
+  auto it = std::lower_bound(parameters.begin(), parameters.end(), name,
+                             KeyLess<ParameterMap::value_type>);
+  if (it == parameters.end() || it->first != name) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void MethodInfoImpl::AddParameter(ParameterMap *parameters, const string &name,
+                                  const string &value) {
+  auto it = std::lower_bound(parameters->begin(), parameters->end(), name,
+                             KeyLess<ParameterMap::value_type>);
+  if (it == parameters->end() || it->first != name) {
+    it = parameters->insert(it, ParameterMap::value_type(name, {}));
+  }
+  it->second.push_back(value);
+}
+
 void MethodInfoImpl::process_system_parameters() {
-  api_key_http_headers_ = http_header_parameters(api_key_parameter_name);
-  api_key_url_query_parameters_ = url_query_parameters(api_key_parameter_name);
+  // Copy the api_key lookups out of the parameter maps so the per request
+  // ExtractApiKey() does not search them, and lowercase the header names
+  // once here instead of on every header lookup.
+  const std::vector<string> *headers =
+      http_header_parameters(api_key_parameter_name);
+  if (headers) {
+    api_key_http_headers_.reset(new std::vector<string>(*headers));
+    for (auto &header : *api_key_http_headers_) {
+      std::transform(header.begin(), header.end(), header.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+    }
+  } else {
+    api_key_http_headers_.reset();
+  }
+
+  const std::vector<string> *url_queries =
+      url_query_parameters(api_key_parameter_name);
+  if (url_queries) {
+    api_key_url_query_parameters_.reset(new std::vector<string>(*url_queries));
+  } else {
+    api_key_url_query_parameters_.reset();
+  }
+
+  if (api_key_http_headers_ || api_key_url_query_parameters_) {
+    api_key_lookup_queries_.clear();
+    if (api_key_url_query_parameters_) {
+      api_key_lookup_queries_ = *api_key_url_query_parameters_;
+    }
+    api_key_lookup_headers_.clear();
+    if (api_key_http_headers_) {
+      api_key_lookup_headers_ = *api_key_http_headers_;
+    }
+  } else {
+    api_key_lookup_queries_.assign(std::begin(kDefaultApiKeyQueryNames),
+                                   std::end(kDefaultApiKeyQueryNames));
+    api_key_lookup_headers_.assign(1, kDefaultApiKeyHeaderName);
+  }
 }
 
 void MethodInfoImpl::ProcessSystemQueryParameterNames() {
   for (const auto &param : url_query_parameters_) {
     for (const auto &name : param.second) {
-      system_query_parameter_names_.insert(name);
+      InsertSorted(&system_query_parameter_names_, name);
     }
   }
 
-  if (!api_key_http_headers_ && !api_key_url_query_parameters_) {
-    // Adding the default api_key url query parameters
-    system_query_parameter_names_.insert("key");
-    system_query_parameter_names_.insert("api_key");
+  // Adds the api_key url query parameters, the default ones included.
+  for (const auto &name : api_key_lookup_queries_) {
+    InsertSorted(&system_query_parameter_names_, name);
   }
 }
 
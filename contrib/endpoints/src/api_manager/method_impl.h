@@ -15,13 +15,13 @@
 #ifndef API_MANAGER_METHOD_IMPL_H_
 #define API_MANAGER_METHOD_IMPL_H_
 
-#include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "contrib/endpoints/include/api_manager/method.h"
-#include "contrib/endpoints/src/api_manager/utils/stl_util.h"
 
 namespace google {
 namespace api_manager {
@@ -46,19 +46,27 @@ class MethodInfoImpl : public MethodInfo {
 
   const std::vector<std::string> *http_header_parameters(
       const std::string &name) const {
-    return utils::FindOrNull(http_header_parameters_, name);
+    return FindParameter(http_header_parameters_, name);
   }
   const std::vector<std::string> *url_query_parameters(
       const std::string &name) const {
-    return utils::FindOrNull(url_query_parameters_, name);
+    return FindParameter(url_query_parameters_, name);
   }
 
+  // The api_key header names are lowercased once at config load.
   const std::vector<std::string> *api_key_http_headers() const {
-    return api_key_http_headers_;
+    return api_key_http_headers_.get();
   }
 
   const std::vector<std::string> *api_key_url_query_parameters() const {
-    return api_key_url_query_parameters_;
+    return api_key_url_query_parameters_.get();
+  }
+
+  const std::vector<std::string> &api_key_lookup_queries() const {
+    return api_key_lookup_queries_;
+  }
+  const std::vector<std::string> &api_key_lookup_headers() const {
+    return api_key_lookup_headers_;
   }
 
   const std::string &backend_address() const { return backend_address_; }
@@ -88,11 +96,11 @@ class MethodInfoImpl : public MethodInfo {
 
   void add_http_header_parameter(const std::string &name,
                                  const std::string &http_header) {
-    http_header_parameters_[name].push_back(http_header);
+    AddParameter(&http_header_parameters_, name, http_header);
   }
   void add_url_query_parameter(const std::string &name,
                                const std::string &url_query_parameter) {
-    url_query_parameters_[name].push_back(url_query_parameter);
+    AddParameter(&url_query_parameters_, name, url_query_parameter);
   }
 
   void add_metric_cost(const std::string &metric, int64_t cost) {
@@ -129,13 +137,28 @@ class MethodInfoImpl : public MethodInfo {
     response_streaming_ = response_streaming;
   }
 
-  const std::set<std::string> &system_query_parameter_names() const {
+  const std::vector<std::string> &system_query_parameter_names() const {
     return system_query_parameter_names_;
   }
 
   void ProcessSystemQueryParameterNames();
 
  private:
+  // A flat map of system parameter name to its http_header or url query
+  // parameter names, sorted by parameter name. A method only has a handful
+  // of system parameters, so a binary search over contiguous storage is
+  // cheaper than walking a std::map.
+  typedef std::vector<std::pair<std::string, std::vector<std::string>>>
+      ParameterMap;
+
+  // Allowed audiences of an issuer, sorted by audience.
+  typedef std::pair<std::string, std::vector<std::string>> IssuerAudiences;
+
+  static const std::vector<std::string> *FindParameter(
+      const ParameterMap &parameters, const std::string &name);
+  static void AddParameter(ParameterMap *parameters, const std::string &name,
+                           const std::string &value);
+
   // Method name
   std::string name_;
   // API name
@@ -147,22 +170,28 @@ class MethodInfoImpl : public MethodInfo {
   // Does the method allow unregistered callers (callers without client identity
   // such as API Key)?
   bool allow_unregistered_calls_;
-  // Issuers to allowed audiences map.
-  std::map<std::string, std::set<std::string>> issuer_audiences_map_;
+  // Issuers to allowed audiences, sorted by issuer.
+  std::vector<IssuerAudiences> issuer_audiences_;
 
   // system parameter map of parameter name to http_header name.
-  std::map<std::string, std::vector<std::string>> http_header_parameters_;
+  ParameterMap http_header_parameters_;
 
   // system parameter map of parameter name to url query parameter name.
-  std::map<std::string, std::vector<std::string>> url_query_parameters_;
+  ParameterMap url_query_parameters_;
+
+  // all the names of system query parameters, sorted.
+  std::vector<std::string> system_query_parameter_names_;
 
-  // all the names of system query parameters
-  std::set<std::string> system_query_parameter_names_;
+  // http header for api_key, lowercased. Null if not configured.
+  std::unique_ptr<std::vector<std::string>> api_key_http_headers_;
 
-  // http header for api_key.
-  const std::vector<std::string> *api_key_http_headers_;
+  // url query parameters for api_key. Null if not configured.
+  std::unique_ptr<std::vector<std::string>> api_key_url_query_parameters_;
 
-  const std::vector<std::string> *api_key_url_query_parameters_;
+  // Where ExtractApiKey() looks the api_key up, the configured places or the
+  // default ones, so that it needs no fallback per request.
+  std::vector<std::string> api_key_lookup_queries_;
+  std::vector<std::string> api_key_lookup_headers_;
 
   // The backend address for this method.
   std::string backend_address_;
@@ -113,6 +113,59 @@ TEST(MethodInfo, TestParameters) {
   ASSERT_EQ((*url_queries)[1], "url_query2");
 }
 
+TEST(MethodInfo, ApiKeyParameters) {
+  MethodInfoImplPtr method_info(new MethodInfoImpl(kMethodName, "", ""));
+  method_info->process_system_parameters();
+  ASSERT_EQ(nullptr, method_info->api_key_http_headers());
+  ASSERT_EQ(nullptr, method_info->api_key_url_query_parameters());
+  // Falls back to the default places.
+  ASSERT_EQ(std::vector<std::string>({"key", "api_key"}),
+            method_info->api_key_lookup_queries());
+  ASSERT_EQ(std::vector<std::string>({"x-api-key"}),
+            method_info->api_key_lookup_headers());
+
+  method_info->add_http_header_parameter("api_key", "X-Api-Key");
+  method_info->add_http_header_parameter("name1", "Http-Header1");
+  method_info->add_url_query_parameter("api_key", "apiKey");
+  method_info->process_system_parameters();
+
+  auto headers = method_info->api_key_http_headers();
+  ASSERT_NE(nullptr, headers);
+  ASSERT_EQ(1ul, headers->size());
+  ASSERT_EQ("x-api-key", (*headers)[0]);
+  // The system parameter itself keeps the configured spelling.
+  ASSERT_EQ("X-Api-Key", (*method_info->http_header_parameters("api_key"))[0]);
+
+  auto url_queries = method_info->api_key_url_query_parameters();
+  ASSERT_NE(nullptr, url_queries);
+  ASSERT_EQ(1ul, url_queries->size());
+  ASSERT_EQ("apiKey", (*url_queries)[0]);
+
+  ASSERT_EQ(std::vector<std::string>({"apiKey"}),
+            method_info->api_key_lookup_queries());
+  ASSERT_EQ(std::vector<std::string>({"x-api-key"}),
+            method_info->api_key_lookup_headers());
+}
+
+TEST(MethodInfo, SystemQueryParameterNames) {
+  MethodInfoImplPtr method_info(new MethodInfoImpl(kMethodName, "", ""));
+  method_info->add_url_query_parameter("name1", "url_query2");
+  method_info->add_url_query_parameter("name1", "url_query1");
+  method_info->process_system_parameters();
+  method_info->ProcessSystemQueryParameterNames();
+  // Sorted, with the default api_key url query parameters.
+  ASSERT_EQ(std::vector<std::string>(
+                {"api_key", "key", "url_query1", "url_query2"}),
+            method_info->system_query_parameter_names());
+
+  MethodInfoImplPtr with_api_key(new MethodInfoImpl(kMethodName, "", ""));
+  with_api_key->add_http_header_parameter("api_key", "X-Api-Key");
+  with_api_key->process_system_parameters();
+  with_api_key->ProcessSystemQueryParameterNames();
+  ASSERT_TRUE(with_api_key->api_key_lookup_queries().empty());
+  ASSERT_TRUE(with_api_key->system_query_parameter_names().empty());
+}
+
 TEST(MethodInfo, PreservesBackendAddress) {
   MethodInfoImplPtr method_info(new MethodInfoImpl(kMethodName, "", ""));
   method_info->set_backend_address("backend");
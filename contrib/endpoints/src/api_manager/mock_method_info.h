@@ -40,6 +40,8 @@ class MockMethodInfo : public MethodInfo {
   MOCK_CONST_METHOD0(api_key_http_headers, const std::vector<std::string>*());
   MOCK_CONST_METHOD0(api_key_url_query_parameters,
                      const std::vector<std::string>*());
+  MOCK_CONST_METHOD0(api_key_lookup_queries, const std::vector<std::string>&());
+  MOCK_CONST_METHOD0(api_key_lookup_headers, const std::vector<std::string>&());
   MOCK_CONST_METHOD0(backend_address, const std::string&());
   MOCK_CONST_METHOD0(rpc_method_full_name, const std::string&());
   MOCK_CONST_METHOD0(request_type_url, const std::string&());
@@ -47,7 +49,7 @@ class MockMethodInfo : public MethodInfo {
   MOCK_CONST_METHOD0(response_type_url, const std::string&());
   MOCK_CONST_METHOD0(response_streaming, bool());
   MOCK_CONST_METHOD0(system_query_parameter_names,
-                     const std::set<std::string>&());
+                     const std::vector<std::string>&());
   MOCK_CONST_METHOD0(metric_cost_vector,
                      const std::vector<std::pair<std::string, int>>&());
 };
@@ -15,15 +15,17 @@
 #ifndef API_MANAGER_PATH_MATCHER_H_
 #define API_MANAGER_PATH_MATCHER_H_
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <set>
-#include <sstream>
 #include <string>
 #include <unordered_map>
 
 #include "contrib/endpoints/src/api_manager/http_template.h"
+#include "contrib/endpoints/src/api_manager/http_template_cache.h"
 #include "contrib/endpoints/src/api_manager/path_matcher_node.h"
+#include "contrib/endpoints/src/api_manager/utils/url_parser.h"
 
 namespace google {
 namespace api_manager {
@@ -74,7 +76,9 @@ class PathMatcher {
   // Data we store per each registered method
   struct MethodData {
     Method method;
-    std::vector<HttpTemplate::Variable> variables;
+    // The parsed template, shared with the template cache if any. Its
+    // variables are used to extract the bindings from the path.
+    std::shared_ptr<const HttpTemplate> http_template;
     std::string body_field_path;
   };
   // The info associated with each method. The path matcher nodes
@@ -95,7 +99,10 @@ using PathMatcherPtr = std::unique_ptr<PathMatcher<Method>>;
 template <class Method>
 class PathMatcherBuilder {
  public:
-  PathMatcherBuilder();
+  // If template_cache is not nullptr, http templates are parsed through it
+  // so that identical templates are parsed only once. The cache must outlive
+  // the builder.
+  explicit PathMatcherBuilder(HttpTemplateCache* template_cache = nullptr);
   ~PathMatcherBuilder() {}
 
   // Registers a method.
@@ -126,128 +133,29 @@ class PathMatcherBuilder {
   std::set<std::string> custom_verbs_;
   typedef typename PathMatcher<Method>::MethodData MethodData;
   std::vector<std::unique_ptr<MethodData>> methods_;
+  // The optional parse cache for http templates. Not owned.
+  HttpTemplateCache* template_cache_;
 
   friend class PathMatcher<Method>;
 };
 
 namespace {
 
+// Splits s at delim and appends the pieces to elems. Like std::getline,
+// a trailing delim does not produce a trailing empty piece.
 std::vector<std::string>& split(const std::string& s, char delim,
                                 std::vector<std::string>& elems) {
-  std::stringstream ss(s);
-  std::string item;
-  while (std::getline(ss, item, delim)) {
-    elems.push_back(item);
-  }
-  return elems;
-}
-
-inline bool IsReservedChar(char c) {
-  // Reserved characters according to RFC 6570
-  switch (c) {
-    case '!':
-    case '#':
-    case '$':
-    case '&':
-    case '\'':
-    case '(':
-    case ')':
-    case '*':
-    case '+':
-    case ',':
-    case '/':
-    case ':':
-    case ';':
-    case '=':
-    case '?':
-    case '@':
-    case '[':
-    case ']':
-      return true;
-    default:
-      return false;
-  }
-}
-
-// Check if an ASCII character is a hex digit.  We can't use ctype's
-// isxdigit() because it is affected by locale. This function is applied
-// to the escaped characters in a url, not to natural-language
-// strings, so locale should not be taken into account.
-inline bool ascii_isxdigit(char c) {
-  return ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F') ||
-         ('0' <= c && c <= '9');
-}
-
-inline int hex_digit_to_int(char c) {
-  /* Assume ASCII. */
-  int x = static_cast<unsigned char>(c);
-  if (x > '9') {
-    x += 9;
-  }
-  return x & 0xf;
-}
-
-// This is a helper function for UrlUnescapeString. It takes a string and
-// the index of where we are within that string.
-//
-// The function returns true if the next three characters are of the format:
-// "%[0-9A-Fa-f]{2}".
-//
-// If the next three characters are an escaped character then this function will
-// also return what character is escaped.
-bool GetEscapedChar(const std::string& src, size_t i,
-                    bool unescape_reserved_chars, char* out) {
-  if (i + 2 < src.size() && src[i] == '%') {
-    if (ascii_isxdigit(src[i + 1]) && ascii_isxdigit(src[i + 2])) {
-      char c =
-          (hex_digit_to_int(src[i + 1]) << 4) | hex_digit_to_int(src[i + 2]);
-      if (!unescape_reserved_chars && IsReservedChar(c)) {
-        return false;
-      }
-      *out = c;
-      return true;
-    }
-  }
-  return false;
-}
-
-// Unescapes string 'part' and returns the unescaped string. Reserved characters
-// (as specified in RFC 6570) are not escaped if unescape_reserved_chars is
-// false.
-std::string UrlUnescapeString(const std::string& part,
-                              bool unescape_reserved_chars) {
-  std::string unescaped;
-  // Check whether we need to escape at all.
-  bool needs_unescaping = false;
-  char ch = '\0';
-  for (size_t i = 0; i < part.size(); ++i) {
-    if (GetEscapedChar(part, i, unescape_reserved_chars, &ch)) {
-      needs_unescaping = true;
+  const char* p = s.data();
+  const char* end = p + s.size();
+  while (p < end) {
+    const char* next = utils::FindChar(p, end, delim);
+    elems.emplace_back(p, next - p);
+    if (next == end) {
       break;
     }
+    p = next + 1;
   }
-  if (!needs_unescaping) {
-    unescaped = part;
-    return unescaped;
-  }
-
-  unescaped.resize(part.size());
-
-  char* begin = &(unescaped)[0];
-  char* p = begin;
-
-  for (size_t i = 0; i < part.size();) {
-    if (GetEscapedChar(part, i, unescape_reserved_chars, &ch)) {
-      *p++ = ch;
-      i += 3;
-    } else {
-      *p++ = part[i];
-      i += 1;
-    }
-  }
-
-  unescaped.resize(p - begin);
-  return unescaped;
+  return elems;
 }
 
 template <class VariableBinding>
@@ -274,7 +182,8 @@ void ExtractBindingsFromPath(const std::vector<HttpTemplate::Variable>& vars,
     // Joins parts with "/"  to form a path string.
     for (size_t i = var.start_segment; i < end_segment; ++i) {
       // For multipart matches only unescape non-reserved characters.
-      binding.value += UrlUnescapeString(parts[i], !is_multipart);
+      utils::UrlUnescapeAppend(parts[i].data(), parts[i].size(),
+                               !is_multipart, &binding.value);
       if (i < end_segment - 1) {
         binding.value += "/";
       }
@@ -285,30 +194,30 @@ void ExtractBindingsFromPath(const std::vector<HttpTemplate::Variable>& vars,
 
 template <class VariableBinding>
 void ExtractBindingsFromQueryParameters(
-    const std::string& query_params, const std::set<std::string>& system_params,
+    const std::string& query_params,
+    const std::vector<std::string>& system_params,
     std::vector<VariableBinding>* bindings) {
   // The bindings in URL the query parameters have the following form:
   //      <field_path1>=value1&<field_path2>=value2&...&<field_pathN>=valueN
   // Query parameters may also contain system parameters such as `api_key`.
   // We'll need to ignore these. Example:
   //      book.id=123&book.author=Neal%20Stephenson&api_key=AIzaSyAz7fhBkC35D2M
-  std::vector<std::string> params;
-  split(query_params, '&', params);
+  std::vector<utils::QueryParameter> params;
+  utils::ParseQueryString(query_params.data(), query_params.size(), &params);
   for (const auto& param : params) {
-    size_t pos = param.find('=');
-    if (pos != 0 && pos != std::string::npos) {
-      auto name = param.substr(0, pos);
-      // Make sure the query parameter is not a system parameter (e.g.
-      // `api_key`) before adding the binding.
-      if (system_params.find(name) == std::end(system_params)) {
-        // The name of the parameter is a field path, which is a dot-delimited
-        // sequence of field names that identify the (potentially deep) field
-        // in the request, e.g. `book.author.name`.
-        VariableBinding binding;
-        split(name, '.', binding.field_path);
-        binding.value = UrlUnescapeString(param.substr(pos + 1), true);
-        bindings->emplace_back(std::move(binding));
-      }
+    std::string name(param.name, param.name_size);
+    // Make sure the query parameter is not a system parameter (e.g.
+    // `api_key`) before adding the binding.
+    if (!std::binary_search(system_params.begin(), system_params.end(),
+                            name)) {
+      // The name of the parameter is a field path, which is a dot-delimited
+      // sequence of field names that identify the (potentially deep) field
+      // in the request, e.g. `book.author.name`.
+      VariableBinding binding;
+      split(name, '.', binding.field_path);
+      utils::UrlUnescapeAppend(param.value, param.value_size, true,
+                               &binding.value);
+      bindings->emplace_back(std::move(binding));
     }
   }
 }
@@ -409,7 +318,8 @@ Method PathMatcher<Method>::Lookup(
   MethodData* method_data = reinterpret_cast<MethodData*>(lookup_result.data);
   if (variable_bindings != nullptr) {
     variable_bindings->clear();
-    ExtractBindingsFromPath(method_data->variables, parts, variable_bindings);
+    ExtractBindingsFromPath(method_data->http_template->variables(), parts,
+                            variable_bindings);
     ExtractBindingsFromQueryParameters(
         query_params, method_data->method->system_query_parameter_names(),
         variable_bindings);
@@ -444,8 +354,9 @@ Method PathMatcher<Method>::Lookup(const std::string& http_method,
 
 // Initializes the builder with a root Path Segment
 template <class Method>
-PathMatcherBuilder<Method>::PathMatcherBuilder()
-    : root_ptr_(new PathMatcherNode()) {}
+PathMatcherBuilder<Method>::PathMatcherBuilder(
+    HttpTemplateCache* template_cache)
+    : root_ptr_(new PathMatcherNode()), template_cache_(template_cache) {}
 
 template <class Method>
 PathMatcherPtr<Method> PathMatcherBuilder<Method>::Build() {
@@ -471,7 +382,12 @@ bool PathMatcherBuilder<Method>::Register(std::string http_method,
                                           std::string http_template,
                                           std::string body_field_path,
                                           Method method) {
-  std::unique_ptr<HttpTemplate> ht(HttpTemplate::Parse(http_template));
+  std::shared_ptr<const HttpTemplate> ht;
+  if (template_cache_ != nullptr) {
+    ht = template_cache_->Parse(http_template);
+  } else {
+    ht.reset(HttpTemplate::Parse(http_template));
+  }
   if (nullptr == ht) {
     return false;
   }
@@ -483,7 +399,7 @@ bool PathMatcherBuilder<Method>::Register(std::string http_method,
   // into the path matcher trie.
   auto method_data = std::unique_ptr<MethodData>(new MethodData());
   method_data->method = method;
-  method_data->variables = std::move(ht->Variables());
+  method_data->http_template = std::move(ht);
   method_data->body_field_path = std::move(body_field_path);
 
   InsertPathToNode(path_info, method_data.get(), http_method, true,
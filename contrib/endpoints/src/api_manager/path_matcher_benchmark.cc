@@ -0,0 +1,325 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks PathMatcher build and lookup.
+//
+// Without arguments, it runs over synthetic route tables of 10, 1k and 50k
+// routes, mixing literal paths, variable bindings, '*' and '**' wildcards and
+// custom verbs, and replays a request corpus generated from the same table.
+//
+// A recorded route table and request corpus can be replayed with
+//     path_matcher_benchmark <routes_file> <requests_file>
+// where each line of routes_file is "<http method> <http template> [body]"
+// and each line of requests_file is "<http method> <path>[?<query>]".
+//
+// For every table it reports the build time, the number of allocations and
+// live heap bytes of the built matcher, and for lookups with and without
+// variable bindings the lookups/sec and allocations per lookup.
+//
+#include "contrib/endpoints/src/api_manager/path_matcher.h"
+#include "contrib/endpoints/src/api_manager/utils/benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Heap accounting for the whole binary. Every allocation is prefixed with a
+// header holding its size, so that frees can be subtracted from live bytes.
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<int64_t> g_live_bytes(0);
+
+const size_t kHeaderSize = alignof(std::max_align_t);
+
+void *CountedAlloc(size_t size) {
+  void *p = malloc(size + kHeaderSize);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  *static_cast<size_t *>(p) = size;
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_live_bytes.fetch_add(size, std::memory_order_relaxed);
+  return static_cast<char *>(p) + kHeaderSize;
+}
+
+void CountedFree(void *ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  void *p = static_cast<char *>(ptr) - kHeaderSize;
+  g_live_bytes.fetch_sub(*static_cast<size_t *>(p),
+                         std::memory_order_relaxed);
+  free(p);
+}
+
+}  // namespace
+
+void *operator new(size_t size) { return CountedAlloc(size); }
+void *operator new[](size_t size) { return CountedAlloc(size); }
+void operator delete(void *ptr) noexcept { CountedFree(ptr); }
+void operator delete[](void *ptr) noexcept { CountedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { CountedFree(ptr); }
+
+namespace google {
+namespace api_manager {
+namespace {
+
+using utils::DoNotOptimize;
+using utils::RunBenchmark;
+
+// The method type stored in the matcher.
+class MethodInfo {
+ public:
+  const std::vector<std::string> &system_query_parameter_names() const {
+    return system_query_parameter_names_;
+  }
+
+ private:
+  // Sorted, as the path matcher searches it.
+  std::vector<std::string> system_query_parameter_names_{"api_key", "key"};
+};
+
+struct Binding {
+  std::vector<std::string> field_path;
+  std::string value;
+};
+
+struct Route {
+  std::string http_method;
+  std::string http_template;
+  std::string body_field_path;
+};
+
+struct Request {
+  std::string http_method;
+  std::string path;
+  std::string query_params;
+};
+
+// Generates n routes of six shapes and, for each route, a matching request.
+// About one in ten requests of the corpus does not match any route.
+void GenerateSyntheticTable(int n, std::vector<Route> *routes,
+                            std::vector<Request> *requests) {
+  for (int i = 0; i < n; ++i) {
+    std::string c = "collection" + std::to_string(i);
+    std::string project = "p" + std::to_string(i % 97);
+    std::string item = "item-" + std::to_string(i * 7919 % 100003);
+    switch (i % 6) {
+      case 0:
+        routes->push_back(
+            {"GET", "/v1/projects/{project}/" + c + "/items/{item}", ""});
+        requests->push_back({"GET",
+                             "/v1/projects/" + project + "/" + c + "/items/" +
+                                 item,
+                             "view=FULL&api_key=AIzaSyAz7fhBkC35D2M"});
+        break;
+      case 1:
+        routes->push_back({"POST",
+                           "/v1/projects/{project}/" + c +
+                               "/items:batchCreate",
+                           "*"});
+        requests->push_back(
+            {"POST",
+             "/v1/projects/" + project + "/" + c + "/items:batchCreate", ""});
+        break;
+      case 2:
+        routes->push_back(
+            {"GET", "/v1/{name=projects/*/" + c + "/items/*}/versions", ""});
+        requests->push_back({"GET",
+                             "/v1/projects/" + project + "/" + c + "/items/" +
+                                 item + "/versions",
+                             "page_size=100&page_token=CiAKGjBpNDd2Nmp2Zml2"});
+        break;
+      case 3:
+        routes->push_back({"GET", "/v1/files/" + c + "/{path=**}", ""});
+        requests->push_back({"GET",
+                             "/v1/files/" + c + "/a/b%20c/d/" + item +
+                                 ".txt",
+                             ""});
+        break;
+      case 4:
+        routes->push_back(
+            {"PATCH", "/v1/projects/{project}/" + c + "/items/{item.id}",
+             "item"});
+        requests->push_back(
+            {"PATCH", "/v1/projects/" + project + "/" + c + "/items/" + item,
+             "item.labels.env=prod&update_mask=labels"});
+        break;
+      case 5:
+        routes->push_back({"GET", "/v1/static/" + c + "/settings", ""});
+        requests->push_back({"GET", "/v1/static/" + c + "/settings", ""});
+        break;
+    }
+    if (i % 10 == 9) {
+      requests->push_back({"GET", "/v1/unknown/" + c + "/" + item, ""});
+    }
+  }
+}
+
+bool ReadLines(const char *file_name, std::vector<std::string> *lines) {
+  std::ifstream input(file_name);
+  if (!input) {
+    fprintf(stderr, "Cannot open %s\n", file_name);
+    return false;
+  }
+  std::string line;
+  while (std::getline(input, line)) {
+    if (!line.empty() && line[0] != '#') {
+      lines->push_back(line);
+    }
+  }
+  return true;
+}
+
+bool ReadRecordedTable(const char *routes_file, const char *requests_file,
+                       std::vector<Route> *routes,
+                       std::vector<Request> *requests) {
+  std::vector<std::string> lines;
+  if (!ReadLines(routes_file, &lines)) {
+    return false;
+  }
+  for (const auto &line : lines) {
+    std::istringstream fields(line);
+    Route route;
+    fields >> route.http_method >> route.http_template >>
+        route.body_field_path;
+    routes->push_back(route);
+  }
+  lines.clear();
+  if (!ReadLines(requests_file, &lines)) {
+    return false;
+  }
+  for (const auto &line : lines) {
+    std::istringstream fields(line);
+    Request request;
+    fields >> request.http_method >> request.path;
+    size_t pos = request.path.find('?');
+    if (pos != std::string::npos) {
+      request.query_params = request.path.substr(pos + 1);
+      request.path.resize(pos);
+    }
+    requests->push_back(request);
+  }
+  return true;
+}
+
+void Run(const std::string &name, const std::vector<Route> &routes,
+         std::vector<Request> requests) {
+  printf("%s: %zu routes, %zu requests\n", name.c_str(), routes.size(),
+         requests.size());
+  // Replay the corpus in a fixed random order, so that consecutive lookups
+  // do not walk the same trie branches.
+  std::shuffle(requests.begin(), requests.end(), std::mt19937(1234));
+
+  MethodInfo method;
+  uint64_t allocations = g_allocations;
+  int64_t live_bytes = g_live_bytes;
+  auto start = std::chrono::steady_clock::now();
+
+  PathMatcherBuilder<MethodInfo *> builder;
+  int invalid = 0;
+  for (const auto &route : routes) {
+    if (!builder.Register(route.http_method, route.http_template,
+                          route.body_field_path, &method)) {
+      ++invalid;
+    }
+  }
+  PathMatcherPtr<MethodInfo *> matcher = builder.Build();
+
+  double build_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  printf("  build: %.2f ms, %llu allocations, %.1f KB live, %d invalid\n",
+         build_ms,
+         static_cast<unsigned long long>(g_allocations - allocations),
+         (g_live_bytes - live_bytes) / 1024.0, invalid);
+
+  // One pass over the corpus to count matches and allocations per lookup.
+  int matched = 0;
+  allocations = g_allocations;
+  for (const auto &request : requests) {
+    if (matcher->Lookup(request.http_method, request.path) != nullptr) {
+      ++matched;
+    }
+  }
+  double lookup_allocations =
+      static_cast<double>(g_allocations - allocations) / requests.size();
+
+  std::vector<Binding> bindings;
+  std::string body_field_path;
+  allocations = g_allocations;
+  for (const auto &request : requests) {
+    matcher->Lookup(request.http_method, request.path, request.query_params,
+                    &bindings, &body_field_path);
+  }
+  double binding_allocations =
+      static_cast<double>(g_allocations - allocations) / requests.size();
+  printf("  %d of %zu requests matched\n", matched, requests.size());
+
+  size_t i = 0;
+  RunBenchmark("  Lookup", [&]() {
+    const Request &request = requests[i++ % requests.size()];
+    DoNotOptimize(matcher->Lookup(request.http_method, request.path));
+  });
+  printf("  %.1f allocations/lookup\n", lookup_allocations);
+
+  RunBenchmark("  Lookup with bindings", [&]() {
+    const Request &request = requests[i++ % requests.size()];
+    DoNotOptimize(matcher->Lookup(request.http_method, request.path,
+                                  request.query_params, &bindings,
+                                  &body_field_path));
+  });
+  printf("  %.1f allocations/lookup\n", binding_allocations);
+}
+
+}  // namespace
+}  // namespace api_manager
+}  // namespace google
+
+int main(int argc, char **argv) {
+  using namespace ::google::api_manager;
+  if (argc == 3) {
+    std::vector<Route> routes;
+    std::vector<Request> requests;
+    if (!ReadRecordedTable(argv[1], argv[2], &routes, &requests) ||
+        requests.empty()) {
+      return 1;
+    }
+    Run(std::string("recorded ") + argv[1], routes, std::move(requests));
+    return 0;
+  }
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s [<routes_file> <requests_file>]\n", argv[0]);
+    return 1;
+  }
+  for (int n : {10, 1000, 50000}) {
+    std::vector<Route> routes;
+    std::vector<Request> requests;
+    GenerateSyntheticTable(n, &routes, &requests);
+    Run("synthetic", routes, std::move(requests));
+  }
+  return 0;
+}
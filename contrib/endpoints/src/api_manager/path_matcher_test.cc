@@ -49,7 +49,7 @@ typedef std::vector<std::string> FieldPath;
 class MethodInfo {
  public:
   MOCK_CONST_METHOD0(system_query_parameter_names,
-                     const std::set<std::string>&());
+                     const std::vector<std::string>&());
 };
 
 bool operator==(const Binding& b1, const Binding& b2) {
@@ -92,7 +92,7 @@ class PathMatcherTest : public ::testing::Test {
                                        std::string body_field_path) {
     auto method = new MethodInfo();
     ON_CALL(*method, system_query_parameter_names())
-        .WillByDefault(ReturnRef(empty_set_));
+        .WillByDefault(ReturnRef(empty_vector_));
     if (!builder_.Register(http_method, http_template, body_field_path,
                            method)) {
       delete method;
@@ -104,7 +104,7 @@ class PathMatcherTest : public ::testing::Test {
 
   MethodInfo* AddPathWithSystemParams(
       std::string http_method, std::string http_template,
-      const std::set<std::string>* system_params) {
+      const std::vector<std::string>* system_params) {
     auto method = new MethodInfo();
     ON_CALL(*method, system_query_parameter_names())
         .WillByDefault(ReturnRef(*system_params));
@@ -156,7 +156,7 @@ class PathMatcherTest : public ::testing::Test {
   PathMatcherBuilder<MethodInfo*> builder_;
   PathMatcherPtr<MethodInfo*> matcher_;
   std::vector<std::unique_ptr<MethodInfo>> stored_methods_;
-  std::set<std::string> empty_set_;
+  std::vector<std::string> empty_vector_;
 };
 
 TEST_F(PathMatcherTest, WildCardMatchesRoot) {
@@ -718,7 +718,7 @@ TEST_F(PathMatcherTest, VariableBindingsWithQueryParamsEncoding) {
 }
 
 TEST_F(PathMatcherTest, VariableBindingsWithQueryParamsAndSystemParams) {
-  std::set<std::string> system_params{"key", "api_key"};
+  std::vector<std::string> system_params{"api_key", "key"};
   MethodInfo* a_b = AddPathWithSystemParams("GET", "/a/{x}/b", &system_params);
   Build();
 
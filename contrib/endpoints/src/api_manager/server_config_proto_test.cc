@@ -46,12 +46,26 @@ service_control_config {
     cache_entries: 1000
     flush_interval_ms: 10
     response_expiration_ms: 20
+    refresh_ahead_min_hits: 5
+  }
+
+  quota_aggregator_config {
+    prealloc_chunk: 100
+    prealloc_lifetime_ms: 30000
   }
 
   report_aggregator_config {
     cache_entries: 1020
     flush_interval_ms: 15
+    max_flush_interval_ms: 3000
+    high_load_reports_per_sec: 2000
   }
+
+  report_compression_min_bytes: 1024
+  report_rollup_entries: 500
+  grpc_transport: true
+  report_spill_path: "/var/spool/esp/reports"
+  report_spill_max_bytes: 1048576
 }
 
 metadata_server_config {
@@ -62,6 +76,7 @@ metadata_server_config {
 google_authentication_secret: "{"
                                 "The client secret goes here."
                               "}"
+auth_token_renew_before_sec: 600
 
 cloud_tracing_config {
   force_disable: false,
@@ -70,6 +85,12 @@ cloud_tracing_config {
 
 api_authentication_config {
   force_disable: true
+  jwt_cache_size: 5000
+  jwt_cache_timeout_sec: 120
+  jwt_cache_shards: 8
+  verification_threads: 4
+  negative_jwt_cache_size: 2000
+  negative_jwt_cache_ttl_sec: 5
 }
 
 experimental {
@@ -96,12 +117,36 @@ TEST(ServerConfigProto, ServerConfigFromString) {
   EXPECT_EQ(20, server_config.service_control_config()
                     .check_aggregator_config()
                     .response_expiration_ms());
+  EXPECT_EQ(5, server_config.service_control_config()
+                   .check_aggregator_config()
+                   .refresh_ahead_min_hits());
+  EXPECT_EQ(100, server_config.service_control_config()
+                     .quota_aggregator_config()
+                     .prealloc_chunk());
+  EXPECT_EQ(30000, server_config.service_control_config()
+                       .quota_aggregator_config()
+                       .prealloc_lifetime_ms());
   EXPECT_EQ(1020, server_config.service_control_config()
                       .report_aggregator_config()
                       .cache_entries());
   EXPECT_EQ(15, server_config.service_control_config()
                     .report_aggregator_config()
                     .flush_interval_ms());
+  EXPECT_EQ(3000, server_config.service_control_config()
+                      .report_aggregator_config()
+                      .max_flush_interval_ms());
+  EXPECT_EQ(2000, server_config.service_control_config()
+                      .report_aggregator_config()
+                      .high_load_reports_per_sec());
+  EXPECT_EQ(1024, server_config.service_control_config()
+                      .report_compression_min_bytes());
+  EXPECT_EQ(500,
+            server_config.service_control_config().report_rollup_entries());
+  EXPECT_TRUE(server_config.service_control_config().grpc_transport());
+  EXPECT_EQ("/var/spool/esp/reports",
+            server_config.service_control_config().report_spill_path());
+  EXPECT_EQ(1048576,
+            server_config.service_control_config().report_spill_max_bytes());
 
   // Check metadata_server_config
   EXPECT_EQ(true, server_config.metadata_server_config().enabled());
@@ -111,6 +156,7 @@ TEST(ServerConfigProto, ServerConfigFromString) {
   // Check google_authentication_secret
   EXPECT_EQ("{The client secret goes here.}",
             server_config.google_authentication_secret());
+  EXPECT_EQ(600, server_config.auth_token_renew_before_sec());
 
   // Check cloud_tracing_config
   EXPECT_EQ(false, server_config.cloud_tracing_config().force_disable());
@@ -119,6 +165,16 @@ TEST(ServerConfigProto, ServerConfigFromString) {
 
   // Check api_authentication_config
   EXPECT_EQ(true, server_config.api_authentication_config().force_disable());
+  EXPECT_EQ(5000, server_config.api_authentication_config().jwt_cache_size());
+  EXPECT_EQ(120,
+            server_config.api_authentication_config().jwt_cache_timeout_sec());
+  EXPECT_EQ(8, server_config.api_authentication_config().jwt_cache_shards());
+  EXPECT_EQ(4,
+            server_config.api_authentication_config().verification_threads());
+  EXPECT_EQ(2000, server_config.api_authentication_config()
+                      .negative_jwt_cache_size());
+  EXPECT_EQ(5, server_config.api_authentication_config()
+                   .negative_jwt_cache_ttl_sec());
 
   // Check disable_log_status
   EXPECT_EQ(false, server_config.experimental().disable_log_status());
@@ -0,0 +1,66 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/adaptive_flush_interval.h"
+
+#include <algorithm>
+
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+// The weight of the last interval in the smoothed load.
+const double kLoadSmoothing = 0.5;
+}  // namespace
+
+AdaptiveFlushInterval::AdaptiveFlushInterval(int min_interval_ms,
+                                             int max_interval_ms,
+                                             int high_load_per_sec,
+                                             steady_clock::time_point now)
+    : min_interval_ms_(min_interval_ms),
+      max_interval_ms_(std::max(min_interval_ms, max_interval_ms)),
+      high_load_per_sec_(std::max(1, high_load_per_sec)),
+      reports_(0),
+      interval_ms_(min_interval_ms),
+      reports_per_sec_(0),
+      last_flush_(now) {}
+
+bool AdaptiveFlushInterval::ShouldFlush(steady_clock::time_point now) {
+  auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        now - last_flush_)
+                        .count();
+  if (elapsed_ms < interval_ms_) {
+    return false;
+  }
+  last_flush_ = now;
+
+  double load =
+      reports_.exchange(0) * 1000.0 / std::max<int64_t>(1, elapsed_ms);
+  double smoothed =
+      kLoadSmoothing * load + (1 - kLoadSmoothing) * reports_per_sec_;
+  reports_per_sec_ = smoothed;
+  double fraction = std::min(1.0, smoothed / high_load_per_sec_);
+  int range_ms = max_interval_ms_ - min_interval_ms_;
+  interval_ms_ = min_interval_ms_ + static_cast<int>(range_ms * fraction);
+  return true;
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,70 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_ADAPTIVE_FLUSH_INTERVAL_H_
+#define API_MANAGER_SERVICE_CONTROL_ADAPTIVE_FLUSH_INTERVAL_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// Picks the interval between report flushes from the load. The interval
+// grows linearly with the reports per second, from min_interval_ms when
+// idle to max_interval_ms at high_load_per_sec and above. A long interval
+// merges more reports into each operation under high load, which keeps the
+// number of outbound Report calls down, and a short one keeps the metrics
+// fresh under low load.
+//
+// The load is measured between flushes, and smoothed over the last few of
+// them. AddReport() may be called from any thread, and ShouldFlush() from
+// one thread at a time.
+class AdaptiveFlushInterval {
+ public:
+  AdaptiveFlushInterval(int min_interval_ms, int max_interval_ms,
+                        int high_load_per_sec,
+                        std::chrono::steady_clock::time_point now);
+
+  // Counts a report.
+  void AddReport() { ++reports_; }
+
+  // Returns whether the interval has passed since the last flush at "now".
+  // If so, starts a new interval, sized for the load of the last one.
+  bool ShouldFlush(std::chrono::steady_clock::time_point now);
+
+  // Returns the current flush interval.
+  int interval_ms() const { return interval_ms_; }
+
+  // Returns the smoothed reports per second.
+  double reports_per_sec() const { return reports_per_sec_; }
+
+ private:
+  const int min_interval_ms_;
+  const int max_interval_ms_;
+  const int high_load_per_sec_;
+
+  std::atomic<uint64_t> reports_;
+  std::atomic<int> interval_ms_;
+  std::atomic<double> reports_per_sec_;
+  std::chrono::steady_clock::time_point last_flush_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_ADAPTIVE_FLUSH_INTERVAL_H_
@@ -0,0 +1,89 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/adaptive_flush_interval.h"
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+// Adds "count" reports, then flushes "elapsed" after "*now".
+bool AddAndFlush(AdaptiveFlushInterval* flush, int count, milliseconds elapsed,
+                 steady_clock::time_point* now) {
+  for (int i = 0; i < count; ++i) {
+    flush->AddReport();
+  }
+  *now += elapsed;
+  return flush->ShouldFlush(*now);
+}
+
+TEST(AdaptiveFlushInterval, StartsAtTheMinimum) {
+  steady_clock::time_point now;
+  AdaptiveFlushInterval flush(100, 5000, 1000, now);
+  EXPECT_EQ(100, flush.interval_ms());
+  EXPECT_FALSE(flush.ShouldFlush(now + milliseconds(99)));
+  EXPECT_TRUE(flush.ShouldFlush(now + milliseconds(100)));
+  // Idle, so the interval stays at the minimum.
+  EXPECT_EQ(100, flush.interval_ms());
+}
+
+TEST(AdaptiveFlushInterval, GrowsWithTheLoad) {
+  steady_clock::time_point now;
+  AdaptiveFlushInterval flush(100, 5000, 1000, now);
+  // 5000 reports per second, far over the high load.
+  ASSERT_TRUE(AddAndFlush(&flush, 500, milliseconds(100), &now));
+  EXPECT_EQ(2500, flush.reports_per_sec());
+  EXPECT_EQ(5000, flush.interval_ms());
+  EXPECT_FALSE(AddAndFlush(&flush, 0, milliseconds(4999), &now));
+  EXPECT_TRUE(AddAndFlush(&flush, 0, milliseconds(1), &now));
+}
+
+TEST(AdaptiveFlushInterval, ShrinksWhenTheLoadDrops) {
+  steady_clock::time_point now;
+  AdaptiveFlushInterval flush(100, 5000, 1000, now);
+  ASSERT_TRUE(AddAndFlush(&flush, 1000, milliseconds(100), &now));
+  EXPECT_EQ(5000, flush.interval_ms());
+
+  // The load is smoothed, so it takes a few idle intervals to come down.
+  ASSERT_TRUE(AddAndFlush(&flush, 0, milliseconds(5000), &now));
+  EXPECT_EQ(5000, flush.interval_ms());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(
+        AddAndFlush(&flush, 0, milliseconds(flush.interval_ms()), &now));
+  }
+  EXPECT_LT(flush.interval_ms(), 200);
+}
+
+TEST(AdaptiveFlushInterval, InterpolatesBetweenTheBounds) {
+  steady_clock::time_point now;
+  AdaptiveFlushInterval flush(1000, 3000, 100, now);
+  // 100 reports per second, smoothed to 50, half the high load.
+  ASSERT_TRUE(AddAndFlush(&flush, 100, milliseconds(1000), &now));
+  EXPECT_EQ(50, flush.reports_per_sec());
+  EXPECT_EQ(2000, flush.interval_ms());
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -16,9 +16,14 @@
 //
 #include "contrib/endpoints/src/api_manager/service_control/aggregated.h"
 
+#include <uuid/uuid.h>
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <typeinfo>
 #include "contrib/endpoints/src/api_manager/service_control/logs_metrics_loader.h"
+#include "contrib/endpoints/src/api_manager/utils/gzip_output_stream.h"
+#include "google/protobuf/io/coded_stream.h"
 
 using ::google::api::servicecontrol::v1::CheckRequest;
 using ::google::api::servicecontrol::v1::CheckResponse;
@@ -45,6 +50,8 @@ namespace {
 
 const int kQuotaAggregationEntries = 10000;
 const int kQuotaAggregationRefreshMs = 1000;
+// The default lifetime of pre-allocated quota.
+const int kQuotaPreallocLifetimeMs = 60000;
 
 // Default config for check aggregator
 const int kCheckAggregationEntries = 10000;
@@ -57,6 +64,18 @@ const int kCheckAggregationExpirationMs = 300000;
 // Default config for report aggregator
 const int kReportAggregationEntries = 10000;
 const int kReportAggregationFlushIntervalMs = 1000;
+// The default reports per second at which adaptive report flushing waits the
+// longest between flushes.
+const int kReportHighLoadPerSec = 1000;
+
+// The default room for undelivered reports in the spill file.
+const int kReportSpillMaxBytes = 64 << 20;
+// Spilled reports are replayed at most this many per interval.
+const int kReportSpillReplayIntervalMs = 1000;
+const int kReportSpillReplayPerTick = 10;
+
+// The number of Report body buffers kept for reuse.
+const size_t kReportBodyPoolSize = 4;
 
 // The default connection timeout for check requests.
 const int kCheckDefaultTimeoutInMs = 5000;
@@ -65,14 +84,15 @@ const int kAllocateQuotaDefaultTimeoutInMs = 1000;
 // The default connection timeout for report requests.
 const int kReportDefaultTimeoutInMs = 15000;
 
-// The maximum protobuf pool size. All usages of pool alloc() and free() are
-// within a function frame. If no con-current usage, pool size of 1 is enough.
-// This number should correspond to maximum of concurrent calls.
-const int kProtoPoolMaxSize = 100;
+// Maximum 36 byte string for UUID
+const int kMaxUUIDBufSize = 40;
 
 // Defines protobuf content type.
 const char application_proto[] = "application/x-protobuf";
 
+// The content encoding of compressed requests.
+const char gzip_encoding[] = "gzip";
+
 // The service_control service name. used for as audience to generate JWT token.
 const char servicecontrol_service[] =
     "/google.api.servicecontrol.v1.ServiceController";
@@ -129,29 +149,67 @@ ReportAggregationOptions GetReportAggregationOptions(
                                   kReportAggregationFlushIntervalMs);
 }
 
-}  // namespace
-
-template <class Type>
-std::unique_ptr<Type> Aggregated::ProtoPool<Type>::Alloc() {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (!pool_.empty()) {
-    auto item = std::move(pool_.front());
-    pool_.pop_front();
-    item->Clear();
-    return item;
-  } else {
-    return std::unique_ptr<Type>(new Type);
+// Returns the key of the check cache entry of a request. It holds every
+// field of the request that goes into the signature of the entry, so two
+// requests with the same key share the entry.
+std::string GetCheckRefreshKey(const CheckRequestInfo& info) {
+  std::string key;
+  for (const ::google::protobuf::StringPiece& piece :
+       {info.operation_name, info.api_key, info.producer_project_id,
+        info.referer}) {
+    key.append(piece.data(), piece.size());
+    key.push_back('\0');
+  }
+  for (const std::string* value :
+       {&info.client_ip, &info.android_package_name,
+        &info.android_cert_fingerprint, &info.ios_bundle_id}) {
+    key.append(*value);
+    key.push_back('\0');
   }
+  return key;
 }
 
-template <class Type>
-void Aggregated::ProtoPool<Type>::Free(std::unique_ptr<Type> item) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (pool_.size() < kProtoPoolMaxSize) {
-    pool_.push_back(std::move(item));
+// Returns whether a Report request that failed with an HTTP status, or a
+// negative code for a connection failure, could succeed later.
+bool IsRetriableReportFailure(int code) {
+  return code < 0 || code == 429 || code >= 500;
+}
+
+// Serializes a protobuf whose sizes are already cached straight into a gzip
+// stream, so that no uncompressed copy of it is made.
+bool SerializeToGzip(const ::google::protobuf::Message& message,
+                     std::string* output) {
+  utils::GzipOutputStream gzip(output);
+  {
+    ::google::protobuf::io::CodedOutputStream coded(&gzip);
+    message.SerializeWithCachedSizes(&coded);
+    if (coded.HadError()) {
+      return false;
+    }
   }
+  return gzip.Close();
 }
 
+// Generates a UUID string, used as the operation_id of quota refills.
+std::string GenerateUUID() {
+  char uuid_buf[kMaxUUIDBufSize];
+  uuid_t uuid;
+  uuid_generate(uuid);
+  uuid_unparse(uuid, uuid_buf);
+  return uuid_buf;
+}
+
+// Serializes a protobuf whose sizes are already cached into output, whose
+// capacity is reused.
+void SerializeWithCachedSizes(const ::google::protobuf::Message& message,
+                              size_t size, std::string* output) {
+  output->resize(size);
+  message.SerializeWithCachedSizesToArray(
+      reinterpret_cast<::google::protobuf::uint8*>(&(*output)[0]));
+}
+
+}  // namespace
+
 Aggregated::Aggregated(const ::google::api::Service& service,
                        const ServerConfig* server_config,
                        ApiManagerEnvInterface* env,
@@ -168,7 +226,16 @@ Aggregated::Aggregated(const ::google::api::Service& service,
       url_(service_, server_config),
       mismatched_check_config_id(service.id()),
       mismatched_report_config_id(service.id()),
-      max_report_size_(0) {
+      max_report_size_(0),
+      grpc_transport_(server_config != nullptr &&
+                      server_config->service_control_config().grpc_transport()),
+      report_cache_entries_(0),
+      report_flush_interval_ms_(0),
+      report_flush_max_interval_ms_(0),
+      replaying_spilled_report_(false),
+      spilled_reports_(0),
+      replayed_spilled_reports_(0),
+      dropped_spilled_reports_(0) {
   if (sa_token_) {
     sa_token_->SetAudience(
         auth::ServiceAccountToken::JWT_TOKEN_FOR_SERVICE_CONTROL,
@@ -189,9 +256,22 @@ Aggregated::Aggregated(const std::set<std::string>& logs,
       service_control_proto_(logs, "", ""),
       url_(service_, server_config_),
       client_(std::move(client)),
-      max_report_size_(0) {}
-
-Aggregated::~Aggregated() {}
+      max_report_size_(0),
+      grpc_transport_(false),
+      report_cache_entries_(0),
+      report_flush_interval_ms_(0),
+      report_flush_max_interval_ms_(0),
+      replaying_spilled_report_(false),
+      spilled_reports_(0),
+      replayed_spilled_reports_(0),
+      dropped_spilled_reports_(0) {}
+
+Aggregated::~Aggregated() {
+  // The timers, and the timers of the client, call back into this object,
+  // and the client flushes its cache through it when destroyed, so they are
+  // shut down while all the members are still alive.
+  Close();
+}
 
 Status Aggregated::Init() {
   // Init() can be called repeatedly.
@@ -207,6 +287,10 @@ Status Aggregated::Init() {
       GetQuotaAggregationOptions(server_config_),
       GetReportAggregationOptions(server_config_));
 
+  InitAdaptiveReportFlush(&options);
+  report_cache_entries_ = options.report_options.num_entries;
+  report_flush_interval_ms_ = options.report_options.flush_interval_ms;
+
   std::stringstream ss;
   ss << "Check_aggregation_options: "
      << "num_entries: " << options.check_options.num_entries
@@ -215,6 +299,9 @@ Status Aggregated::Init() {
      << ", Report_aggregation_options: "
      << "num_entries: " << options.report_options.num_entries
      << ", flush_interval_ms: " << options.report_options.flush_interval_ms;
+  if (report_flush_) {
+    ss << ", adaptive up to: " << report_flush_max_interval_ms_;
+  }
   env_->LogInfo(ss.str().c_str());
 
   options.check_transport = [this](
@@ -232,34 +319,232 @@ Status Aggregated::Init() {
   options.periodic_timer = [this](int interval_ms,
                                   std::function<void()> callback)
       -> std::unique_ptr<::google::service_control_client::PeriodicTimer> {
+        if (report_flush_) {
+          // The client flushes the cached reports older than the report
+          // flush interval on every tick, so skipping ticks stretches the
+          // report batches to the adaptive interval.
+          callback = [this, callback]() {
+            if (report_flush_->ShouldFlush(std::chrono::steady_clock::now())) {
+              callback();
+            }
+          };
+        }
         return std::unique_ptr<::google::service_control_client::PeriodicTimer>(
             new ApiManagerPeriodicTimer(env_->StartPeriodicTimer(
                 std::chrono::milliseconds(interval_ms), callback)));
       };
   client_ = ::google::service_control_client::CreateServiceControlClient(
       service_->name(), service_->id(), options);
+
+  if (server_config_ != nullptr) {
+    const auto& quota_config =
+        server_config_->service_control_config().quota_aggregator_config();
+    if (quota_config.prealloc_chunk() > 0) {
+      const QuotaAggregationOptions& quota_options = options.quota_options;
+      QuotaTokenBuckets::Options bucket_options;
+      bucket_options.chunk = quota_config.prealloc_chunk();
+      bucket_options.lifetime = std::chrono::milliseconds(
+          quota_config.prealloc_lifetime_ms() > 0
+              ? quota_config.prealloc_lifetime_ms()
+              : kQuotaPreallocLifetimeMs);
+      bucket_options.backoff = std::chrono::milliseconds(
+          quota_options.refresh_interval_ms > 0
+              ? quota_options.refresh_interval_ms
+              : kQuotaAggregationRefreshMs);
+      bucket_options.max_buckets = quota_options.num_entries > 0
+                                       ? quota_options.num_entries
+                                       : kQuotaAggregationEntries;
+      quota_buckets_.reset(new QuotaTokenBuckets(bucket_options));
+    }
+  }
+
+  int refresh_min_hits = GetCheckRefreshAheadMinHits();
+  if (refresh_min_hits > 0 && options.check_options.num_entries > 0 &&
+      options.check_options.flush_interval_ms > 0) {
+    check_refresh_.reset(new CheckRefreshAhead(
+        options.check_options.num_entries,
+        std::chrono::milliseconds(options.check_options.flush_interval_ms),
+        refresh_min_hits));
+  }
+
+  int rollup_entries = GetReportRollupEntries();
+  if (rollup_entries > 0) {
+    int flush_interval_ms = options.report_options.flush_interval_ms > 0
+                                ? options.report_options.flush_interval_ms
+                                : kReportAggregationFlushIntervalMs;
+    report_rollup_.reset(new ReportRollup(
+        service_control_proto_.GetRollupMetrics(), rollup_entries));
+    report_rollup_timer_ =
+        env_->StartPeriodicTimer(std::chrono::milliseconds(flush_interval_ms),
+                                 [this]() { FlushReportRollup(); });
+  }
+
+  if (server_config_ != nullptr &&
+      !server_config_->service_control_config().report_spill_path().empty()) {
+    const auto& config = server_config_->service_control_config();
+    std::string error;
+    report_spill_ = ReportSpillQueue::Open(
+        config.report_spill_path(), config.report_spill_max_bytes() > 0
+                                        ? config.report_spill_max_bytes()
+                                        : kReportSpillMaxBytes,
+        &error);
+    if (report_spill_) {
+      report_spill_timer_ = env_->StartPeriodicTimer(
+          std::chrono::milliseconds(kReportSpillReplayIntervalMs),
+          [this]() { ReplaySpilledReports(kReportSpillReplayPerTick); });
+    } else {
+      env_->LogError(error);
+    }
+  }
   return Status::OK;
 }
 
+void Aggregated::InitAdaptiveReportFlush(
+    ServiceControlClientOptions* options) {
+  if (server_config_ == nullptr ||
+      !server_config_->service_control_config()
+           .has_report_aggregator_config()) {
+    return;
+  }
+  const auto& config =
+      server_config_->service_control_config().report_aggregator_config();
+  ReportAggregationOptions& report_options = options->report_options;
+  int min_interval_ms = report_options.flush_interval_ms;
+  int max_interval_ms = config.max_flush_interval_ms();
+  // The quota cache is refreshed from the same timer, so the quota refresh
+  // interval bounds the flush interval of services that use quota.
+  if (service_ && service_->quota().metric_rules_size() > 0) {
+    max_interval_ms = std::min(max_interval_ms,
+                               options->quota_options.refresh_interval_ms);
+  }
+  if (report_options.num_entries <= 0 || min_interval_ms <= 0 ||
+      max_interval_ms <= min_interval_ms) {
+    return;
+  }
+
+  // Keeps room for the reports of the longest interval.
+  int64_t num_entries = static_cast<int64_t>(report_options.num_entries) *
+                        max_interval_ms / min_interval_ms;
+  report_options.num_entries = static_cast<int>(
+      std::min<int64_t>(num_entries, std::numeric_limits<int>::max()));
+  report_flush_max_interval_ms_ = max_interval_ms;
+  report_flush_.reset(new AdaptiveFlushInterval(
+      min_interval_ms, max_interval_ms,
+      config.high_load_reports_per_sec() > 0
+          ? config.high_load_reports_per_sec()
+          : kReportHighLoadPerSec,
+      std::chrono::steady_clock::now()));
+}
+
 Status Aggregated::Close() {
+  if (report_rollup_timer_) {
+    report_rollup_timer_->Stop();
+    report_rollup_timer_.reset();
+  }
+  FlushReportRollup();
+  if (report_spill_timer_) {
+    report_spill_timer_->Stop();
+    report_spill_timer_.reset();
+  }
   // Just destroy the client to flush all its cache.
   client_.reset();
   return Status::OK;
 }
 
+std::string Aggregated::AllocReportBody() {
+  std::string body;
+  std::lock_guard<std::mutex> lock(report_bodies_mutex_);
+  if (!report_bodies_.empty()) {
+    body.swap(report_bodies_.back());
+    report_bodies_.pop_back();
+    body.clear();
+  }
+  return body;
+}
+
+void Aggregated::FreeReportBody(std::string* body) {
+  std::lock_guard<std::mutex> lock(report_bodies_mutex_);
+  if (report_bodies_.size() < kReportBodyPoolSize) {
+    report_bodies_.emplace_back();
+    report_bodies_.back().swap(*body);
+  }
+}
+
+void Aggregated::SpillReport(const std::string& body, bool compressed) {
+  if (report_spill_->Push(body, compressed)) {
+    ++spilled_reports_;
+  } else {
+    ++dropped_spilled_reports_;
+    env_->LogError("Report spill file " + report_spill_->path() +
+                   " is full, dropping a report");
+  }
+}
+
+void Aggregated::ReplaySpilledReports(int count) {
+  std::string body;
+  bool compressed;
+  if (count <= 0 || replaying_spilled_report_ ||
+      !report_spill_->Front(&body, &compressed)) {
+    return;
+  }
+  replaying_spilled_report_ = true;
+  std::unique_ptr<HTTPRequest> http_request(new HTTPRequest(
+      [this, count](Status status, std::map<std::string, std::string>&&,
+                    std::string&&) {
+        replaying_spilled_report_ = false;
+        if (!status.ok() && IsRetriableReportFailure(status.code())) {
+          // Still unreachable, so the report is retried on the next tick.
+          return;
+        }
+        if (status.ok()) {
+          ++replayed_spilled_reports_;
+        } else {
+          ++dropped_spilled_reports_;
+          env_->LogError("Spilled report rejected: " + status.ToString());
+        }
+        report_spill_->Pop();
+        ReplaySpilledReports(count - 1);
+      }));
+
+  http_request->set_url(url_.report_url())
+      .set_method("POST")
+      .set_auth_token(GetAuthToken<ReportRequest>())
+      .set_header("Content-Type", application_proto)
+      .set_body(std::move(body));
+  if (compressed) {
+    http_request->set_header("Content-Encoding", gzip_encoding);
+  }
+  http_request->set_timeout_ms(GetHttpRequestTimeout<ReportRequest>());
+
+  env_->RunHTTPRequest(std::move(http_request));
+}
+
 Status Aggregated::Report(const ReportRequestInfo& info) {
   if (!client_) {
     return Status(Code::INTERNAL, "Missing service control client");
   }
+  if (report_flush_) {
+    report_flush_->AddReport();
+  }
   auto request = report_pool_.Alloc();
-  Status status = service_control_proto_.FillReportRequest(info, request.get());
-  if (!status.ok()) {
-    report_pool_.Free(std::move(request));
-    return status;
+  Status status =
+      report_rollup_
+          ? service_control_proto_.RollupReportRequest(
+                info, report_rollup_.get(), request.get())
+          : service_control_proto_.FillReportRequest(info, request.get());
+  if (status.ok() && request->operations_size() > 0) {
+    SendReport(*request);
   }
+  // There is no reference to request anymore at this point and it is safe to
+  // free request now.
+  report_pool_.Free(std::move(request));
+  return status;
+}
+
+void Aggregated::SendReport(const ReportRequest& request) {
   ReportResponse* response = new ReportResponse;
   client_->Report(
-      *request, response,
+      request, response,
       [this, response](const ::google::protobuf::util::Status& status) {
         if (service_control_proto_.service_config_id() !=
             response->service_config_id()) {
@@ -278,10 +563,19 @@ Status Aggregated::Report(const ReportRequestInfo& info) {
         }
         delete response;
       });
-  // There is no reference to request anymore at this point and it is safe to
-  // free request now.
+}
+
+void Aggregated::FlushReportRollup() {
+  if (!client_ || !report_rollup_) {
+    return;
+  }
+  auto request = report_pool_.Alloc();
+  if (report_rollup_->Flush(request.get()) > 0) {
+    request->set_service_name(service_control_proto_.service_name());
+    request->set_service_config_id(service_control_proto_.service_config_id());
+    SendReport(*request);
+  }
   report_pool_.Free(std::move(request));
-  return Status::OK;
 }
 
 void Aggregated::Check(
@@ -303,6 +597,17 @@ void Aggregated::Check(
     return;
   }
 
+  // A due refresh is sent first, so that the request is served from the
+  // cache while it is in flight.
+  std::string refresh_key;
+  if (check_refresh_) {
+    refresh_key = GetCheckRefreshKey(info);
+    if (check_refresh_->Hit(refresh_key, std::chrono::steady_clock::now())) {
+      RefreshCheck(*request, refresh_key);
+    }
+  }
+
+  call_stats_.CountCacheLookup(RPC_CHECK);
   CheckResponse* response = new CheckResponse;
   bool allow_unregistered_calls = info.allow_unregistered_calls;
 
@@ -353,15 +658,49 @@ void Aggregated::Check(
 
   client_->Check(
       *request, response, check_on_done,
-      [trace_span, this](const CheckRequest& request, CheckResponse* response,
-                         TransportDoneFunc on_done) {
-        Call(request, response, on_done, trace_span.get());
+      [trace_span, refresh_key, this](const CheckRequest& request,
+                                      CheckResponse* response,
+                                      TransportDoneFunc on_done) {
+        call_stats_.CountCacheMiss(RPC_CHECK);
+        Call(request, response, OnCheckRefreshed(refresh_key, on_done),
+             trace_span.get());
       });
   // There is no reference to request anymore at this point and it is safe to
   // free request now.
   check_pool_.Free(std::move(request));
 }
 
+void Aggregated::RefreshCheck(const CheckRequest& request,
+                              const std::string& key) {
+  CheckResponse* response = new CheckResponse;
+  // The client sends the request from within Check() if the cached response
+  // is due for a refresh, and serves it from the cache otherwise.
+  std::shared_ptr<bool> sent(new bool(false));
+  client_->Check(
+      request, response,
+      [response](const ::google::protobuf::util::Status&) { delete response; },
+      [key, sent, this](const CheckRequest& request, CheckResponse* response,
+                        TransportDoneFunc on_done) {
+        *sent = true;
+        Call(request, response, OnCheckRefreshed(key, on_done), nullptr);
+      });
+  if (!*sent) {
+    check_refresh_->Cancel(key);
+  }
+}
+
+TransportDoneFunc Aggregated::OnCheckRefreshed(const std::string& key,
+                                               TransportDoneFunc on_done) {
+  if (!check_refresh_) {
+    return on_done;
+  }
+  // Runs after on_done, which caches the response.
+  return [key, on_done, this](const ::google::protobuf::util::Status& status) {
+    on_done(status);
+    check_refresh_->Refreshed(key, std::chrono::steady_clock::now());
+  };
+}
+
 void Aggregated::Quota(const QuotaRequestInfo& info,
                        cloud_trace::CloudTraceSpan* parent_span,
                        std::function<void(utils::Status)> on_done) {
@@ -383,6 +722,42 @@ void Aggregated::Quota(const QuotaRequestInfo& info,
     return;
   }
 
+  if (quota_buckets_ && info.metric_cost_vector != nullptr &&
+      !info.metric_cost_vector->empty()) {
+    const std::string& consumer = request->allocate_operation().consumer_id();
+    bool refill = false;
+    switch (quota_buckets_->Acquire(consumer, *info.metric_cost_vector,
+                                    std::chrono::steady_clock::now(),
+                                    &refill)) {
+      case QuotaTokenBuckets::ACQUIRED:
+        TRACE(trace_span) << "Quota allocated locally";
+        if (refill) {
+          RefillQuota(*request, *info.metric_cost_vector, nullptr, nullptr);
+        }
+        quota_pool_.Free(std::move(request));
+        on_done(Status::OK);
+        return;
+      case QuotaTokenBuckets::REFILL:
+        RefillQuota(*request, *info.metric_cost_vector, trace_span, on_done);
+        quota_pool_.Free(std::move(request));
+        return;
+      case QuotaTokenBuckets::MISS:
+        break;
+    }
+  }
+
+  AllocateQuota(*request, trace_span, on_done);
+
+  // There is no reference to request anymore at this point and it is safe to
+  // free request now.
+  quota_pool_.Free(std::move(request));
+}
+
+void Aggregated::AllocateQuota(
+    const AllocateQuotaRequest& request,
+    std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+    std::function<void(utils::Status)> on_done) {
+  call_stats_.CountCacheLookup(RPC_ALLOCATE_QUOTA);
   AllocateQuotaResponse* response = new AllocateQuotaResponse();
 
   auto quota_on_done = [this, response, on_done, trace_span](
@@ -401,16 +776,68 @@ void Aggregated::Quota(const QuotaRequestInfo& info,
     delete response;
   };
 
-  client_->Quota(*request, response, quota_on_done,
+  client_->Quota(request, response, quota_on_done,
                  [trace_span, this](const AllocateQuotaRequest& request,
                                     AllocateQuotaResponse* response,
                                     TransportDoneFunc on_done) {
+                   call_stats_.CountCacheMiss(RPC_ALLOCATE_QUOTA);
                    Call(request, response, on_done, trace_span.get());
                  });
+}
 
-  // There is no reference to request anymore at this point and it is safe to
-  // free request now.
-  quota_pool_.Free(std::move(request));
+void Aggregated::RefillQuota(
+    const AllocateQuotaRequest& request, const QuotaTokenBuckets::Costs& costs,
+    std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+    std::function<void(utils::Status)> on_done) {
+  // The refill is allocated all or nothing, straight from the server: the
+  // quota cache of the client would not tell whether it was granted.
+  std::shared_ptr<AllocateQuotaRequest> original(
+      new AllocateQuotaRequest(request));
+  AllocateQuotaRequest refill_request(request);
+  auto* operation = refill_request.mutable_allocate_operation();
+  // The server dedupes allocations by operation_id, so the refill must not
+  // share it with the fallback allocation of the original request.
+  operation->set_operation_id(GenerateUUID());
+  operation->set_quota_mode(
+      ::google::api::servicecontrol::v1::QuotaOperation_QuotaMode::
+          QuotaOperation_QuotaMode_NORMAL);
+  QuotaTokenBuckets::Costs refill_costs = quota_buckets_->GetRefillCosts(costs);
+  for (int i = 0; i < operation->quota_metrics_size(); ++i) {
+    operation->mutable_quota_metrics(i)
+        ->mutable_metric_values(0)
+        ->set_int64_value(refill_costs[i].second);
+  }
+
+  AllocateQuotaResponse* response = new AllocateQuotaResponse();
+  std::string consumer = operation->consumer_id();
+  auto refill_on_done = [this, original, response, consumer, costs,
+                         trace_span, on_done](
+      const ::google::protobuf::util::Status& status) {
+    Status result = status.ok()
+                        ? Proto::ConvertAllocateQuotaResponse(
+                              *response, service_control_proto_.service_name())
+                        : Status::FromProto(status);
+    delete response;
+    TRACE(trace_span) << "Quota refill returned with status: "
+                      << result.ToString();
+
+    auto now = std::chrono::steady_clock::now();
+    if (result.ok()) {
+      quota_buckets_->Refilled(consumer, costs, on_done != nullptr, now);
+      if (on_done) {
+        on_done(Status::OK);
+      }
+      return;
+    }
+    quota_buckets_->RefillFailed(
+        consumer, costs, result.code() == Code::RESOURCE_EXHAUSTED, now);
+    if (on_done) {
+      // Allocates the cost of the request alone, as without pre-allocation.
+      AllocateQuota(*original, trace_span, on_done);
+    }
+  };
+
+  Call(refill_request, response, refill_on_done, trace_span.get());
 }
 
 Status Aggregated::GetStatistics(Statistics* esp_stat) const {
@@ -433,10 +860,44 @@ Status Aggregated::GetStatistics(Statistics* esp_stat) const {
   esp_stat->send_reports_in_flight = client_stat.send_reports_in_flight;
   esp_stat->send_report_operations = client_stat.send_report_operations;
   esp_stat->max_report_size = max_report_size_;
+  esp_stat->check_request_allocs = check_pool_.allocs();
+  esp_stat->check_request_reuses = check_pool_.reuses();
+  esp_stat->quota_request_allocs = quota_pool_.allocs();
+  esp_stat->quota_request_reuses = quota_pool_.reuses();
+  esp_stat->report_request_allocs = report_pool_.allocs();
+  esp_stat->report_request_reuses = report_pool_.reuses();
+  esp_stat->refreshed_ahead_checks =
+      check_refresh_ ? check_refresh_->refreshes() : 0;
+  esp_stat->local_quota_allocations =
+      quota_buckets_ ? quota_buckets_->local_allocations() : 0;
+  esp_stat->quota_preallocations =
+      quota_buckets_ ? quota_buckets_->refills() : 0;
+  esp_stat->spilled_reports = spilled_reports_;
+  esp_stat->replayed_spilled_reports = replayed_spilled_reports_;
+  esp_stat->dropped_spilled_reports = dropped_spilled_reports_;
+  esp_stat->rolled_up_reports =
+      report_rollup_ ? report_rollup_->rolled_up_reports() : 0;
+  esp_stat->rolled_up_operations =
+      report_rollup_ ? report_rollup_->flushed_operations() : 0;
+  esp_stat->report_cache_entries = report_cache_entries_;
+  esp_stat->report_flush_interval_ms =
+      report_flush_ ? report_flush_->interval_ms() : report_flush_interval_ms_;
+  call_stats_.GetStatistics(esp_stat);
 
   return Status::OK;
 }
 
+template <class RequestType>
+Rpc Aggregated::GetRpc() {
+  if (typeid(RequestType) == typeid(CheckRequest)) {
+    return RPC_CHECK;
+  } else if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return RPC_ALLOCATE_QUOTA;
+  } else {
+    return RPC_REPORT;
+  }
+}
+
 template <class RequestType>
 const std::string& Aggregated::GetApiReqeustUrl() {
   if (typeid(RequestType) == typeid(CheckRequest)) {
@@ -448,6 +909,27 @@ const std::string& Aggregated::GetApiReqeustUrl() {
   }
 }
 
+template <class RequestType>
+const char* Aggregated::GetGrpcService() {
+  // Skips the leading '/' of the audience.
+  if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return quotacontrol_service + 1;
+  } else {
+    return servicecontrol_service + 1;
+  }
+}
+
+template <class RequestType>
+const char* Aggregated::GetGrpcMethod() {
+  if (typeid(RequestType) == typeid(CheckRequest)) {
+    return "Check";
+  } else if (typeid(RequestType) == typeid(AllocateQuotaRequest)) {
+    return "AllocateQuota";
+  } else {
+    return "Report";
+  }
+}
+
 template <class RequestType>
 int Aggregated::GetHttpRequestTimeout() {
   int timeout_ms = 0;
@@ -482,6 +964,33 @@ int Aggregated::GetHttpRequestTimeout() {
   return timeout_ms;
 }
 
+int Aggregated::GetCheckRefreshAheadMinHits() const {
+  if (server_config_ != nullptr &&
+      server_config_->has_service_control_config()) {
+    return server_config_->service_control_config()
+        .check_aggregator_config()
+        .refresh_ahead_min_hits();
+  }
+  return 0;
+}
+
+int Aggregated::GetReportRollupEntries() const {
+  if (server_config_ != nullptr &&
+      server_config_->has_service_control_config()) {
+    return server_config_->service_control_config().report_rollup_entries();
+  }
+  return 0;
+}
+
+int Aggregated::GetReportCompressionMinBytes() const {
+  if (server_config_ != nullptr &&
+      server_config_->has_service_control_config()) {
+    return server_config_->service_control_config()
+        .report_compression_min_bytes();
+  }
+  return 0;
+}
+
 template <class RequestType>
 const std::string& Aggregated::GetAuthToken() {
   if (sa_token_) {
@@ -505,14 +1014,69 @@ void Aggregated::Call(const RequestType& request, ResponseType* response,
   std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span(
       CreateChildSpan(parent_span, "Call ServiceControl server"));
 
+  auto serialize_start = std::chrono::steady_clock::now();
+  std::string request_body;
+  bool compressed = false;
+  if (typeid(RequestType) == typeid(ReportRequest)) {
+    // Also caches the sizes of the request, for the serialization.
+    size_t request_size = request.ByteSizeLong();
+    if (request_size > max_report_size_) {
+      max_report_size_ = request_size;
+    }
+    request_body = AllocReportBody();
+    // gRPC channels negotiate their own compression.
+    int min_bytes = GetReportCompressionMinBytes();
+    if (!grpc_transport_ && min_bytes > 0 &&
+        request_size >= static_cast<size_t>(min_bytes)) {
+      compressed = SerializeToGzip(request, &request_body);
+    }
+    if (!compressed) {
+      SerializeWithCachedSizes(request, request_size, &request_body);
+    }
+  } else {
+    request.SerializeToString(&request_body);
+  }
+  call_stats_.RecordRequest(
+      GetRpc<RequestType>(),
+      std::chrono::steady_clock::now() - serialize_start, request_body.size());
+
+  if (grpc_transport_) {
+    CallGRPC<RequestType>(std::move(request_body), response, on_done,
+                          trace_span);
+  } else {
+    CallHTTP<RequestType>(std::move(request_body), compressed, response,
+                          on_done, trace_span);
+  }
+}
+
+template <class RequestType, class ResponseType>
+void Aggregated::CallHTTP(std::string&& request_body, bool compressed,
+                          ResponseType* response, TransportDoneFunc on_done,
+                          std::shared_ptr<cloud_trace::CloudTraceSpan>
+                              trace_span) {
   const std::string& url = GetApiReqeustUrl<RequestType>();
   TRACE(trace_span) << "Http request URL: " << url;
 
-  std::unique_ptr<HTTPRequest> http_request(new HTTPRequest([url, response,
-                                                             on_done,
-                                                             trace_span, this](
-      Status status, std::map<std::string, std::string>&&, std::string&& body) {
+  // Points to a Report request once it is created, so that an undelivered
+  // Report is spilled from its body instead of a copy, and so that its body
+  // buffer is reused.
+  std::shared_ptr<HTTPRequest*> report_request;
+  if (typeid(RequestType) == typeid(ReportRequest)) {
+    report_request.reset(new HTTPRequest*(nullptr));
+  }
+
+  auto sent = std::chrono::steady_clock::now();
+  std::unique_ptr<HTTPRequest> http_request(new HTTPRequest([
+    url, response, on_done, trace_span, report_request, compressed, sent, this
+  ](Status status, std::map<std::string, std::string>&&, std::string&& body) {
     TRACE(trace_span) << "HTTP response status: " << status.ToString();
+    if (report_request) {
+      if (report_spill_ && !status.ok() &&
+          IsRetriableReportFailure(status.code())) {
+        SpillReport((*report_request)->body(), compressed);
+      }
+      FreeReportBody((*report_request)->mutable_body());
+    }
     if (status.ok()) {
       // Handle 200 response
       if (!response->ParseFromString(body)) {
@@ -534,32 +1098,110 @@ void Aggregated::Call(const RequestType& request, ResponseType* response,
                        std::to_string(status.code()));
       }
     }
+    call_stats_.RecordResponse(GetRpc<RequestType>(),
+                               std::chrono::steady_clock::now() - sent,
+                               body.size(), status.ok());
     on_done(status.ToProto());
   }));
 
-  std::string request_body;
-  request.SerializeToString(&request_body);
-
-  if ((typeid(RequestType) == typeid(ReportRequest)) &&
-      (request_body.size() > max_report_size_)) {
-    max_report_size_ = request_body.size();
-  }
-
   http_request->set_url(url)
       .set_method("POST")
       .set_auth_token(GetAuthToken<RequestType>())
       .set_header("Content-Type", application_proto)
-      .set_body(request_body);
+      .set_body(std::move(request_body));
+  if (compressed) {
+    http_request->set_header("Content-Encoding", gzip_encoding);
+  }
 
   http_request->set_timeout_ms(GetHttpRequestTimeout<RequestType>());
+  if (report_request) {
+    *report_request = http_request.get();
+  }
 
   env_->RunHTTPRequest(std::move(http_request));
 }
 
+template <class RequestType, class ResponseType>
+void Aggregated::CallGRPC(std::string&& request_body, ResponseType* response,
+                          TransportDoneFunc on_done,
+                          std::shared_ptr<cloud_trace::CloudTraceSpan>
+                              trace_span) {
+  std::string method = std::string("/") + GetGrpcService<RequestType>() +
+                       "/" + GetGrpcMethod<RequestType>();
+  TRACE(trace_span) << "gRPC request: " << url_.grpc_server() << method;
+
+  // Points to the request once it is created, so that its body is moved out
+  // if the call has to be resent over HTTP, spilled from it, and otherwise
+  // given back to the pool of Report bodies.
+  std::shared_ptr<GRPCRequest*> sent_request(new GRPCRequest*(nullptr));
+  auto sent = std::chrono::steady_clock::now();
+  std::unique_ptr<GRPCRequest> grpc_request(new GRPCRequest(
+      [method, response, on_done, trace_span, sent_request, sent, this](
+          Status status, std::string&& body) {
+        TRACE(trace_span) << "gRPC response status: " << status.ToString();
+        if (status.code() == Code::UNIMPLEMENTED) {
+          if (grpc_transport_.exchange(false)) {
+            env_->LogWarning(
+                "gRPC is not supported, calling service control over HTTP");
+          }
+          CallHTTP<RequestType>(std::move(*(*sent_request)->mutable_body()),
+                                false, response, on_done, trace_span);
+          return;
+        }
+        if (status.ok()) {
+          if (!response->ParseFromString(body)) {
+            status =
+                Status(Code::INVALID_ARGUMENT, std::string("Invalid response"));
+          }
+        } else {
+          env_->LogError(std::string("Failed to call ") + url_.grpc_server() +
+                         method + ", Error: " + status.ToString());
+          if (report_spill_ && typeid(RequestType) == typeid(ReportRequest) &&
+              (status.code() == Code::UNAVAILABLE ||
+               status.code() == Code::DEADLINE_EXCEEDED)) {
+            SpillReport((*sent_request)->body(), false);
+          }
+          status = Status(Code::UNAVAILABLE,
+                          "Service control request failed with gRPC status " +
+                              std::to_string(status.code()));
+        }
+        if (typeid(RequestType) == typeid(ReportRequest)) {
+          FreeReportBody((*sent_request)->mutable_body());
+        }
+        call_stats_.RecordResponse(GetRpc<RequestType>(),
+                                   std::chrono::steady_clock::now() - sent,
+                                   body.size(), status.ok());
+        on_done(status.ToProto());
+      }));
+
+  grpc_request->set_server(url_.grpc_server())
+      .set_secure(url_.grpc_secure())
+      .set_service(GetGrpcService<RequestType>())
+      .set_method(GetGrpcMethod<RequestType>())
+      .set_auth_token(GetAuthToken<RequestType>())
+      .set_body(std::move(request_body))
+      .set_timeout_ms(GetHttpRequestTimeout<RequestType>());
+  *sent_request = grpc_request.get();
+
+  env_->RunGRPCRequest(std::move(grpc_request));
+}
+
 Interface* Aggregated::Create(const ::google::api::Service& service,
                               const ServerConfig* server_config,
                               ApiManagerEnvInterface* env,
                               auth::ServiceAccountToken* sa_token) {
+  std::set<std::string> logs, metrics, labels;
+  Status s = LogsMetricsLoader::Load(service, &logs, &metrics, &labels);
+  return Create(service, server_config, env, sa_token, logs, metrics, labels);
+}
+
+Interface* Aggregated::Create(const ::google::api::Service& service,
+                              const ServerConfig* server_config,
+                              ApiManagerEnvInterface* env,
+                              auth::ServiceAccountToken* sa_token,
+                              const std::set<std::string>& logs,
+                              const std::set<std::string>& metrics,
+                              const std::set<std::string>& labels) {
   if (server_config &&
       server_config->service_control_config().force_disable()) {
     env->LogError("Service control is disabled.");
@@ -571,8 +1213,6 @@ Interface* Aggregated::Create(const ::google::api::Service& service,
         "Service control address is not specified. Disabling API management.");
     return nullptr;
   }
-  std::set<std::string> logs, metrics, labels;
-  Status s = LogsMetricsLoader::Load(service, &logs, &metrics, &labels);
   return new Aggregated(service, server_config, env, sa_token, logs, metrics,
                         labels);
 }
@@ -15,20 +15,30 @@
 #ifndef API_MANAGER_SERVICE_CONTROL_AGGREGATED_H_
 #define API_MANAGER_SERVICE_CONTROL_AGGREGATED_H_
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "contrib/endpoints/include/api_manager/env_interface.h"
 #include "contrib/endpoints/src/api_manager/auth/service_account_token.h"
 #include "contrib/endpoints/src/api_manager/cloud_trace/cloud_trace.h"
 #include "contrib/endpoints/src/api_manager/proto/server_config.pb.h"
+#include "contrib/endpoints/src/api_manager/service_control/adaptive_flush_interval.h"
+#include "contrib/endpoints/src/api_manager/service_control/call_stats.h"
+#include "contrib/endpoints/src/api_manager/service_control/check_refresh_ahead.h"
 #include "contrib/endpoints/src/api_manager/service_control/interface.h"
 #include "contrib/endpoints/src/api_manager/service_control/proto.h"
+#include "contrib/endpoints/src/api_manager/service_control/proto_pool.h"
+#include "contrib/endpoints/src/api_manager/service_control/quota_token_buckets.h"
+#include "contrib/endpoints/src/api_manager/service_control/report_rollup.h"
+#include "contrib/endpoints/src/api_manager/service_control/report_spill_queue.h"
 #include "contrib/endpoints/src/api_manager/service_control/url.h"
 #include "google/api/service.pb.h"
 #include "google/api/servicecontrol/v1/quota_controller.pb.h"
 #include "google/api/servicecontrol/v1/service_controller.pb.h"
 #include "include/service_control_client.h"
 
-#include <list>
-#include <mutex>
 
 namespace google {
 namespace api_manager {
@@ -42,6 +52,16 @@ class Aggregated : public Interface {
                            ApiManagerEnvInterface* env,
                            auth::ServiceAccountToken* sa_token);
 
+  // Same as above, but with the logs, metrics and labels already loaded from
+  // the service config by LogsMetricsLoader.
+  static Interface* Create(const ::google::api::Service& service,
+                           const proto::ServerConfig* server_config,
+                           ApiManagerEnvInterface* env,
+                           auth::ServiceAccountToken* sa_token,
+                           const std::set<std::string>& logs,
+                           const std::set<std::string>& metrics,
+                           const std::set<std::string>& labels);
+
   virtual ~Aggregated();
 
   virtual utils::Status Report(const ReportRequestInfo& info);
@@ -77,25 +97,6 @@ class Aggregated : public Interface {
     std::unique_ptr<::google::api_manager::PeriodicTimer> esp_timer_;
   };
 
-  // The protobuf pool to reuse protobuf. Performance tests showed that reusing
-  // protobuf is faster than allocating a new protobuf.
-  template <class Type>
-  class ProtoPool {
-   public:
-    // Allocates a protobuf. If there is one in the pool, uses it, otherwise
-    // creates a new one.
-    std::unique_ptr<Type> Alloc();
-    // Frees a protobuf. If pool did not reach maximum size, stores it in the
-    // pool, otherwise frees it.
-    void Free(std::unique_ptr<Type> item);
-
-   private:
-    // Protobuf pool to store used protobufs.
-    std::list<std::unique_ptr<Type>> pool_;
-    // Mutex to protect the protobuf pool.
-    std::mutex mutex_;
-  };
-
   friend class AggregatedTestWithMockedClient;
   // Constructor for unit-test only.
   Aggregated(
@@ -116,6 +117,30 @@ class Aggregated : public Interface {
             ::google::service_control_client::TransportDoneFunc on_done,
             cloud_trace::CloudTraceSpan* parent_span);
 
+  // Sends a serialized request to service control over HTTP.
+  template <class RequestType, class ResponseType>
+  void CallHTTP(std::string&& request_body, bool compressed,
+                ResponseType* response,
+                ::google::service_control_client::TransportDoneFunc on_done,
+                std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span);
+
+  // Sends a serialized request to service control as a gRPC call. Falls
+  // back to HTTP for good if the environment does not support gRPC.
+  template <class RequestType, class ResponseType>
+  void CallGRPC(std::string&& request_body, ResponseType* response,
+                ::google::service_control_client::TransportDoneFunc on_done,
+                std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span);
+
+  // Returns the gRPC service and method names based on RequestType
+  template <class RequestType>
+  const char* GetGrpcService();
+  template <class RequestType>
+  const char* GetGrpcMethod();
+
+  // Returns the Rpc based on RequestType
+  template <class RequestType>
+  Rpc GetRpc();
+
   // Returns API request url based on RequestType
   template <class RequestType>
   const std::string& GetApiReqeustUrl();
@@ -124,6 +149,68 @@ class Aggregated : public Interface {
   template <class RequestType>
   int GetHttpRequestTimeout();
 
+  // Returns the minimum size of the Report requests to compress, or 0 if
+  // they are not compressed.
+  int GetReportCompressionMinBytes() const;
+
+  // Sets up adaptive report flushing, if enabled, and sizes the report cache
+  // for it.
+  void InitAdaptiveReportFlush(
+      ::google::service_control_client::ServiceControlClientOptions* options);
+
+  // Allocates quota through the quota cache of the service control client.
+  void AllocateQuota(
+      const ::google::api::servicecontrol::v1::AllocateQuotaRequest& request,
+      std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+      std::function<void(utils::Status)> on_done);
+
+  // Pre-allocates quota for the buckets of request from the server. If
+  // on_done is set, the cost of the request is taken from the refill, or
+  // allocated on its own if the refill fails, and on_done is called with
+  // the result. Otherwise the buckets are refilled in the background.
+  void RefillQuota(
+      const ::google::api::servicecontrol::v1::AllocateQuotaRequest& request,
+      const QuotaTokenBuckets::Costs& costs,
+      std::shared_ptr<cloud_trace::CloudTraceSpan> trace_span,
+      std::function<void(utils::Status)> on_done);
+
+  // Returns the minimum hits of a cached check response for it to be
+  // refreshed ahead, or 0 if check responses are not refreshed ahead.
+  int GetCheckRefreshAheadMinHits() const;
+
+  // Sends a Check request in the background to refresh its cached response.
+  void RefreshCheck(
+      const ::google::api::servicecontrol::v1::CheckRequest& request,
+      const std::string& key);
+
+  // Returns on_done, wrapped to record that the cached response of key was
+  // refreshed, if check responses are refreshed ahead.
+  ::google::service_control_client::TransportDoneFunc OnCheckRefreshed(
+      const std::string& key,
+      ::google::service_control_client::TransportDoneFunc on_done);
+
+  // Returns the maximum number of entries of the report rollup, or 0 if
+  // reports are not rolled up.
+  int GetReportRollupEntries() const;
+
+  // Sends a Report request through the service control client.
+  void SendReport(const ::google::api::servicecontrol::v1::ReportRequest&
+                      request);
+
+  // Sends the operations rolled up since the last flush.
+  void FlushReportRollup();
+
+  // Returns an empty Report body, reusing the buffer of an earlier one if
+  // any, and takes back the buffer of a body that was sent.
+  std::string AllocReportBody();
+  void FreeReportBody(std::string* body);
+
+  // Keeps a Report request that could not be delivered, to replay it later.
+  void SpillReport(const std::string& body, bool compressed);
+
+  // Replays up to "count" spilled Report requests, one after the other.
+  void ReplaySpilledReports(int count);
+
   // Returns API request auth token based on RequestType
   template <class RequestType>
   const std::string& GetAuthToken();
@@ -158,6 +245,9 @@ class Aggregated : public Interface {
   // The protobuf pool to reuse ReportRequest protobuf.
   ProtoPool<::google::api::servicecontrol::v1::ReportRequest> report_pool_;
 
+  // The latencies, sizes and cache hits of the calls to the server.
+  CallStats call_stats_;
+
   // Mismatched config ID received for a check request
   std::string mismatched_check_config_id;
 
@@ -166,6 +256,43 @@ class Aggregated : public Interface {
 
   // Maximum report size send to server.
   uint64_t max_report_size_;
+
+  // Whether requests are sent as gRPC calls instead of HTTP requests.
+  // Cleared by a gRPC callback, read when a call is made.
+  std::atomic<bool> grpc_transport_;
+
+  // The report cache size and flush interval the client was created with.
+  int report_cache_entries_;
+  int report_flush_interval_ms_;
+  // Picks the report flush interval from the load, if enabled.
+  std::unique_ptr<AdaptiveFlushInterval> report_flush_;
+  // The longest adaptive report flush interval.
+  int report_flush_max_interval_ms_;
+
+  // Decides which cached check responses to refresh ahead, if enabled.
+  std::unique_ptr<CheckRefreshAhead> check_refresh_;
+
+  // Holds pre-allocated quota, if enabled.
+  std::unique_ptr<QuotaTokenBuckets> quota_buckets_;
+
+  // Rolls up the metrics of reports, if enabled.
+  std::unique_ptr<ReportRollup> report_rollup_;
+  // The timer to flush report_rollup_.
+  std::unique_ptr<PeriodicTimer> report_rollup_timer_;
+
+  // Holds the Report requests that could not be delivered, if enabled.
+  std::unique_ptr<ReportSpillQueue> report_spill_;
+  // The timer to replay report_spill_.
+  std::unique_ptr<PeriodicTimer> report_spill_timer_;
+  // Whether a spilled Report request is being replayed.
+  bool replaying_spilled_report_;
+  uint64_t spilled_reports_;
+  uint64_t replayed_spilled_reports_;
+  uint64_t dropped_spilled_reports_;
+
+  // The buffers of sent Report bodies, reused for the next ones.
+  std::mutex report_bodies_mutex_;
+  std::vector<std::string> report_bodies_;
 };
 
 }  // namespace service_control
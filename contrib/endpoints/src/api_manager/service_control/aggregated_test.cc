@@ -22,6 +22,12 @@
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
 using ::google::api::servicecontrol::v1::CheckRequest;
 using ::google::api::servicecontrol::v1::CheckResponse;
 using ::google::api::servicecontrol::v1::AllocateQuotaRequest;
@@ -239,6 +245,265 @@ TEST_F(AggregatedTestWithRealClient, CheckOKTest) {
   EXPECT_EQ(stat.send_checks_by_flush, 0);
   EXPECT_EQ(stat.send_checks_in_flight, 1);
   EXPECT_EQ(stat.send_report_operations, 0);
+  EXPECT_EQ(stat.check_request_allocs, 1);
+  EXPECT_EQ(stat.report_request_allocs, 0);
+  EXPECT_EQ(stat.check_cache_hits, 0);
+  EXPECT_EQ(stat.check_cache_misses, 1);
+  EXPECT_EQ(stat.rpc_latency[RPC_CHECK].count, 1);
+  EXPECT_EQ(stat.rpc_failures[RPC_CHECK], 0);
+  EXPECT_EQ(stat.serialize_latency[RPC_CHECK].count, 1);
+  EXPECT_GT(stat.request_bytes[RPC_CHECK], 0);
+  EXPECT_EQ(stat.response_bytes[RPC_CHECK], 0);
+  EXPECT_EQ(stat.rpc_latency[RPC_REPORT].count, 0);
+}
+
+// Sets up a service, a server config and an env for the tests of the server
+// config options. The tests fill the config and set up the env, then call
+// Create().
+class AggregatedTestWithServerConfig : public ::testing::Test {
+ public:
+  void SetUp() {
+    service_.set_name("test_service");
+    service_.mutable_control()->set_environment(
+        "servicecontrol.googleapis.com");
+    config_ = server_config_.mutable_service_control_config();
+  }
+
+  // Disables the report aggregation, so that reports are sent at once.
+  void DisableReportAggregation() {
+    config_->mutable_report_aggregator_config()->set_cache_entries(0);
+    config_->mutable_report_aggregator_config()->set_flush_interval_ms(1000);
+  }
+
+  // Creates the client from the server config and initializes it.
+  void Create() {
+    sc_lib_.reset(
+        Aggregated::Create(service_, &server_config_, &env_, nullptr));
+    ASSERT_TRUE((bool)(sc_lib_));
+    sc_lib_->Init();
+  }
+
+  ::google::api::Service service_;
+  proto::ServerConfig server_config_;
+  proto::ServiceControlConfig* config_;
+  ::testing::NiceMock<MockApiManagerEnvironment> env_;
+  std::unique_ptr<Interface> sc_lib_;
+};
+
+TEST_F(AggregatedTestWithServerConfig, CompressesLargeReports) {
+  config_->set_report_compression_min_bytes(1);
+  DisableReportAggregation();
+
+  EXPECT_CALL(env_, DoRunHTTPRequest(_)).WillOnce(Invoke([](HTTPRequest* req) {
+    auto it = req->request_headers().find("Content-Encoding");
+    ASSERT_TRUE(it != req->request_headers().end());
+    EXPECT_EQ("gzip", it->second);
+    // The gzip magic number.
+    EXPECT_EQ(0, req->body().compare(0, 2, "\x1f\x8b"));
+    std::map<std::string, std::string> headers;
+    req->OnComplete(Status::OK, std::move(headers), "");
+  }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
+}
+
+TEST_F(AggregatedTestWithServerConfig, RollsUpReportsOfOneOperation) {
+  config_->set_report_rollup_entries(10);
+  DisableReportAggregation();
+
+  ReportRequest sent;
+  EXPECT_CALL(env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&sent](HTTPRequest* req) {
+        ASSERT_TRUE(sent.ParseFromString(req->body()));
+        std::map<std::string, std::string> headers;
+        req->OnComplete(Status::OK, std::move(headers), "");
+      }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(sc_lib_->Report(info).ok());
+  }
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.rolled_up_reports, 3);
+  EXPECT_EQ(stat.total_called_reports, 0);
+
+  // Close() flushes the rollup.
+  ASSERT_TRUE(sc_lib_->Close().ok());
+  ASSERT_EQ(1, sent.operations_size());
+  bool found = false;
+  for (const auto& value_set : sent.operations(0).metric_value_sets()) {
+    if (value_set.metric_name() ==
+        "serviceruntime.googleapis.com/api/consumer/request_count") {
+      EXPECT_EQ(3, value_set.metric_values(0).int64_value());
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST_F(AggregatedTestWithServerConfig, FlushesTheRollupOnDestruction) {
+  config_->set_report_rollup_entries(10);
+  DisableReportAggregation();
+
+  EXPECT_CALL(env_, DoRunHTTPRequest(_)).WillOnce(Invoke([](HTTPRequest* req) {
+    std::map<std::string, std::string> headers;
+    req->OnComplete(Status::OK, std::move(headers), "");
+  }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
+  // Destroyed without Close().
+  sc_lib_.reset();
+}
+
+TEST_F(AggregatedTestWithServerConfig, SizesTheCacheForTheLongestInterval) {
+  auto* report_config = config_->mutable_report_aggregator_config();
+  report_config->set_cache_entries(100);
+  report_config->set_flush_interval_ms(1000);
+  report_config->set_max_flush_interval_ms(5000);
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.report_cache_entries, 500);
+  // No load yet, so the interval is the shortest.
+  EXPECT_EQ(stat.report_flush_interval_ms, 1000);
+}
+
+TEST_F(AggregatedTestWithServerConfig, RefreshesHotChecksInTheBackground) {
+  auto* check_config = config_->mutable_check_aggregator_config();
+  check_config->set_cache_entries(10);
+  check_config->set_flush_interval_ms(10);
+  check_config->set_response_expiration_ms(60000);
+  check_config->set_refresh_ahead_min_hits(1);
+
+  // The first check fills the cache, the second one refreshes it.
+  EXPECT_CALL(env_, DoRunHTTPRequest(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([](HTTPRequest* req) {
+        std::map<std::string, std::string> headers;
+        req->OnComplete(Status::OK, std::move(headers), "");
+      }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  CheckRequestInfo info;
+  FillOperationInfo(&info);
+  int done = 0;
+  auto on_done = [&done](Status status, const CheckResponseInfo&) {
+    EXPECT_TRUE(status.ok());
+    ++done;
+  };
+  sc_lib_->Check(info, nullptr, on_done);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sc_lib_->Check(info, nullptr, on_done);
+  EXPECT_EQ(2, done);
+
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.refreshed_ahead_checks, 1);
+}
+
+TEST_F(AggregatedTestWithServerConfig, SpillsAndReplaysUndeliveredReports) {
+  const char* tmp_dir = getenv("TEST_TMPDIR");
+  std::string spill_path = std::string(tmp_dir ? tmp_dir : "/tmp") +
+                           "/aggregated_spill_" + std::to_string(getpid());
+  config_->set_report_spill_path(spill_path);
+  config_->set_report_spill_max_bytes(4096);
+  DisableReportAggregation();
+
+  // The replay timer is the last one started.
+  std::function<void()> replay;
+  ON_CALL(env_, StartPeriodicTimer(_, _))
+      .WillByDefault(Invoke([&replay](std::chrono::milliseconds,
+                                      std::function<void()> callback) {
+        replay = callback;
+        return std::unique_ptr<PeriodicTimer>();
+      }));
+  std::string sent_body;
+  EXPECT_CALL(env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&sent_body](HTTPRequest* req) {
+        sent_body = req->body();
+        std::map<std::string, std::string> headers;
+        req->OnComplete(Status(503, "Service Unavailable"), std::move(headers),
+                        "");
+      }))
+      .WillOnce(Invoke([&sent_body](HTTPRequest* req) {
+        EXPECT_EQ(sent_body, req->body());
+        std::map<std::string, std::string> headers;
+        req->OnComplete(Status::OK, std::move(headers), "");
+      }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.spilled_reports, 1);
+
+  ASSERT_TRUE((bool)replay);
+  replay();
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.replayed_spilled_reports, 1);
+
+  sc_lib_.reset();
+  remove(spill_path.c_str());
+}
+
+TEST_F(AggregatedTestWithServerConfig, SendsReportsOverGrpc) {
+  config_->set_grpc_transport(true);
+  config_->set_report_compression_min_bytes(1);
+  DisableReportAggregation();
+
+  EXPECT_CALL(env_, DoRunHTTPRequest(_)).Times(0);
+  EXPECT_CALL(env_, DoRunGRPCRequest(_)).WillOnce(Invoke([](GRPCRequest* req) {
+    EXPECT_EQ("servicecontrol.googleapis.com:443", req->server());
+    EXPECT_TRUE(req->secure());
+    EXPECT_EQ("google.api.servicecontrol.v1.ServiceController",
+              req->service());
+    EXPECT_EQ("Report", req->method());
+    // gRPC requests are not gzip-compressed.
+    ReportRequest request;
+    EXPECT_TRUE(request.ParseFromString(req->body()));
+    req->OnComplete(Status::OK, "");
+  }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
+}
+
+TEST_F(AggregatedTestWithServerConfig, FallsBackToHttp) {
+  config_->set_grpc_transport(true);
+  DisableReportAggregation();
+
+  EXPECT_CALL(env_, DoRunGRPCRequest(_)).WillOnce(Invoke([](GRPCRequest* req) {
+    req->OnComplete(Status(Code::UNIMPLEMENTED, "no gRPC"), "");
+  }));
+  // The request is resent over HTTP, and so are the later ones.
+  EXPECT_CALL(env_, DoRunHTTPRequest(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([](HTTPRequest* req) {
+        ReportRequest request;
+        EXPECT_TRUE(request.ParseFromString(req->body()));
+        std::map<std::string, std::string> headers;
+        req->OnComplete(Status::OK, std::move(headers), "");
+      }));
+  ASSERT_NO_FATAL_FAILURE(Create());
+
+  ReportRequestInfo info;
+  FillOperationInfo(&info);
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
+  ASSERT_TRUE(sc_lib_->Report(info).ok());
 }
 
 class QuotaAllocationTestWithRealClient : public ::testing::Test {
@@ -310,6 +575,12 @@ TEST_F(QuotaAllocationTestWithRealClient, AllocateQuotaTest) {
   FillOperationInfo(&info);
   sc_lib_->Quota(info, nullptr,
                  [](Status status) { ASSERT_TRUE(status.ok()); });
+
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.quota_cache_misses, 1);
+  EXPECT_EQ(stat.rpc_latency[RPC_ALLOCATE_QUOTA].count, 1);
+  EXPECT_GT(stat.response_bytes[RPC_ALLOCATE_QUOTA], 0);
 }
 
 TEST_F(QuotaAllocationTestWithRealClient, AllocateQuotaFailedTest) {
@@ -333,6 +604,91 @@ TEST_F(QuotaAllocationTestWithRealClient, AllocateQuotaFailedTest) {
   });
 }
 
+TEST_F(QuotaAllocationTestWithRealClient, PreallocatesQuota) {
+  proto::ServerConfig server_config;
+  server_config.mutable_service_control_config()
+      ->mutable_quota_aggregator_config()
+      ->set_prealloc_chunk(20);
+  sc_lib_.reset(
+      Aggregated::Create(service_, &server_config, env_.get(), nullptr));
+  ASSERT_TRUE((bool)(sc_lib_));
+  sc_lib_->Init();
+
+  // One chunk of each metric, allocated all or nothing.
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([this](HTTPRequest* request) {
+        AllocateQuotaRequest quota_request;
+        ASSERT_TRUE(quota_request.ParseFromString(request->body()));
+        const auto& operation = quota_request.allocate_operation();
+        EXPECT_EQ(::google::api::servicecontrol::v1::QuotaOperation::NORMAL,
+                  operation.quota_mode());
+        ASSERT_EQ(2, operation.quota_metrics_size());
+        for (const auto& metric : operation.quota_metrics()) {
+          EXPECT_EQ(20, metric.metric_values(0).int64_value());
+        }
+        std::map<std::string, std::string> headers;
+        request->OnComplete(Status::OK, std::move(headers),
+                            getResponseBody(kAllocateQuotaResponse));
+      }));
+
+  QuotaRequestInfo info;
+  info.metric_cost_vector = &metric_cost_vector_;
+  FillOperationInfo(&info);
+  // 20 units of metric_second cover 5 requests without a refill.
+  for (int i = 0; i < 5; ++i) {
+    sc_lib_->Quota(info, nullptr,
+                   [](Status status) { EXPECT_TRUE(status.ok()); });
+  }
+
+  Statistics stat;
+  ASSERT_TRUE(sc_lib_->GetStatistics(&stat).ok());
+  EXPECT_EQ(stat.local_quota_allocations, 5);
+}
+
+TEST_F(QuotaAllocationTestWithRealClient, RefillHasItsOwnOperationId) {
+  proto::ServerConfig server_config;
+  server_config.mutable_service_control_config()
+      ->mutable_quota_aggregator_config()
+      ->set_prealloc_chunk(20);
+  sc_lib_.reset(
+      Aggregated::Create(service_, &server_config, env_.get(), nullptr));
+  ASSERT_TRUE((bool)(sc_lib_));
+  sc_lib_->Init();
+
+  // The refill fails, then the request is allocated alone.
+  std::vector<std::string> operation_ids;
+  EXPECT_CALL(*env_, DoRunHTTPRequest(_))
+      .WillOnce(Invoke([&operation_ids](HTTPRequest* request) {
+        AllocateQuotaRequest quota_request;
+        ASSERT_TRUE(quota_request.ParseFromString(request->body()));
+        operation_ids.push_back(
+            quota_request.allocate_operation().operation_id());
+        std::map<std::string, std::string> headers;
+        request->OnComplete(Status(503, "Service Unavailable"),
+                            std::move(headers), "");
+      }))
+      .WillOnce(Invoke([this, &operation_ids](HTTPRequest* request) {
+        AllocateQuotaRequest quota_request;
+        ASSERT_TRUE(quota_request.ParseFromString(request->body()));
+        operation_ids.push_back(
+            quota_request.allocate_operation().operation_id());
+        std::map<std::string, std::string> headers;
+        request->OnComplete(Status::OK, std::move(headers),
+                            getResponseBody(kAllocateQuotaResponse));
+      }));
+
+  QuotaRequestInfo info;
+  info.metric_cost_vector = &metric_cost_vector_;
+  FillOperationInfo(&info);
+  sc_lib_->Quota(info, nullptr,
+                 [](Status status) { EXPECT_TRUE(status.ok()); });
+
+  ASSERT_EQ(2, operation_ids.size());
+  EXPECT_FALSE(operation_ids[0].empty());
+  EXPECT_NE(info.operation_id, operation_ids[0]);
+  EXPECT_EQ(info.operation_id, operation_ids[1]);
+}
+
 TEST(AggregatedServiceControlTest, Create) {
   // Verify that invalid service config yields nullptr.
   ::google::api::Service
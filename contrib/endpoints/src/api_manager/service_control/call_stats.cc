@@ -0,0 +1,80 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/call_stats.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+CallStats::CallStats() {
+  for (int i = 0; i < RPC_MAX; ++i) {
+    failures_[i] = 0;
+    request_bytes_[i] = 0;
+    response_bytes_[i] = 0;
+    cache_lookups_[i] = 0;
+    cache_misses_[i] = 0;
+  }
+}
+
+void CallStats::RecordRequest(Rpc rpc,
+                              std::chrono::steady_clock::duration serialize,
+                              uint64_t bytes) {
+  serialize_[rpc].Record(serialize);
+  request_bytes_[rpc].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void CallStats::RecordResponse(Rpc rpc,
+                               std::chrono::steady_clock::duration latency,
+                               uint64_t bytes, bool ok) {
+  latency_[rpc].Record(latency);
+  response_bytes_[rpc].fetch_add(bytes, std::memory_order_relaxed);
+  if (!ok) {
+    failures_[rpc].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void CallStats::CountCacheLookup(Rpc rpc) {
+  ++cache_lookups_[rpc];
+}
+
+void CallStats::CountCacheMiss(Rpc rpc) {
+  ++cache_misses_[rpc];
+}
+
+void CallStats::GetStatistics(Statistics* stat) const {
+  for (int i = 0; i < RPC_MAX; ++i) {
+    latency_[i].Get(&stat->rpc_latency[i]);
+    serialize_[i].Get(&stat->serialize_latency[i]);
+    stat->rpc_failures[i] = failures_[i].load(std::memory_order_relaxed);
+    stat->request_bytes[i] = request_bytes_[i].load(std::memory_order_relaxed);
+    stat->response_bytes[i] =
+        response_bytes_[i].load(std::memory_order_relaxed);
+  }
+  // A miss is counted after its lookup; reading the misses first keeps the
+  // hits from going negative.
+  uint64_t check_misses = cache_misses_[RPC_CHECK].load();
+  uint64_t quota_misses = cache_misses_[RPC_ALLOCATE_QUOTA].load();
+  stat->check_cache_misses = check_misses;
+  stat->check_cache_hits = cache_lookups_[RPC_CHECK].load() - check_misses;
+  stat->quota_cache_misses = quota_misses;
+  stat->quota_cache_hits =
+      cache_lookups_[RPC_ALLOCATE_QUOTA].load() - quota_misses;
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,77 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_CALL_STATS_H_
+#define API_MANAGER_SERVICE_CONTROL_CALL_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "contrib/endpoints/include/api_manager/service_control.h"
+#include "contrib/endpoints/src/api_manager/utils/atomic_latency_histogram.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// Per RPC statistics of the calls to the service control server: latency
+// and serialization time histograms, request and response bytes, failed
+// calls, and how often the client cache had to go to the server. They are
+// reported through Statistics. Calls from the transport callbacks may run
+// on any thread, so the counters are atomic.
+class CallStats {
+ public:
+  CallStats();
+
+  // Records a request about to be sent: the time to serialize it and its
+  // serialized size.
+  void RecordRequest(Rpc rpc, std::chrono::steady_clock::duration serialize,
+                     uint64_t bytes);
+
+  // Records a completed RPC: the time from sending its request to handling
+  // its response, and the size of the response.
+  void RecordResponse(Rpc rpc, std::chrono::steady_clock::duration latency,
+                      uint64_t bytes, bool ok);
+
+  // Counts a call looked up in the cache of the service control client, and
+  // a lookup which missed and was sent to the server.
+  void CountCacheLookup(Rpc rpc);
+  void CountCacheMiss(Rpc rpc);
+
+  // Copies out the statistics. The other fields of stat are left unchanged.
+  void GetStatistics(Statistics* stat) const;
+
+ private:
+  // A histogram with the RPC latency bounds, which default constructs so
+  // that it can be held in an array.
+  struct RpcLatencyHistogram : public utils::AtomicLatencyHistogram {
+    RpcLatencyHistogram()
+        : utils::AtomicLatencyHistogram(kRpcLatencyHistogramBoundsUs) {}
+  };
+
+  RpcLatencyHistogram latency_[RPC_MAX];
+  utils::AtomicLatencyHistogram serialize_[RPC_MAX];
+  std::atomic<uint64_t> failures_[RPC_MAX];
+  std::atomic<uint64_t> request_bytes_[RPC_MAX];
+  std::atomic<uint64_t> response_bytes_[RPC_MAX];
+  std::atomic<uint64_t> cache_lookups_[RPC_MAX];
+  std::atomic<uint64_t> cache_misses_[RPC_MAX];
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_CALL_STATS_H_
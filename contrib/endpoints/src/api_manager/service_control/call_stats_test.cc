@@ -0,0 +1,122 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/call_stats.h"
+#include <cstring>
+#include "gtest/gtest.h"
+
+using std::chrono::microseconds;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+Statistics GetStatistics(const CallStats& stats) {
+  Statistics stat;
+  memset(&stat, 0, sizeof(stat));
+  stats.GetStatistics(&stat);
+  return stat;
+}
+
+TEST(CallStats, Empty) {
+  CallStats stats;
+  Statistics stat = GetStatistics(stats);
+  for (int i = 0; i < RPC_MAX; ++i) {
+    ASSERT_EQ(0u, stat.rpc_latency[i].count);
+    ASSERT_EQ(0u, stat.serialize_latency[i].count);
+    ASSERT_EQ(0u, stat.request_bytes[i]);
+    ASSERT_EQ(0u, stat.response_bytes[i]);
+  }
+  ASSERT_EQ(0u, stat.check_cache_hits);
+  ASSERT_EQ(0u, stat.quota_cache_misses);
+}
+
+TEST(CallStats, RecordRpcs) {
+  CallStats stats;
+  stats.RecordRequest(RPC_CHECK, microseconds(5), 100);
+  stats.RecordResponse(RPC_CHECK, microseconds(2000), 30, true);
+  stats.RecordRequest(RPC_CHECK, microseconds(15), 120);
+  stats.RecordResponse(RPC_CHECK, microseconds(50000), 0, false);
+  stats.RecordRequest(RPC_REPORT, microseconds(400), 4000);
+
+  Statistics stat = GetStatistics(stats);
+  const LatencyHistogram& check = stat.rpc_latency[RPC_CHECK];
+  ASSERT_EQ(2u, check.count);
+  ASSERT_EQ(52000u, check.total_us);
+  ASSERT_EQ(50000u, check.max_us);
+  // RPC latencies are counted in buckets from 1 ms to 10 s.
+  ASSERT_EQ(1u, check.buckets[1]);
+  ASSERT_EQ(1u, check.buckets[4]);
+  ASSERT_EQ(1u, stat.rpc_failures[RPC_CHECK]);
+  ASSERT_EQ(2u, stat.serialize_latency[RPC_CHECK].count);
+  ASSERT_EQ(20u, stat.serialize_latency[RPC_CHECK].total_us);
+  ASSERT_EQ(220u, stat.request_bytes[RPC_CHECK]);
+  ASSERT_EQ(30u, stat.response_bytes[RPC_CHECK]);
+
+  // A request still in flight has no latency yet.
+  ASSERT_EQ(1u, stat.serialize_latency[RPC_REPORT].count);
+  ASSERT_EQ(4000u, stat.request_bytes[RPC_REPORT]);
+  ASSERT_EQ(0u, stat.rpc_latency[RPC_REPORT].count);
+  ASSERT_EQ(0u, stat.rpc_failures[RPC_REPORT]);
+
+  ASSERT_EQ(0u, stat.rpc_latency[RPC_ALLOCATE_QUOTA].count);
+}
+
+TEST(CallStats, CacheHits) {
+  CallStats stats;
+  for (int i = 0; i < 10; ++i) {
+    stats.CountCacheLookup(RPC_CHECK);
+  }
+  stats.CountCacheMiss(RPC_CHECK);
+  stats.CountCacheLookup(RPC_ALLOCATE_QUOTA);
+  stats.CountCacheMiss(RPC_ALLOCATE_QUOTA);
+  stats.CountCacheLookup(RPC_ALLOCATE_QUOTA);
+
+  Statistics stat = GetStatistics(stats);
+  ASSERT_EQ(9u, stat.check_cache_hits);
+  ASSERT_EQ(1u, stat.check_cache_misses);
+  ASSERT_EQ(1u, stat.quota_cache_hits);
+  ASSERT_EQ(1u, stat.quota_cache_misses);
+}
+
+TEST(CallStats, Merge) {
+  CallStats stats1;
+  stats1.RecordResponse(RPC_ALLOCATE_QUOTA, microseconds(20), 10, true);
+  stats1.CountCacheLookup(RPC_CHECK);
+  CallStats stats2;
+  stats2.RecordResponse(RPC_ALLOCATE_QUOTA, microseconds(3000), 15, false);
+  stats2.CountCacheLookup(RPC_CHECK);
+  stats2.CountCacheMiss(RPC_CHECK);
+
+  Statistics stat = GetStatistics(stats1);
+  stat.Merge(GetStatistics(stats2));
+  const LatencyHistogram& quota = stat.rpc_latency[RPC_ALLOCATE_QUOTA];
+  ASSERT_EQ(2u, quota.count);
+  ASSERT_EQ(3020u, quota.total_us);
+  ASSERT_EQ(3000u, quota.max_us);
+  ASSERT_EQ(1u, stat.rpc_failures[RPC_ALLOCATE_QUOTA]);
+  ASSERT_EQ(25u, stat.response_bytes[RPC_ALLOCATE_QUOTA]);
+  ASSERT_EQ(1u, stat.check_cache_hits);
+  ASSERT_EQ(1u, stat.check_cache_misses);
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
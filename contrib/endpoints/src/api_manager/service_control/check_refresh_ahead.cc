@@ -0,0 +1,98 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/check_refresh_ahead.h"
+
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+CheckRefreshAhead::CheckRefreshAhead(size_t max_entries,
+                                     std::chrono::milliseconds flush_interval,
+                                     int min_hits)
+    : max_entries_(max_entries),
+      flush_interval_(flush_interval),
+      min_hits_(min_hits),
+      refreshes_(0) {}
+
+bool CheckRefreshAhead::Hit(const std::string& key,
+                            const steady_clock::time_point& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    if (entries_.size() >= max_entries_) {
+      DropColdEntries();
+      if (entries_.size() >= max_entries_) {
+        return false;
+      }
+    }
+    // The first hit of a signature is sent to the server by the client.
+    Entry& entry = entries_[key];
+    entry.last_refresh = now;
+    entry.hits = 1;
+    entry.refreshing = false;
+    return false;
+  }
+  Entry& entry = it->second;
+  ++entry.hits;
+  if (entry.refreshing || entry.hits < min_hits_ ||
+      now - entry.last_refresh < flush_interval_) {
+    return false;
+  }
+  entry.refreshing = true;
+  ++refreshes_;
+  return true;
+}
+
+void CheckRefreshAhead::Refreshed(const std::string& key,
+                                  const steady_clock::time_point& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    it->second.last_refresh = now;
+    it->second.hits = 0;
+    it->second.refreshing = false;
+  }
+}
+
+void CheckRefreshAhead::Cancel(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    it->second.refreshing = false;
+  }
+}
+
+size_t CheckRefreshAhead::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+void CheckRefreshAhead::DropColdEntries() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.hits < min_hits_ && !it->second.refreshing) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
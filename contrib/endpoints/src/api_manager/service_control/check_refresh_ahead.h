@@ -0,0 +1,93 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_CHECK_REFRESH_AHEAD_H_
+#define API_MANAGER_SERVICE_CONTROL_CHECK_REFRESH_AHEAD_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// Decides when to refresh a cached Check result in the background.
+//
+// The service control client serves a cached Check result until it is
+// flush_interval old, and then sends the next Check of its signature to the
+// server and makes that request wait for the response. For a hot signature
+// this puts one slow request on the tail latency every interval.
+//
+// This class counts the hits of each signature since its result was last
+// refreshed. Once the result is due for a refresh and the signature was hit
+// at least min_hits times, Hit() asks its caller to issue the Check in the
+// background first, so the request itself is still served from the cache.
+// At most one refresh per signature is in flight.
+//
+// The number of signatures is bounded. When full, the signatures that are
+// not hot are dropped, and new ones are not tracked if none is. All methods
+// are thread safe.
+class CheckRefreshAhead {
+ public:
+  CheckRefreshAhead(size_t max_entries,
+                    std::chrono::milliseconds flush_interval, int min_hits);
+
+  // Counts a hit of the signature "key". Returns true if the caller should
+  // refresh its Check result now, and then call Refreshed() or Cancel().
+  bool Hit(const std::string& key,
+           const std::chrono::steady_clock::time_point& now);
+
+  // Records that the Check result of key was received from the server.
+  void Refreshed(const std::string& key,
+                 const std::chrono::steady_clock::time_point& now);
+
+  // Records that a refresh asked for by Hit() was not sent to the server.
+  void Cancel(const std::string& key);
+
+  // Returns the number of refreshes asked for by Hit().
+  uint64_t refreshes() const { return refreshes_; }
+
+  // Returns the number of tracked signatures.
+  size_t Size() const;
+
+ private:
+  struct Entry {
+    std::chrono::steady_clock::time_point last_refresh;
+    int hits;
+    bool refreshing;
+  };
+
+  // Drops the signatures that are not hot.
+  void DropColdEntries();
+
+  const size_t max_entries_;
+  const std::chrono::milliseconds flush_interval_;
+  const int min_hits_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+
+  std::atomic<uint64_t> refreshes_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_CHECK_REFRESH_AHEAD_H_
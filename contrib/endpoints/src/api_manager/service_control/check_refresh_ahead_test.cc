@@ -0,0 +1,85 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/check_refresh_ahead.h"
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+TEST(CheckRefreshAhead, RefreshesHotSignaturesWhenDue) {
+  steady_clock::time_point now;
+  CheckRefreshAhead refresh(10, milliseconds(1000), 3);
+  EXPECT_FALSE(refresh.Hit("a", now));
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(10)));
+  // Hot, but not due yet.
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(999)));
+  EXPECT_TRUE(refresh.Hit("a", now + milliseconds(1000)));
+  EXPECT_EQ(1, refresh.refreshes());
+
+  // One refresh at a time.
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(1001)));
+  refresh.Refreshed("a", now + milliseconds(1050));
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(2049)));
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(2050)));
+  EXPECT_TRUE(refresh.Hit("a", now + milliseconds(2051)));
+}
+
+TEST(CheckRefreshAhead, LeavesColdSignaturesToTheClient) {
+  steady_clock::time_point now;
+  CheckRefreshAhead refresh(10, milliseconds(1000), 3);
+  EXPECT_FALSE(refresh.Hit("a", now));
+  EXPECT_FALSE(refresh.Hit("a", now + milliseconds(5000)));
+  EXPECT_EQ(0, refresh.refreshes());
+}
+
+TEST(CheckRefreshAhead, CancelAllowsAnotherRefresh) {
+  steady_clock::time_point now;
+  CheckRefreshAhead refresh(10, milliseconds(1000), 1);
+  EXPECT_FALSE(refresh.Hit("a", now));
+  EXPECT_TRUE(refresh.Hit("a", now + milliseconds(1000)));
+  refresh.Cancel("a");
+  EXPECT_TRUE(refresh.Hit("a", now + milliseconds(1001)));
+}
+
+TEST(CheckRefreshAhead, DropsColdSignaturesWhenFull) {
+  steady_clock::time_point now;
+  CheckRefreshAhead refresh(2, milliseconds(1000), 2);
+  refresh.Hit("hot", now);
+  refresh.Hit("hot", now);
+  refresh.Hit("cold", now);
+  EXPECT_EQ(2, refresh.Size());
+  refresh.Hit("new", now);
+  EXPECT_EQ(2, refresh.Size());
+  EXPECT_TRUE(refresh.Hit("hot", now + milliseconds(1000)));
+
+  // Nothing cold left to drop, so the next signature is not tracked.
+  refresh.Hit("new", now);
+  refresh.Hit("other", now);
+  EXPECT_EQ(2, refresh.Size());
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
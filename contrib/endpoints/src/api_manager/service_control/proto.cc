@@ -55,6 +55,13 @@ const char kConsumerQuotaUsedCount[] =
 
 const char kQuotaName[] = "/quota_name";
 
+// The parameters to initialize DistributionHelper
+struct DistributionHelperOptions {
+  int buckets;
+  double growth;
+  double scale;
+};
+
 struct SupportedMetric {
   const char* name;
   ::google::api::MetricDescriptor_MetricKind metric_kind;
@@ -64,8 +71,10 @@ struct SupportedMetric {
   enum Tag { START = 0, INTERMEDIATE = 1, FINAL = 2 };
   Tag tag;
   Mark mark;
-  Status (*set)(const SupportedMetric& m, const ReportRequestInfo& info,
-                Operation* operation);
+  // Returns whether the request has a value for the metric, and the value.
+  bool (*sample)(const ReportRequestInfo& info, double* value);
+  // The buckets of a distribution metric, nullptr for an int64 metric.
+  const DistributionHelperOptions* distribution;
 };
 
 struct SupportedLabel {
@@ -75,8 +84,15 @@ struct SupportedLabel {
   enum Kind { USER = 0, SYSTEM = 1 };
   Kind kind;
 
-  Status (*set)(const SupportedLabel& l, const ReportRequestInfo& info,
+  Status (*set)(const std::string& key, const ReportRequestInfo& info,
                 Map<std::string, std::string>* labels);
+
+  // ANY labels are set on every report, FINAL labels on the final report
+  // only. CONSTANT labels do not depend on the request, so their value is
+  // computed once, when Proto is created, and set on every report. The
+  // service agent version is set at startup, before any Proto is created.
+  enum Tag { ANY = 0, FINAL = 1, CONSTANT = 2 };
+  Tag tag;
 };
 
 namespace {
@@ -95,13 +111,6 @@ void AddInt64Metric(const char* metric_name, int64_t value,
   metric_value->set_int64_value(value);
 }
 
-// The parameters to initialize DistributionHelper
-struct DistributionHelperOptions {
-  int buckets;
-  double growth;
-  double scale;
-};
-
 const DistributionHelperOptions time_distribution = {29, 2.0, 1e-6};
 const DistributionHelperOptions size_distribution = {8, 10.0, 1};
 const double kMsToSecs = 1e-3;
@@ -121,125 +130,87 @@ Status AddDistributionMetric(const DistributionHelperOptions& options,
   return Status::OK;
 }
 
+// Adds the value of a metric to operation, if the request has one.
+Status SetMetric(const SupportedMetric& m, const ReportRequestInfo& info,
+                 Operation* operation) {
+  double value;
+  if (!(m.sample)(info, &value)) {
+    return Status::OK;
+  }
+  if (m.distribution) {
+    return AddDistributionMetric(*m.distribution, m.name, value, operation);
+  }
+  AddInt64Metric(m.name, static_cast<int64_t>(value), operation);
+  return Status::OK;
+}
+
 // Metrics supported by ESP.
 
-Status set_int64_metric_to_constant_1(const SupportedMetric& m,
-                                      const ReportRequestInfo& info,
-                                      Operation* operation) {
-  AddInt64Metric(m.name, 1l, operation);
-  return Status::OK;
+bool sample_constant_1(const ReportRequestInfo& info, double* value) {
+  *value = 1;
+  return true;
 }
 
-Status set_int64_metric_to_constant_1_if_http_error(
-    const SupportedMetric& m, const ReportRequestInfo& info,
-    Operation* operation) {
+bool sample_constant_1_if_http_error(const ReportRequestInfo& info,
+                                     double* value) {
   // Use status code >= 400 to determine request failed.
-  if (info.response_code >= 400) {
-    AddInt64Metric(m.name, 1l, operation);
-  }
-  return Status::OK;
+  *value = 1;
+  return info.response_code >= 400;
 }
 
-Status set_distribution_metric_to_request_size(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
-  if (info.request_size >= 0) {
-    return AddDistributionMetric(size_distribution, m.name, info.request_size,
-                                 operation);
-  }
-  return Status::OK;
+bool sample_request_size(const ReportRequestInfo& info, double* value) {
+  *value = info.request_size;
+  return info.request_size >= 0;
 }
 
-Status set_distribution_metric_to_response_size(const SupportedMetric& m,
-                                                const ReportRequestInfo& info,
-                                                Operation* operation) {
-  if (info.response_size >= 0) {
-    return AddDistributionMetric(size_distribution, m.name, info.response_size,
-                                 operation);
-  }
-  return Status::OK;
+bool sample_response_size(const ReportRequestInfo& info, double* value) {
+  *value = info.response_size;
+  return info.response_size >= 0;
 }
 
-// TODO: Consider refactoring following 3 functions to avoid duplicate code
-Status set_distribution_metric_to_request_time(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
-  if (info.latency.request_time_ms >= 0) {
-    double request_time_secs = info.latency.request_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, request_time_secs,
-                                 operation);
-  }
-  return Status::OK;
+bool sample_request_time(const ReportRequestInfo& info, double* value) {
+  *value = info.latency.request_time_ms * kMsToSecs;
+  return info.latency.request_time_ms >= 0;
 }
 
-Status set_distribution_metric_to_backend_time(const SupportedMetric& m,
-                                               const ReportRequestInfo& info,
-                                               Operation* operation) {
-  if (info.latency.backend_time_ms >= 0) {
-    double backend_time_secs = info.latency.backend_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, backend_time_secs,
-                                 operation);
-  }
-  return Status::OK;
+bool sample_backend_time(const ReportRequestInfo& info, double* value) {
+  *value = info.latency.backend_time_ms * kMsToSecs;
+  return info.latency.backend_time_ms >= 0;
 }
 
-Status set_distribution_metric_to_overhead_time(const SupportedMetric& m,
-                                                const ReportRequestInfo& info,
-                                                Operation* operation) {
-  if (info.latency.overhead_time_ms >= 0) {
-    double overhead_time_secs = info.latency.overhead_time_ms * kMsToSecs;
-    return AddDistributionMetric(time_distribution, m.name, overhead_time_secs,
-                                 operation);
-  }
-  return Status::OK;
+bool sample_overhead_time(const ReportRequestInfo& info, double* value) {
+  *value = info.latency.overhead_time_ms * kMsToSecs;
+  return info.latency.overhead_time_ms >= 0;
 }
 
-Status set_int64_metric_to_request_bytes(const SupportedMetric& m,
-                                         const ReportRequestInfo& info,
-                                         Operation* operation) {
-  if (info.request_bytes > 0) {
-    AddInt64Metric(m.name, info.request_bytes, operation);
-  }
-  return Status::OK;
+bool sample_request_bytes(const ReportRequestInfo& info, double* value) {
+  *value = info.request_bytes;
+  return info.request_bytes > 0;
 }
 
-Status set_int64_metric_to_response_bytes(const SupportedMetric& m,
-                                          const ReportRequestInfo& info,
-                                          Operation* operation) {
-  if (info.response_bytes > 0) {
-    AddInt64Metric(m.name, info.response_bytes, operation);
-  }
-  return Status::OK;
+bool sample_response_bytes(const ReportRequestInfo& info, double* value) {
+  *value = info.response_bytes;
+  return info.response_bytes > 0;
 }
 
-Status set_distribution_metric_to_streaming_request_message_counts(
-    const SupportedMetric& m, const ReportRequestInfo& info,
-    Operation* operation) {
-  if (info.streaming_request_message_counts > 0) {
-    AddDistributionMetric(size_distribution, m.name,
-                          info.streaming_request_message_counts, operation);
-  }
-  return Status::OK;
+bool sample_streaming_request_message_counts(const ReportRequestInfo& info,
+                                             double* value) {
+  *value = info.streaming_request_message_counts;
+  return info.streaming_request_message_counts > 0;
 }
-Status set_distribution_metric_to_streaming_response_message_counts(
-    const SupportedMetric& m, const ReportRequestInfo& info,
-    Operation* operation) {
-  if (info.streaming_response_message_counts > 0) {
-    AddDistributionMetric(size_distribution, m.name,
-                          info.streaming_response_message_counts, operation);
-  }
-  return Status::OK;
+
+bool sample_streaming_response_message_counts(const ReportRequestInfo& info,
+                                              double* value) {
+  *value = info.streaming_response_message_counts;
+  return info.streaming_response_message_counts > 0;
 }
 
-Status set_distribution_metric_to_streaming_durations(
-    const SupportedMetric& m, const ReportRequestInfo& info,
-    Operation* operation) {
-  if (info.streaming_durations > 0) {
-    AddDistributionMetric(time_distribution, m.name, info.streaming_durations,
-                          operation);
-  }
-  return Status::OK;
+bool sample_streaming_durations(const ReportRequestInfo& info,
+                                double* value) {
+  *value = info.streaming_durations;
+  return info.streaming_durations > 0;
 }
+
 // Currently unsupported metrics:
 //
 //  "serviceruntime.googleapis.com/api/producer/by_consumer/quota_used_count"
@@ -249,121 +220,121 @@ const SupportedMetric supported_metrics[] = {
         "serviceruntime.googleapis.com/api/consumer/request_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::START,
-        SupportedMetric::CONSUMER, set_int64_metric_to_constant_1,
+        SupportedMetric::CONSUMER, sample_constant_1, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/request_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::START,
-        SupportedMetric::PRODUCER, set_int64_metric_to_constant_1,
+        SupportedMetric::PRODUCER, sample_constant_1, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/request_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::FINAL,
-        SupportedMetric::PRODUCER, set_int64_metric_to_constant_1,
+        SupportedMetric::PRODUCER, sample_constant_1, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/request_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_request_size,
+        sample_request_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/request_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_request_size,
+        sample_request_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/request_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_request_size,
+        sample_request_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/response_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_response_size,
+        sample_response_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/response_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_response_size,
+        sample_response_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/response_sizes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_response_size,
+        sample_response_size, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/request_bytes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::INTERMEDIATE, SupportedMetric::CONSUMER,
-        set_int64_metric_to_request_bytes,
+        sample_request_bytes, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/response_bytes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::INTERMEDIATE, SupportedMetric::CONSUMER,
-        set_int64_metric_to_response_bytes,
+        sample_response_bytes, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/request_bytes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::INTERMEDIATE, SupportedMetric::PRODUCER,
-        set_int64_metric_to_request_bytes,
+        sample_request_bytes, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/response_bytes",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64,
         SupportedMetric::INTERMEDIATE, SupportedMetric::PRODUCER,
-        set_int64_metric_to_response_bytes,
+        sample_response_bytes, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/error_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::FINAL,
-        SupportedMetric::CONSUMER, set_int64_metric_to_constant_1_if_http_error,
+        SupportedMetric::CONSUMER, sample_constant_1_if_http_error, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/error_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::FINAL,
-        SupportedMetric::PRODUCER, set_int64_metric_to_constant_1_if_http_error,
+        SupportedMetric::PRODUCER, sample_constant_1_if_http_error, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/error_count",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_INT64, SupportedMetric::FINAL,
-        SupportedMetric::PRODUCER, set_int64_metric_to_constant_1_if_http_error,
+        SupportedMetric::PRODUCER, sample_constant_1_if_http_error, nullptr,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/total_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_request_time,
+        sample_request_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/total_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_request_time,
+        sample_request_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/"
@@ -371,21 +342,21 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_request_time,
+        sample_request_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/backend_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_backend_time,
+        sample_backend_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/backend_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_backend_time,
+        sample_backend_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/"
@@ -393,21 +364,21 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_backend_time,
+        sample_backend_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/request_overhead_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_overhead_time,
+        sample_overhead_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/request_overhead_latencies",
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_overhead_time,
+        sample_overhead_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/by_consumer/"
@@ -415,7 +386,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_overhead_time,
+        sample_overhead_time, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/"
@@ -423,7 +394,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_streaming_request_message_counts,
+        sample_streaming_request_message_counts, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/"
@@ -431,7 +402,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_streaming_request_message_counts,
+        sample_streaming_request_message_counts, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/"
@@ -439,7 +410,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_streaming_response_message_counts,
+        sample_streaming_response_message_counts, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/"
@@ -447,7 +418,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_streaming_response_message_counts,
+        sample_streaming_response_message_counts, &size_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/consumer/"
@@ -455,7 +426,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::CONSUMER,
-        set_distribution_metric_to_streaming_durations,
+        sample_streaming_durations, &time_distribution,
     },
     {
         "serviceruntime.googleapis.com/api/producer/"
@@ -463,7 +434,7 @@ const SupportedMetric supported_metrics[] = {
         ::google::api::MetricDescriptor_MetricKind_DELTA,
         ::google::api::MetricDescriptor_ValueType_DISTRIBUTION,
         SupportedMetric::FINAL, SupportedMetric::PRODUCER,
-        set_distribution_metric_to_streaming_durations,
+        sample_streaming_durations, &time_distribution,
     },
 
 };
@@ -496,7 +467,7 @@ const char kUserAgent[] = "ESP";
 const char kServiceAgentPrefix[] = "ESP/";
 
 // /credential_id
-Status set_credential_id(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_credential_id(const std::string& key, const ReportRequestInfo& info,
                          Map<std::string, std::string>* labels) {
   // The rule to set /credential_id is:
   // 1) If api_key is available, set it as apiKey:API-KEY
@@ -505,7 +476,7 @@ Status set_credential_id(const SupportedLabel& l, const ReportRequestInfo& info,
   if (!info.api_key.empty()) {
     std::string credential_id("apikey:");
     credential_id += info.api_key.ToString();
-    (*labels)[l.name] = credential_id;
+    (*labels)[key] = credential_id;
   } else if (!info.auth_issuer.empty()) {
     // If auth is used, auth_issuer should NOT be empty since it is required.
     char* base64_issuer = auth::esp_base64_encode(
@@ -531,7 +502,7 @@ Status set_credential_id(const SupportedLabel& l, const ReportRequestInfo& info,
       credential_id += base64_audience;
       auth::esp_grpc_free(base64_audience);
     }
-    (*labels)[l.name] = credential_id;
+    (*labels)[key] = credential_id;
   }
   return Status::OK;
 }
@@ -540,121 +511,118 @@ const char* error_types[10] = {"0xx", "1xx", "2xx", "3xx", "4xx",
                                "5xx", "6xx", "7xx", "8xx", "9xx"};
 
 // /error_type
-Status set_error_type(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_error_type(const std::string& key, const ReportRequestInfo& info,
                       Map<std::string, std::string>* labels) {
   if (info.response_code >= 400) {
     int code = (info.response_code / 100) % 10;
     if (error_types[code]) {
-      (*labels)[l.name] = error_types[code];
+      (*labels)[key] = error_types[code];
     }
   }
   return Status::OK;
 }
 
 // /protocol
-Status set_protocol(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_protocol(const std::string& key, const ReportRequestInfo& info,
                     Map<std::string, std::string>* labels) {
-  (*labels)[l.name] = protocol::ToString(info.frontend_protocol);
+  (*labels)[key] = protocol::ToString(info.frontend_protocol);
   return Status::OK;
 }
 
 // /servicecontrol.googleapis.com/backend_protocol
-Status set_backend_protocol(const SupportedLabel& l,
+Status set_backend_protocol(const std::string& key,
                             const ReportRequestInfo& info,
                             Map<std::string, std::string>* labels) {
   // backend_protocol is either GRPC or UNKNOWN.
   if (info.backend_protocol == protocol::GRPC &&
       info.frontend_protocol != info.backend_protocol) {
-    (*labels)[l.name] = protocol::ToString(info.backend_protocol);
+    (*labels)[key] = protocol::ToString(info.backend_protocol);
   }
   return Status::OK;
 }
 
 // /referer
-Status set_referer(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_referer(const std::string& key, const ReportRequestInfo& info,
                    Map<std::string, std::string>* labels) {
   if (!info.referer.empty()) {
-    (*labels)[l.name] = info.referer;
+    (*labels)[key] = info.referer;
   }
   return Status::OK;
 }
 
 // /response_code
-Status set_response_code(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_response_code(const std::string& key, const ReportRequestInfo& info,
                          Map<std::string, std::string>* labels) {
-  if (!info.is_final_report) return Status::OK;
   char response_code_buf[20];
   snprintf(response_code_buf, sizeof(response_code_buf), "%d",
            info.response_code);
-  (*labels)[l.name] = response_code_buf;
+  (*labels)[key] = response_code_buf;
   return Status::OK;
 }
 
 // /response_code_class
-Status set_response_code_class(const SupportedLabel& l,
+Status set_response_code_class(const std::string& key,
                                const ReportRequestInfo& info,
                                Map<std::string, std::string>* labels) {
-  if (!info.is_final_report) return Status::OK;
-  (*labels)[l.name] = error_types[(info.response_code / 100) % 10];
+  (*labels)[key] = error_types[(info.response_code / 100) % 10];
   return Status::OK;
 }
 
 // /status_code
-Status set_status_code(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_status_code(const std::string& key, const ReportRequestInfo& info,
                        Map<std::string, std::string>* labels) {
-  if (!info.is_final_report) return Status::OK;
   char status_code_buf[20];
   snprintf(status_code_buf, sizeof(status_code_buf), "%d",
            info.status.CanonicalCode());
-  (*labels)[l.name] = status_code_buf;
+  (*labels)[key] = status_code_buf;
   return Status::OK;
 }
 
 // cloud.googleapis.com/location
-Status set_location(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_location(const std::string& key, const ReportRequestInfo& info,
                     Map<std::string, std::string>* labels) {
   if (!info.location.empty()) {
-    (*labels)[l.name] = info.location;
+    (*labels)[key] = info.location;
   }
   return Status::OK;
 }
 
 // serviceruntime.googleapis.com/api_method
-Status set_api_method(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_api_method(const std::string& key, const ReportRequestInfo& info,
                       Map<std::string, std::string>* labels) {
   if (!info.api_method.empty()) {
-    (*labels)[l.name] = info.api_method;
+    (*labels)[key] = info.api_method;
   }
   return Status::OK;
 }
 
 // serviceruntime.googleapis.com/api_version
-Status set_api_version(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_api_version(const std::string& key, const ReportRequestInfo& info,
                        Map<std::string, std::string>* labels) {
   if (!info.api_version.empty()) {
-    (*labels)[l.name] = info.api_version;
+    (*labels)[key] = info.api_version;
   }
   return Status::OK;
 }
 
 // servicecontrol.googleapis.com/platform
-Status set_platform(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_platform(const std::string& key, const ReportRequestInfo& info,
                     Map<std::string, std::string>* labels) {
-  (*labels)[l.name] = compute_platform::ToString(info.compute_platform);
+  (*labels)[key] = compute_platform::ToString(info.compute_platform);
   return Status::OK;
 }
 
 // servicecontrol.googleapis.com/service_agent
-Status set_service_agent(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_service_agent(const std::string& key, const ReportRequestInfo& info,
                          Map<std::string, std::string>* labels) {
-  (*labels)[l.name] = kServiceAgentPrefix + utils::Version::instance().get();
+  (*labels)[key] = kServiceAgentPrefix + utils::Version::instance().get();
   return Status::OK;
 }
 
 // serviceruntime.googleapis.com/user_agent
-Status set_user_agent(const SupportedLabel& l, const ReportRequestInfo& info,
+Status set_user_agent(const std::string& key, const ReportRequestInfo& info,
                       Map<std::string, std::string>* labels) {
-  (*labels)[l.name] = kUserAgent;
+  (*labels)[key] = kUserAgent;
   return Status::OK;
 }
 
@@ -685,15 +653,15 @@ const SupportedLabel supported_labels[] = {
     },
     {
         "/response_code", ::google::api::LabelDescriptor_ValueType_STRING,
-        SupportedLabel::USER, set_response_code,
+        SupportedLabel::USER, set_response_code, SupportedLabel::FINAL,
     },
     {
         "/response_code_class", ::google::api::LabelDescriptor::STRING,
-        SupportedLabel::USER, set_response_code_class,
+        SupportedLabel::USER, set_response_code_class, SupportedLabel::FINAL,
     },
     {
         "/status_code", ::google::api::LabelDescriptor_ValueType_STRING,
-        SupportedLabel::USER, set_status_code,
+        SupportedLabel::USER, set_status_code, SupportedLabel::FINAL,
     },
     {
         "appengine.googleapis.com/clone_id",
@@ -777,12 +745,12 @@ const SupportedLabel supported_labels[] = {
     {
         kServiceControlServiceAgent,
         ::google::api::LabelDescriptor_ValueType_STRING, SupportedLabel::SYSTEM,
-        set_service_agent,
+        set_service_agent, SupportedLabel::CONSTANT,
     },
     {
         kServiceControlUserAgent,
         ::google::api::LabelDescriptor_ValueType_STRING, SupportedLabel::SYSTEM,
-        set_user_agent,
+        set_user_agent, SupportedLabel::CONSTANT,
     },
     {
         kServiceControlPlatform,
@@ -799,6 +767,54 @@ const SupportedLabel supported_labels[] = {
 const int supported_labels_count =
     sizeof(supported_labels) / sizeof(supported_labels[0]);
 
+// The fields of a report which label values are read from. A rollup key
+// holds the fields read by the labels of the report, rather than the labels
+// themselves, so that a rolled up report fills no labels.
+enum RollupField {
+  ROLLUP_AUTH = 1 << 0,
+  ROLLUP_REFERER = 1 << 1,
+  ROLLUP_RESPONSE_CODE = 1 << 2,
+  ROLLUP_STATUS_CODE = 1 << 3,
+  ROLLUP_PROTOCOLS = 1 << 4,
+  ROLLUP_LOCATION = 1 << 5,
+  ROLLUP_API_METHOD = 1 << 6,
+  ROLLUP_API_VERSION = 1 << 7,
+  ROLLUP_PLATFORM = 1 << 8,
+  ROLLUP_ALL = (1 << 9) - 1,
+};
+
+// Returns the fields the value of a label is read from. The api key is
+// always part of the rollup key, as it sets the consumer.
+int GetRollupFields(const SupportedLabel* l) {
+  if (l->tag == SupportedLabel::CONSTANT) return 0;
+  if (l->set == set_credential_id) return ROLLUP_AUTH;
+  if (l->set == set_referer) return ROLLUP_REFERER;
+  if (l->set == set_error_type || l->set == set_response_code ||
+      l->set == set_response_code_class) {
+    return ROLLUP_RESPONSE_CODE;
+  }
+  if (l->set == set_status_code) return ROLLUP_STATUS_CODE;
+  if (l->set == set_protocol || l->set == set_backend_protocol) {
+    return ROLLUP_PROTOCOLS;
+  }
+  if (l->set == set_location) return ROLLUP_LOCATION;
+  if (l->set == set_api_method) return ROLLUP_API_METHOD;
+  if (l->set == set_api_version) return ROLLUP_API_VERSION;
+  if (l->set == set_platform) return ROLLUP_PLATFORM;
+  // Unknown labels may read any field.
+  return ROLLUP_ALL;
+}
+
+void AppendRollupKey(::google::protobuf::StringPiece value, std::string* key) {
+  key->push_back('\0');
+  key->append(value.data(), value.size());
+}
+
+void AppendRollupKey(int value, std::string* key) {
+  key->push_back('\0');
+  key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
 // Supported intrinsic labels:
 // "servicecontrol.googleapis.com/operation_name": Operation.operation_name
 // "servicecontrol.googleapis.com/consumer_id": Operation.consumer_id
@@ -960,14 +976,18 @@ std::vector<const Element*> FilterPointers(
 Proto::Proto(const std::set<std::string>& logs, const std::string& service_name,
              const std::string& service_config_id)
     : logs_(logs.begin(), logs.end()),
-      metrics_(FilterPointers<SupportedMetric>(
+      service_name_(service_name),
+      service_config_id_(service_config_id) {
+  BuildFillPlans(
+      FilterPointers<SupportedMetric>(
           supported_metrics, supported_metrics + supported_metrics_count,
-          [](const struct SupportedMetric* m) { return m->set != nullptr; })),
-      labels_(FilterPointers<SupportedLabel>(
+          [](const struct SupportedMetric* m) {
+            return m->sample != nullptr;
+          }),
+      FilterPointers<SupportedLabel>(
           supported_labels, supported_labels + supported_labels_count,
-          [](const struct SupportedLabel* l) { return l->set != nullptr; })),
-      service_name_(service_name),
-      service_config_id_(service_config_id) {}
+          [](const struct SupportedLabel* l) { return l->set != nullptr; }));
+}
 
 Proto::Proto(const std::set<std::string>& logs,
              const std::set<std::string>& metrics,
@@ -975,19 +995,116 @@ Proto::Proto(const std::set<std::string>& logs,
              const std::string& service_name,
              const std::string& service_config_id)
     : logs_(logs.begin(), logs.end()),
-      metrics_(FilterPointers<SupportedMetric>(
+      service_name_(service_name),
+      service_config_id_(service_config_id) {
+  BuildFillPlans(
+      FilterPointers<SupportedMetric>(
           supported_metrics, supported_metrics + supported_metrics_count,
           [&metrics](const struct SupportedMetric* m) {
-            return m->set && metrics.find(m->name) != metrics.end();
-          })),
-      labels_(FilterPointers<SupportedLabel>(
+            return m->sample && metrics.find(m->name) != metrics.end();
+          }),
+      FilterPointers<SupportedLabel>(
           supported_labels, supported_labels + supported_labels_count,
           [&labels](const struct SupportedLabel* l) {
             return l->set && (l->kind == SupportedLabel::SYSTEM ||
                               labels.find(l->name) != labels.end());
-          })),
-      service_name_(service_name),
-      service_config_id_(service_config_id) {}
+          }));
+}
+
+int Proto::MetricPlanIndex(bool first_report, bool final_report,
+                           bool consumer_metrics) {
+  return (first_report ? 4 : 0) + (final_report ? 2 : 0) +
+         (consumer_metrics ? 1 : 0);
+}
+
+void Proto::BuildFillPlans(
+    const std::vector<const struct SupportedMetric*>& metrics,
+    const std::vector<const struct SupportedLabel*>& labels) {
+  // The labels keep the order of supported_labels, so that reports are the
+  // same as when the labels were looked up on every report.
+  rollup_fields_[0] = rollup_fields_[1] = 0;
+  for (const SupportedLabel* l : labels) {
+    LabelFiller filler;
+    filler.key = l->name;
+    filler.label = l;
+    filler.constant = l->tag == SupportedLabel::CONSTANT;
+    if (filler.constant) {
+      Map<std::string, std::string> value;
+      (l->set)(filler.key, ReportRequestInfo(), &value);
+      filler.value = value[filler.key];
+    }
+    if (l->tag != SupportedLabel::FINAL) {
+      label_plans_[0].push_back(filler);
+      rollup_fields_[0] |= GetRollupFields(l);
+    }
+    label_plans_[1].push_back(filler);
+    rollup_fields_[1] |= GetRollupFields(l);
+  }
+
+  metrics_ = metrics;
+  for (int first = 0; first < 2; ++first) {
+    for (int last = 0; last < 2; ++last) {
+      for (int consumer = 0; consumer < 2; ++consumer) {
+        std::vector<int>& plan =
+            metric_plans_[MetricPlanIndex(first, last, consumer)];
+        for (size_t i = 0; i < metrics_.size(); ++i) {
+          const SupportedMetric* m = metrics_[i];
+          if (!consumer && m->mark == SupportedMetric::CONSUMER) {
+            continue;
+          }
+          if ((first && m->tag == SupportedMetric::START) ||
+              (last && (m->tag == SupportedMetric::FINAL ||
+                        m->tag == SupportedMetric::INTERMEDIATE)) ||
+              (!last && m->tag == SupportedMetric::INTERMEDIATE)) {
+            plan.push_back(i);
+          }
+        }
+      }
+    }
+  }
+}
+
+const std::vector<int>& Proto::GetMetricPlan(
+    const ReportRequestInfo& info) const {
+  // Not to send consumer metrics if api_key is empty.
+  // api_key is empty in one of following cases:
+  // 1) api_key is not provided,
+  // 2) api_key is invalid determined by the server from the Check call.
+  // 3) the service is not activated for the consumer project.
+  bool send_consumer_metric = !info.api_key.empty();
+  return metric_plans_[MetricPlanIndex(
+      info.is_first_report, info.is_final_report, send_consumer_metric)];
+}
+
+Status Proto::FillReportLabels(const ReportRequestInfo& info,
+                               Map<std::string, std::string>* labels) const {
+  // Set all labels of this kind of report.
+  for (const LabelFiller& filler : label_plans_[info.is_final_report]) {
+    if (filler.constant) {
+      (*labels)[filler.key] = filler.value;
+      continue;
+    }
+    Status status = (filler.label->set)(filler.key, info, labels);
+    if (!status.ok()) return status;
+  }
+  return Status::OK;
+}
+
+std::vector<ReportRollup::Metric> Proto::GetRollupMetrics() const {
+  std::vector<ReportRollup::Metric> rollup_metrics;
+  for (const SupportedMetric* m : metrics_) {
+    ReportRollup::Metric metric;
+    metric.name = m->name;
+    metric.distribution = m->distribution != nullptr;
+    if (m->distribution) {
+      metric.num_buckets = m->distribution->buckets;
+      metric.growth = m->distribution->growth;
+      metric.scale = m->distribution->scale;
+    }
+    rollup_metrics.push_back(metric);
+  }
+  return rollup_metrics;
+}
 
 utils::Status Proto::FillAllocateQuotaRequest(
     const QuotaRequestInfo& info,
@@ -1101,39 +1218,13 @@ Status Proto::FillReportRequest(const ReportRequestInfo& info,
 
   // Only populate metrics if we can associate them with a method/operation.
   if (!info.operation_id.empty() && !info.operation_name.empty()) {
-    Map<std::string, std::string>* labels = op->mutable_labels();
-    // Set all labels.
-    for (auto it = labels_.begin(), end = labels_.end(); it != end; it++) {
-      const SupportedLabel* l = *it;
-      if (l->set) {
-        status = (l->set)(*l, info, labels);
-        if (!status.ok()) return status;
-      }
-    }
+    status = FillReportLabels(info, op->mutable_labels());
+    if (!status.ok()) return status;
 
-    // Not to send consumer metrics if api_key is empty.
-    // api_key is empty in one of following cases:
-    // 1) api_key is not provided,
-    // 2) api_key is invalid determined by the server from the Check call.
-    // 3) the service is not activated for the consumer project.
-    bool send_consumer_metric = !info.api_key.empty();
-
-    // Populate all metrics.
-    for (auto it = metrics_.begin(), end = metrics_.end(); it != end; it++) {
-      const SupportedMetric* m = *it;
-      if (send_consumer_metric || m->mark != SupportedMetric::CONSUMER) {
-        if (m->set) {
-          if ((info.is_first_report && m->tag == SupportedMetric::START) ||
-              (info.is_final_report &&
-               (m->tag == SupportedMetric::FINAL ||
-                m->tag == SupportedMetric::INTERMEDIATE)) ||
-              (!info.is_final_report &&
-               m->tag == SupportedMetric::INTERMEDIATE)) {
-            status = (m->set)(*m, info, op);
-            if (!status.ok()) return status;
-          }
-        }
-      }
+    // Populate all metrics of this kind of report.
+    for (int i : GetMetricPlan(info)) {
+      status = SetMetric(*metrics_[i], info, op);
+      if (!status.ok()) return status;
     }
   }
 
@@ -1147,6 +1238,88 @@ Status Proto::FillReportRequest(const ReportRequestInfo& info,
   return Status::OK;
 }
 
+std::string Proto::GetRollupKey(const ReportRequestInfo& info) const {
+  std::string key(info.api_key.data(), info.api_key.size());
+  AppendRollupKey(info.operation_name, &key);
+  AppendRollupKey(info.is_final_report, &key);
+  int fields = rollup_fields_[info.is_final_report];
+  if (fields & ROLLUP_AUTH) {
+    AppendRollupKey(info.auth_issuer, &key);
+    AppendRollupKey(info.auth_audience, &key);
+  }
+  if (fields & ROLLUP_REFERER) {
+    AppendRollupKey(info.referer, &key);
+  }
+  if (fields & ROLLUP_RESPONSE_CODE) {
+    AppendRollupKey(info.response_code, &key);
+  }
+  if (fields & ROLLUP_STATUS_CODE) {
+    AppendRollupKey(info.status.CanonicalCode(), &key);
+  }
+  if (fields & ROLLUP_PROTOCOLS) {
+    AppendRollupKey(info.frontend_protocol, &key);
+    AppendRollupKey(info.backend_protocol, &key);
+  }
+  if (fields & ROLLUP_LOCATION) {
+    AppendRollupKey(info.location, &key);
+  }
+  if (fields & ROLLUP_API_METHOD) {
+    AppendRollupKey(info.api_method, &key);
+  }
+  if (fields & ROLLUP_API_VERSION) {
+    AppendRollupKey(info.api_version, &key);
+  }
+  if (fields & ROLLUP_PLATFORM) {
+    AppendRollupKey(info.compute_platform, &key);
+  }
+  return key;
+}
+
+Status Proto::RollupReportRequest(const ReportRequestInfo& info,
+                                  ReportRollup* rollup,
+                                  ReportRequest* request) {
+  if (info.operation_id.empty() || info.operation_name.empty()) {
+    return FillReportRequest(info, request);
+  }
+  Status status = VerifyRequiredReportFields(info);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::vector<ReportRollup::Sample> samples;
+  for (int i : GetMetricPlan(info)) {
+    ReportRollup::Sample sample;
+    if ((metrics_[i]->sample)(info, &sample.value)) {
+      sample.metric = i;
+      samples.push_back(sample);
+    }
+  }
+
+  // Only the first report of a key builds the operation of its entry.
+  Timestamp current_time = GetCurrentTimestamp();
+  std::string key = GetRollupKey(info);
+  if (!rollup->Update(key, current_time, samples)) {
+    Operation operation;
+    SetOperationCommonFields(info, current_time, &operation);
+    status = FillReportLabels(info, operation.mutable_labels());
+    if (!status.ok()) return status;
+    if (!rollup->Add(key, operation, samples)) {
+      return FillReportRequest(info, request);
+    }
+  }
+
+  if (info.is_final_report && !logs_.empty()) {
+    request->set_service_name(service_name_);
+    request->set_service_config_id(service_config_id_);
+    Operation* op = request->add_operations();
+    SetOperationCommonFields(info, current_time, op);
+    for (auto it = logs_.begin(), end = logs_.end(); it != end; it++) {
+      FillLogEntry(info, *it, current_time, op->add_log_entries());
+    }
+  }
+  return Status::OK;
+}
+
 Status Proto::ConvertAllocateQuotaResponse(
     const ::google::api::servicecontrol::v1::AllocateQuotaResponse& response,
     const std::string& service_name) {
@@ -17,11 +17,15 @@
 
 #include "contrib/endpoints/include/api_manager/utils/status.h"
 #include "contrib/endpoints/src/api_manager/service_control/info.h"
+#include "contrib/endpoints/src/api_manager/service_control/report_rollup.h"
 #include "google/api/label.pb.h"
 #include "google/api/metric.pb.h"
 #include "google/api/servicecontrol/v1/quota_controller.pb.h"
 #include "google/api/servicecontrol/v1/service_controller.pb.h"
 
+#include <string>
+#include <vector>
+
 namespace google {
 namespace api_manager {
 namespace service_control {
@@ -60,6 +64,18 @@ class Proto final {
       const ReportRequestInfo& info,
       ::google::api::servicecontrol::v1::ReportRequest* request);
 
+  // Rolls the labels and metrics of a report up into rollup, instead of
+  // filling them into an operation of their own. The log entries of a final
+  // report are still filled into request, with an operation of their own.
+  // Falls back to FillReportRequest() if rollup is full, or if the report
+  // has no metrics.
+  utils::Status RollupReportRequest(
+      const ReportRequestInfo& info, ReportRollup* rollup,
+      ::google::api::servicecontrol::v1::ReportRequest* request);
+
+  // Returns the metrics of the reports, to create a ReportRollup.
+  std::vector<ReportRollup::Metric> GetRollupMetrics() const;
+
   // Converts the response status information in the CheckResponse protocol
   // buffer into utils::Status and returns and returns 'check_response_info'
   // subtracted from this CheckResponse.
@@ -79,9 +95,46 @@ class Proto final {
   const std::string& service_config_id() const { return service_config_id_; }
 
  private:
+  // A label to fill into reports, with its map key built once.
+  struct LabelFiller {
+    std::string key;
+    const struct SupportedLabel* label;
+    // Whether value holds the label value, which does not depend on the
+    // request.
+    bool constant;
+    std::string value;
+  };
+
+  // Builds the fill plans from the labels and metrics to report.
+  void BuildFillPlans(const std::vector<const struct SupportedMetric*>& metrics,
+                      const std::vector<const struct SupportedLabel*>& labels);
+
+  // Returns the metric fill plan of a report.
+  const std::vector<int>& GetMetricPlan(const ReportRequestInfo& info) const;
+
+  // Fills the labels of a report.
+  utils::Status FillReportLabels(
+      const ReportRequestInfo& info,
+      ::google::protobuf::Map<std::string, std::string>* labels) const;
+
+  // Returns the key of the rollup entry of a report. Reports with the same
+  // key have the same consumer, operation name and labels.
+  std::string GetRollupKey(const ReportRequestInfo& info) const;
+
+  // Returns the index of the metric fill plan of a report.
+  static int MetricPlanIndex(bool first_report, bool final_report,
+                             bool consumer_metrics);
+
   const std::vector<std::string> logs_;
-  const std::vector<const struct SupportedMetric*> metrics_;
-  const std::vector<const struct SupportedLabel*> labels_;
+  // The labels to fill into intermediate and final reports.
+  std::vector<LabelFiller> label_plans_[2];
+  // The report fields read by the labels of each plan, as RollupField bits.
+  int rollup_fields_[2];
+  // The metrics to report.
+  std::vector<const struct SupportedMetric*> metrics_;
+  // The indexes in metrics_ of the metrics to fill into each kind of report,
+  // indexed by MetricPlanIndex().
+  std::vector<int> metric_plans_[8];
   const std::string service_name_;
   const std::string service_config_id_;
 };
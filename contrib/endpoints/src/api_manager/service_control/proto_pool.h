@@ -0,0 +1,121 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_PROTO_POOL_H_
+#define API_MANAGER_SERVICE_CONTROL_PROTO_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// A pool to reuse protobufs. Performance tests showed that reusing protobuf
+// is faster than allocating a new protobuf.
+//
+// Every thread keeps a few free protobufs of each type, so the usual
+// Alloc() and Free() within one function frame take no lock. Only when the
+// thread's list is empty or full does the pool fall back to a shared list,
+// bounded by max_size and guarded by a mutex. The per-thread lists are
+// shared by all the pools of the same type and live until the thread exits.
+template <class Type>
+class ProtoPool {
+ public:
+  // The number of free protobufs kept by each thread.
+  static const size_t kThreadCacheSize = 4;
+  // The default maximum size of the shared list. All usages of Alloc() and
+  // Free() are within a function frame, so this should correspond to the
+  // maximum number of concurrent calls.
+  static const size_t kDefaultMaxSize = 100;
+
+  explicit ProtoPool(size_t max_size = kDefaultMaxSize) : max_size_(max_size) {}
+
+  // Allocates a protobuf. If there is a free one, clears and reuses it,
+  // otherwise creates a new one.
+  std::unique_ptr<Type> Alloc() {
+    ++allocs_;
+    std::unique_ptr<Type> item;
+    std::vector<std::unique_ptr<Type>>& cache = ThreadCache();
+    if (!cache.empty()) {
+      item = std::move(cache.back());
+      cache.pop_back();
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!pool_.empty()) {
+        item = std::move(pool_.back());
+        pool_.pop_back();
+      }
+    }
+    if (!item) {
+      return std::unique_ptr<Type>(new Type);
+    }
+    ++reuses_;
+    item->Clear();
+    return item;
+  }
+
+  // Frees a protobuf. Keeps it in the thread's list or the shared list if
+  // either has room, otherwise deletes it.
+  void Free(std::unique_ptr<Type> item) {
+    std::vector<std::unique_ptr<Type>>& cache = ThreadCache();
+    if (cache.size() < kThreadCacheSize) {
+      cache.push_back(std::move(item));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pool_.size() < max_size_) {
+      pool_.push_back(std::move(item));
+    }
+  }
+
+  // Returns the number of protobufs allocated.
+  uint64_t allocs() const { return allocs_; }
+
+  // Returns the number of allocations served by a free protobuf. The reuse
+  // rate is reuses() / allocs().
+  uint64_t reuses() const { return reuses_; }
+
+ private:
+  // Returns the calling thread's list of free protobufs.
+  static std::vector<std::unique_ptr<Type>>& ThreadCache() {
+    static thread_local std::vector<std::unique_ptr<Type>> cache;
+    return cache;
+  }
+
+  // The maximum size of the shared list.
+  size_t max_size_;
+  // The free protobufs that did not fit in a thread's list.
+  std::vector<std::unique_ptr<Type>> pool_;
+  // Mutex to protect the shared list.
+  std::mutex mutex_;
+
+  std::atomic<uint64_t> allocs_{0};
+  std::atomic<uint64_t> reuses_{0};
+};
+
+template <class Type>
+const size_t ProtoPool<Type>::kThreadCacheSize;
+template <class Type>
+const size_t ProtoPool<Type>::kDefaultMaxSize;
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_PROTO_POOL_H_
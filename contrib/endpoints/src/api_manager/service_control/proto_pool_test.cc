@@ -0,0 +1,114 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/proto_pool.h"
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+// Stands in for a protobuf. The per-thread lists are shared by all the pools
+// of a type, so each test uses its own type.
+template <int N>
+struct Item {
+  void Clear() { value = 0; }
+  int value = 0;
+};
+
+TEST(ProtoPool, ReusesAndClears) {
+  ProtoPool<Item<0>> pool;
+  auto item = pool.Alloc();
+  item->value = 5;
+  Item<0>* raw = item.get();
+  pool.Free(std::move(item));
+
+  item = pool.Alloc();
+  EXPECT_EQ(raw, item.get());
+  EXPECT_EQ(0, item->value);
+  EXPECT_EQ(2u, pool.allocs());
+  EXPECT_EQ(1u, pool.reuses());
+}
+
+TEST(ProtoPool, OverflowsToSharedList) {
+  // Frees more items than the thread keeps, then allocates them all back.
+  const size_t count = ProtoPool<Item<1>>::kThreadCacheSize + 3;
+  ProtoPool<Item<1>> pool(2);
+  std::vector<std::unique_ptr<Item<1>>> items;
+  for (size_t i = 0; i < count; ++i) {
+    items.push_back(pool.Alloc());
+  }
+  for (auto& item : items) {
+    pool.Free(std::move(item));
+  }
+  items.clear();
+  for (size_t i = 0; i < count; ++i) {
+    items.push_back(pool.Alloc());
+  }
+  // One item did not fit in the shared list and was deleted.
+  EXPECT_EQ(2 * count, pool.allocs());
+  EXPECT_EQ(count - 1, pool.reuses());
+}
+
+TEST(ProtoPool, SharedAcrossThreads) {
+  ProtoPool<Item<2>> pool(10);
+  // Fills this thread's list, so the next item goes to the shared list.
+  std::vector<std::unique_ptr<Item<2>>> items;
+  for (size_t i = 0; i <= ProtoPool<Item<2>>::kThreadCacheSize; ++i) {
+    items.push_back(pool.Alloc());
+  }
+  for (auto& item : items) {
+    pool.Free(std::move(item));
+  }
+
+  // Another thread starts with an empty list and takes from the shared one.
+  std::thread thread([&pool]() {
+    auto item = pool.Alloc();
+    pool.Free(std::move(item));
+  });
+  thread.join();
+  EXPECT_EQ(1u, pool.reuses());
+}
+
+TEST(ProtoPool, ConcurrentAllocAndFree) {
+  ProtoPool<Item<3>> pool;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pool]() {
+      for (int i = 0; i < 1000; ++i) {
+        auto item = pool.Alloc();
+        item->value = i;
+        pool.Free(std::move(item));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(4000u, pool.allocs());
+  // Each thread allocates once, then reuses its own item.
+  EXPECT_EQ(3996u, pool.reuses());
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
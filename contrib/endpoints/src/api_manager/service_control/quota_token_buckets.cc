@@ -0,0 +1,194 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/quota_token_buckets.h"
+
+#include <algorithm>
+
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+// The cost the server is asked for, as in Proto::FillAllocateQuotaRequest().
+int64_t GetCost(int cost) { return cost <= 0 ? 1 : cost; }
+
+}  // namespace
+
+QuotaTokenBuckets::QuotaTokenBuckets(const Options& options)
+    : options_(options), local_allocations_(0), refills_(0) {}
+
+QuotaTokenBuckets::Result QuotaTokenBuckets::Acquire(
+    const std::string& consumer, const Costs& costs,
+    const steady_clock::time_point& now, bool* refill) {
+  *refill = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Idle buckets are only swept when the request needs a bucket that does
+  // not fit, and at most once per backoff period, so that the requests
+  // served by existing buckets do not pay for the scan.
+  if (buckets_.size() + costs.size() > options_.max_buckets &&
+      now >= next_sweep_ && HasMissingBucket(consumer, costs)) {
+    DropIdleBuckets(now);
+    next_sweep_ = now + options_.backoff;
+  }
+
+  request_buckets_.clear();
+  bool enough = true;
+  bool refilling = false;
+  for (const auto& cost : costs) {
+    Bucket* bucket = GetBucket(consumer, cost.first, now);
+    if (bucket == nullptr || now < bucket->bypass_until) {
+      return MISS;
+    }
+    if (now >= bucket->expiration) {
+      bucket->tokens = 0;
+    }
+    enough = enough && bucket->tokens >= GetCost(cost.second);
+    refilling = refilling || bucket->refilling;
+    request_buckets_.push_back(bucket);
+  }
+
+  if (enough) {
+    for (size_t i = 0; i < costs.size(); ++i) {
+      Bucket* bucket = request_buckets_[i];
+      bucket->tokens -= GetCost(costs[i].second);
+      if (!refilling && bucket->tokens < options_.chunk / 2) {
+        *refill = true;
+      }
+    }
+    ++local_allocations_;
+  } else if (refilling) {
+    return MISS;
+  }
+  if (!enough || *refill) {
+    for (Bucket* bucket : request_buckets_) {
+      bucket->refilling = true;
+    }
+    ++refills_;
+  }
+  return enough ? ACQUIRED : REFILL;
+}
+
+QuotaTokenBuckets::Costs QuotaTokenBuckets::GetRefillCosts(
+    const Costs& costs) const {
+  Costs refill_costs;
+  refill_costs.reserve(costs.size());
+  for (const auto& cost : costs) {
+    refill_costs.emplace_back(
+        cost.first, static_cast<int>(std::max(options_.chunk,
+                                              GetCost(cost.second))));
+  }
+  return refill_costs;
+}
+
+void QuotaTokenBuckets::Refilled(const std::string& consumer,
+                                 const Costs& costs, bool acquire,
+                                 const steady_clock::time_point& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& cost : costs) {
+    Bucket* bucket = GetBucket(consumer, cost.first, now);
+    if (bucket == nullptr) {
+      continue;
+    }
+    if (now >= bucket->expiration) {
+      bucket->tokens = 0;
+    }
+    bucket->tokens += std::max(options_.chunk, GetCost(cost.second));
+    if (acquire) {
+      bucket->tokens -= GetCost(cost.second);
+    }
+    bucket->expiration = now + options_.lifetime;
+    bucket->refilling = false;
+  }
+  if (acquire) {
+    ++local_allocations_;
+  }
+}
+
+void QuotaTokenBuckets::RefillFailed(const std::string& consumer,
+                                     const Costs& costs, bool exhausted,
+                                     const steady_clock::time_point& now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& cost : costs) {
+    Bucket* bucket = GetBucket(consumer, cost.first, now);
+    if (bucket == nullptr) {
+      continue;
+    }
+    bucket->refilling = false;
+    if (exhausted) {
+      bucket->tokens = 0;
+      bucket->bypass_until = now + options_.backoff;
+    }
+  }
+}
+
+size_t QuotaTokenBuckets::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buckets_.size();
+}
+
+QuotaTokenBuckets::Bucket* QuotaTokenBuckets::GetBucket(
+    const std::string& consumer, const std::string& metric,
+    const steady_clock::time_point& now) {
+  key_.assign(consumer);
+  key_.push_back('\0');
+  key_.append(metric);
+  auto it = buckets_.find(key_);
+  if (it != buckets_.end()) {
+    return &it->second;
+  }
+  if (buckets_.size() >= options_.max_buckets) {
+    return nullptr;
+  }
+  Bucket& bucket = buckets_[key_];
+  bucket.tokens = 0;
+  bucket.expiration = now;
+  bucket.bypass_until = now;
+  bucket.refilling = false;
+  return &bucket;
+}
+
+bool QuotaTokenBuckets::HasMissingBucket(const std::string& consumer,
+                                         const Costs& costs) {
+  for (const auto& cost : costs) {
+    key_.assign(consumer);
+    key_.push_back('\0');
+    key_.append(cost.first);
+    if (buckets_.find(key_) == buckets_.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void QuotaTokenBuckets::DropIdleBuckets(const steady_clock::time_point& now) {
+  for (auto it = buckets_.begin(); it != buckets_.end();) {
+    const Bucket& bucket = it->second;
+    if (!bucket.refilling && now >= bucket.bypass_until &&
+        (bucket.tokens <= 0 || now >= bucket.expiration)) {
+      it = buckets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,146 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_QUOTA_TOKEN_BUCKETS_H_
+#define API_MANAGER_SERVICE_CONTROL_QUOTA_TOKEN_BUCKETS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// Serves quota allocations locally from quota pre-allocated in chunks.
+//
+// There is a bucket of tokens per consumer and quota metric. A request
+// whose buckets all hold enough tokens takes its cost from them, and does
+// not call the server. A bucket is refilled with a chunk of tokens
+// allocated from the server, all or nothing: in the background once it
+// runs below half a chunk, or by the request that finds it short. Tokens
+// expire a lifetime after the last refill, so quota allocated in one quota
+// window is not spent long after it.
+//
+// A bucket whose chunk was refused, because the quota is nearly exhausted,
+// is bypassed for a backoff period, and its requests are allocated one by
+// one as before. The same goes for requests that find a refill in flight,
+// and for new consumers once the number of buckets reaches its bound. All
+// methods are thread safe.
+class QuotaTokenBuckets {
+ public:
+  struct Options {
+    // The tokens of each metric allocated per refill.
+    int64_t chunk;
+    // How long allocated tokens can be spent.
+    std::chrono::milliseconds lifetime;
+    // How long a bucket is bypassed after a refused refill.
+    std::chrono::milliseconds backoff;
+    // The maximum number of buckets.
+    size_t max_buckets;
+  };
+
+  // The cost of each quota metric of a request.
+  typedef std::vector<std::pair<std::string, int>> Costs;
+
+  enum Result {
+    // The cost was taken from the buckets.
+    ACQUIRED,
+    // The buckets are short. The caller should refill them, taking the cost
+    // from the refill.
+    REFILL,
+    // The cost should be allocated by the server.
+    MISS,
+  };
+
+  explicit QuotaTokenBuckets(const Options& options);
+
+  // Takes the costs of a request of consumer from its buckets. If ACQUIRED,
+  // sets *refill if the caller should refill the buckets in the background.
+  // After REFILL or a refill, the caller must call Refilled() or
+  // RefillFailed().
+  Result Acquire(const std::string& consumer, const Costs& costs,
+                 const std::chrono::steady_clock::time_point& now,
+                 bool* refill);
+
+  // Returns the costs to allocate from the server to refill the buckets of
+  // a request: a chunk of each metric, or the cost if it is larger.
+  Costs GetRefillCosts(const Costs& costs) const;
+
+  // Adds the refill costs of a request to its buckets. Takes the costs of
+  // the request out of them if "acquire" is set, after REFILL.
+  void Refilled(const std::string& consumer, const Costs& costs, bool acquire,
+                const std::chrono::steady_clock::time_point& now);
+
+  // Records that a refill failed. If "exhausted", the quota could not be
+  // allocated, and the buckets are bypassed for the backoff period.
+  void RefillFailed(const std::string& consumer, const Costs& costs,
+                    bool exhausted,
+                    const std::chrono::steady_clock::time_point& now);
+
+  // Returns the number of allocations served from the buckets.
+  uint64_t local_allocations() const { return local_allocations_; }
+
+  // Returns the number of refills asked for.
+  uint64_t refills() const { return refills_; }
+
+  // Returns the number of buckets.
+  size_t Size() const;
+
+ private:
+  struct Bucket {
+    int64_t tokens;
+    std::chrono::steady_clock::time_point expiration;
+    std::chrono::steady_clock::time_point bypass_until;
+    bool refilling;
+  };
+
+  // Returns the bucket of consumer and metric, creating it if needed.
+  // Returns nullptr if it does not exist and there is no room for it.
+  // Buckets are only dropped by DropIdleBuckets(), so the pointer stays
+  // valid while the lock is held.
+  Bucket* GetBucket(const std::string& consumer, const std::string& metric,
+                    const std::chrono::steady_clock::time_point& now);
+
+  // Returns true if a bucket of the costs of consumer does not exist.
+  bool HasMissingBucket(const std::string& consumer, const Costs& costs);
+
+  // Drops the buckets that have nothing to spend and nothing in flight.
+  void DropIdleBuckets(const std::chrono::steady_clock::time_point& now);
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Bucket> buckets_;
+  // The earliest time of the next sweep of the idle buckets.
+  std::chrono::steady_clock::time_point next_sweep_;
+  // Reused to build the bucket keys, and to hold the buckets of a request.
+  std::string key_;
+  std::vector<Bucket*> request_buckets_;
+
+  std::atomic<uint64_t> local_allocations_;
+  std::atomic<uint64_t> refills_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_QUOTA_TOKEN_BUCKETS_H_
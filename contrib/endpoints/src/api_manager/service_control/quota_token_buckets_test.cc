@@ -0,0 +1,165 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/quota_token_buckets.h"
+#include "gtest/gtest.h"
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+QuotaTokenBuckets::Options GetOptions() {
+  QuotaTokenBuckets::Options options;
+  options.chunk = 10;
+  options.lifetime = milliseconds(60000);
+  options.backoff = milliseconds(1000);
+  options.max_buckets = 4;
+  return options;
+}
+
+TEST(QuotaTokenBuckets, RefillsThenServesLocally) {
+  steady_clock::time_point now;
+  QuotaTokenBuckets buckets(GetOptions());
+  QuotaTokenBuckets::Costs costs = {{"reads", 2}, {"writes", 1}};
+  bool refill;
+  ASSERT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now, &refill));
+  // Other requests do not wait for the refill.
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", costs, now, &refill));
+  EXPECT_EQ(QuotaTokenBuckets::Costs({{"reads", 10}, {"writes", 10}}),
+            buckets.GetRefillCosts(costs));
+  buckets.Refilled("c", costs, true, now);
+
+  // 8 reads and 9 writes left.
+  EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+            buckets.Acquire("c", costs, now, &refill));
+  EXPECT_FALSE(refill);
+  // Reads drop below half a chunk.
+  EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+            buckets.Acquire("c", costs, now, &refill));
+  EXPECT_TRUE(refill);
+  // A refill is already in flight.
+  EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+            buckets.Acquire("c", costs, now, &refill));
+  EXPECT_FALSE(refill);
+  EXPECT_EQ(4, buckets.local_allocations());
+  EXPECT_EQ(2, buckets.refills());
+
+  // Refilled in the background, with nothing taken out: 12 reads left.
+  buckets.Refilled("c", costs, false, now);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+              buckets.Acquire("c", costs, now, &refill));
+  }
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", costs, now, &refill));
+}
+
+TEST(QuotaTokenBuckets, TokensExpire) {
+  steady_clock::time_point now;
+  QuotaTokenBuckets buckets(GetOptions());
+  QuotaTokenBuckets::Costs costs = {{"reads", 1}};
+  bool refill;
+  ASSERT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now, &refill));
+  buckets.Refilled("c", costs, true, now);
+  EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+            buckets.Acquire("c", costs, now + milliseconds(59999), &refill));
+  EXPECT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now + milliseconds(60000), &refill));
+}
+
+TEST(QuotaTokenBuckets, BypassesExhaustedBuckets) {
+  steady_clock::time_point now;
+  QuotaTokenBuckets buckets(GetOptions());
+  QuotaTokenBuckets::Costs costs = {{"reads", 1}};
+  bool refill;
+  ASSERT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now, &refill));
+  buckets.RefillFailed("c", costs, true, now);
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", costs, now + milliseconds(999), &refill));
+  EXPECT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now + milliseconds(1000), &refill));
+
+  // Other failures allow another refill at once.
+  buckets.RefillFailed("c", costs, false, now + milliseconds(1000));
+  EXPECT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", costs, now + milliseconds(1000), &refill));
+}
+
+TEST(QuotaTokenBuckets, BoundsTheBuckets) {
+  steady_clock::time_point now;
+  QuotaTokenBuckets buckets(GetOptions());
+  bool refill;
+  for (const char* consumer : {"a", "b"}) {
+    QuotaTokenBuckets::Costs costs = {{"reads", 1}, {"writes", 1}};
+    ASSERT_EQ(QuotaTokenBuckets::REFILL,
+              buckets.Acquire(consumer, costs, now, &refill));
+    buckets.Refilled(consumer, costs, true, now);
+  }
+  EXPECT_EQ(4, buckets.Size());
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", {{"reads", 1}}, now, &refill));
+
+  // Once the tokens of "a" expire, its buckets make room.
+  EXPECT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", {{"reads", 1}}, now + milliseconds(60000),
+                            &refill));
+  EXPECT_EQ(1, buckets.Size());
+}
+
+TEST(QuotaTokenBuckets, SweepsIdleBucketsOncePerBackoff) {
+  steady_clock::time_point now;
+  QuotaTokenBuckets buckets(GetOptions());
+  bool refill;
+  for (const char* consumer : {"a", "b"}) {
+    QuotaTokenBuckets::Costs costs = {{"reads", 1}, {"writes", 1}};
+    ASSERT_EQ(QuotaTokenBuckets::REFILL,
+              buckets.Acquire(consumer, costs, now, &refill));
+    buckets.Refilled(consumer, costs, true, now);
+  }
+
+  // Hits on the existing buckets do not sweep them.
+  EXPECT_EQ(QuotaTokenBuckets::ACQUIRED,
+            buckets.Acquire("a", {{"reads", 1}}, now + milliseconds(59000),
+                            &refill));
+  // A new consumer sweeps, but nothing is idle yet.
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", {{"reads", 1}}, now + milliseconds(59500),
+                            &refill));
+  // The tokens have expired, but the next sweep waits for the backoff.
+  EXPECT_EQ(QuotaTokenBuckets::MISS,
+            buckets.Acquire("c", {{"reads", 1}}, now + milliseconds(60000),
+                            &refill));
+  EXPECT_EQ(4, buckets.Size());
+  EXPECT_EQ(QuotaTokenBuckets::REFILL,
+            buckets.Acquire("c", {{"reads", 1}}, now + milliseconds(60500),
+                            &refill));
+  EXPECT_EQ(1, buckets.Size());
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,144 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/report_rollup.h"
+
+#include "utils/distribution_helper.h"
+
+using ::google::api::servicecontrol::v1::Distribution;
+using ::google::api::servicecontrol::v1::MetricValue;
+using ::google::api::servicecontrol::v1::MetricValueSet;
+using ::google::api::servicecontrol::v1::Operation;
+using ::google::api::servicecontrol::v1::ReportRequest;
+using ::google::service_control_client::DistributionHelper;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// The rolled up values of one key.
+struct ReportRollup::Entry {
+  // The rolled up value of a metric.
+  struct Value {
+    // Whether any report had a value for the metric.
+    bool set = false;
+    int64_t int64_value = 0;
+    Distribution distribution;
+  };
+
+  explicit Entry(size_t num_metrics) : values(num_metrics) {}
+
+  std::unique_ptr<Operation> operation;
+  // Indexed like the metrics of the rollup.
+  std::vector<Value> values;
+};
+
+ReportRollup::ReportRollup(const std::vector<Metric>& metrics,
+                           size_t max_entries)
+    : metrics_(metrics),
+      max_entries_(max_entries),
+      rolled_up_reports_(0),
+      flushed_operations_(0) {}
+
+ReportRollup::~ReportRollup() {}
+
+bool ReportRollup::Add(const std::string& key, const Operation& operation,
+                       const std::vector<Sample>& samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    if (entries_.size() >= max_entries_) {
+      return false;
+    }
+    std::unique_ptr<Entry> entry(new Entry(metrics_.size()));
+    entry->operation.reset(new Operation(operation));
+    it = entries_.emplace(key, std::move(entry)).first;
+  } else {
+    *it->second->operation->mutable_end_time() = operation.end_time();
+  }
+
+  AddSamples(it->second.get(), samples);
+  ++rolled_up_reports_;
+  return true;
+}
+
+bool ReportRollup::Update(const std::string& key,
+                          const ::google::protobuf::Timestamp& end_time,
+                          const std::vector<Sample>& samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  *it->second->operation->mutable_end_time() = end_time;
+  AddSamples(it->second.get(), samples);
+  ++rolled_up_reports_;
+  return true;
+}
+
+void ReportRollup::AddSamples(Entry* entry,
+                              const std::vector<Sample>& samples) {
+  for (const Sample& sample : samples) {
+    const Metric& metric = metrics_[sample.metric];
+    Entry::Value& value = entry->values[sample.metric];
+    if (!metric.distribution) {
+      value.int64_value += static_cast<int64_t>(sample.value);
+    } else {
+      // The buckets are allocated by the first sample of the entry, and
+      // only counted into afterwards.
+      if (!value.set) {
+        DistributionHelper::InitExponential(metric.num_buckets, metric.growth,
+                                            metric.scale, &value.distribution);
+      }
+      DistributionHelper::AddSample(sample.value, &value.distribution);
+    }
+    value.set = true;
+  }
+}
+
+int ReportRollup::Flush(ReportRequest* request) {
+  std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries.swap(entries_);
+  }
+
+  for (auto& it : entries) {
+    Entry* entry = it.second.get();
+    Operation* operation = entry->operation.release();
+    for (size_t i = 0; i < metrics_.size(); ++i) {
+      Entry::Value& value = entry->values[i];
+      if (!value.set) {
+        continue;
+      }
+      MetricValueSet* value_set = operation->add_metric_value_sets();
+      value_set->set_metric_name(metrics_[i].name);
+      MetricValue* metric_value = value_set->add_metric_values();
+      if (metrics_[i].distribution) {
+        metric_value->mutable_distribution_value()->Swap(&value.distribution);
+      } else {
+        metric_value->set_int64_value(value.int64_value);
+      }
+    }
+    request->mutable_operations()->AddAllocated(operation);
+  }
+  flushed_operations_ += entries.size();
+  return entries.size();
+}
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,112 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_REPORT_ROLLUP_H_
+#define API_MANAGER_SERVICE_CONTROL_REPORT_ROLLUP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "google/api/servicecontrol/v1/service_controller.pb.h"
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// Rolls the metrics of many reports up locally, so that the reports of the
+// same kind of request are sent as one operation per flush interval.
+//
+// An entry is keyed by everything that would set the operation of a report
+// apart from the others: its consumer, its method and its labels, which
+// include the response code. Int64 values are summed, and distribution
+// samples are added to buckets allocated once per entry, so a report that
+// is rolled up builds no MetricValue or Distribution of its own.
+//
+// The number of entries is bounded. A report that would need one more entry
+// is not rolled up, and its caller sends it on its own. All methods are
+// thread safe.
+class ReportRollup {
+ public:
+  // A metric to roll up.
+  struct Metric {
+    std::string name;
+    // Whether the metric is a distribution, with the exponential buckets
+    // given by num_buckets, growth and scale, or an int64 metric.
+    bool distribution;
+    int num_buckets;
+    double growth;
+    double scale;
+  };
+
+  // A value of the metric at index "metric" of the metrics of the rollup.
+  struct Sample {
+    int metric;
+    double value;
+  };
+
+  ReportRollup(const std::vector<Metric>& metrics, size_t max_entries);
+  ~ReportRollup();
+
+  // Adds the samples of a report to the entry of key. A new entry starts
+  // from "operation", which holds the fields shared by all the reports of
+  // the key, and has no metric values. Returns false, and adds nothing, if
+  // the key has no entry and the rollup is full.
+  bool Add(const std::string& key,
+           const ::google::api::servicecontrol::v1::Operation& operation,
+           const std::vector<Sample>& samples);
+
+  // Adds the samples of a report to the entry of key, and moves its end
+  // time to end_time. Returns false, and adds nothing, if the key has no
+  // entry; the caller then builds the operation of the key and calls Add().
+  bool Update(const std::string& key,
+              const ::google::protobuf::Timestamp& end_time,
+              const std::vector<Sample>& samples);
+
+  // Moves one operation per entry into request, and empties the rollup.
+  // Returns the number of operations added.
+  int Flush(::google::api::servicecontrol::v1::ReportRequest* request);
+
+  // Returns the number of reports rolled up.
+  uint64_t rolled_up_reports() const { return rolled_up_reports_; }
+
+  // Returns the number of operations flushed.
+  uint64_t flushed_operations() const { return flushed_operations_; }
+
+ private:
+  struct Entry;
+
+  // Adds samples to entry. Called with mutex_ held.
+  void AddSamples(Entry* entry, const std::vector<Sample>& samples);
+
+  const std::vector<Metric> metrics_;
+  const size_t max_entries_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+
+  std::atomic<uint64_t> rolled_up_reports_;
+  std::atomic<uint64_t> flushed_operations_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_REPORT_ROLLUP_H_
@@ -0,0 +1,149 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/report_rollup.h"
+#include "gtest/gtest.h"
+
+using ::google::api::servicecontrol::v1::Operation;
+using ::google::api::servicecontrol::v1::ReportRequest;
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+std::vector<ReportRollup::Metric> Metrics() {
+  ReportRollup::Metric count;
+  count.name = "request_count";
+  count.distribution = false;
+  ReportRollup::Metric sizes;
+  sizes.name = "request_sizes";
+  sizes.distribution = true;
+  sizes.num_buckets = 8;
+  sizes.growth = 10.0;
+  sizes.scale = 1;
+  return {count, sizes};
+}
+
+Operation MakeOperation(const std::string& id, int64_t seconds) {
+  Operation operation;
+  operation.set_operation_id(id);
+  operation.set_operation_name("ListShelves");
+  (*operation.mutable_labels())["/response_code"] = "200";
+  operation.mutable_start_time()->set_seconds(seconds);
+  operation.mutable_end_time()->set_seconds(seconds);
+  return operation;
+}
+
+TEST(ReportRollup, MergesReportsOfOneKey) {
+  ReportRollup rollup(Metrics(), 10);
+  ASSERT_TRUE(rollup.Add("key", MakeOperation("id1", 100), {{0, 1}, {1, 5}}));
+  ASSERT_TRUE(rollup.Add("key", MakeOperation("id2", 101), {{0, 1}, {1, 500}}));
+  ASSERT_TRUE(rollup.Add("key", MakeOperation("id3", 102), {{0, 1}}));
+
+  ReportRequest request;
+  EXPECT_EQ(1, rollup.Flush(&request));
+  ASSERT_EQ(1, request.operations_size());
+  const Operation& operation = request.operations(0);
+  // The operation is the first one of the key, and ends with the last one.
+  EXPECT_EQ("id1", operation.operation_id());
+  EXPECT_EQ("200", operation.labels().at("/response_code"));
+  EXPECT_EQ(100, operation.start_time().seconds());
+  EXPECT_EQ(102, operation.end_time().seconds());
+
+  ASSERT_EQ(2, operation.metric_value_sets_size());
+  EXPECT_EQ("request_count", operation.metric_value_sets(0).metric_name());
+  EXPECT_EQ(3, operation.metric_value_sets(0).metric_values(0).int64_value());
+  EXPECT_EQ("request_sizes", operation.metric_value_sets(1).metric_name());
+  const auto& distribution =
+      operation.metric_value_sets(1).metric_values(0).distribution_value();
+  EXPECT_EQ(2, distribution.count());
+  EXPECT_EQ(5, distribution.minimum());
+  EXPECT_EQ(500, distribution.maximum());
+  EXPECT_EQ(8, distribution.exponential_buckets().num_finite_buckets());
+  ASSERT_EQ(10, distribution.bucket_counts_size());
+  EXPECT_EQ(1, distribution.bucket_counts(1));
+  EXPECT_EQ(1, distribution.bucket_counts(3));
+
+  EXPECT_EQ(3u, rollup.rolled_up_reports());
+  EXPECT_EQ(1u, rollup.flushed_operations());
+}
+
+TEST(ReportRollup, KeepsKeysApart) {
+  ReportRollup rollup(Metrics(), 10);
+  ASSERT_TRUE(rollup.Add("key1", MakeOperation("id1", 100), {{0, 1}}));
+  ASSERT_TRUE(rollup.Add("key2", MakeOperation("id2", 100), {{0, 1}}));
+
+  ReportRequest request;
+  EXPECT_EQ(2, rollup.Flush(&request));
+  ASSERT_EQ(2, request.operations_size());
+  for (const Operation& operation : request.operations()) {
+    // Metrics without samples are left out.
+    ASSERT_EQ(1, operation.metric_value_sets_size());
+    EXPECT_EQ(1, operation.metric_value_sets(0).metric_values(0).int64_value());
+  }
+}
+
+TEST(ReportRollup, RejectsNewKeysWhenFull) {
+  ReportRollup rollup(Metrics(), 1);
+  ASSERT_TRUE(rollup.Add("key1", MakeOperation("id1", 100), {{0, 1}}));
+  EXPECT_FALSE(rollup.Add("key2", MakeOperation("id2", 100), {{0, 1}}));
+  // Existing keys still take reports.
+  EXPECT_TRUE(rollup.Add("key1", MakeOperation("id3", 100), {{0, 1}}));
+  EXPECT_EQ(2u, rollup.rolled_up_reports());
+
+  ReportRequest request;
+  EXPECT_EQ(1, rollup.Flush(&request));
+  const Operation& operation = request.operations(0);
+  EXPECT_EQ(2, operation.metric_value_sets(0).metric_values(0).int64_value());
+}
+
+TEST(ReportRollup, UpdatesExistingKeysOnly) {
+  ReportRollup rollup(Metrics(), 10);
+  ::google::protobuf::Timestamp end_time;
+  end_time.set_seconds(105);
+  EXPECT_FALSE(rollup.Update("key", end_time, {{0, 1}}));
+  ASSERT_TRUE(rollup.Add("key", MakeOperation("id1", 100), {{0, 1}}));
+  EXPECT_TRUE(rollup.Update("key", end_time, {{0, 1}}));
+  EXPECT_EQ(2u, rollup.rolled_up_reports());
+
+  ReportRequest request;
+  EXPECT_EQ(1, rollup.Flush(&request));
+  const Operation& operation = request.operations(0);
+  EXPECT_EQ(105, operation.end_time().seconds());
+  EXPECT_EQ(2, operation.metric_value_sets(0).metric_values(0).int64_value());
+}
+
+TEST(ReportRollup, FlushEmptiesTheRollup) {
+  ReportRollup rollup(Metrics(), 1);
+  ASSERT_TRUE(rollup.Add("key1", MakeOperation("id1", 100), {{0, 1}}));
+
+  ReportRequest request;
+  EXPECT_EQ(1, rollup.Flush(&request));
+  request.Clear();
+  EXPECT_EQ(0, rollup.Flush(&request));
+  EXPECT_EQ(0, request.operations_size());
+
+  // The freed entry can be used by another key.
+  EXPECT_TRUE(rollup.Add("key2", MakeOperation("id2", 100), {{0, 1}}));
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
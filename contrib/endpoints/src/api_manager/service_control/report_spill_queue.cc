@@ -0,0 +1,202 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/report_spill_queue.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+// Identifies the file format.
+const char kMagic[8] = {'E', 'S', 'P', 'S', 'P', 'I', 'L', '1'};
+
+// The number of files tried by Open().
+const int kMaxFiles = 64;
+
+// A record is its size, its flags, and its body.
+const size_t kRecordHeaderSize = 2 * sizeof(uint32_t);
+const uint32_t kCompressed = 1;
+
+}  // namespace
+
+struct ReportSpillQueue::Header {
+  char magic[sizeof(kMagic)];
+  // Offsets of the first record and of the end of the last one, from the
+  // end of the header.
+  uint64_t head;
+  uint64_t tail;
+  uint64_t count;
+  // The room for records.
+  uint64_t capacity;
+};
+
+ReportSpillQueue::ReportSpillQueue(int fd, char* base, size_t file_size,
+                                   const std::string& path)
+    : fd_(fd), base_(base), file_size_(file_size), path_(path) {}
+
+ReportSpillQueue::~ReportSpillQueue() {
+  munmap(base_, file_size_);
+  // Also releases the lock.
+  close(fd_);
+}
+
+std::unique_ptr<ReportSpillQueue> ReportSpillQueue::Open(
+    const std::string& path, size_t max_bytes, std::string* error) {
+  size_t file_size = sizeof(Header) + max_bytes;
+  for (int i = 0; i < kMaxFiles; ++i) {
+    std::string file_path = i == 0 ? path : path + "." + std::to_string(i);
+    int fd = open(file_path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+      *error = "Failed to open " + file_path + ": " + strerror(errno);
+      return nullptr;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      // Held by another process.
+      close(fd);
+      continue;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (static_cast<size_t>(st.st_size) != file_size &&
+         ftruncate(fd, file_size) != 0)) {
+      *error = "Failed to size " + file_path + ": " + strerror(errno);
+      close(fd);
+      return nullptr;
+    }
+    void* base = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+    if (base == MAP_FAILED) {
+      *error = "Failed to map " + file_path + ": " + strerror(errno);
+      close(fd);
+      return nullptr;
+    }
+    std::unique_ptr<ReportSpillQueue> queue(new ReportSpillQueue(
+        fd, static_cast<char*>(base), file_size, file_path));
+    // Starts over unless the file holds a valid queue of the same size.
+    Header* header = queue->header();
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+        header->capacity != max_bytes || header->head > header->tail ||
+        header->tail > max_bytes ||
+        (header->count == 0) != (header->head == header->tail)) {
+      memcpy(header->magic, kMagic, sizeof(kMagic));
+      header->head = 0;
+      header->tail = 0;
+      header->count = 0;
+      header->capacity = max_bytes;
+    }
+    return queue;
+  }
+  *error = "All spill files of " + path + " are in use";
+  return nullptr;
+}
+
+ReportSpillQueue::Header* ReportSpillQueue::header() const {
+  return reinterpret_cast<Header*>(base_);
+}
+
+bool ReportSpillQueue::Push(const std::string& body, bool compressed) {
+  Header* h = header();
+  if (body.size() > h->capacity ||
+      h->capacity - (h->tail - h->head) < kRecordHeaderSize + body.size()) {
+    return false;
+  }
+  if (h->capacity - h->tail < kRecordHeaderSize + body.size()) {
+    // Reclaims the room of the records consumed. A crash in between leaves
+    // records that fail the checks of GetHeadSize(), and are dropped.
+    char* records = base_ + sizeof(Header);
+    memmove(records, records + h->head, h->tail - h->head);
+    h->tail -= h->head;
+    h->head = 0;
+  }
+  char* record = base_ + sizeof(Header) + h->tail;
+  uint32_t fields[2] = {static_cast<uint32_t>(body.size()),
+                        compressed ? kCompressed : 0};
+  memcpy(record, fields, sizeof(fields));
+  memcpy(record + kRecordHeaderSize, body.data(), body.size());
+  // The record is complete before the tail covers it.
+  h->tail += kRecordHeaderSize + body.size();
+  ++h->count;
+  return true;
+}
+
+bool ReportSpillQueue::Front(std::string* body, bool* compressed) {
+  uint32_t size;
+  if (!GetHeadSize(&size)) {
+    return false;
+  }
+  const char* record = base_ + sizeof(Header) + header()->head;
+  uint32_t fields[2];
+  memcpy(fields, record, sizeof(fields));
+  body->assign(record + kRecordHeaderSize, size);
+  *compressed = (fields[1] & kCompressed) != 0;
+  return true;
+}
+
+void ReportSpillQueue::Pop() {
+  uint32_t size;
+  if (!GetHeadSize(&size)) {
+    return;
+  }
+  Header* h = header();
+  h->head += kRecordHeaderSize + size;
+  if (--h->count == 0) {
+    // Drained, so the segment starts over.
+    h->head = 0;
+    h->tail = 0;
+  }
+}
+
+bool ReportSpillQueue::GetHeadSize(uint32_t* size) {
+  Header* h = header();
+  if (h->count == 0) {
+    return false;
+  }
+  // The file may have been left torn or corrupt by a previous process.
+  if (h->head > h->tail || h->tail > h->capacity ||
+      h->tail - h->head < kRecordHeaderSize) {
+    Reset();
+    return false;
+  }
+  memcpy(size, base_ + sizeof(Header) + h->head, sizeof(*size));
+  if (h->tail - h->head - kRecordHeaderSize < *size) {
+    Reset();
+    return false;
+  }
+  return true;
+}
+
+void ReportSpillQueue::Reset() {
+  Header* h = header();
+  h->head = 0;
+  h->tail = 0;
+  h->count = 0;
+}
+
+uint64_t ReportSpillQueue::size() const { return header()->count; }
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,93 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_SERVICE_CONTROL_REPORT_SPILL_QUEUE_H_
+#define API_MANAGER_SERVICE_CONTROL_REPORT_SPILL_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+// A bounded, durable FIFO of serialized Report requests that could not be
+// delivered, kept in a memory-mapped file rather than on the heap.
+//
+// The file is one fixed-size segment. Records are appended at its tail and
+// consumed from its head. When a record does not fit at the tail, the
+// records left are moved to the beginning of the segment to reclaim the
+// room consumed; a record that still does not fit is dropped. The head and
+// tail live in the file too, so the records left by a process are replayed
+// by the next one that opens the file. Records are checked against the
+// tail before being read, and a corrupt queue is emptied.
+//
+// The file is locked while open, so every process of a multi-process server
+// gets a file of its own. This class is not thread safe.
+class ReportSpillQueue {
+ public:
+  ~ReportSpillQueue();
+
+  // Opens or creates the first of "path", "path.1", ... "path.<N>" that no
+  // other process holds, with room for max_bytes of records. Returns
+  // nullptr, and sets *error, if none can be opened.
+  static std::unique_ptr<ReportSpillQueue> Open(const std::string& path,
+                                                size_t max_bytes,
+                                                std::string* error);
+
+  // Appends a record. Returns false if it does not fit.
+  bool Push(const std::string& body, bool compressed);
+
+  // Copies the oldest record out. Returns false if the queue is empty, or
+  // was found corrupt and emptied.
+  bool Front(std::string* body, bool* compressed);
+
+  // Removes the oldest record.
+  void Pop();
+
+  // Returns the number of records.
+  uint64_t size() const;
+  bool empty() const { return size() == 0; }
+
+  // Returns the path of the file in use.
+  const std::string& path() const { return path_; }
+
+ private:
+  struct Header;
+
+  ReportSpillQueue(int fd, char* base, size_t file_size,
+                   const std::string& path);
+
+  Header* header() const;
+
+  // Returns the size of the body of the record at the head, or false, after
+  // emptying the queue, if the record does not end within the tail.
+  bool GetHeadSize(uint32_t* size);
+
+  // Empties the queue.
+  void Reset();
+
+  int fd_;
+  char* base_;
+  size_t file_size_;
+  std::string path_;
+};
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_SERVICE_CONTROL_REPORT_SPILL_QUEUE_H_
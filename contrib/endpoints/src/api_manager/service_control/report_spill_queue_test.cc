@@ -0,0 +1,180 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/service_control/report_spill_queue.h"
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+
+namespace google {
+namespace api_manager {
+namespace service_control {
+
+namespace {
+
+class ReportSpillQueueTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    const char* dir = getenv("TEST_TMPDIR");
+    path_ = std::string(dir != nullptr ? dir : "/tmp") + "/report_spill_" +
+            std::to_string(getpid());
+  }
+
+  void TearDown() {
+    remove(path_.c_str());
+    remove((path_ + ".1").c_str());
+  }
+
+  std::unique_ptr<ReportSpillQueue> Open(size_t max_bytes) {
+    std::string error;
+    std::unique_ptr<ReportSpillQueue> queue =
+        ReportSpillQueue::Open(path_, max_bytes, &error);
+    EXPECT_TRUE(queue != nullptr) << error;
+    return queue;
+  }
+
+  std::string path_;
+};
+
+TEST_F(ReportSpillQueueTest, KeepsTheOrder) {
+  std::unique_ptr<ReportSpillQueue> queue = Open(1024);
+  ASSERT_TRUE(queue != nullptr);
+  EXPECT_TRUE(queue->empty());
+  EXPECT_TRUE(queue->Push("first", false));
+  EXPECT_TRUE(queue->Push("second", true));
+  EXPECT_EQ(2, queue->size());
+
+  std::string body;
+  bool compressed;
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("first", body);
+  EXPECT_FALSE(compressed);
+  queue->Pop();
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("second", body);
+  EXPECT_TRUE(compressed);
+  queue->Pop();
+  EXPECT_FALSE(queue->Front(&body, &compressed));
+}
+
+TEST_F(ReportSpillQueueTest, IsBounded) {
+  // Room for two records of 8 bytes of header and 8 of body.
+  std::unique_ptr<ReportSpillQueue> queue = Open(32);
+  ASSERT_TRUE(queue != nullptr);
+  EXPECT_TRUE(queue->Push("12345678", false));
+  EXPECT_TRUE(queue->Push("12345678", false));
+  EXPECT_FALSE(queue->Push("1", false));
+
+  // The room of a consumed record is reclaimed before the queue drains.
+  queue->Pop();
+  EXPECT_TRUE(queue->Push("1", false));
+  EXPECT_FALSE(queue->Push("1", false));
+
+  std::string body;
+  bool compressed;
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("12345678", body);
+  queue->Pop();
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("1", body);
+  queue->Pop();
+  EXPECT_TRUE(queue->empty());
+  EXPECT_TRUE(queue->Push("12345678", false));
+  EXPECT_TRUE(queue->Push("12345678", false));
+}
+
+TEST_F(ReportSpillQueueTest, KeepsRoomUnderTrickle) {
+  // Room for four records of 8 bytes of header and 8 of body.
+  std::unique_ptr<ReportSpillQueue> queue = Open(64);
+  ASSERT_TRUE(queue != nullptr);
+  std::string previous = std::to_string(10000000);
+  ASSERT_TRUE(queue->Push(previous, false));
+  // The queue never drains, but never runs out of room either.
+  for (int i = 1; i < 100; ++i) {
+    std::string next = std::to_string(10000000 + i);
+    ASSERT_TRUE(queue->Push(next, false)) << i;
+    std::string body;
+    bool compressed;
+    ASSERT_TRUE(queue->Front(&body, &compressed));
+    EXPECT_EQ(previous, body);
+    queue->Pop();
+    previous = next;
+  }
+  EXPECT_EQ(1, queue->size());
+}
+
+TEST_F(ReportSpillQueueTest, DropsCorruptRecords) {
+  {
+    std::unique_ptr<ReportSpillQueue> queue = Open(1024);
+    ASSERT_TRUE(queue != nullptr);
+    EXPECT_TRUE(queue->Push("torn", false));
+  }
+  // Overwrites the size of the record with one past the end of the file.
+  FILE* file = fopen(path_.c_str(), "r+b");
+  ASSERT_TRUE(file != nullptr);
+  uint32_t size = 1 << 20;
+  ASSERT_EQ(0, fseek(file, 40, SEEK_SET));
+  ASSERT_EQ(1u, fwrite(&size, sizeof(size), 1, file));
+  fclose(file);
+
+  std::unique_ptr<ReportSpillQueue> queue = Open(1024);
+  ASSERT_TRUE(queue != nullptr);
+  EXPECT_EQ(1, queue->size());
+  std::string body;
+  bool compressed;
+  EXPECT_FALSE(queue->Front(&body, &compressed));
+  EXPECT_TRUE(queue->empty());
+  EXPECT_TRUE(queue->Push("next", false));
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("next", body);
+}
+
+TEST_F(ReportSpillQueueTest, SurvivesReopening) {
+  {
+    std::unique_ptr<ReportSpillQueue> queue = Open(1024);
+    ASSERT_TRUE(queue != nullptr);
+    EXPECT_TRUE(queue->Push("pending", false));
+  }
+  std::unique_ptr<ReportSpillQueue> queue = Open(1024);
+  ASSERT_TRUE(queue != nullptr);
+  std::string body;
+  bool compressed;
+  ASSERT_TRUE(queue->Front(&body, &compressed));
+  EXPECT_EQ("pending", body);
+
+  // A different size starts over.
+  queue.reset();
+  queue = Open(2048);
+  ASSERT_TRUE(queue != nullptr);
+  EXPECT_TRUE(queue->empty());
+}
+
+TEST_F(ReportSpillQueueTest, LocksTheFile) {
+  std::unique_ptr<ReportSpillQueue> first = Open(1024);
+  std::unique_ptr<ReportSpillQueue> second = Open(1024);
+  ASSERT_TRUE(first != nullptr);
+  ASSERT_TRUE(second != nullptr);
+  EXPECT_EQ(path_, first->path());
+  EXPECT_EQ(path_ + ".1", second->path());
+}
+
+}  // namespace
+
+}  // namespace service_control
+}  // namespace api_manager
+}  // namespace google
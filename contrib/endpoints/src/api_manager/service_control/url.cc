@@ -49,10 +49,30 @@ const std::string& GetServiceControlAddress(
   return service->control().environment();
 }
 
+// Returns the host:port of a URL, with the default port of its scheme if
+// it has none. Sets secure if the scheme is https.
+std::string GetServerAddress(const std::string& url, bool* secure) {
+  *secure = url.compare(0, sizeof(https) - 1, https) == 0;
+  size_t begin = *secure ? sizeof(https) - 1 : sizeof(http) - 1;
+  size_t end = url.find('/', begin);
+  std::string server = url.substr(begin, end == std::string::npos
+                                             ? std::string::npos
+                                             : end - begin);
+  // A colon after the closing bracket of an IPv6 address starts the port.
+  size_t colon = server.rfind(':');
+  size_t bracket = server.rfind(']');
+  if (colon == std::string::npos ||
+      (bracket != std::string::npos && colon < bracket)) {
+    server += *secure ? ":443" : ":80";
+  }
+  return server;
+}
+
 }  // namespace
 
 Url::Url(const ::google::api::Service* service,
-         const proto::ServerConfig* server_config) {
+         const proto::ServerConfig* server_config)
+    : grpc_secure_(false) {
   // Precompute check and report URLs
   if (service) {
     service_control_ = GetServiceControlAddress(service, server_config);
@@ -68,6 +88,7 @@ Url::Url(const ::google::api::Service* service,
     check_url_ = path + check_verb;
     report_url_ = path + report_verb;
     quota_url_ = path + quota_verb;
+    grpc_server_ = GetServerAddress(service_control_, &grpc_secure_);
   }
 }
 
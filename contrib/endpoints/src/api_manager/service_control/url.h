@@ -33,6 +33,11 @@ class Url {
   const std::string& check_url() const { return check_url_; }
   const std::string& quota_url() const { return quota_url_; }
   const std::string& report_url() const { return report_url_; }
+  // The host:port of the service control server, for gRPC calls.
+  const std::string& grpc_server() const { return grpc_server_; }
+  // Whether gRPC calls to the service control server use TLS, i.e. whether
+  // its url is https.
+  bool grpc_secure() const { return grpc_secure_; }
 
  private:
   // Pre-computed url for service control methods.
@@ -40,6 +45,8 @@ class Url {
   std::string check_url_;
   std::string quota_url_;
   std::string report_url_;
+  std::string grpc_server_;
+  bool grpc_secure_;
 };
 
 }  // namespace service_control
@@ -61,6 +61,8 @@ TEST(UrlTest, PrependHttps) {
       "https://servicecontrol.googleapis.com/v1/services/"
       "https-config:allocateQuota",
       url.quota_url());
+  ASSERT_EQ("servicecontrol.googleapis.com:443", url.grpc_server());
+  ASSERT_TRUE(url.grpc_secure());
 }
 
 TEST(UrlTest, ServerControlOverride) {
@@ -73,6 +75,22 @@ TEST(UrlTest, ServerControlOverride) {
   Url url(&config->service(), config->server_config());
   ASSERT_EQ("https://servicecontrol-testing.googleapis.com",
             url.service_control());
+  ASSERT_EQ("servicecontrol-testing.googleapis.com:443", url.grpc_server());
+}
+
+TEST(UrlTest, GrpcServerKeepsThePort) {
+  ::google::api::Service service;
+  service.set_name("test_service");
+  proto::ServerConfig server_config;
+  server_config.mutable_service_control_config()->set_url_override(
+      "http://[::1]:8081/prefix");
+  Url url(&service, &server_config);
+  ASSERT_EQ("[::1]:8081", url.grpc_server());
+  ASSERT_FALSE(url.grpc_secure());
+
+  server_config.mutable_service_control_config()->set_url_override(
+      "http://localhost");
+  ASSERT_EQ("localhost:80", Url(&service, &server_config).grpc_server());
 }
 
 }  // namespace
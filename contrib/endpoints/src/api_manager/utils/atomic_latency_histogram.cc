@@ -0,0 +1,59 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/atomic_latency_histogram.h"
+
+#include <algorithm>
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+AtomicLatencyHistogram::AtomicLatencyHistogram(const uint64_t* bounds_us)
+    : bounds_us_(bounds_us), count_(0), total_us_(0), max_us_(0) {
+  for (auto& bucket : buckets_) {
+    bucket = 0;
+  }
+}
+
+void AtomicLatencyHistogram::Record(
+    std::chrono::steady_clock::duration latency) {
+  uint64_t us = std::max<int64_t>(
+      0,
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+  const uint64_t* bounds_end = bounds_us_ + kLatencyHistogramBuckets - 1;
+  int bucket = std::upper_bound(bounds_us_, bounds_end, us) - bounds_us_;
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_us_.fetch_add(us, std::memory_order_relaxed);
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max_us = max_us_.load(std::memory_order_relaxed);
+  while (us > max_us && !max_us_.compare_exchange_weak(
+                            max_us, us, std::memory_order_relaxed)) {
+  }
+}
+
+void AtomicLatencyHistogram::Get(LatencyHistogram* histogram) const {
+  histogram->count = count_.load(std::memory_order_relaxed);
+  histogram->total_us = total_us_.load(std::memory_order_relaxed);
+  histogram->max_us = max_us_.load(std::memory_order_relaxed);
+  for (int i = 0; i < kLatencyHistogramBuckets; ++i) {
+    histogram->buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+}
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
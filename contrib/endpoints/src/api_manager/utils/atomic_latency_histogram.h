@@ -0,0 +1,55 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_UTILS_ATOMIC_LATENCY_HISTOGRAM_H_
+#define API_MANAGER_UTILS_ATOMIC_LATENCY_HISTOGRAM_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "contrib/endpoints/include/api_manager/latency_histogram.h"
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+// A LatencyHistogram with atomic counters. Record() and Get() are thread
+// safe and lock free; Get() may see a latency counted in some fields only.
+class AtomicLatencyHistogram {
+ public:
+  // bounds_us holds the kLatencyHistogramBuckets - 1 upper bounds of the
+  // buckets, and must outlive the histogram.
+  explicit AtomicLatencyHistogram(
+      const uint64_t* bounds_us = kLatencyHistogramBoundsUs);
+
+  // Records a latency. A negative latency counts as zero.
+  void Record(std::chrono::steady_clock::duration latency);
+
+  // Copies out the histogram.
+  void Get(LatencyHistogram* histogram) const;
+
+ private:
+  const uint64_t* bounds_us_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> total_us_;
+  std::atomic<uint64_t> max_us_;
+  std::atomic<uint64_t> buckets_[kLatencyHistogramBuckets];
+};
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_UTILS_ATOMIC_LATENCY_HISTOGRAM_H_
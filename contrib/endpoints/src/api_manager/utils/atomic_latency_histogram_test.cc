@@ -0,0 +1,103 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/atomic_latency_histogram.h"
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using std::chrono::microseconds;
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+namespace {
+
+LatencyHistogram Get(const AtomicLatencyHistogram& histogram) {
+  LatencyHistogram h;
+  memset(&h, 0, sizeof(h));
+  histogram.Get(&h);
+  return h;
+}
+
+TEST(AtomicLatencyHistogram, Empty) {
+  AtomicLatencyHistogram histogram;
+  LatencyHistogram h = Get(histogram);
+  ASSERT_EQ(0u, h.count);
+  ASSERT_EQ(0u, h.total_us);
+  ASSERT_EQ(0u, h.max_us);
+  for (int i = 0; i < kLatencyHistogramBuckets; ++i) {
+    ASSERT_EQ(0u, h.buckets[i]);
+  }
+}
+
+TEST(AtomicLatencyHistogram, Record) {
+  AtomicLatencyHistogram histogram;
+  histogram.Record(microseconds(9));
+  // A latency on a bound goes to the next bucket.
+  histogram.Record(microseconds(10));
+  histogram.Record(microseconds(100000));
+  // A negative latency from a clock adjustment counts as zero.
+  histogram.Record(microseconds(-3));
+
+  LatencyHistogram h = Get(histogram);
+  ASSERT_EQ(4u, h.count);
+  ASSERT_EQ(100019u, h.total_us);
+  ASSERT_EQ(100000u, h.max_us);
+  ASSERT_EQ(2u, h.buckets[0]);
+  ASSERT_EQ(1u, h.buckets[1]);
+  ASSERT_EQ(1u, h.buckets[kLatencyHistogramBuckets - 1]);
+}
+
+TEST(AtomicLatencyHistogram, RecordWithRpcBounds) {
+  AtomicLatencyHistogram histogram(kRpcLatencyHistogramBoundsUs);
+  histogram.Record(microseconds(999));
+  histogram.Record(microseconds(200000));
+  histogram.Record(microseconds(10000000));
+
+  LatencyHistogram h = Get(histogram);
+  ASSERT_EQ(3u, h.count);
+  ASSERT_EQ(1u, h.buckets[0]);
+  ASSERT_EQ(1u, h.buckets[5]);
+  ASSERT_EQ(1u, h.buckets[kLatencyHistogramBuckets - 1]);
+}
+
+TEST(AtomicLatencyHistogram, ConcurrentRecord) {
+  AtomicLatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t]() {
+      for (int i = 0; i < 1000; ++i) {
+        histogram.Record(microseconds(t * 100));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LatencyHistogram h = Get(histogram);
+  ASSERT_EQ(4000u, h.count);
+  ASSERT_EQ(600000u, h.total_us);
+  ASSERT_EQ(300u, h.max_us);
+}
+
+}  // namespace
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
@@ -0,0 +1,86 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_UTILS_BENCHMARK_H_
+#define API_MANAGER_UTILS_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+// A minimal micro-benchmark runner for the *_benchmark binaries.
+//
+// Usage example:
+//     RunBenchmark("UrlUnescape/long", [&]() {
+//       DoNotOptimize(UrlUnescape(input, true));
+//     });
+//
+// prints
+//     UrlUnescape/long       1048576 iterations      123.4 ns/op   8.1M ops/s
+
+// Prevents the compiler from optimizing away the computation of value.
+template <class T>
+inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// The result of a benchmark run.
+struct BenchmarkResult {
+  uint64_t iterations;
+  double ns_per_op;
+  double ops_per_second;
+};
+
+// Runs fn in batches of doubling size until the total run time reaches
+// min_seconds, then prints and returns the per-operation cost.
+template <class Fn>
+BenchmarkResult RunBenchmark(const char *name, Fn fn,
+                             double min_seconds = 0.5) {
+  typedef std::chrono::steady_clock Clock;
+  // Warm up caches and lazily initialized state.
+  fn();
+
+  uint64_t iterations = 0;
+  uint64_t batch = 1;
+  Clock::duration elapsed = Clock::duration::zero();
+  while (std::chrono::duration<double>(elapsed).count() < min_seconds) {
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < batch; ++i) {
+      fn();
+    }
+    elapsed += Clock::now() - start;
+    iterations += batch;
+    batch *= 2;
+  }
+
+  BenchmarkResult result;
+  result.iterations = iterations;
+  result.ns_per_op =
+      std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+  result.ops_per_second = 1e9 / result.ns_per_op;
+  printf("%-48s %12llu iterations %12.1f ns/op %12.0f ops/s\n", name,
+         static_cast<unsigned long long>(iterations), result.ns_per_op,
+         result.ops_per_second);
+  return result;
+}
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_UTILS_BENCHMARK_H_
@@ -0,0 +1,102 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/gzip_output_stream.h"
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+namespace {
+// Adding 16 to the window bits makes zlib write a gzip header and trailer
+// instead of a zlib one.
+const int kGzipWindowBits = 15 + 16;
+const int kMemLevel = 8;
+}  // namespace
+
+GzipOutputStream::GzipOutputStream(std::string* output, int level)
+    : output_(output), pending_(0), byte_count_(0) {
+  zstream_.zalloc = Z_NULL;
+  zstream_.zfree = Z_NULL;
+  zstream_.opaque = Z_NULL;
+  ok_ = deflateInit2(&zstream_, level, Z_DEFLATED, kGzipWindowBits, kMemLevel,
+                     Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipOutputStream::~GzipOutputStream() {
+  if (ok_) {
+    deflateEnd(&zstream_);
+  }
+}
+
+bool GzipOutputStream::Next(void** data, int* size) {
+  if (!ok_ || (pending_ > 0 && !Deflate(Z_NO_FLUSH))) {
+    return false;
+  }
+  *data = input_;
+  *size = kBufferSize;
+  pending_ = kBufferSize;
+  byte_count_ += kBufferSize;
+  return true;
+}
+
+void GzipOutputStream::BackUp(int count) {
+  pending_ -= count;
+  byte_count_ -= count;
+}
+
+int64_t GzipOutputStream::ByteCount() const { return byte_count_; }
+
+bool GzipOutputStream::Close() {
+  if (!ok_) {
+    return false;
+  }
+  if (!Deflate(Z_FINISH)) {
+    return false;
+  }
+  deflateEnd(&zstream_);
+  ok_ = false;
+  return true;
+}
+
+bool GzipOutputStream::Deflate(int flush) {
+  zstream_.next_in = reinterpret_cast<Bytef*>(input_);
+  zstream_.avail_in = pending_;
+  pending_ = 0;
+  int ret;
+  do {
+    // Grows the output by at least the bound of the input, so that most
+    // calls need a single deflate() pass.
+    size_t old_size = output_->size();
+    size_t chunk = deflateBound(&zstream_, zstream_.avail_in);
+    output_->resize(old_size + chunk);
+    zstream_.next_out = reinterpret_cast<Bytef*>(&(*output_)[old_size]);
+    zstream_.avail_out = chunk;
+    ret = deflate(&zstream_, flush);
+    output_->resize(old_size + chunk - zstream_.avail_out);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      ok_ = false;
+      deflateEnd(&zstream_);
+      return false;
+    }
+  } while (zstream_.avail_in > 0 ||
+           (flush == Z_FINISH && ret != Z_STREAM_END));
+  return true;
+}
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
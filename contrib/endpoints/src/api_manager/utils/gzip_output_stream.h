@@ -0,0 +1,74 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_UTILS_GZIP_OUTPUT_STREAM_H_
+#define API_MANAGER_UTILS_GZIP_OUTPUT_STREAM_H_
+
+#include <zlib.h>
+#include <cstdint>
+#include <string>
+
+#include "google/protobuf/io/zero_copy_stream.h"
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+// A ZeroCopyOutputStream that gzip-compresses everything written to it and
+// appends the result to a string. A protobuf serialized into it is
+// compressed as it is serialized, without an uncompressed copy of the whole
+// message.
+//
+// Close() must be called to finish the gzip stream before the output is
+// used.
+class GzipOutputStream : public ::google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  // The size of the input buffer handed out by Next().
+  static const int kBufferSize = 8192;
+
+  // Appends the compressed data to "output", which must outlive the stream.
+  // "level" is a zlib compression level.
+  explicit GzipOutputStream(std::string* output,
+                            int level = Z_DEFAULT_COMPRESSION);
+  virtual ~GzipOutputStream();
+
+  // ZeroCopyOutputStream interface.
+  virtual bool Next(void** data, int* size);
+  virtual void BackUp(int count);
+  virtual int64_t ByteCount() const;
+
+  // Compresses the remaining input and finishes the gzip stream. Returns
+  // false on a compression error. Nothing may be written afterwards.
+  bool Close();
+
+ private:
+  // Compresses the pending input into output_.
+  bool Deflate(int flush);
+
+  std::string* output_;
+  z_stream zstream_;
+  // Whether the stream is usable: initialized, not closed and no error.
+  bool ok_;
+  // The bytes of input_ handed out by the last Next() and not backed up.
+  int pending_;
+  // The number of uncompressed bytes written.
+  int64_t byte_count_;
+  char input_[kBufferSize];
+};
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_UTILS_GZIP_OUTPUT_STREAM_H_
@@ -0,0 +1,139 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/gzip_output_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "google/protobuf/struct.pb.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+namespace {
+
+// Decompresses gzip data. Returns false if it is not a complete gzip stream.
+bool Gunzip(const std::string& compressed, std::string* output) {
+  z_stream zstream;
+  memset(&zstream, 0, sizeof(zstream));
+  if (inflateInit2(&zstream, 15 + 16) != Z_OK) {
+    return false;
+  }
+  zstream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  zstream.avail_in = compressed.size();
+  output->clear();
+  char buffer[1024];
+  int ret;
+  do {
+    zstream.next_out = reinterpret_cast<Bytef*>(buffer);
+    zstream.avail_out = sizeof(buffer);
+    ret = inflate(&zstream, Z_NO_FLUSH);
+    output->append(buffer, sizeof(buffer) - zstream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&zstream);
+  return ret == Z_STREAM_END && zstream.avail_in == 0;
+}
+
+// Writes data through Next() and BackUp(), like a protobuf serializer.
+bool Write(GzipOutputStream* stream, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    void* buffer;
+    int size;
+    if (!stream->Next(&buffer, &size)) {
+      return false;
+    }
+    int n = std::min<size_t>(size, data.size() - written);
+    memcpy(buffer, data.data() + written, n);
+    written += n;
+    stream->BackUp(size - n);
+  }
+  return true;
+}
+
+TEST(GzipOutputStream, Empty) {
+  std::string compressed;
+  GzipOutputStream stream(&compressed);
+  ASSERT_TRUE(stream.Close());
+  std::string output;
+  ASSERT_TRUE(Gunzip(compressed, &output));
+  EXPECT_EQ("", output);
+  EXPECT_EQ(0, stream.ByteCount());
+}
+
+TEST(GzipOutputStream, LargeInput) {
+  std::string data;
+  for (int i = 0; i < 10000; ++i) {
+    data += "operation " + std::to_string(i % 37) + ";";
+  }
+  std::string compressed;
+  GzipOutputStream stream(&compressed);
+  // Writes in pieces that do not line up with the buffer.
+  ASSERT_TRUE(Write(&stream, data.substr(0, 100)));
+  ASSERT_TRUE(Write(&stream, data.substr(100)));
+  EXPECT_EQ(static_cast<int64_t>(data.size()), stream.ByteCount());
+  ASSERT_TRUE(stream.Close());
+  EXPECT_LT(compressed.size(), data.size() / 10);
+
+  std::string output;
+  ASSERT_TRUE(Gunzip(compressed, &output));
+  EXPECT_EQ(data, output);
+
+  // Nothing can be written after Close().
+  void* buffer;
+  int size;
+  EXPECT_FALSE(stream.Next(&buffer, &size));
+}
+
+TEST(GzipOutputStream, AppendsToOutput) {
+  std::string compressed = "prefix";
+  GzipOutputStream stream(&compressed);
+  ASSERT_TRUE(Write(&stream, "data"));
+  ASSERT_TRUE(stream.Close());
+  ASSERT_EQ(0, compressed.compare(0, 6, "prefix"));
+  std::string output;
+  ASSERT_TRUE(Gunzip(compressed.substr(6), &output));
+  EXPECT_EQ("data", output);
+}
+
+TEST(GzipOutputStream, SerializeProto) {
+  ::google::protobuf::Struct message;
+  for (int i = 0; i < 1000; ++i) {
+    (*message.mutable_fields())["key" + std::to_string(i)].set_string_value(
+        "value");
+  }
+  std::string compressed;
+  GzipOutputStream stream(&compressed);
+  ASSERT_TRUE(message.SerializeToZeroCopyStream(&stream));
+  ASSERT_TRUE(stream.Close());
+
+  std::string output;
+  ASSERT_TRUE(Gunzip(compressed, &output));
+  ::google::protobuf::Struct parsed;
+  ASSERT_TRUE(parsed.ParseFromString(output));
+  EXPECT_EQ(1000, parsed.fields_size());
+  EXPECT_EQ("value", parsed.fields().at("key999").string_value());
+}
+
+}  // namespace
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
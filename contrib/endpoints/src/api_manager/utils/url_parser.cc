@@ -0,0 +1,161 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/url_parser.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+namespace {
+
+// Check if an ASCII character is a hex digit.  We can't use ctype's
+// isxdigit() because it is affected by locale. This function is applied
+// to the escaped characters in a url, not to natural-language
+// strings, so locale should not be taken into account.
+inline bool ascii_isxdigit(char c) {
+  return ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F') ||
+         ('0' <= c && c <= '9');
+}
+
+inline int hex_digit_to_int(char c) {
+  /* Assume ASCII. */
+  int x = static_cast<unsigned char>(c);
+  if (x > '9') {
+    x += 9;
+  }
+  return x & 0xf;
+}
+
+}  // namespace
+
+const char *FindChar(const char *begin, const char *end, char c) {
+#if defined(__SSE2__)
+  const __m128i needle = _mm_set1_epi8(c);
+  while (end - begin >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+    begin += 16;
+  }
+#endif
+  // Scalar fallback, also handles the tail shorter than 16 bytes.
+  for (; begin < end; ++begin) {
+    if (*begin == c) {
+      return begin;
+    }
+  }
+  return end;
+}
+
+bool IsUrlReservedChar(char c) {
+  // Reserved characters according to RFC 6570
+  switch (c) {
+    case '!':
+    case '#':
+    case '$':
+    case '&':
+    case '\'':
+    case '(':
+    case ')':
+    case '*':
+    case '+':
+    case ',':
+    case '/':
+    case ':':
+    case ';':
+    case '=':
+    case '?':
+    case '@':
+    case '[':
+    case ']':
+      return true;
+    default:
+      return false;
+  }
+}
+
+void UrlUnescapeAppend(const char *data, size_t size,
+                       bool unescape_reserved_chars, std::string *out) {
+  // The unescaped string is never longer than the escaped one.
+  size_t old_size = out->size();
+  out->resize(old_size + size);
+  char *begin = &(*out)[0];
+  char *dst = begin + old_size;
+
+  const char *p = data;
+  const char *end = data + size;
+  while (p < end) {
+    // Copy the run of plain characters up to the next '%' in one go.
+    const char *percent = FindChar(p, end, '%');
+    memcpy(dst, p, percent - p);
+    dst += percent - p;
+    if (percent == end) {
+      break;
+    }
+    // An escape is "%[0-9A-Fa-f]{2}".
+    if (end - percent > 2 && ascii_isxdigit(percent[1]) &&
+        ascii_isxdigit(percent[2])) {
+      char c = (hex_digit_to_int(percent[1]) << 4) |
+               hex_digit_to_int(percent[2]);
+      if (unescape_reserved_chars || !IsUrlReservedChar(c)) {
+        *dst++ = c;
+        p = percent + 3;
+        continue;
+      }
+    }
+    *dst++ = '%';
+    p = percent + 1;
+  }
+  out->resize(dst - begin);
+}
+
+std::string UrlUnescape(const std::string &src, bool unescape_reserved_chars) {
+  std::string unescaped;
+  UrlUnescapeAppend(src.data(), src.size(), unescape_reserved_chars,
+                    &unescaped);
+  return unescaped;
+}
+
+void ParseQueryString(const char *data, size_t size,
+                      std::vector<QueryParameter> *params) {
+  const char *p = data;
+  const char *end = data + size;
+  while (p < end) {
+    const char *amp = FindChar(p, end, '&');
+    const char *eq = FindChar(p, amp, '=');
+    if (eq != p && eq != amp) {
+      params->push_back(QueryParameter{p, static_cast<size_t>(eq - p), eq + 1,
+                                       static_cast<size_t>(amp - eq - 1)});
+    }
+    if (amp == end) {
+      break;
+    }
+    p = amp + 1;
+  }
+}
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
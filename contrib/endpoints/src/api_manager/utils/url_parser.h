@@ -0,0 +1,62 @@
+/* Copyright 2017 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef API_MANAGER_UTILS_URL_PARSER_H_
+#define API_MANAGER_UTILS_URL_PARSER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+// Returns a pointer to the first occurrence of c in [begin, end), or end if
+// there is none. Scans 16 bytes at a time with SSE2 when available.
+const char *FindChar(const char *begin, const char *end, char c);
+
+// Returns true if c is a reserved character according to RFC 6570.
+bool IsUrlReservedChar(char c);
+
+// Percent-decodes [data, data + size) and appends the result to out.
+// A '%' not followed by two hex digits is copied as is. Reserved characters
+// (as specified in RFC 6570) are left escaped if unescape_reserved_chars is
+// false.
+void UrlUnescapeAppend(const char *data, size_t size,
+                       bool unescape_reserved_chars, std::string *out);
+
+// Same as above, but returns the unescaped string.
+std::string UrlUnescape(const std::string &src, bool unescape_reserved_chars);
+
+// A name=value parameter of a query string. Both point into the parsed
+// query string, which must outlive the parameter.
+struct QueryParameter {
+  const char *name;
+  size_t name_size;
+  const char *value;
+  size_t value_size;
+};
+
+// Splits a query string of the form "name1=value1&name2=value2" into its
+// parameters without copying or unescaping them. Parameters without '=' or
+// with an empty name are skipped. The parameters are appended to params.
+void ParseQueryString(const char *data, size_t size,
+                      std::vector<QueryParameter> *params);
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
+
+#endif  // API_MANAGER_UTILS_URL_PARSER_H_
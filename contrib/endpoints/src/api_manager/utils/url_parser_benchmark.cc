@@ -0,0 +1,170 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Compares the url_parser functions against the byte-at-a-time,
+// std::stringstream based implementation they replaced in path_matcher.h.
+//
+#include "contrib/endpoints/src/api_manager/utils/benchmark.h"
+#include "contrib/endpoints/src/api_manager/utils/url_parser.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace api_manager {
+namespace utils {
+namespace {
+
+// The previous implementation, kept here as the baseline.
+namespace baseline {
+
+bool GetEscapedChar(const std::string &src, size_t i, char *out) {
+  if (i + 2 < src.size() && src[i] == '%') {
+    auto isxdigit = [](char c) {
+      return ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F') ||
+             ('0' <= c && c <= '9');
+    };
+    auto digit = [](char c) {
+      int x = static_cast<unsigned char>(c);
+      return (x > '9' ? x + 9 : x) & 0xf;
+    };
+    if (isxdigit(src[i + 1]) && isxdigit(src[i + 2])) {
+      *out = (digit(src[i + 1]) << 4) | digit(src[i + 2]);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string UrlUnescapeString(const std::string &part) {
+  char ch = '\0';
+  bool needs_unescaping = false;
+  for (size_t i = 0; i < part.size(); ++i) {
+    if (GetEscapedChar(part, i, &ch)) {
+      needs_unescaping = true;
+      break;
+    }
+  }
+  if (!needs_unescaping) {
+    return part;
+  }
+  std::string unescaped;
+  unescaped.resize(part.size());
+  char *begin = &unescaped[0];
+  char *p = begin;
+  for (size_t i = 0; i < part.size();) {
+    if (GetEscapedChar(part, i, &ch)) {
+      *p++ = ch;
+      i += 3;
+    } else {
+      *p++ = part[i];
+      i += 1;
+    }
+  }
+  unescaped.resize(p - begin);
+  return unescaped;
+}
+
+size_t ParseAndUnescape(const std::string &query) {
+  std::vector<std::string> params;
+  std::stringstream ss(query);
+  std::string item;
+  while (std::getline(ss, item, '&')) {
+    params.push_back(item);
+  }
+  size_t total = 0;
+  for (const auto &param : params) {
+    size_t pos = param.find('=');
+    if (pos != 0 && pos != std::string::npos) {
+      total += param.substr(0, pos).size();
+      total += UrlUnescapeString(param.substr(pos + 1)).size();
+    }
+  }
+  return total;
+}
+
+}  // namespace baseline
+
+size_t ParseAndUnescape(const std::string &query) {
+  std::vector<QueryParameter> params;
+  ParseQueryString(query.data(), query.size(), &params);
+  size_t total = 0;
+  std::string value;
+  for (const auto &param : params) {
+    value.clear();
+    UrlUnescapeAppend(param.value, param.value_size, true, &value);
+    total += param.name_size + value.size();
+  }
+  return total;
+}
+
+// A ~2.5 KB query string with marketing and tracking parameters.
+std::string TrackingQuery() {
+  std::string query =
+      "utm_source=newsletter&utm_medium=email&utm_campaign=spring_sale_2017"
+      "&utm_term=running%20shoes&utm_content=hero_banner_v2"
+      "&gclid=EAIaIQobChMI4p3b2Y3x0wIVhLXtCh0Xcw5WEAAYASAAEgJXsfD_BwE"
+      "&fbclid=IwAR2F4-dbP0l-5a1E0mBZmRj5pZcVNf4tUE3k2aWbCFNmT3G0EoZLt8Q";
+  for (int i = 0; i < 40; ++i) {
+    query += "&_ga_session" + std::to_string(i) +
+             "=GA1.2.1234567890.1497000000.session%3D" + std::to_string(i);
+  }
+  return query;
+}
+
+// A ~3 KB query string dominated by one big percent-encoded filter.
+std::string FilterQuery() {
+  std::string query = "pageSize=100&orderBy=create_time%20desc&filter=";
+  for (int i = 0; i < 60; ++i) {
+    if (i > 0) {
+      query += "%20OR%20";
+    }
+    query += "(labels.env%3D%22prod%22%20AND%20name%3A%22shelf" +
+             std::to_string(i) + "%22)";
+  }
+  return query;
+}
+
+void Run(const char *name, const std::string &query) {
+  printf("%s: %zu bytes\n", name, query.size());
+  RunBenchmark("  baseline stringstream + scalar unescape",
+               [&]() { DoNotOptimize(baseline::ParseAndUnescape(query)); });
+  RunBenchmark("  ParseQueryString + UrlUnescapeAppend",
+               [&]() { DoNotOptimize(ParseAndUnescape(query)); });
+  RunBenchmark("  baseline UrlUnescapeString (whole query)", [&]() {
+    DoNotOptimize(baseline::UrlUnescapeString(query));
+  });
+  RunBenchmark("  UrlUnescape (whole query)",
+               [&]() { DoNotOptimize(UrlUnescape(query, true)); });
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
+
+int main() {
+  using namespace ::google::api_manager::utils;
+#if defined(__SSE2__)
+  printf("FindChar: SSE2\n");
+#else
+  printf("FindChar: scalar\n");
+#endif
+  Run("tracking parameters", TrackingQuery());
+  Run("filter expression", FilterQuery());
+  return 0;
+}
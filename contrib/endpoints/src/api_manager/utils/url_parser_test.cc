@@ -0,0 +1,118 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+#include "contrib/endpoints/src/api_manager/utils/url_parser.h"
+
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api_manager {
+namespace utils {
+
+namespace {
+
+std::vector<std::pair<std::string, std::string>> Parse(
+    const std::string &query) {
+  std::vector<QueryParameter> params;
+  ParseQueryString(query.data(), query.size(), &params);
+  std::vector<std::pair<std::string, std::string>> result;
+  for (const auto &param : params) {
+    result.emplace_back(std::string(param.name, param.name_size),
+                        std::string(param.value, param.value_size));
+  }
+  return result;
+}
+
+typedef std::vector<std::pair<std::string, std::string>> Params;
+
+}  // namespace
+
+TEST(UrlParser, FindChar) {
+  // Long enough to exercise both the 16-byte blocks and the scalar tail.
+  std::string s = "abcdefghijklmnopqrstuvwxyz0123456789%";
+  const char *begin = s.data();
+  const char *end = begin + s.size();
+  for (size_t i = 0; i < s.size(); ++i) {
+    EXPECT_EQ(begin + i, FindChar(begin, end, s[i]));
+  }
+  EXPECT_EQ(end, FindChar(begin, end, '&'));
+  EXPECT_EQ(begin + 3, FindChar(begin, begin + 3, 'z'));
+  EXPECT_EQ(begin, FindChar(begin, begin, 'a'));
+}
+
+TEST(UrlParser, UrlUnescape) {
+  EXPECT_EQ("", UrlUnescape("", true));
+  EXPECT_EQ("abc", UrlUnescape("abc", true));
+  EXPECT_EQ("a b", UrlUnescape("a%20b", true));
+  EXPECT_EQ("Neal Stephenson", UrlUnescape("Neal%20Stephenson", true));
+  EXPECT_EQ("\xff", UrlUnescape("%ff", true));
+  EXPECT_EQ("\xff", UrlUnescape("%FF", true));
+  // Invalid escapes are copied as is.
+  EXPECT_EQ("%", UrlUnescape("%", true));
+  EXPECT_EQ("%2", UrlUnescape("%2", true));
+  EXPECT_EQ("%2x", UrlUnescape("%2x", true));
+  EXPECT_EQ("%%20", UrlUnescape("%%2520", true));
+  EXPECT_EQ("%a", UrlUnescape("%%61", true));
+  // Reserved characters.
+  EXPECT_EQ("a/b", UrlUnescape("a%2Fb", true));
+  EXPECT_EQ("a%2Fb", UrlUnescape("a%2Fb", false));
+  EXPECT_EQ("a%3a b", UrlUnescape("a%3a%20b", false));
+}
+
+TEST(UrlParser, UrlUnescapeLongString) {
+  std::string escaped;
+  std::string expected;
+  for (int i = 0; i < 100; ++i) {
+    escaped += "filter%3Dname%20eq%20%27value" + std::to_string(i) + "%27&";
+    expected += "filter=name eq 'value" + std::to_string(i) + "'&";
+  }
+  EXPECT_EQ(expected, UrlUnescape(escaped, true));
+
+  std::string out = "prefix:";
+  UrlUnescapeAppend(escaped.data(), escaped.size(), true, &out);
+  EXPECT_EQ("prefix:" + expected, out);
+}
+
+TEST(UrlParser, ParseQueryString) {
+  EXPECT_EQ(Params(), Parse(""));
+  EXPECT_EQ(Params(), Parse("&&&"));
+  EXPECT_EQ(Params({{"a", "b"}}), Parse("a=b"));
+  EXPECT_EQ(Params({{"a", "b"}, {"c", "d"}}), Parse("a=b&c=d"));
+  EXPECT_EQ(Params({{"a", ""}, {"c", "d=e"}}), Parse("a=&c=d=e&"));
+  // Parameters without '=' or with an empty name are skipped.
+  EXPECT_EQ(Params({{"c", "d"}}), Parse("a&=b&c=d"));
+  // Values are not unescaped.
+  EXPECT_EQ(Params({{"book.author", "Neal%20Stephenson"}}),
+            Parse("book.author=Neal%20Stephenson"));
+}
+
+TEST(UrlParser, ParseLongQueryString) {
+  std::string query;
+  for (int i = 0; i < 200; ++i) {
+    query += "utm_param" + std::to_string(i) + "=value" + std::to_string(i);
+    query += "&";
+  }
+  auto params = Parse(query);
+  ASSERT_EQ(200, params.size());
+  for (int i = 0; i < 200; ++i) {
+    EXPECT_EQ("utm_param" + std::to_string(i), params[i].first);
+    EXPECT_EQ("value" + std::to_string(i), params[i].second);
+  }
+}
+
+}  // namespace utils
+}  // namespace api_manager
+}  // namespace google
@@ -83,11 +83,16 @@ class TestMethodInfo : public MethodInfo {
   const std::vector<std::string> *api_key_url_query_parameters() const {
     return nullptr;
   }
+  const std::vector<std::string> &api_key_lookup_queries() const {
+    return empty_vector_;
+  }
+  const std::vector<std::string> &api_key_lookup_headers() const {
+    return empty_vector_;
+  }
   const std::string &backend_address() const { return empty_; }
   const std::string &rpc_method_full_name() const { return empty_; }
-  const std::set<std::string> &system_query_parameter_names() const {
-    static std::set<std::string> dummy;
-    return dummy;
+  const std::vector<std::string> &system_query_parameter_names() const {
+    return empty_vector_;
   };
 
   const std::vector<std::pair<std::string, int>> &metric_cost_vector() const {
@@ -108,6 +113,7 @@ class TestMethodInfo : public MethodInfo {
   bool response_streaming_;
   std::string body_field_path_;
   std::string empty_;
+  std::vector<std::string> empty_vector_;
   std::vector<std::pair<std::string, int>> metric_cost_vector_;
 };
 
@@ -36,8 +36,8 @@ class MethodInfo {
  public:
   MethodInfo(const google::protobuf::MethodDescriptor* method)
       : method_(method) {}
-  const std::set<std::string> system_query_parameter_names() const {
-    return std::set<std::string>();
+  const std::vector<std::string> system_query_parameter_names() const {
+    return std::vector<std::string>();
   }
   const google::protobuf::MethodDescriptor* method() const { return method_; }
 